@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Helpers shared by the host-side benchmarks: synthetic inputs and low discrepancy sequences.
+// Nothing in here needs a Vulkan device.
+//
+
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+// Lat-long environment (RGB32F) with a sky gradient, a darker ground and a small very bright sun.
+// This is the typical case where importance sampling matters: most of the energy is in a few texels.
+inline std::vector<float> makeSyntheticEnvironment(uint32_t width, uint32_t height, float sunIntensity = 20000.f)
+{
+  std::vector<float> pixels(size_t(width) * height * 3);
+  const float        sun[3]    = {0.3f, 0.8f, 0.52f};
+  const float        sunLen    = std::sqrt(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+  const float        cosSunRad = std::cos(0.02f);  // ~1 degree
+
+  for(uint32_t y = 0; y < height; ++y)
+  {
+    const float theta = (float(y) + 0.5f) / float(height) * float(M_PI);
+    for(uint32_t x = 0; x < width; ++x)
+    {
+      const float phi = (float(x) + 0.5f) / float(width) * float(2.0 * M_PI) - float(M_PI);
+      const float d[3]{std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta)};
+      float*      p = &pixels[(size_t(y) * width + x) * 3];
+
+      if(d[1] > 0.f)
+      {
+        p[0] = 0.3f + 0.2f * d[1];
+        p[1] = 0.5f + 0.2f * d[1];
+        p[2] = 0.9f + 0.3f * d[1];
+      }
+      else
+      {
+        p[0] = p[1] = p[2] = 0.1f;
+      }
+      const float cosSun = (d[0] * sun[0] + d[1] * sun[1] + d[2] * sun[2]) / sunLen;
+      if(cosSun > cosSunRad)
+      {
+        p[0] += sunIntensity;
+        p[1] += sunIntensity * 0.95f;
+        p[2] += sunIntensity * 0.85f;
+      }
+    }
+  }
+  return pixels;
+}
+
+// Radical inverse in base b, used for the Halton sequence
+inline float radicalInverse(uint32_t i, uint32_t base)
+{
+  const float invBase = 1.f / float(base);
+  float       inv     = invBase;
+  float       result  = 0.f;
+  while(i > 0)
+  {
+    result += float(i % base) * inv;
+    i /= base;
+    inv *= invBase;
+  }
+  return std::min(result, 0.99999994f);
+}
+
+// Random or Halton (with a random Cranley-Patterson rotation) point set in [0,1)^3
+struct SampleSet
+{
+  bool                                  qmc{false};
+  float                                 shift[3]{0.f, 0.f, 0.f};
+  std::mt19937                          rng{};
+  std::uniform_real_distribution<float> dist{0.f, 0.99999994f};
+
+  SampleSet(bool useQmc, uint32_t seed)
+      : qmc(useQmc)
+      , rng(seed)
+  {
+    for(auto& s : shift)
+      s = dist(rng);
+  }
+
+  void get(uint32_t i, float xi[3])
+  {
+    static const uint32_t bases[3] = {2, 3, 5};
+    for(int d = 0; d < 3; ++d)
+    {
+      if(qmc)
+      {
+        xi[d] = radicalInverse(i, bases[d]) + shift[d];
+        xi[d] = xi[d] >= 1.f ? xi[d] - 1.f : xi[d];
+      }
+      else
+        xi[d] = dist(rng);
+    }
+  }
+};
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Environment importance sampling: alias map (EnvAccel) versus luminance mip pyramid.
+// - Build: time to create the sampling data and its size ("bytes")
+// - Variance: relative variance of the irradiance estimate on an upward facing surface, using
+//   random or QMC (Halton) samples. The samplers mirror the ones in env_sampling.glsl.
+// - MisGlossy: equal-time comparison of the MIS compensation on a glossy lobe, combining
+//   environment and BSDF sampling as pathtrace.glsl does.
+//
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_common.hpp"
+#include "hdr_sampling.hpp"
+
+
+namespace {
+
+struct EnvDirSample
+{
+  float dir[3];
+  float u, v;
+  float pdf;
+};
+
+// Uniformly sampling the solid angle of texel (px, py) of a (width x height) lat-long grid
+void sampleTexel(uint32_t px, uint32_t py, uint32_t width, uint32_t height, float xu, float xv, EnvDirSample& s)
+{
+  s.u                   = (float(px) + xu) / float(width);
+  const float phi       = s.u * float(2.0 * M_PI) - float(M_PI);
+  const float stepTheta = float(M_PI) / float(height);
+  const float theta0    = float(py) * stepTheta;
+  const float cosTheta  = std::cos(theta0) * (1.0f - xv) + std::cos(theta0 + stepTheta) * xv;
+  const float theta     = std::acos(cosTheta);
+  const float sinTheta  = std::sin(theta);
+  s.v                   = theta / float(M_PI);
+  s.dir[0]              = std::cos(phi) * sinTheta;
+  s.dir[1]              = cosTheta;
+  s.dir[2]              = std::sin(phi) * sinTheta;
+}
+
+// Same as Environment_sample()
+void sampleAliasMap(const std::vector<EnvAccel>& accel, uint32_t width, uint32_t height, float xi[3], EnvDirSample& s)
+{
+  const uint32_t size = width * height;
+  const uint32_t idx  = std::min(uint32_t(xi[0] * float(size)), size - 1);
+  const EnvAccel& e   = accel[idx];
+  uint32_t        envIdx;
+  if(xi[1] < e.q)
+  {
+    envIdx = idx;
+    xi[1] /= e.q;
+    s.pdf = e.pdf;
+  }
+  else
+  {
+    envIdx = e.alias;
+    xi[1]  = (xi[1] - e.q) / (1.0f - e.q);
+    s.pdf  = e.aliasPdf;
+  }
+  sampleTexel(envIdx % width, envIdx / width, width, height, xi[1], xi[2], s);
+}
+
+bool warpSelect(float p, float& xi)
+{
+  if(xi < p)
+  {
+    xi /= p;
+    return true;
+  }
+  xi = (xi - p) / (1.0f - p);
+  return false;
+}
+
+// Same as Environment_sampleMip()
+void samplePyramid(const std::vector<float>& pyr, uint32_t nbLevels, float xi[2], EnvDirSample& s)
+{
+  const float total = pyr[0] + pyr[1];
+  uint32_t    px = 0, py = 0;
+  if(!warpSelect(total > 0.f ? pyr[0] / total : 0.5f, xi[0]))
+    px = 1;
+
+  for(uint32_t level = 1; level < nbLevels; level++)
+  {
+    const uint32_t width = 2u << level;
+    px *= 2;
+    py *= 2;
+    const uint32_t idx = HdrSampling::pyramidOffset(level) + py * width + px;
+    float          v00 = pyr[idx], v10 = pyr[idx + 1], v01 = pyr[idx + width], v11 = pyr[idx + width + 1];
+    float          top = v00 + v10;
+    float          sum = top + v01 + v11;
+    float          l = v00, r = v10;
+    if(!warpSelect(sum > 0.f ? top / sum : 0.5f, xi[1]))
+    {
+      py += 1;
+      l = v01;
+      r = v11;
+    }
+    if(!warpSelect(l + r > 0.f ? l / (l + r) : 0.5f, xi[0]))
+      px += 1;
+  }
+
+  const uint32_t width  = 2u << (nbLevels - 1);
+  const uint32_t height = 1u << (nbLevels - 1);
+  const float    leaf   = pyr[HdrSampling::pyramidOffset(nbLevels - 1) + py * width + px];
+  sampleTexel(px, py, width, height, std::min(xi[0], 0.99999994f), std::min(xi[1], 0.99999994f), s);
+
+  const float stepTheta = float(M_PI) / float(height);
+  const float area = (std::cos(float(py) * stepTheta) - std::cos(float(py + 1) * stepTheta)) * float(2.0 * M_PI) / float(width);
+  s.pdf = leaf / (total * area);
+}
+
+// Nearest texel lookup of the luminance
+float lookup(const std::vector<float>& pixels, uint32_t width, uint32_t height, float u, float v)
+{
+  uint32_t     x = std::min(uint32_t(u * float(width)), width - 1);
+  uint32_t     y = std::min(uint32_t(v * float(height)), height - 1);
+  const float* p = &pixels[(size_t(y) * width + x) * 3];
+  return p[0] * 0.2126f + p[1] * 0.7152f + p[2] * 0.0722f;
+}
+
+// Direction to lat-long coordinates, same as GetSphericalUv()
+void directionToUv(const float dir[3], float& u, float& v)
+{
+  u = std::atan2(dir[2], dir[0]) / float(2.0 * M_PI) + 0.5f;
+  v = std::acos(std::max(-1.f, std::min(1.f, dir[1]))) / float(M_PI);
+}
+
+// Same as EnvPdf()
+float pdfAliasMap(const std::vector<EnvAccel>& accel, uint32_t width, uint32_t height, float u, float v)
+{
+  uint32_t x = std::min(uint32_t(u * float(width)), width - 1);
+  uint32_t y = std::min(uint32_t(v * float(height)), height - 1);
+  return accel[y * width + x].pdf;
+}
+
+float pdfPyramid(const std::vector<float>& pyr, uint32_t nbLevels, float u, float v)
+{
+  const uint32_t width     = 2u << (nbLevels - 1);
+  const uint32_t height    = 1u << (nbLevels - 1);
+  const uint32_t x         = std::min(uint32_t(u * float(width)), width - 1);
+  const uint32_t y         = std::min(uint32_t(v * float(height)), height - 1);
+  const float    stepTheta = float(M_PI) / float(height);
+  const float area = (std::cos(float(y) * stepTheta) - std::cos(float(y + 1) * stepTheta)) * float(2.0 * M_PI) / float(width);
+  return pyr[HdrSampling::pyramidOffset(nbLevels - 1) + y * width + x] / ((pyr[0] + pyr[1]) * area);
+}
+
+// Normalized Phong lobe around axis r: (n+1)/(2pi) cos^n, sampled exactly (pdf == value)
+struct PhongLobe
+{
+  float r[3], t[3], b[3];
+  float n;
+
+  PhongLobe(const float axis[3], float exponent)
+      : n(exponent)
+  {
+    const float len = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for(int i = 0; i < 3; ++i)
+      r[i] = axis[i] / len;
+    // Orthonormal basis, "Building an Orthonormal Basis, Revisited"
+    const float sign = std::copysign(1.f, r[2]);
+    const float a    = -1.f / (sign + r[2]);
+    const float c    = r[0] * r[1] * a;
+    t[0] = 1.f + sign * r[0] * r[0] * a, t[1] = sign * c, t[2] = -sign * r[0];
+    b[0] = c, b[1] = sign + r[1] * r[1] * a, b[2] = -r[1];
+  }
+
+  float eval(const float d[3]) const
+  {
+    const float c = d[0] * r[0] + d[1] * r[1] + d[2] * r[2];
+    return c > 0.f ? (n + 1.f) / float(2.0 * M_PI) * std::pow(c, n) : 0.f;
+  }
+
+  void sample(float x0, float x1, float d[3]) const
+  {
+    const float cosA = std::pow(1.f - x0, 1.f / (n + 1.f));
+    const float sinA = std::sqrt(std::max(0.f, 1.f - cosA * cosA));
+    const float phi  = float(2.0 * M_PI) * x1;
+    for(int i = 0; i < 3; ++i)
+      d[i] = t[i] * std::cos(phi) * sinA + b[i] * std::sin(phi) * sinA + r[i] * cosA;
+  }
+};
+
+inline float powerHeuristic(float a, float b)
+{
+  const float t = a * a;
+  return t / (b * b + t);
+}
+
+uint32_t pyramidLevels(const std::vector<float>& pyr)
+{
+  uint32_t levels = 1;
+  while(HdrSampling::pyramidOffset(levels) < pyr.size())
+    levels++;
+  return levels;
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Building the sampling data, argument is the width of the environment (height is half)
+//
+static void BM_EnvBuild(benchmark::State& state, EnvSampling method)
+{
+  const uint32_t width  = static_cast<uint32_t>(state.range(0));
+  const uint32_t height = width / 2;
+  auto           pixels = makeSyntheticEnvironment(width, height);
+  VkExtent2D     size{width, height};
+  HdrSampling    hdr;
+  size_t         bytes = 0;
+
+  for(auto _ : state)
+  {
+    if(method == eEnvMipPyramid)
+    {
+      auto pyramid = hdr.createEnvironmentPyramid(pixels.data(), size);
+      bytes        = pyramid.size() * sizeof(float);
+      benchmark::DoNotOptimize(pyramid.data());
+    }
+    else
+    {
+      auto accel = hdr.createEnvironmentAccel(pixels.data(), size);
+      bytes      = accel.size() * sizeof(EnvAccel);
+      benchmark::DoNotOptimize(accel.data());
+    }
+  }
+
+  state.counters["bytes"] = static_cast<double>(bytes);
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * height);
+}
+BENCHMARK_CAPTURE(BM_EnvBuild, alias, eEnvAliasMap)->Arg(1024)->Arg(2048)->Arg(4096)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_EnvBuild, mip, eEnvMipPyramid)->Arg(1024)->Arg(2048)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+// Alias map alone, from the solid angle weighted luminance of the texels
+static void BM_BuildAliasmap(benchmark::State& state)
+{
+  const uint32_t width  = static_cast<uint32_t>(state.range(0));
+  const uint32_t height = width / 2;
+  const auto     pixels = makeSyntheticEnvironment(width, height);
+
+  std::vector<float> importance(size_t(width) * height);
+  for(uint32_t y = 0; y < height; ++y)
+  {
+    const float sinTheta = std::sin((float(y) + 0.5f) / float(height) * float(M_PI));
+    for(uint32_t x = 0; x < width; ++x)
+    {
+      const float* p                    = &pixels[(size_t(y) * width + x) * 3];
+      importance[size_t(y) * width + x] = (0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2]) * sinTheta;
+    }
+  }
+
+  HdrSampling           hdr;
+  std::vector<EnvAccel> accel(importance.size());
+  for(auto _ : state)
+  {
+    benchmark::DoNotOptimize(hdr.buildAliasmap(importance, accel));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * height);
+}
+BENCHMARK(BM_BuildAliasmap)->Arg(1024)->Arg(2048)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+
+//--------------------------------------------------------------------------------------------------
+// Variance of the irradiance estimate E = sum(L * cos / pdf) / N on an upward facing surface.
+// Each iteration is one estimate with N samples; arguments: {QMC (0/1), N}
+//
+static void BM_EnvVariance(benchmark::State& state, EnvSampling method)
+{
+  const bool     qmc       = state.range(0) != 0;
+  const uint32_t nbSamples = static_cast<uint32_t>(state.range(1));
+  const uint32_t width     = 1024;
+  const uint32_t height    = 512;
+  auto           pixels    = makeSyntheticEnvironment(width, height);
+  VkExtent2D     size{width, height};
+  HdrSampling    hdr;
+
+  std::vector<EnvAccel> accel;
+  std::vector<float>    pyramid;
+  uint32_t              levels = 0;
+  if(method == eEnvMipPyramid)
+  {
+    pyramid = hdr.createEnvironmentPyramid(pixels.data(), size);
+    levels  = pyramidLevels(pyramid);
+  }
+  else
+    accel = hdr.createEnvironmentAccel(pixels.data(), size);
+
+  std::vector<double> estimates;
+  uint32_t            trial = 0;
+  for(auto _ : state)
+  {
+    SampleSet set(qmc, trial++);
+    double    sum = 0.0;
+    for(uint32_t i = 0; i < nbSamples; ++i)
+    {
+      float        xi[3];
+      EnvDirSample s{};
+      set.get(i, xi);
+      if(method == eEnvMipPyramid)
+        samplePyramid(pyramid, levels, xi, s);
+      else
+        sampleAliasMap(accel, width, height, xi, s);
+
+      const float cosTheta = s.dir[1];  // normal is +Y
+      if(s.pdf > 0.f && cosTheta > 0.f)
+        sum += lookup(pixels, width, height, s.u, s.v) * cosTheta / s.pdf;
+    }
+    estimates.push_back(sum / nbSamples);
+  }
+
+  double mean = 0.0, var = 0.0;
+  for(double e : estimates)
+    mean += e;
+  mean /= double(estimates.size());
+  for(double e : estimates)
+    var += (e - mean) * (e - mean);
+  var /= double(std::max<size_t>(1, estimates.size() - 1));
+
+  state.counters["mean"]        = mean;
+  state.counters["relVariance"] = mean > 0.0 ? var / (mean * mean) : 0.0;
+  state.SetItemsProcessed(state.iterations() * nbSamples);
+}
+BENCHMARK_CAPTURE(BM_EnvVariance, alias, eEnvAliasMap)->ArgsProduct({{0, 1}, {16, 256}});
+BENCHMARK_CAPTURE(BM_EnvVariance, mip, eEnvMipPyramid)->ArgsProduct({{0, 1}, {16, 256}});
+
+
+//--------------------------------------------------------------------------------------------------
+// Reflected radiance of a glossy lobe (normal +Y) under the synthetic environment, one light sample and
+// one BSDF sample per estimate, combined with the power heuristic.
+// Arguments: {MIS compensation in percent of the average, Phong exponent}
+// "relVariance" is per estimate, "efficiency" is 1 / (relVariance * microseconds per estimate): the
+// equal-time figure of merit, higher is better.
+//
+static void BM_EnvMisGlossy(benchmark::State& state, EnvSampling method)
+{
+  const float    fraction = static_cast<float>(state.range(0)) / 100.f;
+  const float    exponent = static_cast<float>(state.range(1));
+  const uint32_t width    = 1024;
+  const uint32_t height   = 512;
+  auto           pixels   = makeSyntheticEnvironment(width, height);
+  VkExtent2D     size{width, height};
+  HdrSampling    hdr;
+  hdr.setMisCompensation(fraction);
+
+  std::vector<EnvAccel> accel;
+  std::vector<float>    pyramid;
+  uint32_t              levels = 0;
+  if(method == eEnvMipPyramid)
+  {
+    pyramid = hdr.createEnvironmentPyramid(pixels.data(), size);
+    levels  = pyramidLevels(pyramid);
+  }
+  else
+    accel = hdr.createEnvironmentAccel(pixels.data(), size);
+
+  auto envPdf = [&](float u, float v) {
+    return method == eEnvMipPyramid ? pdfPyramid(pyramid, levels, u, v) : pdfAliasMap(accel, width, height, u, v);
+  };
+  // Integrand: environment * lobe * cosine with the normal
+  const float axis[3] = {-0.5f, 0.7f, 0.3f};
+  PhongLobe   lobe(axis, exponent);
+  auto        integrand = [&](const float d[3], float u, float v) {
+    return d[1] > 0.f ? lookup(pixels, width, height, u, v) * lobe.eval(d) * d[1] : 0.f;
+  };
+
+  const uint32_t nbEstimates = 64;
+  SampleSet      set(false, 1);
+  double         sum = 0.0, sum2 = 0.0;
+  uint64_t       count = 0;
+  double         seconds = 0.0;
+  for(auto _ : state)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    for(uint32_t i = 0; i < nbEstimates; ++i)
+    {
+      float xi[3], xb[3];
+      set.get(i, xi);
+      set.get(i, xb);
+      double estimate = 0.0;
+
+      // Light sample
+      EnvDirSample s{};
+      if(method == eEnvMipPyramid)
+        samplePyramid(pyramid, levels, xi, s);
+      else
+        sampleAliasMap(accel, width, height, xi, s);
+      if(s.pdf > 0.f)
+        estimate += powerHeuristic(s.pdf, lobe.eval(s.dir)) * integrand(s.dir, s.u, s.v) / s.pdf;
+
+      // BSDF sample
+      float d[3], u, v;
+      lobe.sample(xb[0], xb[1], d);
+      directionToUv(d, u, v);
+      const float bsdfPdf = lobe.eval(d);
+      if(bsdfPdf > 0.f)
+        estimate += powerHeuristic(bsdfPdf, envPdf(u, v)) * integrand(d, u, v) / bsdfPdf;
+
+      sum += estimate;
+      sum2 += estimate * estimate;
+    }
+    count += nbEstimates;
+    seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    benchmark::DoNotOptimize(sum);
+  }
+
+  const double mean        = sum / double(count);
+  const double var         = std::max(0.0, sum2 / double(count) - mean * mean);
+  const double relVariance = mean > 0.0 ? var / (mean * mean) : 0.0;
+  const double usPerSample = seconds * 1e6 / double(count);
+
+  state.counters["mean"]        = mean;
+  state.counters["relVariance"] = relVariance;
+  state.counters["efficiency"]  = relVariance > 0.0 ? 1.0 / (relVariance * usPerSample) : 0.0;
+  state.SetItemsProcessed(int64_t(count));
+}
+BENCHMARK_CAPTURE(BM_EnvMisGlossy, alias, eEnvAliasMap)->ArgsProduct({{0, 50, 100}, {10, 100}});
+BENCHMARK_CAPTURE(BM_EnvMisGlossy, mip, eEnvMipPyramid)->ArgsProduct({{0, 50, 100}, {10, 100}});
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Image loading: stb_image versus the parallel decoders of image_io.
+// The input is the synthetic environment written as a RLE Radiance file in the temp directory.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <filesystem>
+
+#include "bench_common.hpp"
+#include "image_io.hpp"
+#include "stb_image.h"
+
+
+namespace {
+
+// Run-length encoding of one component of a scanline, as the reference Radiance writer
+void writeRleComponent(const uint8_t* data, uint32_t count, std::vector<uint8_t>& out)
+{
+  uint32_t cur = 0;
+  while(cur < count)
+  {
+    // Looking for a run of at least 4
+    uint32_t begRun = cur, runCount = 0, oldRunCount = 0;
+    while(runCount < 4 && begRun < count)
+    {
+      begRun += runCount;
+      oldRunCount = runCount;
+      runCount    = 1;
+      while(begRun + runCount < count && runCount < 127 && data[begRun] == data[begRun + runCount])
+        runCount++;
+    }
+    // A short run before the long one
+    if(oldRunCount > 1 && oldRunCount == begRun - cur)
+    {
+      out.push_back(static_cast<uint8_t>(128 + oldRunCount));
+      out.push_back(data[cur]);
+      cur = begRun;
+    }
+    // Literals up to the run
+    while(cur < begRun)
+    {
+      uint32_t n = std::min(begRun - cur, 128u);
+      out.push_back(static_cast<uint8_t>(n));
+      out.insert(out.end(), data + cur, data + cur + n);
+      cur += n;
+    }
+    if(runCount >= 4)
+    {
+      out.push_back(static_cast<uint8_t>(128 + runCount));
+      out.push_back(data[begRun]);
+      cur += runCount;
+    }
+  }
+}
+
+bool writeRadiance(const std::string& filename, const std::vector<float>& rgb, uint32_t width, uint32_t height)
+{
+  FILE* f = fopen(filename.c_str(), "wb");
+  if(f == nullptr)
+    return false;
+  fprintf(f, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", height, width);
+
+  std::vector<uint8_t> planes(size_t(width) * 4);
+  std::vector<uint8_t> out;
+  for(uint32_t y = 0; y < height; y++)
+  {
+    for(uint32_t x = 0; x < width; x++)
+    {
+      const float* p = &rgb[(size_t(y) * width + x) * 3];
+      float        v = std::max(p[0], std::max(p[1], p[2]));
+      if(v < 1e-32f)
+      {
+        planes[x] = planes[width + x] = planes[2 * width + x] = planes[3 * width + x] = 0;
+        continue;
+      }
+      int   e;
+      float scale = std::frexp(v, &e) * 256.f / v;
+      planes[x]             = static_cast<uint8_t>(p[0] * scale);
+      planes[width + x]     = static_cast<uint8_t>(p[1] * scale);
+      planes[2 * width + x] = static_cast<uint8_t>(p[2] * scale);
+      planes[3 * width + x] = static_cast<uint8_t>(e + 128);
+    }
+    out = {2, 2, static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width & 0xff)};
+    for(uint32_t c = 0; c < 4; c++)
+      writeRleComponent(&planes[c * width], width, out);
+    fwrite(out.data(), 1, out.size(), f);
+  }
+  fclose(f);
+  return true;
+}
+
+std::string radianceFile(uint32_t width)
+{
+  auto path = std::filesystem::temp_directory_path() / ("bench_env_" + std::to_string(width) + ".hdr");
+  if(!std::filesystem::exists(path))
+    writeRadiance(path.string(), makeSyntheticEnvironment(width, width / 2), width, width / 2);
+  return path.string();
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Argument is the width of the environment (height is half)
+//
+static void BM_LoadHdrStb(benchmark::State& state)
+{
+  const uint32_t    width    = static_cast<uint32_t>(state.range(0));
+  const std::string filename = radianceFile(width);
+  for(auto _ : state)
+  {
+    int    w, h, c;
+    float* pixels = stbi_loadf(filename.c_str(), &w, &h, &c, STBI_rgb_alpha);  // As before image_io
+    if(pixels == nullptr)
+    {
+      state.SkipWithError("stb_image failed");
+      break;
+    }
+    benchmark::DoNotOptimize(pixels);
+    stbi_image_free(pixels);
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * (width / 2));
+}
+BENCHMARK(BM_LoadHdrStb)->Arg(2048)->Arg(8192)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_LoadHdrImageIo(benchmark::State& state)
+{
+  const uint32_t    width    = static_cast<uint32_t>(state.range(0));
+  const std::string filename = radianceFile(width);
+  for(auto _ : state)
+  {
+    FloatImage image;
+    if(!imageio::loadRadiance(filename, image))
+    {
+      state.SkipWithError("loadRadiance failed");
+      break;
+    }
+    benchmark::DoNotOptimize(image.pixels.data());
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * (width / 2));
+}
+BENCHMARK(BM_LoadHdrImageIo)->Arg(2048)->Arg(8192)->Unit(benchmark::kMillisecond)->UseRealTime();
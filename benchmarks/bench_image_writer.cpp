@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Writing the LDR image as SampleExample::dumpImage does: the mapped BGRA image is converted to
+// packed RGB(A), then encoded. The argument is the width of the image (height is half).
+//
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+
+#include "image_writer.hpp"
+
+
+namespace {
+
+// BGRA pixels with rows `rowPitch` bytes apart, as a linear image mapped after the copy
+std::vector<uint8_t> makeMappedImage(uint32_t width, uint32_t height, size_t rowPitch)
+{
+  std::vector<uint8_t> pixels(rowPitch * height);
+  for(uint32_t y = 0; y < height; y++)
+    for(uint32_t x = 0; x < width; x++)
+    {
+      uint8_t* p = &pixels[y * rowPitch + x * 4];
+      p[0]       = static_cast<uint8_t>(x);
+      p[1]       = static_cast<uint8_t>(y);
+      p[2]       = static_cast<uint8_t>(x ^ y);
+      p[3]       = 255;
+    }
+  return pixels;
+}
+
+// Row pitch of a mapped image, aligned to 256 bytes
+size_t mappedRowPitch(uint32_t width)
+{
+  return (size_t(width) * 4 + 255) & ~size_t(255);
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// BGRA to RGB (channels = 3) or RGBA (channels = 4)
+//
+static void BM_ConvertRgba8(benchmark::State& state, uint32_t channels)
+{
+  const uint32_t width    = static_cast<uint32_t>(state.range(0));
+  const uint32_t height   = width / 2;
+  const size_t   rowPitch = mappedRowPitch(width);
+  const auto     mapped   = makeMappedImage(width, height, rowPitch);
+
+  std::vector<uint8_t> packed(size_t(width) * height * channels);
+  for(auto _ : state)
+  {
+    convertRgba8(mapped.data(), rowPitch, width, height, true, channels, packed.data());
+    benchmark::DoNotOptimize(packed.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * height);
+}
+BENCHMARK_CAPTURE(BM_ConvertRgba8, rgb, 3u)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_ConvertRgba8, rgba, 4u)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+//--------------------------------------------------------------------------------------------------
+// PPM encoding of the packed image, in memory or to a file in the temp directory.
+// Arguments: {width, channels of the image (3: copied as is, 4: alpha is dropped)}
+//
+static void BM_WritePpm(benchmark::State& state, bool toFile)
+{
+  const uint32_t width    = static_cast<uint32_t>(state.range(0));
+  const uint32_t height   = width / 2;
+  const size_t   rowPitch = mappedRowPitch(width);
+  const auto     mapped   = makeMappedImage(width, height, rowPitch);
+  const auto     filename = (std::filesystem::temp_directory_path() / "bench_writer.ppm").string();
+
+  OutputImage image;
+  image.width    = width;
+  image.height   = height;
+  image.channels = static_cast<uint32_t>(state.range(1));
+  image.ldr.resize(size_t(width) * height * image.channels);
+  convertRgba8(mapped.data(), rowPitch, width, height, true, image.channels, image.ldr.data());
+
+  ImageWriter          writer;
+  std::vector<uint8_t> data;
+  for(auto _ : state)
+  {
+    if(!writer.encode(filename, image, {}, data) || (toFile && !imageio::writeFile(filename, data)))
+    {
+      state.SkipWithError("PPM writing failed");
+      break;
+    }
+    benchmark::DoNotOptimize(data.data());
+  }
+  std::filesystem::remove(filename);
+
+  state.SetItemsProcessed(state.iterations() * int64_t(width) * height);
+  state.SetBytesProcessed(state.iterations() * int64_t(data.size()));
+}
+BENCHMARK_CAPTURE(BM_WritePpm, memory, false)->ArgsProduct({{1024, 4096}, {3, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_WritePpm, file, true)->ArgsProduct({{1024, 4096}, {3, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Conversion of the glTF data when loading a scene: the packing functions of compress.glsl, the
+// vertex and material conversion of Scene and the glTF to Vulkan sampler mapping.
+// The inputs are synthetic, the argument is the number of elements.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <math.h>  // isinf() of compress.glsl, in the global namespace
+
+#include "bench_common.hpp"
+#include "scene_conversion.hpp"
+#include "shaders/compress.glsl"
+#include "tiny_gltf.h"
+
+
+namespace {
+
+std::vector<vec3> randomUnitVectors(uint32_t count, uint32_t seed = 1)
+{
+  std::mt19937                    rng(seed);
+  std::normal_distribution<float> dist;
+  std::vector<vec3>               dirs(count);
+  for(auto& d : dirs)
+  {
+    d = vec3(dist(rng), dist(rng), dist(rng));
+    d = normalize(d);
+  }
+  return dirs;
+}
+
+// Attributes of `count` vertices, as nvh::GltfScene has them after parsing
+nvh::GltfScene makeSyntheticVertices(uint32_t count)
+{
+  std::mt19937                          rng(2);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  auto                                  normals  = randomUnitVectors(count, 3);
+  auto                                  tangents = randomUnitVectors(count, 4);
+
+  nvh::GltfScene gltf;
+  gltf.m_positions.resize(count);
+  gltf.m_normals = normals;
+  gltf.m_tangents.resize(count);
+  gltf.m_texcoords0.resize(count);
+  gltf.m_colors0.resize(count);
+  for(uint32_t i = 0; i < count; i++)
+  {
+    gltf.m_positions[i]  = vec3(dist(rng), dist(rng), dist(rng)) * 100.f;
+    gltf.m_tangents[i]   = vec4(tangents[i], (i & 1) ? 1.f : -1.f);
+    gltf.m_texcoords0[i] = vec2(dist(rng), dist(rng));
+    gltf.m_colors0[i]    = vec4(dist(rng), dist(rng), dist(rng), 1.f);
+  }
+  return gltf;
+}
+
+// Materials using most of the extensions, so every field is converted
+std::vector<nvh::GltfMaterial> makeSyntheticMaterials(uint32_t count)
+{
+  std::vector<nvh::GltfMaterial> materials(count);
+  for(uint32_t i = 0; i < count; i++)
+  {
+    auto& m                   = materials[i];
+    m.baseColorFactor         = vec4(float(i % 7) / 7.f, 0.5f, 0.25f, 1.f);
+    m.baseColorTexture        = int(i % 16);
+    m.metallicFactor          = float(i % 3) / 3.f;
+    m.roughnessFactor         = float(i % 5) / 5.f;
+    m.normalTexture           = int(i % 16);
+    m.emissiveFactor          = vec3(float(i % 2), float(i % 2), float(i % 2));
+    m.clearcoat.factor        = 0.5f;
+    m.sheen.colorFactor       = vec3(0.2f, 0.3f, 0.4f);
+    m.sheen.roughnessFactor   = 0.5f;
+    m.transmission.factor     = float(i % 2);
+    m.volume.attenuationColor = vec3(0.9f, 0.9f, 0.9f);
+    m.anisotropy.factor       = 0.25f;
+  }
+  return materials;
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Octahedral compression of the normals and tangents
+//
+static void BM_CompressUnitVec(benchmark::State& state)
+{
+  const auto            dirs = randomUnitVectors(static_cast<uint32_t>(state.range(0)));
+  std::vector<uint32_t> packed(dirs.size());
+  for(auto _ : state)
+  {
+    for(size_t i = 0; i < dirs.size(); i++)
+      packed[i] = compress_unit_vec(dirs[i]);
+    benchmark::DoNotOptimize(packed.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(dirs.size()));
+}
+BENCHMARK(BM_CompressUnitVec)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void BM_DecompressUnitVec(benchmark::State& state)
+{
+  const auto            dirs = randomUnitVectors(static_cast<uint32_t>(state.range(0)));
+  std::vector<uint32_t> packed(dirs.size());
+  for(size_t i = 0; i < dirs.size(); i++)
+    packed[i] = compress_unit_vec(dirs[i]);
+
+  std::vector<vec3> unpacked(dirs.size());
+  for(auto _ : state)
+  {
+    for(size_t i = 0; i < packed.size(); i++)
+      unpacked[i] = decompress_unit_vec(packed[i]);
+    benchmark::DoNotOptimize(unpacked.data());
+    benchmark::ClobberMemory();
+  }
+
+  // Largest angle between a direction and its round trip, in degrees
+  float minCos = 1.f;
+  for(size_t i = 0; i < dirs.size(); i++)
+    minCos = std::min(minCos, dot(dirs[i], unpacked[i]));
+  state.counters["max_error_deg"] = std::acos(std::min(minCos, 1.f)) * 180.0 / M_PI;
+  state.SetItemsProcessed(state.iterations() * int64_t(dirs.size()));
+}
+BENCHMARK(BM_DecompressUnitVec)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void BM_PackUnorm4x8(benchmark::State& state)
+{
+  const uint32_t                        count = static_cast<uint32_t>(state.range(0));
+  std::mt19937                          rng(5);
+  std::uniform_real_distribution<float> dist(-0.1f, 1.1f);  // Some values are clamped
+  std::vector<vec4>                     colors(count);
+  for(auto& c : colors)
+    c = vec4(dist(rng), dist(rng), dist(rng), dist(rng));
+
+  std::vector<uint32_t> packed(count);
+  for(auto _ : state)
+  {
+    for(uint32_t i = 0; i < count; i++)
+      packed[i] = packUnorm4x8(colors[i]);
+    benchmark::DoNotOptimize(packed.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(count));
+}
+BENCHMARK(BM_PackUnorm4x8)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+
+//--------------------------------------------------------------------------------------------------
+// Vertex conversion of Scene::createVertexBuffer, without the upload
+//
+static void BM_ConvertVertices(benchmark::State& state)
+{
+  const uint32_t                count = static_cast<uint32_t>(state.range(0));
+  const nvh::GltfScene          gltf  = makeSyntheticVertices(count);
+  std::vector<VertexAttributes> vertex(count);
+  for(auto _ : state)
+  {
+    convertVertices(gltf, 0, count, vertex.data());
+    benchmark::DoNotOptimize(vertex.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(count));
+  state.SetBytesProcessed(state.iterations() * int64_t(count) * sizeof(VertexAttributes));
+}
+BENCHMARK(BM_ConvertVertices)->RangeMultiplier(16)->Range(1 << 10, 1 << 22)->Unit(benchmark::kMicrosecond);
+
+
+//--------------------------------------------------------------------------------------------------
+// Material conversion of Scene::createMaterialBuffer, without the upload
+//
+static void BM_ConvertMaterials(benchmark::State& state)
+{
+  const auto materials = makeSyntheticMaterials(static_cast<uint32_t>(state.range(0)));
+  for(auto _ : state)
+  {
+    auto shadeMaterials = convertMaterials(materials);
+    benchmark::DoNotOptimize(shadeMaterials.data());
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(materials.size()));
+}
+BENCHMARK(BM_ConvertMaterials)->RangeMultiplier(8)->Range(8, 1 << 15);
+
+
+//--------------------------------------------------------------------------------------------------
+// Sampler mapping of Scene::createTextureImages, one call per texture
+//
+static void BM_GltfSamplerToVulkan(benchmark::State& state)
+{
+  static const int filters[] = {-1, 9728, 9729, 9984, 9985, 9986, 9987};
+  static const int wraps[]   = {33071, 33648, 10497};
+
+  std::vector<tinygltf::Sampler> samplers(static_cast<size_t>(state.range(0)));
+  for(size_t i = 0; i < samplers.size(); i++)
+  {
+    samplers[i].magFilter = filters[i % 7];
+    samplers[i].minFilter = filters[(i / 7) % 7];
+    samplers[i].wrapS     = wraps[i % 3];
+    samplers[i].wrapT     = wraps[(i / 3) % 3];
+  }
+
+  std::vector<VkSamplerCreateInfo> infos(samplers.size());
+  for(auto _ : state)
+  {
+    for(size_t i = 0; i < samplers.size(); i++)
+      infos[i] = gltfSamplerToVulkan(samplers[i]);
+    benchmark::DoNotOptimize(infos.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(samplers.size()));
+}
+BENCHMARK(BM_GltfSamplerToVulkan)->RangeMultiplier(8)->Range(8, 1 << 12);
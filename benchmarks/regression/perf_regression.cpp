@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// End-to-end performance regression runner: runs vk_raytrace on the fixed cases of a suite, each
+// several times, and collects the time of its stages (-stages, see src/stage_times.hpp). The
+// median of each stage is compared with a stored baseline:
+//
+//   slower = median - baseline > max(tolerance * baseline, noise * sigma, minms)
+//
+// where sigma is the larger of the two spreads, estimated from the median absolute deviation. A
+// stage is only reported when it moves more than its own noise, and tiny stages never are.
+//
+// Usage:
+//   vk_raytrace_perf -suite perf_suite.json -baseline perf_baseline.json [-o results.json]
+//                    [-runs 5] [-warmup 1] [-tolerance 0.1] [-noise 3] [-minms 1] [-updatebaseline]
+//                    [-exe path/to/vk_raytrace]
+//
+// Baselines are specific to the machine and are not part of the sources. -updatebaseline writes
+// the results as the new baseline. Without a baseline, the results are written as the baseline
+// but nothing is compared, and the exit code says so.
+//
+// Exit code: 0 no regression, 1 regression, 2 a case failed to run, 3 no baseline to compare with.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvh/inputparser.h"
+#include "nvh/nvprint.hpp"
+#include "nvp/nvpsystem.hpp"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+struct Case
+{
+  std::string name;
+  std::string args;  // "{out}" is the directory of the outputs
+};
+
+struct StageStats
+{
+  std::vector<double> runs;
+  double              median{0.};
+  double              mad{0.};  // Median absolute deviation
+};
+
+// Stage name -> times, for each case
+using Results = std::map<std::string, std::map<std::string, StageStats>>;
+
+double median(std::vector<double> values)
+{
+  if(values.empty())
+    return 0.;
+  const size_t mid = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + mid, values.end());
+  double m = values[mid];
+  if(values.size() % 2 == 0)
+    m = (m + *std::max_element(values.begin(), values.begin() + mid)) * 0.5;
+  return m;
+}
+
+void computeStats(StageStats& stats)
+{
+  stats.median = median(stats.runs);
+  std::vector<double> deviations;
+  for(double v : stats.runs)
+    deviations.push_back(std::abs(v - stats.median));
+  stats.mad = median(deviations);
+}
+
+bool loadSuite(const std::string& filename, std::vector<Case>& cases)
+{
+  std::ifstream file(filename);
+  if(!file)
+  {
+    LOGE("Cannot open the suite %s\n", filename.c_str());
+    return false;
+  }
+  try
+  {
+    json j = json::parse(file);
+    for(const auto& c : j.at("cases"))
+      cases.push_back({c.at("name").get<std::string>(), c.value("args", std::string())});
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid suite %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+  return !cases.empty();
+}
+
+// Stages of one run, as written by -stages
+bool loadStages(const std::string& filename, std::map<std::string, double>& stages)
+{
+  std::ifstream file(filename);
+  if(!file)
+    return false;
+  try
+  {
+    json j = json::parse(file);
+    for(const auto& s : j.at("stages"))
+      stages[s.at("name").get<std::string>()] = s.at("ms").get<double>();
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid stage times %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+json toJson(const Results& results)
+{
+  json j;
+  for(const auto& c : results)
+    for(const auto& s : c.second)
+      j["cases"][c.first][s.first] = {{"median", s.second.median}, {"mad", s.second.mad}, {"runs", s.second.runs}};
+  return j;
+}
+
+Results fromJson(const json& j)
+{
+  Results results;
+  for(const auto& c : j.at("cases").items())
+    for(const auto& s : c.value().items())
+    {
+      StageStats& stats = results[c.key()][s.key()];
+      stats.median      = s.value().at("median").get<double>();
+      stats.mad         = s.value().value("mad", 0.);
+      stats.runs        = s.value().value("runs", std::vector<double>());
+    }
+  return results;
+}
+
+bool writeJson(const std::string& filename, const json& j)
+{
+  std::ofstream file(filename);
+  file << j.dump(2) << std::endl;
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv)
+{
+  InputParser parser(argc, argv);
+  std::string exe          = parser.getString("-exe", NVPSystem::exePath() + RENDERER_NAME);
+  std::string suiteFile    = parser.getString("-suite", "perf_suite.json");
+  std::string baselineFile = parser.getString("-baseline", "perf_baseline.json");
+  std::string outputFile   = parser.getString("-o", "");  // Results of this run, same format as the baseline
+  std::string outputDir    = parser.getString("-outdir", (fs::temp_directory_path() / "vk_raytrace_perf").string());
+  int         runs         = std::max(1, std::stoi(parser.getString("-runs", "5")));
+  int         warmup       = std::max(0, std::stoi(parser.getString("-warmup", "1")));  // Runs not measured, caches
+  double      tolerance    = std::stod(parser.getString("-tolerance", "0.1"));  // Relative to the baseline
+  double      noise        = std::stod(parser.getString("-noise", "3"));  // Sigmas
+  double      minMs        = std::stod(parser.getString("-minms", "1"));  // Smaller changes are ignored
+  bool        update       = parser.exist("-updatebaseline");
+
+  std::vector<Case> cases;
+  if(!loadSuite(suiteFile, cases))
+    return 2;
+  std::error_code ec;
+  fs::create_directories(outputDir, ec);
+
+  // The cases are interleaved, a slow drift of the machine is spread over all of them
+  Results results;
+  for(int run = -warmup; run < runs; run++)
+  {
+    for(const auto& c : cases)
+    {
+      const std::string stagesFile = (fs::path(outputDir) / (c.name + "_stages.json")).string();
+      std::string       args       = c.args;
+      for(size_t pos; (pos = args.find("{out}")) != std::string::npos;)
+        args.replace(pos, 5, outputDir);
+      const std::string command = "\"" + exe + "\" " + args + " -stages \"" + stagesFile + "\"";
+
+      fs::remove(stagesFile, ec);
+      LOGI("%s %s (%d/%d)\n", run < 0 ? "Warm-up" : "Running", c.name.c_str(), std::max(run + 1, 0), runs);
+      std::map<std::string, double> stages;
+      if(std::system(command.c_str()) != 0 || !loadStages(stagesFile, stages))
+      {
+        LOGE("Failed: %s\n", command.c_str());
+        return 2;
+      }
+      if(run < 0)
+        continue;
+      for(const auto& s : stages)
+        results[c.name][s.first].runs.push_back(s.second);
+    }
+  }
+  for(auto& c : results)
+    for(auto& s : c.second)
+      computeStats(s.second);
+
+  if(!outputFile.empty())
+    writeJson(outputFile, toJson(results));
+  if(update)
+  {
+    LOGI("Baseline written to %s\n", baselineFile.c_str());
+    return writeJson(baselineFile, toJson(results)) ? 0 : 2;
+  }
+  if(!fs::exists(baselineFile))
+  {
+    LOGW("No baseline %s, nothing compared: this run is written as the baseline\n", baselineFile.c_str());
+    return writeJson(baselineFile, toJson(results)) ? 3 : 2;
+  }
+
+  Results baseline;
+  try
+  {
+    std::ifstream file(baselineFile);
+    baseline = fromJson(json::parse(file));
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid baseline %s: %s\n", baselineFile.c_str(), e.what());
+    return 2;
+  }
+
+  // Comparison, stage by stage
+  int regressions = 0;
+  LOGI("%-24s %-24s %12s %12s %8s\n", "case", "stage", "baseline ms", "current ms", "change");
+  for(const auto& c : results)
+  {
+    for(const auto& s : c.second)
+    {
+      auto bc = baseline.find(c.first);
+      if(bc == baseline.end() || bc->second.find(s.first) == bc->second.end())
+      {
+        LOGI("%-24s %-24s %12s %12.3f %8s\n", c.first.c_str(), s.first.c_str(), "-", s.second.median, "new");
+        continue;
+      }
+      const StageStats& base   = bc->second.at(s.first);
+      const double      sigma  = 1.4826 * std::max(base.mad, s.second.mad);  // MAD to standard deviation
+      const double      margin = std::max({tolerance * base.median, noise * sigma, minMs});
+      const double      delta  = s.second.median - base.median;
+      const char*       status = delta > margin ? "SLOWER" : (-delta > margin ? "faster" : "");
+      regressions += delta > margin ? 1 : 0;
+      LOGI("%-24s %-24s %12.3f %12.3f %+7.1f%% %s\n", c.first.c_str(), s.first.c_str(), base.median, s.second.median,
+           base.median > 0. ? 100. * delta / base.median : 0., status);
+    }
+  }
+  for(const auto& c : baseline)
+    for(const auto& s : c.second)
+      if(results.count(c.first) && !results[c.first].count(s.first))
+        LOGW("%s: the stage %s is no longer recorded\n", c.first.c_str(), s.first.c_str());
+
+  LOGI("%d stage regression(s)\n", regressions);
+  return regressions > 0 ? 1 : 0;
+}
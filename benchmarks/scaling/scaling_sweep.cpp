@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Scaling study: sweeps the parameters of the synthetic scenes (see scene_generator.hpp) one at a
+// time from a base scene, renders each scene with vk_raytrace and collects
+// - the time of the stages (-stages), the load time being the sum of the scene stages
+// - the render throughput, in million samples per second
+// - the device memory of the render (-predict, needs VK_EXT_memory_budget)
+//
+// The results are written as CSV, one file per sweep and all together, with a gnuplot script
+// plotting each sweep: `gnuplot scaling.gp` in the output directory.
+//
+// Usage:
+//   vk_raytrace_sweep -sweep scaling_sweep.json [-outdir dir] [-runs 1] [-only triangles,lights]
+//                     [-nomemory] [-keepscenes] [-exe path/to/vk_raytrace]
+//
+// The sweep file:
+//   { "render": {"width": 1280, "height": 720, "samples": 16, "args": "..."},
+//     "format": ".gltf",
+//     "base": {"triangles": 100000, "materials": 4, ...},
+//     "sweeps": [{"param": "triangles", "values": [1e4, 1e5, 1e6]}, {"param": ..., "base": {...}}] }
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvh/inputparser.h"
+#include "nvh/nvprint.hpp"
+#include "nvp/nvpsystem.hpp"
+#include "scene_generator.hpp"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+// The stages of loading the scene, see Scene::load and AccelStructure
+const std::set<std::string> kLoadStages{"gltf parse", "image load",     "gltf convert", "material buffer",
+                                        "textures",   "vertex buffers", "finalize",     "acceleration structures"};
+
+struct Point
+{
+  std::string                   sweep;
+  std::string                   value;
+  double                        fileMb{0.};
+  std::map<std::string, double> stages;  // Median of the runs
+  double                        deviceMb{0.};
+};
+
+double median(std::vector<double> values)
+{
+  if(values.empty())
+    return 0.;
+  std::sort(values.begin(), values.end());
+  const size_t mid = values.size() / 2;
+  return values.size() % 2 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+}
+
+// JSON values as the command line options: numbers and strings
+std::string toParam(const json& value)
+{
+  if(value.is_string())
+    return value.get<std::string>();
+  const double number = value.get<double>();  // 1e6 is written as 1000000
+  if(number == std::floor(number) && std::abs(number) < 1e15)
+    return std::to_string(static_cast<int64_t>(number));
+  return std::to_string(number);
+}
+
+bool applyParams(SceneParams& params, const json& object)
+{
+  for(const auto& p : object.items())
+    if(!setSceneParam(params, p.key(), toParam(p.value())))
+      return false;
+  return true;
+}
+
+// The scene with its .bin and images
+std::vector<fs::path> sceneFiles(const fs::path& scene)
+{
+  std::error_code       ec;
+  std::vector<fs::path> files;
+  const std::string     stem = scene.stem().string();
+  for(const auto& entry : fs::directory_iterator(scene.parent_path(), ec))
+  {
+    const std::string ext = entry.path().extension().string();
+    if((entry.path().stem() == stem || entry.path().stem().string().rfind(stem + "_", 0) == 0)
+       && (ext == ".gltf" || ext == ".glb" || ext == ".bin" || ext == ".png"))
+      files.push_back(entry.path());
+  }
+  return files;
+}
+
+double sceneMb(const fs::path& scene)
+{
+  std::error_code ec;
+  double          bytes = 0.;
+  for(const auto& file : sceneFiles(scene))
+    bytes += double(fs::file_size(file, ec));
+  return bytes / (1024. * 1024.);
+}
+
+bool loadJson(const std::string& filename, json& j)
+{
+  std::ifstream file(filename);
+  if(!file)
+    return false;
+  try
+  {
+    j = json::parse(file);
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+// Stages of one run, as written by -stages
+bool loadStages(const std::string& filename, std::map<std::string, double>& stages)
+{
+  json j;
+  if(!loadJson(filename, j))
+    return false;
+  for(const auto& s : j.value("stages", json::array()))
+    stages[s.value("name", std::string())] = s.value("ms", 0.);
+  return true;
+}
+
+double loadMs(const Point& point)
+{
+  double ms = 0.;
+  for(const auto& s : point.stages)
+    ms += kLoadStages.count(s.first) ? s.second : 0.;
+  return ms;
+}
+
+bool writeCsv(const fs::path& filename, const std::vector<Point>& points, const std::vector<std::string>& stageNames, double samples)
+{
+  std::ofstream file(filename);
+  file << "sweep,value,file_mb,load_ms,render_ms,msamples_per_s,device_mb";
+  for(const auto& s : stageNames)
+    file << "," << s;
+  file << "\n";
+  for(const auto& p : points)
+  {
+    auto         it       = p.stages.find("render");
+    const double renderMs = it != p.stages.end() ? it->second : 0.;
+    file << p.sweep << ",\"" << p.value << "\"," << p.fileMb << "," << loadMs(p) << "," << renderMs << ","
+         << (renderMs > 0. ? samples / (renderMs * 1000.) : 0.) << "," << p.deviceMb;
+    for(const auto& s : stageNames)
+    {
+      auto st = p.stages.find(s);
+      file << "," << (st != p.stages.end() ? st->second : 0.);
+    }
+    file << "\n";
+  }
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+// One image per sweep: load time and its main stages, throughput and device memory per value
+bool writeGnuplot(const fs::path& filename, const std::vector<std::string>& sweeps)
+{
+  std::ofstream file(filename);
+  file << "# Plots of the scaling sweeps: gnuplot " << filename.filename().string() << "\n"
+       << "set datafile separator ','\n"
+       << "set terminal pngcairo size 1500,420\n"
+       << "set key top left\n"
+       << "set grid\n"
+       << "set xtics rotate by -30\n";
+  for(const auto& s : sweeps)
+  {
+    file << "\nset output '" << s << ".png'\n"
+         << "set multiplot layout 1,3 title 'Sweep of " << s << "'\n"
+         << "set ylabel 'ms'\n"
+         << "plot '" << s << ".csv' using 0:4:xtic(2) with linespoints title 'load', \\\n"
+         << "     '' using 0:(column('gltf parse')) with linespoints title 'gltf parse', \\\n"
+         << "     '' using 0:(column('textures')) with linespoints title 'textures', \\\n"
+         << "     '' using 0:(column('acceleration structures')) with linespoints title 'acceleration structures'\n"
+         << "set ylabel 'Msamples/s'\n"
+         << "plot '" << s << ".csv' using 0:6:xtic(2) with linespoints title 'render throughput'\n"
+         << "set ylabel 'MB'\n"
+         << "plot '" << s << ".csv' using 0:7:xtic(2) with linespoints title 'device memory', \\\n"
+         << "     '' using 0:3 with linespoints title 'file size'\n"
+         << "unset multiplot\n";
+  }
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv)
+{
+  InputParser parser(argc, argv);
+  std::string exe       = parser.getString("-exe", NVPSystem::exePath() + RENDERER_NAME);
+  std::string sweepFile = parser.getString("-sweep", "scaling_sweep.json");
+  std::string outputDir = parser.getString("-outdir", (fs::temp_directory_path() / "vk_raytrace_sweep").string());
+  std::string only      = parser.getString("-only", "");  // Comma separated parameters of the sweeps to run
+  int         runs      = std::max(1, std::stoi(parser.getString("-runs", "1")));
+  bool        memory    = !parser.exist("-nomemory");  // One more run per scene, with -predict
+  bool        keep      = parser.exist("-keepscenes");
+
+  json sweep;
+  if(!loadJson(sweepFile, sweep))
+  {
+    LOGE("Cannot read the sweep %s\n", sweepFile.c_str());
+    return 2;
+  }
+  const json        render  = sweep.value("render", json::object());
+  const int         width   = render.value("width", 1280);
+  const int         height  = render.value("height", 720);
+  const int         samples = render.value("samples", 16);
+  const std::string format  = sweep.value("format", std::string(".gltf"));
+  const std::string renderArgs = " -width " + std::to_string(width) + " -height " + std::to_string(height) + " -s "
+                                 + std::to_string(samples) + " " + render.value("args", std::string());
+
+  SceneParams base;
+  if(!applyParams(base, sweep.value("base", json::object())))
+    return 2;
+
+  std::error_code ec;
+  fs::create_directories(outputDir, ec);
+
+  std::vector<Point>       points;
+  std::vector<std::string> sweepNames;
+  std::vector<std::string> stageNames;  // In the order they are first seen
+  for(const auto& s : sweep.value("sweeps", json::array()))
+  {
+    const std::string param = s.value("param", std::string());
+    if(!only.empty() && ("," + only + ",").find("," + param + ",") == std::string::npos)
+      continue;
+    SceneParams sweepBase = base;
+    if(!applyParams(sweepBase, s.value("base", json::object())))
+      return 2;
+    sweepNames.push_back(param);
+
+    int index = 0;
+    for(const auto& v : s.value("values", json::array()))
+    {
+      Point point;
+      point.sweep        = param;
+      point.value        = toParam(v);
+      SceneParams params = sweepBase;
+      if(!setSceneParam(params, param, point.value))
+        return 2;
+
+      const std::string name  = param + "_" + std::to_string(index++);
+      const fs::path    scene = fs::path(outputDir) / (name + format);
+      LOGI("Sweep %s = %s\n", param.c_str(), point.value.c_str());
+      if(!writeScene(scene.string(), params))
+        return 2;
+      point.fileMb = sceneMb(scene);
+
+      const std::string stagesFile = (fs::path(outputDir) / (name + "_stages.json")).string();
+      const std::string command    = "\"" + exe + "\" -f \"" + scene.string() + "\"" + renderArgs + " -ldr \""
+                                  + (fs::path(outputDir) / (name + ".jpg")).string() + "\"";
+      std::map<std::string, std::vector<double>> runTimes;
+      for(int run = 0; run < runs; run++)
+      {
+        std::map<std::string, double> stages;
+        fs::remove(stagesFile, ec);
+        if(std::system((command + " -stages \"" + stagesFile + "\"").c_str()) != 0 || !loadStages(stagesFile, stages))
+        {
+          LOGE("Failed: %s\n", command.c_str());
+          return 2;
+        }
+        for(const auto& st : stages)
+          runTimes[st.first].push_back(st.second);
+      }
+      for(const auto& st : runTimes)
+      {
+        point.stages[st.first] = median(st.second);
+        if(std::find(stageNames.begin(), stageNames.end(), st.first) == stageNames.end())
+          stageNames.push_back(st.first);
+      }
+
+      // The probe renders in the buffers of the full render, its memory is the one of the render
+      if(memory)
+      {
+        const std::string predictFile = (fs::path(outputDir) / (name + "_predict.json")).string();
+        json              prediction;
+        fs::remove(predictFile, ec);
+        if(std::system((command + " -predict \"" + predictFile + "\"").c_str()) == 0 && loadJson(predictFile, prediction))
+          point.deviceMb = double(prediction["memory"].value("deviceBytes", uint64_t(0))) / (1024. * 1024.);
+        else
+          LOGW("No memory prediction for %s\n", name.c_str());
+      }
+
+      LOGI("  load %.1f ms, render %.1f ms, %.1f MB of device memory\n", loadMs(point), point.stages["render"], point.deviceMb);
+      points.push_back(point);
+      if(!keep)
+        for(const auto& file : sceneFiles(scene))
+          fs::remove(file, ec);
+    }
+  }
+  if(points.empty())
+  {
+    LOGE("No sweep to run\n");
+    return 2;
+  }
+
+  // CSV of all the points, of each sweep and the plots
+  const double totalSamples = double(width) * height * samples;
+  bool         success      = writeCsv(fs::path(outputDir) / "scaling.csv", points, stageNames, totalSamples);
+  for(const auto& s : sweepNames)
+  {
+    std::vector<Point> sweepPoints;
+    std::copy_if(points.begin(), points.end(), std::back_inserter(sweepPoints), [&](const Point& p) { return p.sweep == s; });
+    success &= writeCsv(fs::path(outputDir) / (s + ".csv"), sweepPoints, stageNames, totalSamples);
+  }
+  success &= writeGnuplot(fs::path(outputDir) / "scaling.gp", sweepNames);
+  LOGI("Results in %s\n", outputDir.c_str());
+  return success ? 0 : 2;
+}
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "ldr_encoders.hpp"
+#include "nvh/nvprint.hpp"
+#include "scene_generator.hpp"
+#include "tools.hpp"
+
+using json   = nlohmann::json;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+
+// glTF enums
+constexpr int kArrayBuffer        = 34962;
+constexpr int kElementArrayBuffer = 34963;
+constexpr int kFloat              = 5126;
+constexpr int kUnsignedInt        = 5125;
+
+// The binary buffer of the scene, the views are aligned on 4 bytes
+struct BinaryBuffer
+{
+  std::vector<uint8_t> data;
+  json                 views     = json::array();
+  json                 accessors = json::array();
+
+  int addView(const void* src, size_t size, int target = 0)
+  {
+    data.resize((data.size() + 3) & ~size_t(3), 0);
+    json view = {{"buffer", 0}, {"byteOffset", data.size()}, {"byteLength", size}};
+    if(target != 0)
+      view["target"] = target;
+    data.insert(data.end(), static_cast<const uint8_t*>(src), static_cast<const uint8_t*>(src) + size);
+    views.push_back(view);
+    return static_cast<int>(views.size()) - 1;
+  }
+
+  template <typename T>
+  int addAccessor(const std::vector<T>& values, int componentType, int components, const char* type, int target)
+  {
+    const size_t count = values.size() / components;
+    accessors.push_back({{"bufferView", addView(values.data(), values.size() * sizeof(T), target)},
+                         {"componentType", componentType},
+                         {"count", count},
+                         {"type", type}});
+    return static_cast<int>(accessors.size()) - 1;
+  }
+};
+
+// One arc of a torus around Y, segments [u0, u1) of segU around the axis and segV around the tube
+struct TorusArc
+{
+  std::vector<float>    positions;
+  std::vector<float>    normals;
+  std::vector<float>    tangents;
+  std::vector<float>    texcoords;
+  std::vector<uint32_t> indices;
+  float                 bbMin[3]{1e30f, 1e30f, 1e30f};
+  float                 bbMax[3]{-1e30f, -1e30f, -1e30f};
+};
+
+void makeTorusArc(uint32_t u0, uint32_t u1, uint32_t segU, uint32_t segV, float minorRadius, TorusArc& arc)
+{
+  const float    majorRadius = 1.f;
+  const uint32_t rows        = u1 - u0 + 1;
+  arc.positions.reserve(size_t(rows) * (segV + 1) * 3);
+  for(uint32_t i = u0; i <= u1; i++)
+  {
+    const float u = 2.f * kPi * float(i) / float(segU);
+    for(uint32_t j = 0; j <= segV; j++)
+    {
+      const float v = 2.f * kPi * float(j) / float(segV);
+      const float n[3]{std::cos(v) * std::cos(u), std::sin(v), std::cos(v) * std::sin(u)};
+      const float p[3]{majorRadius * std::cos(u) + minorRadius * n[0], minorRadius * n[1], majorRadius * std::sin(u) + minorRadius * n[2]};
+      for(int c = 0; c < 3; c++)
+      {
+        arc.positions.push_back(p[c]);
+        arc.normals.push_back(n[c]);
+        arc.bbMin[c] = std::min(arc.bbMin[c], p[c]);
+        arc.bbMax[c] = std::max(arc.bbMax[c], p[c]);
+      }
+      arc.tangents.insert(arc.tangents.end(), {-std::sin(u), 0.f, std::cos(u), 1.f});
+      arc.texcoords.insert(arc.texcoords.end(), {8.f * float(i) / float(segU), float(j) / float(segV)});
+    }
+  }
+
+  // Counter-clockwise seen from outside the tube
+  arc.indices.reserve(size_t(rows - 1) * segV * 6);
+  for(uint32_t i = 0; i + 1 < rows; i++)
+  {
+    for(uint32_t j = 0; j < segV; j++)
+    {
+      const uint32_t a = i * (segV + 1) + j;
+      const uint32_t b = a + segV + 1;
+      arc.indices.insert(arc.indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+    }
+  }
+}
+
+void hueToRgb(float hue, float rgb[3])
+{
+  for(int c = 0; c < 3; c++)
+  {
+    const float k = std::fmod(hue * 6.f + float(5 - 2 * c), 6.f);  // HSV with full saturation and value
+    rgb[c]        = 1.f - std::max(0.f, std::min({k, 4.f - k, 1.f}));
+  }
+}
+
+// Hue of item i, spread with the golden ratio
+float itemHue(uint32_t i)
+{
+  return std::fmod(0.618034f * float(i), 1.f);
+}
+
+// Checkerboard of the hue of the texture with noise, so it doesn't compress to nothing
+std::vector<uint8_t> texturePixels(uint32_t index, uint32_t size, uint32_t seed)
+{
+  float rgb[3];
+  hueToRgb(itemHue(index), rgb);
+  std::vector<uint8_t> pixels(size_t(size) * size * 3);
+  const uint32_t       cell = std::max(1u, size / 8);
+  parallelRanges(size, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; y++)
+    {
+      uint8_t* row = &pixels[y * size * 3];
+      for(uint32_t x = 0; x < size; x++)
+      {
+        uint32_t    h     = (x * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (seed * 83492791u + index);
+        const float noise = float((h * 0x9E3779B1u) >> 27) / 31.f;  // [0, 1]
+        const float light = ((x / cell + y / cell) & 1) ? 0.85f : 0.45f;
+        for(int c = 0; c < 3; c++)
+          row[x * 3 + c] = static_cast<uint8_t>(std::min(255.f, (rgb[c] * light + 0.1f * noise) * 255.f));
+      }
+    }
+  });
+  return pixels;
+}
+
+// Material `index` with the features of the entry `feature` ("clearcoat+sheen")
+json makeMaterial(uint32_t index, const std::string& feature, const SceneParams& params, std::set<std::string>& extensionsUsed)
+{
+  float color[3];
+  hueToRgb(itemHue(index), color);
+
+  json pbr = {{"baseColorFactor", {color[0], color[1], color[2], 1.f}},
+              {"metallicFactor", index % 3 == 0 ? 1.f : 0.f},
+              {"roughnessFactor", 0.1f + 0.8f * itemHue(index + 7)}};
+  if(params.textures > 0)
+    pbr["baseColorTexture"] = {{"index", index % params.textures}};
+
+  json material = {{"name", "material_" + std::to_string(index) + "_" + feature}};
+  auto addExtension = [&](const char* name, json value) {
+    material["extensions"][name] = std::move(value);
+    extensionsUsed.insert(name);
+  };
+
+  std::stringstream features(feature);
+  for(std::string f; std::getline(features, f, '+');)
+  {
+    if(f == "emissive")
+      material["emissiveFactor"] = {color[0], color[1], color[2]};
+    else if(f == "clearcoat")
+      addExtension("KHR_materials_clearcoat", {{"clearcoatFactor", 1.f}, {"clearcoatRoughnessFactor", 0.1f}});
+    else if(f == "sheen")
+      addExtension("KHR_materials_sheen", {{"sheenColorFactor", {color[0], color[1], color[2]}}, {"sheenRoughnessFactor", 0.5f}});
+    else if(f == "transmission" || f == "volume")
+    {
+      pbr["metallicFactor"]  = 0.f;
+      pbr["roughnessFactor"] = 0.05f;
+      addExtension("KHR_materials_transmission", {{"transmissionFactor", 1.f}});
+      if(f == "volume")
+        addExtension("KHR_materials_volume", {{"thicknessFactor", 0.2f}, {"attenuationDistance", 1.f}, {"attenuationColor", {color[0], color[1], color[2]}}});
+    }
+    else if(f == "ior")
+      addExtension("KHR_materials_ior", {{"ior", 1.8f}});
+    else if(f == "unlit")
+      addExtension("KHR_materials_unlit", json::object());
+    else if(f == "specgloss")
+    {
+      json sg = {{"diffuseFactor", {color[0], color[1], color[2], 1.f}}, {"specularFactor", {0.5f, 0.5f, 0.5f}}, {"glossinessFactor", 0.7f}};
+      if(params.textures > 0)
+        sg["diffuseTexture"] = {{"index", index % params.textures}};
+      addExtension("KHR_materials_pbrSpecularGlossiness", sg);
+    }
+    else if(f == "normalmap" && params.textures > 0)
+      material["normalTexture"] = {{"index", (index + 1) % params.textures}};
+    else if(f == "transform" && params.textures > 0)
+    {
+      pbr["baseColorTexture"]["extensions"]["KHR_texture_transform"] = {{"scale", {4.f, 4.f}}, {"rotation", 0.3f}};
+      extensionsUsed.insert("KHR_texture_transform");
+    }
+    else if(f == "alphamask")
+    {
+      material["alphaMode"]   = "MASK";
+      material["alphaCutoff"] = 0.5f;
+      material["doubleSided"] = true;
+    }
+  }
+  material["pbrMetallicRoughness"] = pbr;
+  return material;
+}
+
+bool writeBytes(const fs::path& filename, const void* data, size_t size)
+{
+  std::ofstream file(filename, std::ios::binary);
+  file.write(static_cast<const char*>(data), size);
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+// Binary glTF: header, JSON chunk padded with spaces, BIN chunk padded with zeros
+bool writeGlb(const fs::path& filename, const std::string& text, std::vector<uint8_t>& bin)
+{
+  std::string jsonChunk = text;
+  jsonChunk.resize((jsonChunk.size() + 3) & ~size_t(3), ' ');
+  bin.resize((bin.size() + 3) & ~size_t(3), 0);
+  const uint64_t total = 12 + 8 + jsonChunk.size() + (bin.empty() ? 0 : 8 + bin.size());
+  if(total > UINT32_MAX)
+  {
+    LOGE("The scene is too large for a .glb (%.1f GB), use .gltf\n", double(total) / (1 << 30));
+    return false;
+  }
+
+  std::vector<uint8_t> out;
+  out.reserve(total);
+  auto put32 = [&](uint32_t v) { out.insert(out.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + 4); };
+  put32(0x46546C67);  // glTF
+  put32(2);
+  put32(static_cast<uint32_t>(total));
+  put32(static_cast<uint32_t>(jsonChunk.size()));
+  put32(0x4E4F534A);  // JSON
+  out.insert(out.end(), jsonChunk.begin(), jsonChunk.end());
+  if(!bin.empty())
+  {
+    put32(static_cast<uint32_t>(bin.size()));
+    put32(0x004E4942);  // BIN
+    out.insert(out.end(), bin.begin(), bin.end());
+  }
+  return writeBytes(filename, out.data(), out.size());
+}
+
+}  // namespace
+
+
+const std::vector<std::string>& materialFeatures()
+{
+  static const std::vector<std::string> features{"pbr",       "emissive",  "clearcoat", "sheen",     "transmission", "volume",
+                                                 "ior",       "unlit",     "specgloss", "normalmap", "transform",    "alphamask"};
+  return features;
+}
+
+const std::vector<std::string>& sceneParamNames()
+{
+  static const std::vector<std::string> names{"triangles", "meshes",      "instances", "materials", "features",
+                                              "textures",  "texturesize", "lights",    "seed"};
+  return names;
+}
+
+bool setSceneParam(SceneParams& params, const std::string& name, const std::string& value)
+{
+  try
+  {
+    if(name == "features")
+    {
+      params.features.clear();
+      std::stringstream list(value);
+      for(std::string entry; std::getline(list, entry, ',');)
+      {
+        std::stringstream parts(entry);
+        for(std::string f; std::getline(parts, f, '+');)
+        {
+          const auto& known = materialFeatures();
+          if(std::find(known.begin(), known.end(), f) == known.end())
+          {
+            LOGE("Unknown material feature %s\n", f.c_str());
+            return false;
+          }
+        }
+        params.features.push_back(entry);
+      }
+      if(params.features.empty())
+        params.features = {"pbr"};
+      return true;
+    }
+
+    const uint64_t v = static_cast<uint64_t>(std::stod(value));  // 1e6 is accepted
+    if(name == "triangles")
+      params.triangles = std::max<uint64_t>(v, 1);
+    else if(name == "meshes")
+      params.meshes = std::max(uint32_t(v), 1u);
+    else if(name == "instances")
+      params.instances = std::max(uint32_t(v), 1u);
+    else if(name == "materials")
+      params.materials = std::max(uint32_t(v), 1u);
+    else if(name == "textures")
+      params.textures = uint32_t(v);
+    else if(name == "texturesize")
+      params.textureSize = std::max(uint32_t(v), 1u);
+    else if(name == "lights")
+      params.lights = uint32_t(v);
+    else if(name == "seed")
+      params.seed = uint32_t(v);
+    else
+    {
+      LOGE("Unknown scene parameter %s\n", name.c_str());
+      return false;
+    }
+  }
+  catch(const std::exception&)
+  {
+    LOGE("Invalid value %s for %s\n", value.c_str(), name.c_str());
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The meshes are written first, then the textures. Each primitive is an arc of the torus of its
+// mesh with its own material, so the materials are all used as long as there are enough arcs.
+//
+bool writeScene(const std::string& filename, const SceneParams& params)
+{
+  const fs::path    path(filename);
+  const bool        binary = path.extension() == ".glb";
+  const std::string stem   = path.stem().string();
+  if(!binary && path.extension() != ".gltf")
+  {
+    LOGE("The scene must be a .gltf or a .glb: %s\n", filename.c_str());
+    return false;
+  }
+
+  BinaryBuffer          buffer;
+  std::set<std::string> extensionsUsed;
+  json                  gltf = {{"asset", {{"version", "2.0"}, {"generator", "vk_raytrace scene generator"}}}};
+
+  // Meshes
+  const uint32_t prims     = std::max(1u, (params.materials + params.meshes - 1) / params.meshes);
+  const uint64_t meshTris  = std::max<uint64_t>(params.triangles / params.meshes, 2 * 3 * prims);
+  const uint32_t segV      = std::max(3u, static_cast<uint32_t>(std::lround(std::sqrt(double(meshTris) / 8.))));
+  const uint32_t segU      = std::max(prims, static_cast<uint32_t>((meshTris + 2 * segV - 1) / (2 * segV)));
+  uint64_t       triangles = 0;
+  for(uint32_t m = 0; m < params.meshes; m++)
+  {
+    json primitives = json::array();
+    for(uint32_t p = 0; p < prims; p++)
+    {
+      TorusArc arc;
+      makeTorusArc(uint32_t(uint64_t(segU) * p / prims), uint32_t(uint64_t(segU) * (p + 1) / prims), segU, segV,
+                   0.25f + 0.05f * float(m % 5), arc);
+      triangles += arc.indices.size() / 3;
+
+      const int position                = buffer.addAccessor(arc.positions, kFloat, 3, "VEC3", kArrayBuffer);
+      buffer.accessors[position]["min"] = {arc.bbMin[0], arc.bbMin[1], arc.bbMin[2]};  // Required for POSITION
+      buffer.accessors[position]["max"] = {arc.bbMax[0], arc.bbMax[1], arc.bbMax[2]};
+
+      json attributes;
+      attributes["POSITION"]   = position;
+      attributes["NORMAL"]     = buffer.addAccessor(arc.normals, kFloat, 3, "VEC3", kArrayBuffer);
+      attributes["TANGENT"]    = buffer.addAccessor(arc.tangents, kFloat, 4, "VEC4", kArrayBuffer);
+      attributes["TEXCOORD_0"] = buffer.addAccessor(arc.texcoords, kFloat, 2, "VEC2", kArrayBuffer);
+      primitives.push_back({{"attributes", attributes},
+                            {"indices", buffer.addAccessor(arc.indices, kUnsignedInt, 1, "SCALAR", kElementArrayBuffer)},
+                            {"material", (m * prims + p) % params.materials}});
+    }
+    gltf["meshes"].push_back({{"name", "mesh_" + std::to_string(m)}, {"primitives", primitives}});
+  }
+
+  // Instances on a grid centered on the origin, randomly turned around Y
+  std::mt19937                          rng(params.seed);
+  std::uniform_real_distribution<float> angle(0.f, 2.f * kPi);
+  const float                           spacing = 3.f;
+  const uint32_t                        side    = static_cast<uint32_t>(std::ceil(std::cbrt(double(params.instances)) - 1e-9));
+  const float                           center  = 0.5f * float(side - 1) * spacing;
+  json                                  roots   = json::array();
+  for(uint32_t i = 0; i < params.instances; i++)
+  {
+    const float a = angle(rng);
+    gltf["nodes"].push_back({{"mesh", i % params.meshes},
+                             {"translation", {float(i % side) * spacing - center, float(i / (side * side)) * spacing - center,
+                                              float((i / side) % side) * spacing - center}},
+                             {"rotation", {0.f, std::sin(0.5f * a), 0.f, std::cos(0.5f * a)}}});
+    roots.push_back(i);
+  }
+
+  // Lights on a circle above the grid, the spots looking down
+  const float height = center + 2.f * spacing;
+  const float radius = center + spacing;
+  for(uint32_t l = 0; l < params.lights; l++)
+  {
+    float color[3];
+    hueToRgb(itemHue(l + 3), color);
+    const bool spot  = l % 2 == 1;
+    json       light = {{"type", spot ? "spot" : "point"},
+                        {"color", {0.5f + 0.5f * color[0], 0.5f + 0.5f * color[1], 0.5f + 0.5f * color[2]}},
+                        {"intensity", 20.f * height * height / float(params.lights)}};
+    if(spot)
+      light["spot"] = {{"innerConeAngle", 0.3f}, {"outerConeAngle", 0.6f}};
+    gltf["extensions"]["KHR_lights_punctual"]["lights"].push_back(light);
+
+    const float a = 2.f * kPi * float(l) / float(params.lights);
+    gltf["nodes"].push_back({{"translation", {radius * std::cos(a), height, radius * std::sin(a)}},
+                             {"rotation", {-0.70710678f, 0.f, 0.f, 0.70710678f}},  // -Z to -Y
+                             {"extensions", {{"KHR_lights_punctual", {{"light", l}}}}}});
+    roots.push_back(params.instances + l);
+  }
+  if(params.lights > 0)
+    extensionsUsed.insert("KHR_lights_punctual");
+
+  // Materials, cycling over the features
+  for(uint32_t i = 0; i < params.materials; i++)
+    gltf["materials"].push_back(makeMaterial(i, params.features[i % params.features.size()], params, extensionsUsed));
+
+  // Textures
+  if(params.textures > 0)
+    gltf["samplers"] = {{{"magFilter", 9729}, {"minFilter", 9987}, {"wrapS", 10497}, {"wrapT", 10497}}};
+  for(uint32_t t = 0; t < params.textures; t++)
+  {
+    std::vector<uint8_t> png;
+    auto                 pixels = texturePixels(t, params.textureSize, params.seed);
+    ldr::encodePng(pixels.data(), params.textureSize, params.textureSize, 3, 1, png);
+    if(binary)
+      gltf["images"].push_back({{"bufferView", buffer.addView(png.data(), png.size())}, {"mimeType", "image/png"}});
+    else
+    {
+      const std::string name = stem + "_" + std::to_string(t) + ".png";
+      if(!writeBytes(path.parent_path() / name, png.data(), png.size()))
+        return false;
+      gltf["images"].push_back({{"uri", name}});
+    }
+    gltf["textures"].push_back({{"sampler", 0}, {"source", t}});
+  }
+
+  gltf["scene"]       = 0;
+  gltf["scenes"]      = {{{"nodes", roots}}};
+  gltf["accessors"]   = buffer.accessors;
+  gltf["bufferViews"] = buffer.views;
+  gltf["buffers"]     = {{{"byteLength", buffer.data.size()}}};
+  if(!extensionsUsed.empty())
+    gltf["extensionsUsed"] = extensionsUsed;
+
+  LOGI("%s: %llu triangles in %u meshes of %u primitives, %u instances, %u materials, %u textures of %u^2, %u lights\n",
+       filename.c_str(), static_cast<unsigned long long>(triangles), params.meshes, prims, params.instances,
+       params.materials, params.textures, params.textureSize, params.lights);
+
+  if(binary)
+    return writeGlb(path, gltf.dump(), buffer.data);
+
+  gltf["buffers"][0]["uri"] = stem + ".bin";
+  const std::string text    = gltf.dump();
+  return writeBytes(path.parent_path() / (stem + ".bin"), buffer.data.data(), buffer.data.size())
+         && writeBytes(path, text.data(), text.size());
+}
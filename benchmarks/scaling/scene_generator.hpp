@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Synthetic glTF scenes for the scaling studies (see scaling_sweep.cpp). Each parameter controls
+// one stage of the loading and rendering:
+//
+// - triangles : total of the distinct meshes, each mesh is a torus split in one arc per primitive
+// - meshes    : distinct meshes, the BLAS count
+// - instances : nodes on a 3D grid, each one referencing a mesh (mesh = node % meshes), the TLAS size.
+//               Instances don't add triangles to the file.
+// - materials : the primitives cycle over them, the features cycle over the materials
+// - textures  : RGB PNG of textureSize^2, the base color (and normal map) of the materials
+// - lights    : KHR_lights_punctual above the grid, alternating point and spot
+//
+// `.gltf` writes the JSON, a .bin and the PNG next to it, which loads the images in parallel.
+// `.glb` embeds everything.
+//
+struct SceneParams
+{
+  uint64_t                 triangles{100000};
+  uint32_t                 meshes{1};
+  uint32_t                 instances{1};
+  uint32_t                 materials{1};
+  std::vector<std::string> features{"pbr"};  // See materialFeatures()
+  uint32_t                 textures{0};
+  uint32_t                 textureSize{1024};
+  uint32_t                 lights{0};
+  uint32_t                 seed{1};
+};
+
+// pbr, emissive, clearcoat, sheen, transmission, volume, ior, unlit, specgloss, normalmap,
+// transform (KHR_texture_transform) and alphamask
+const std::vector<std::string>& materialFeatures();
+
+// Parameter by name, as the command line options of the tools: triangles, meshes, instances,
+// materials, features (comma separated), textures, texturesize, lights and seed
+const std::vector<std::string>& sceneParamNames();
+bool                            setSceneParam(SceneParams& params, const std::string& name, const std::string& value);
+
+// .gltf or .glb, from the extension
+bool writeScene(const std::string& filename, const SceneParams& params);
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Writes a synthetic scene, see scene_generator.hpp
+//
+// Usage:
+//   vk_raytrace_scenegen -o scene.gltf|scene.glb [-triangles 100000] [-meshes 1] [-instances 1]
+//                        [-materials 1] [-features pbr,clearcoat+sheen,...] [-textures 0]
+//                        [-texturesize 1024] [-lights 0] [-seed 1]
+//
+
+#include "nvh/inputparser.h"
+#include "nvh/nvprint.hpp"
+#include "scene_generator.hpp"
+#include "tools.hpp"
+
+
+int main(int argc, char** argv)
+{
+  InputParser parser(argc, argv);
+  std::string output = parser.getString("-o", "");
+  if(output.empty())
+  {
+    LOGE("Usage: %s -o scene.gltf|scene.glb [-<parameter> <value>] ...\n", argv[0]);
+    return 1;
+  }
+
+  SceneParams params;
+  for(const auto& name : sceneParamNames())
+    if(parser.exist("-" + name) && !setSceneParam(params, name, parser.getString("-" + name)))
+      return 1;
+
+  MilliTimer timer;
+  if(!writeScene(output, params))
+    return 1;
+  LOGI("Written in %.3f ms\n", timer.elapsed());
+  return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//-------------------------------------------------------------------------------------------------
+// Thumbnail atlas: the image is a grid of tiles of rtxState.atlasTile pixels, each one rendered
+// with its own camera and showing only its instances (see AtlasTile).
+// Needs `rtxState`, the push constant.
+
+#ifndef ATLAS_GLSL
+#define ATLAS_GLSL
+
+#include "layouts.glsl"
+
+// Tile of a pixel of the image, the tiles are stored row by row
+int AtlasTileIndex(ivec2 pixel)
+{
+  ivec2 tile    = pixel / rtxState.atlasTile;
+  int   columns = max(rtxState.size.x / rtxState.atlasTile.x, 1);
+  return tile.y * columns + tile.x;
+}
+
+// True when the instance (node) is part of the tile of the pixel, always without an atlas
+bool AtlasVisible(ivec2 pixel, int instance)
+{
+  if(rtxState.atlasTile.x <= 0)
+    return true;
+  AtlasTile tile = atlasTiles[AtlasTileIndex(pixel)];
+  if(tile.nbInstances == 0)
+    return true;
+  return instance >= tile.firstInstance && instance < tile.firstInstance + tile.nbInstances;
+}
+
+#endif  // ATLAS_GLSL
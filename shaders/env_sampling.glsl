@@ -99,6 +99,221 @@ vec3 Environment_sample(sampler2D lat_long_tex, in vec3 randVal, out vec3 to_lig
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Environment Sampling (HDR) using the importance pyramid and hierarchical sample warping
+// Level k of the pyramid is (2<<k) x (1<<k), stored from the coarsest, see hdr_sampling.cpp
+//-------------------------------------------------------------------------------------------------
+uint pyramidOffset(uint level)
+{
+  return 2u * ((1u << (2u * level)) - 1u) / 3u;
+}
+
+// Choosing the first element with probability p, and rescaling the random value to [0,1)
+bool warpSelect(float p, inout float xi)
+{
+  if(xi < p)
+  {
+    xi /= p;
+    return true;
+  }
+  xi = (xi - p) / (1.0f - p);
+  return false;
+}
+
+vec3 Environment_sampleMip(sampler2D lat_long_tex, in vec2 randVal, out vec3 to_light, out float pdf)
+{
+  vec2 xi = randVal;
+
+  // The number of levels is deduced from the size of the buffer
+  const uint nbLevels = uint(findMSB(3u * uint(envPyramid.length()) / 2u + 1u)) / 2u;
+
+  // Top level (2x1): left or right half of the sphere
+  const float total = envPyramid[0] + envPyramid[1];
+  uvec2       pos   = uvec2(0);
+  if(!warpSelect(total > 0.0f ? envPyramid[0] / total : 0.5f, xi.x))
+    pos.x = 1;
+
+  // Descending the pyramid: choose the row among the two children rows, then the column
+  for(uint level = 1; level < nbLevels; level++)
+  {
+    const uint width = 2u << level;
+    pos *= 2u;
+    const uint idx = pyramidOffset(level) + pos.y * width + pos.x;
+
+    float v00 = envPyramid[idx];
+    float v10 = envPyramid[idx + 1];
+    float v01 = envPyramid[idx + width];
+    float v11 = envPyramid[idx + width + 1];
+
+    float top = v00 + v10;
+    float sum = top + v01 + v11;
+    vec2  row = vec2(v00, v10);
+    if(!warpSelect(sum > 0.0f ? top / sum : 0.5f, xi.y))
+    {
+      pos.y += 1;
+      row = vec2(v01, v11);
+    }
+    if(!warpSelect(row.x + row.y > 0.0f ? row.x / (row.x + row.y) : 0.5f, xi.x))
+      pos.x += 1;
+  }
+
+  const uint width  = 2u << (nbLevels - 1u);
+  const uint height = 1u << (nbLevels - 1u);
+  const float leaf  = envPyramid[pyramidOffset(nbLevels - 1u) + pos.y * width + pos.x];
+  xi                = min(xi, vec2(0.99999994f));
+
+  // Uniformly sample the solid angle subtended by the leaf texel, as in Environment_sample
+  const float u       = (float(pos.x) + xi.x) / float(width);
+  const float phi     = u * (2.0f * M_PI) - M_PI;
+  float       sin_phi = sin(phi);
+  float       cos_phi = cos(phi);
+
+  const float step_theta = M_PI / float(height);
+  const float theta0     = float(pos.y) * step_theta;
+  const float cos_theta0 = cos(theta0);
+  const float cos_theta1 = cos(theta0 + step_theta);
+  const float cos_theta  = mix(cos_theta0, cos_theta1, xi.y);
+  const float theta      = acos(cos_theta);
+  const float sin_theta  = sin(theta);
+  const float v          = theta * M_1_OVER_PI;
+
+  // The PDF is the probability of the leaf divided by the solid angle it subtends
+  const float area = (cos_theta0 - cos_theta1) * (2.0f * M_PI / float(width));
+  pdf              = leaf / (total * area);
+
+  // Convert to a light direction vector in Cartesian coordinates
+  to_light = vec3(cos_phi * sin_theta, cos_theta, sin_phi * sin_theta);
+
+  // Lookup the environment value using bilinear filtering
+  return texture(lat_long_tex, vec2(u, v)).xyz;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Sun & Sky: the model is baked in `environmentTexture` (see sun_and_sky.cpp), except in the cone
+// holding the sun disk and its glow where it is evaluated, the disk being too small for the texture.
+// The cone is also sampled explicitly with probability rtxState.sunSampling.
+//-------------------------------------------------------------------------------------------------
+float SunConeCos()
+{
+  return cos((0.00465f * 10.0f) * _sunAndSky.sun_disk_scale);  // as in sun_and_sky()
+}
+
+// Uniform sampling of the directions in the sun cone
+vec3 SunConeSample(vec2 xi)
+{
+  const float cos_theta = mix(1.0f, SunConeCos(), xi.x);
+  const float sin_theta = sqrt(max(0.0f, 1.0f - cos_theta * cos_theta));
+  const float phi       = xi.y * 2.0f * M_PI;
+
+  vec3 N = normalize(_sunAndSky.sun_direction);
+  vec3 T, B;
+  CreateCoordinateSystem(N, T, B);
+  return normalize(T * (cos(phi) * sin_theta) + B * (sin(phi) * sin_theta) + N * cos_theta);
+}
+
+float SunConePdf(vec3 dir)
+{
+  const float cos_max = SunConeCos();
+  if(cos_max >= 1.0f || dot(dir, normalize(_sunAndSky.sun_direction)) < cos_max)
+    return 0.0f;
+  return 1.0f / (2.0f * M_PI * (1.0f - cos_max));
+}
+
+
+//-----------------------------------------------------------------------
+// The environment is rotated around Y by rtxState.envRotation. The texture,
+// its sampling data, the sun and the SH projection are in environment space.
+//-----------------------------------------------------------------------
+vec3 EnvToLocal(vec3 dir)
+{
+  const float c = cos(rtxState.envRotation);
+  const float s = sin(rtxState.envRotation);
+  return vec3(c * dir.x - s * dir.z, dir.y, s * dir.x + c * dir.z);
+}
+
+vec3 EnvToWorld(vec3 dir)
+{
+  const float c = cos(rtxState.envRotation);
+  const float s = sin(rtxState.envRotation);
+  return vec3(c * dir.x + s * dir.z, dir.y, -s * dir.x + c * dir.z);
+}
+
+
+//-----------------------------------------------------------------------
+// Radiance of the environment (HDR or Sun & Sky) in direction `dir`,
+// without hdrMultiplier
+//-----------------------------------------------------------------------
+vec3 EnvEval(vec3 dir)
+{
+  dir = EnvToLocal(dir);
+  if(_sunAndSky.in_use == 1 && SunConePdf(dir) > 0.0f)
+    return sun_and_sky(_sunAndSky, dir);
+  return texture(environmentTexture, GetSphericalUv(dir)).rgb;
+}
+
+
+//-----------------------------------------------------------------------
+// PDF of sampling the environment texture in direction `dir` (environment
+// space), as returned by Environment_sample or Environment_sampleMip.
+//-----------------------------------------------------------------------
+float EnvMapPdf(vec3 dir)
+{
+  vec2 uv = GetSphericalUv(dir);
+
+  if(rtxState.envSampling == eEnvMipPyramid)
+  {
+    const uint  nbLevels = uint(findMSB(3u * uint(envPyramid.length()) / 2u + 1u)) / 2u;
+    const uint  width    = 2u << (nbLevels - 1u);
+    const uint  height   = 1u << (nbLevels - 1u);
+    const uvec2 pos      = min(uvec2(uv * vec2(width, height)), uvec2(width - 1u, height - 1u));
+    const float total    = envPyramid[0] + envPyramid[1];
+    const float leaf     = envPyramid[pyramidOffset(nbLevels - 1u) + pos.y * width + pos.x];
+
+    const float step_theta = M_PI / float(height);
+    const float area = (cos(float(pos.y) * step_theta) - cos(float(pos.y + 1u) * step_theta)) * (2.0f * M_PI / float(width));
+    return leaf / (total * area);
+  }
+
+  uvec2       tsize = textureSize(environmentTexture, 0);
+  const uvec2 pos   = min(uvec2(uv * vec2(tsize)), tsize - uvec2(1u));
+  return envSamplingData[pos.y * tsize.x + pos.x].pdf;
+}
+
+//-----------------------------------------------------------------------
+// PDF of EnvSample() in direction `dir`. Used to weight the environment
+// hit by BSDF sampling (MIS).
+//-----------------------------------------------------------------------
+float EnvPdf(vec3 dir)
+{
+  dir       = EnvToLocal(dir);
+  float pdf = EnvMapPdf(dir);
+  if(_sunAndSky.in_use == 1)
+    pdf = mix(pdf, SunConePdf(dir), rtxState.sunSampling);
+  return pdf;
+}
+
+
+//-----------------------------------------------------------------------
+// Irradiance of the environment for the normal `n` from the SH projection
+// done in HdrSampling::projectIrradianceSH (no visibility, no multiplier)
+//-----------------------------------------------------------------------
+vec3 EnvShIrradiance(vec3 n)
+{
+  n      = EnvToLocal(n);
+  vec3 e = envShIrradiance[0].rgb * 0.282095f;
+  e += envShIrradiance[1].rgb * (0.488603f * n.y);
+  e += envShIrradiance[2].rgb * (0.488603f * n.z);
+  e += envShIrradiance[3].rgb * (0.488603f * n.x);
+  e += envShIrradiance[4].rgb * (1.092548f * n.x * n.y);
+  e += envShIrradiance[5].rgb * (1.092548f * n.y * n.z);
+  e += envShIrradiance[6].rgb * (0.315392f * (3.0f * n.z * n.z - 1.0f));
+  e += envShIrradiance[7].rgb * (1.092548f * n.x * n.z);
+  e += envShIrradiance[8].rgb * (0.546274f * (n.x * n.x - n.y * n.y));
+  return max(e, vec3(0.0f));  // ringing of bright sources
+}
+
+
 //-----------------------------------------------------------------------
 // Sampling the HDR environment or Sun and Sky
 //-----------------------------------------------------------------------
@@ -107,27 +322,27 @@ vec4 EnvSample(inout vec3 radiance)
   vec3  lightDir;
   float pdf;
 
-  // Sun & Sky or HDR
-  if(_sunAndSky.in_use == 1)
+  // Sun & Sky: choosing between the sun cone and the baked environment
+  if(_sunAndSky.in_use == 1 && rand(prd.seed) < rtxState.sunSampling)
   {
-    // #TODO: find proper light direction + PDF
-    float sun_radius = (0.00465f * 10.0f) * _sunAndSky.sun_disk_scale;
-    vec3  T, B;
-    CreateCoordinateSystem(_sunAndSky.sun_direction, T, B);
-    vec3 dir;
-    dir.x = rand(prd.seed) * sun_radius;
-    dir.y = rand(prd.seed) * sun_radius;
-    dir.z = sqrt(max(0.0, 1.0 - dir.x * dir.x - dir.y * dir.y));
-
-    lightDir = normalize(T * dir.x + B * dir.y + _sunAndSky.sun_direction * dir.z);
-    radiance = sun_and_sky(_sunAndSky, lightDir);
-    pdf      = 0.5;
+    lightDir = SunConeSample(vec2(rand(prd.seed), rand(prd.seed)));
   }
   else
   {
-    // Sampling the HDR with importance sampling
+    // Sampling the environment texture with importance sampling
     vec3 randVal = vec3(rand(prd.seed), rand(prd.seed), rand(prd.seed));
-    radiance     = Environment_sample(environmentTexture, randVal, lightDir, pdf);
+    if(rtxState.envSampling == eEnvMipPyramid)
+      radiance = Environment_sampleMip(environmentTexture, randVal.xy, lightDir, pdf);
+    else
+      radiance = Environment_sample(environmentTexture, randVal, lightDir, pdf);
+  }
+  lightDir = EnvToWorld(lightDir);
+
+  // The sun cone is evaluated and both strategies have to be accounted in the PDF
+  if(_sunAndSky.in_use == 1)
+  {
+    radiance = EnvEval(lightDir);
+    pdf      = EnvPdf(lightDir);
   }
 
   radiance *= rtxState.hdrMultiplier;
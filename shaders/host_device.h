@@ -28,6 +28,7 @@
 
 
 #ifdef __cplusplus
+#include <stddef.h>
 #include <stdint.h>
 #include "nvmath/nvmath.h"
 // GLSL Type
@@ -67,7 +68,29 @@ END_ENUM();
 // Output image - Set 1
 START_ENUM(OutputBindings)
   eSampler = 0,  // As sampler
-  eStore   = 1   // As storage
+  eStore   = 1,  // As storage
+  eAov     = 2,  // Auxiliary outputs, layers of AovLayers
+  eRelight = 3   // Radiance by light group, eRelightLayerCount layers (one unused layer when off)
+END_ENUM();
+
+// Layers of the AOV image, accumulated as the color
+START_ENUM(AovLayers)
+  eAovAlbedo      = 0,  // Albedo of the first hit, alpha unused
+  eAovNormalDepth = 1,  // Shading normal of the first hit and its distance to the camera
+  eAovEven        = 2,  // Color of the even frames only and their samples, for the convergence estimate
+  eAovSampling    = 3,  // Samples, importance (sample mask), instance of the first hit and time (us) of the pixel
+  eAovCount       = 4
+END_ENUM();
+
+// Relighting: the radiance is also accumulated by group of lights, the groups are scaled and
+// summed afterward to change the lighting without rendering (see relight.hpp)
+START_ENUM(LightGroups)
+  eLightGroupEnvironment = 0,  // HDR or sky, and the SH irradiance fallback
+  eLightGroupSun         = 1,  // Sun & Sky: the directions in the sun cone
+  eLightGroupEmissive    = 2,  // Emissive and unlit materials
+  eLightGroupPunctual    = 3,  // Punctual lights of set 0, set k is eLightGroupPunctual + k
+  eLightGroupCount       = 7,  // 4 sets of punctual lights
+  eRelightLayerCount     = 14  // Relight layers: direct light of group g in g, indirect in eLightGroupCount + g
 END_ENUM();
 
 // Scene Data - Set 2
@@ -83,7 +106,25 @@ END_ENUM();
 START_ENUM(EnvBindings)
   eSunSky     = 0, 
   eHdr        = 1, 
-  eImpSamples = 2 
+  eImpSamples = 2,
+  eImpPyramid = 3,
+  eShIrradiance = 4,  // SH irradiance of the environment
+  eAtlasTiles   = 5,  // Thumbnail atlas: AtlasTile of each tile
+  eFireflyHistogram = 6,  // Adaptive firefly clamp: luminance histogram of the samples of each tile
+  eFireflyThreshold = 7   // Adaptive firefly clamp: threshold of each tile
+END_ENUM();
+
+// Adaptive firefly clamp: the threshold of a tile of pixels is a quantile of the luminance of its
+// samples so far, see firefly_clamp.hpp
+START_ENUM(FireflyHistogram)
+  eFireflyTileSize = 32,  // Pixels
+  eFireflyBins     = 64   // Two per power of two, from 2^-16 to 2^16, the first one also has 0
+END_ENUM();
+
+// Environment importance sampling method
+START_ENUM(EnvSampling)
+  eEnvAliasMap   = 0,  // EnvAccel alias table, one entry per texel
+  eEnvMipPyramid = 1   // Hierarchical warping of a luminance mip pyramid
 END_ENUM();
 
 START_ENUM(DebugMode)
@@ -115,6 +156,17 @@ struct SceneCamera
   int nbLights;
 };
 
+// Thumbnail atlas: camera and visible instances of one tile
+struct AtlasTile
+{
+  mat4 viewInverse;
+  mat4 projInverse;
+  int  firstInstance;  // Visible nodes: [firstInstance, firstInstance + nbInstances)
+  int  nbInstances;    // 0: all nodes, -1: none (unused tile)
+  int  _pad0;
+  int  _pad1;
+};
+
 struct VertexAttributes
 {
   vec3 position;
@@ -200,8 +252,26 @@ struct RtxState
   ivec2 size;                   // rendering size
   int   minHeatmap;             // Debug mode - heat map
   int   maxHeatmap;
+  int   envSampling;            // See EnvSampling
+  float sunSampling;            // Sun & Sky: probability of sampling the sun cone
+  int   shDepth;                // Paths end with the SH irradiance on diffuse surfaces from this depth (0: off)
+  int   _pad1;                  // ivec2 need alignment
+  ivec2 tileOffset;             // Tiled rendering: position of the rendered region in the image of `size`
+  float envRotation;            // Rotation of the environment around the up axis, in radians
+  int   sampleMask;             // 1: the samples per pixel are scaled by the importance in eAovSampling
+  ivec2 atlasTile;              // Thumbnail atlas: size of the tiles, each with its camera and instances (0: off)
+  int   relight;                // 1: the radiance is also accumulated by light group, see LightGroups
+  int   fireflyTiles;           // Tiles per row of the adaptive firefly clamp, 0: fireflyClampThreshold for all
 };
 
+#ifdef __cplusplus
+// The push constant block is std430: an ivec2 is aligned on 8 bytes in GLSL but only on 4 with nvmath
+static_assert(offsetof(RtxState, size) % 8 == 0, "RtxState::size must be aligned as in GLSL");
+static_assert(offsetof(RtxState, tileOffset) % 8 == 0, "RtxState::tileOffset must be aligned as in GLSL");
+static_assert(offsetof(RtxState, atlasTile) % 8 == 0, "RtxState::atlasTile must be aligned as in GLSL");
+static_assert(sizeof(RtxState) % 8 == 0, "The push constant range must cover the whole GLSL block");
+#endif
+
 // Structure used for retrieving the primitive information in the closest hit
 // using gl_InstanceCustomIndexNV
 struct InstanceData
@@ -233,7 +303,8 @@ struct Light
   float outerConeCos;
   int   type;
 
-  vec2 padding;
+  int lightSet;  // Relighting: the light is in group eLightGroupPunctual + lightSet
+  int _pad0;
 };
 
 // Environment acceleration structure - computed in hdr_sampling
@@ -37,6 +37,8 @@
 layout(set = S_ACCEL, binding = eTlas)					uniform accelerationStructureEXT topLevelAS;
 //
 layout(set = S_OUT,   binding = eStore)					uniform image2D			resultImage;
+layout(set = S_OUT,   binding = eAov)					uniform image2DArray	aovImage;
+layout(set = S_OUT,   binding = eRelight)				uniform image2DArray	relightImage;
 //
 layout(set = S_SCENE, binding = eInstData,	scalar)     buffer _InstanceInfo	{ InstanceData geoInfo[]; };
 layout(set = S_SCENE, binding = eCamera,	scalar)		uniform _SceneCamera	{ SceneCamera sceneCamera; };
@@ -47,6 +49,11 @@ layout(set = S_SCENE, binding = eTextures	      )		uniform sampler2D		texturesMa
 layout(set = S_ENV, binding = eSunSky,		scalar)		uniform _SSBuffer		{ SunAndSky _sunAndSky; };
 layout(set = S_ENV, binding = eHdr)						uniform sampler2D		environmentTexture;
 layout(set = S_ENV, binding = eImpSamples,  scalar)		buffer _EnvAccel		{ EnvAccel envSamplingData[]; };
+layout(set = S_ENV, binding = eImpPyramid,  scalar)		buffer _EnvPyramid		{ float envPyramid[]; };
+layout(set = S_ENV, binding = eShIrradiance, scalar)	buffer _EnvShIrradiance	{ vec4 envShIrradiance[9]; };
+layout(set = S_ENV, binding = eAtlasTiles, scalar)		buffer _AtlasTiles		{ AtlasTile atlasTiles[]; };
+layout(set = S_ENV, binding = eFireflyHistogram)		buffer _FireflyHistogram	{ uint fireflyHistogram[]; };
+layout(set = S_ENV, binding = eFireflyThreshold)		buffer _FireflyThreshold	{ float fireflyThreshold[]; };
 
 layout(buffer_reference, scalar) buffer Vertices { VertexAttributes v[]; };
 layout(buffer_reference, scalar) buffer Indices	 { uvec3 i[];            };
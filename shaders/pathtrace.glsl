@@ -34,6 +34,7 @@
 #include "punctual.glsl"
 #include "env_sampling.glsl"
 #include "shade_state.glsl"
+#include "atlas.glsl"
 
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
@@ -90,8 +91,46 @@ struct VisibilityContribution
   vec3  lightDir;   // Direction to the light, to shoot shadow ray
   float lightDist;  // Distance to the light (1e32 for infinite or sky)
   bool  visible;    // true if in front of the face and should shoot shadow ray
+  int   lightGroup; // See LightGroups
 };
 
+//-----------------------------------------------------------------------
+// Relighting: with rtxState.relight, the radiance of the sample is also
+// added by light group, the direct light apart from the indirect one. The
+// layers of the samples of a pixel are summed as the AOVs and accumulated
+// in relightImage.
+// Direct light reaches the camera or the first hit without any bounce: the
+// emitters and environment seen from the camera or sampled from the first
+// hit, and the lights sampled at the first hit.
+//-----------------------------------------------------------------------
+vec3 relightSample[eRelightLayerCount];
+vec3 relightPixel[eRelightLayerCount];
+
+void RelightAdd(int group, bool direct, vec3 radiance)
+{
+  if(rtxState.relight != 0)
+    relightSample[direct ? group : int(eLightGroupCount) + group] += radiance;
+}
+
+// Sun & Sky: the sun cone is apart from the sky
+int EnvLightGroup(vec3 dir)
+{
+  if(_sunAndSky.in_use == 1 && SunConePdf(EnvToLocal(dir)) > 0.0f)
+    return int(eLightGroupSun);
+  return int(eLightGroupEnvironment);
+}
+
+//-----------------------------------------------------------------------
+// Probability for DirectLight() to sample the environment rather than one of
+// the lights: part of the PDF of the environment samples, for MIS
+//-----------------------------------------------------------------------
+float EnvSelectProbability()
+{
+  if(sceneCamera.nbLights == 0)
+    return 1.0f;
+  return rtxState.hdrMultiplier > 0.0f ? 0.5f : 0.0f;
+}
+
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
 VisibilityContribution DirectLight(in Ray r, in State state)
@@ -150,13 +189,17 @@ VisibilityContribution DirectLight(in Ray r, in State state)
     lightContrib = intensity;
     lightDir     = normalize(pointToLight);
     lightPdf     = 1.0;
+
+    contrib.lightGroup = int(eLightGroupPunctual) + clamp(light.lightSet, 0, int(eLightGroupCount - eLightGroupPunctual) - 1);
   }
   // Environment Light
   else
   {
     vec4 dirPdf = EnvSample(lightContrib);
     lightDir    = dirPdf.xyz;
-    lightPdf    = dirPdf.w;
+    lightPdf    = dirPdf.w * EnvSelectProbability();
+
+    contrib.lightGroup = EnvLightGroup(lightDir);
   }
 
   if(state.isSubsurface || dot(lightDir, state.ffnormal) > 0.0)
@@ -188,13 +231,120 @@ VisibilityContribution DirectLight(in Ray r, in State state)
 }
 
 
+//-----------------------------------------------------------------------
+// Surfaces for which the SH irradiance fallback is used: mostly diffuse,
+// not metallic nor transmissive
+//-----------------------------------------------------------------------
+bool IsDiffuseDominant(in State state)
+{
+  return state.mat.metallic < 0.5 && state.mat.transmission < 0.5 && state.mat.clearcoat < 0.5 && state.mat.roughness > 0.5;
+}
+
+//-----------------------------------------------------------------------
+// Auxiliary outputs: albedo, shading normal and distance of the first hit,
+// summed over the samples of the pixel and accumulated over the frames as the color.
+// The color of the frames of even index is also accumulated apart, with its
+// number of samples in w: with the accumulation of all frames it gives two
+// independent halves to compare.
+// eAovSampling holds the number of samples of the pixel (x), its importance (y)
+// when rtxState.sampleMask is set, the instance of the first hit (z) and the
+// time spent on the pixel in microseconds (w), summed over the frames.
+//-----------------------------------------------------------------------
+vec3     aovAlbedo;
+vec4     aovNormalDepth;
+float    aovInstance;
+uint64_t aovStart;
+
+void AovReset()
+{
+  aovAlbedo      = vec3(0);
+  aovNormalDepth = vec4(0);
+  aovInstance    = 0;
+  aovStart       = clockRealtimeEXT();
+  if(rtxState.relight != 0)
+    for(int g = 0; g < int(eRelightLayerCount); g++)
+      relightPixel[g] = vec3(0);
+}
+
+//-----------------------------------------------------------------------
+// Samples of the pixel in this frame: maxSamples, or scaled by the importance
+// of the pixel with a sample mask, the fraction taken at random. All pixels
+// have at least one sample in the first frame.
+//-----------------------------------------------------------------------
+int PixelSamples(ivec2 imageCoords)
+{
+  if(rtxState.sampleMask == 0)
+    return rtxState.maxSamples;
+
+  float n     = float(rtxState.maxSamples) * imageLoad(aovImage, ivec3(imageCoords, eAovSampling)).y;
+  int   count = int(n);
+  if(rand(prd.seed) < n - float(count))
+    count++;
+  return rtxState.frame == 0 ? max(count, 1) : count;
+}
+
+//-----------------------------------------------------------------------
+// Accumulating the color and the AOVs of the `nbSamples` of the frame,
+// weighted by the samples of the pixel so far
+//-----------------------------------------------------------------------
+void AccumulateResult(ivec2 imageCoords, vec3 pixelColor, int nbSamples)
+{
+  vec4 sampling = imageLoad(aovImage, ivec3(imageCoords, eAovSampling));
+  if(rtxState.frame == 0)
+    sampling.xw = vec2(0);  // First frame, replacing the values in the buffers
+
+  // The counts and the time are stored for every pixel. A pixel without samples in this frame
+  // (sample mask, never in the first frame) keeps its accumulation: the colors and the samples
+  // of the even frames stay in step with the total.
+  float cost     = float(clockRealtimeEXT() - aovStart) * 1e-3;
+  float instance = nbSamples > 0 ? aovInstance : sampling.z;
+  imageStore(aovImage, ivec3(imageCoords, eAovSampling), vec4(sampling.x + float(nbSamples), sampling.y, instance, sampling.w + cost));
+  if(nbSamples == 0)
+    return;
+
+  vec3  albedo      = aovAlbedo / float(nbSamples);
+  vec4  normalDepth = aovNormalDepth / float(nbSamples);
+  float w           = float(nbSamples) / (sampling.x + float(nbSamples));
+  vec3  frameColor  = pixelColor;
+  if(rtxState.frame > 0)
+  {
+    pixelColor  = mix(imageLoad(resultImage, imageCoords).xyz, pixelColor, w);
+    albedo      = mix(imageLoad(aovImage, ivec3(imageCoords, eAovAlbedo)).xyz, albedo, w);
+    normalDepth = mix(imageLoad(aovImage, ivec3(imageCoords, eAovNormalDepth)), normalDepth, w);
+  }
+  imageStore(resultImage, imageCoords, vec4(pixelColor, 1.f));
+  imageStore(aovImage, ivec3(imageCoords, eAovAlbedo), vec4(albedo, 1.f));
+  imageStore(aovImage, ivec3(imageCoords, eAovNormalDepth), normalDepth);
+
+  if(rtxState.relight != 0)
+  {
+    for(int g = 0; g < int(eRelightLayerCount); g++)
+    {
+      vec3 layer = relightPixel[g] / float(nbSamples);
+      if(rtxState.frame > 0)
+        layer = mix(imageLoad(relightImage, ivec3(imageCoords, g)).xyz, layer, w);
+      imageStore(relightImage, ivec3(imageCoords, g), vec4(layer, 1.f));
+    }
+  }
+
+  // The even frames are weighted by their samples as the whole accumulation, their count is in w
+  if((rtxState.frame & 1) == 0)
+  {
+    vec4 even = rtxState.frame > 0 ? imageLoad(aovImage, ivec3(imageCoords, eAovEven)) : vec4(0);
+    even.xyz  = mix(even.xyz, frameColor, float(nbSamples) / (even.w + float(nbSamples)));
+    imageStore(aovImage, ivec3(imageCoords, eAovEven), vec4(even.xyz, even.w + float(nbSamples)));
+  }
+}
+
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
 vec3 PathTrace(Ray r)
 {
-  vec3 radiance   = vec3(0.0);
-  vec3 throughput = vec3(1.0);
-  vec3 absorption = vec3(0.0);
+  vec3  radiance   = vec3(0.0);
+  vec3  throughput = vec3(1.0);
+  vec3  absorption = vec3(0.0);
+  float bsdfPdf    = 0.0;    // PDF of the last BSDF sample, for MIS with the environment sampling
+  bool  envMis     = false;  // The last BSDF sample could also be drawn by DirectLight()
 
   for(int depth = 0; depth < rtxState.maxDepth; depth++)
   {
@@ -203,6 +353,9 @@ vec3 PathTrace(Ray r)
     // Hitting the environment
     if(prd.hitT == INFINITY)
     {
+      if(depth == 0)
+        aovNormalDepth.w += INFINITY;
+
       if(rtxState.debugging_mode != eNoDebug)
       {
         if(depth != rtxState.maxDepth - 1)
@@ -215,16 +368,17 @@ vec3 PathTrace(Ray r)
           return (r.direction + vec3(1)) * 0.5;
       }
 
-      vec3 env;
-      if(_sunAndSky.in_use == 1)
-        env = sun_and_sky(_sunAndSky, r.direction);
-      else
-      {
-        vec2 uv = GetSphericalUv(r.direction);  // See sampling.glsl
-        env     = texture(environmentTexture, uv).rgb;
-      }
+      // HDR or baked Sun & Sky, see env_sampling.glsl
+      vec3 env = EnvEval(r.direction);
+
+      // The environment was also sampled in DirectLight(), balancing both strategies.
+      // Directions DirectLight() cannot sample (transmission, below the surface) keep all the weight.
+      if(depth > 0 && envMis)
+        env *= powerHeuristic(bsdfPdf, EnvPdf(r.direction) * EnvSelectProbability());
       // Done sampling return
-      return radiance + (env * rtxState.hdrMultiplier * throughput);
+      env *= rtxState.hdrMultiplier * throughput;
+      RelightAdd(EnvLightGroup(r.direction), depth <= 1, env);
+      return radiance + env;
     }
 
 
@@ -251,6 +405,13 @@ vec3 PathTrace(Ray r)
     // Color at vertices
     state.mat.albedo *= sstate.color;
 
+    if(depth == 0)
+    {
+      aovAlbedo += state.mat.albedo;
+      aovNormalDepth += vec4(state.normal, prd.hitT);
+      aovInstance = float(prd.instanceID + 1);
+    }
+
     // Debugging info
     if(rtxState.debugging_mode != eNoDebug && rtxState.debugging_mode < eRadiance)
       return DebugInfo(state);
@@ -258,6 +419,7 @@ vec3 PathTrace(Ray r)
     // KHR_materials_unlit
     if(state.mat.unlit)
     {
+      RelightAdd(int(eLightGroupEmissive), depth <= 1, state.mat.albedo * throughput);
       return radiance + state.mat.albedo * throughput;
     }
 
@@ -269,10 +431,22 @@ vec3 PathTrace(Ray r)
 
     // Emissive material
     radiance += state.mat.emission * throughput;
+    RelightAdd(int(eLightGroupEmissive), depth <= 1, state.mat.emission * throughput);
 
     // Add absoption (transmission / volume)
     throughput *= exp(-absorption * prd.hitT);
 
+    // Preview: from rtxState.shDepth, the path ends on diffuse surfaces with the irradiance of the
+    // environment (biased: no visibility and no punctual lights)
+    if(rtxState.shDepth > 0 && depth >= rtxState.shDepth && rtxState.debugging_mode == eNoDebug && IsDiffuseDominant(state))
+    {
+      vec3 diffuse = state.mat.albedo * (1.0 - state.mat.metallic) * M_1_OVER_PI;
+      vec3 shLight = diffuse * EnvShIrradiance(state.ffnormal) * rtxState.hdrMultiplier * throughput;
+      radiance += shLight;
+      RelightAdd(int(eLightGroupEnvironment), depth == 0, shLight);
+      break;
+    }
+
     // Light and environment contribution
     VisibilityContribution vcontrib = DirectLight(r, state);
     vcontrib.radiance *= throughput;
@@ -289,6 +463,8 @@ vec3 PathTrace(Ray r)
     if(bsdfSampleRec.pdf > 0.0)
     {
       throughput *= bsdfSampleRec.f * abs(dot(state.ffnormal, bsdfSampleRec.L)) / bsdfSampleRec.pdf;
+      bsdfPdf = bsdfSampleRec.pdf;
+      envMis  = state.isSubsurface || dot(bsdfSampleRec.L, state.ffnormal) > 0.0;
     }
     else
     {
@@ -327,6 +503,7 @@ vec3 PathTrace(Ray r)
       if(!inShadow)
       {
         radiance += vcontrib.radiance;
+        RelightAdd(vcontrib.lightGroup, depth == 0, vcontrib.radiance);
       }
     }
 
@@ -342,15 +519,47 @@ vec3 PathTrace(Ray r)
   return radiance;
 }
 
+//-----------------------------------------------------------------------
+// Firefly threshold of the pixel. With the adaptive clamp, the luminance
+// of the sample is counted in the histogram of its tile and the threshold
+// is the one the host derived from the previous frames.
+//-----------------------------------------------------------------------
+float FireflyThreshold(ivec2 bufferCoords, float lum)
+{
+  if(rtxState.fireflyTiles == 0)
+    return rtxState.fireflyClampThreshold;
+
+  ivec2 tile  = bufferCoords / int(eFireflyTileSize);
+  int   index = tile.y * rtxState.fireflyTiles + tile.x;
+  int   bin   = lum > 0.0 ? clamp(int(floor(log2(lum) * 2.0)) + int(eFireflyBins) / 2, 0, int(eFireflyBins) - 1) : 0;
+  atomicAdd(fireflyHistogram[index * int(eFireflyBins) + bin], 1);
+  return fireflyThreshold[index];
+}
+
 
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
 vec3 samplePixel(ivec2 imageCoords, ivec2 sizeImage)
 {
-  vec3 pixelColor = vec3(0);
+  vec3  pixelColor   = vec3(0);
+  ivec2 bufferCoords = imageCoords - rtxState.tileOffset;  // The firefly tiles cover the buffer, before the atlas
 
   // Subpixel jitter: send the ray through a different position inside the pixel each time, to provide antialiasing.
-  vec2 subpixel_jitter = rtxState.frame == 0 ? vec2(0.5f, 0.5f) : vec2(rand(prd.seed), rand(prd.seed));
+  // Only a single sample of the first frame goes through the center.
+  bool firstSample     = rtxState.frame == 0 && rtxState.maxSamples == 1;
+  vec2 subpixel_jitter = firstSample ? vec2(0.5f, 0.5f) : vec2(rand(prd.seed), rand(prd.seed));
+
+  // Thumbnail atlas: the camera of the tile, looking through the pixel of the tile
+  mat4 viewInverse = sceneCamera.viewInverse;
+  mat4 projInverse = sceneCamera.projInverse;
+  if(rtxState.atlasTile.x > 0)
+  {
+    AtlasTile tile = atlasTiles[AtlasTileIndex(imageCoords)];
+    viewInverse    = tile.viewInverse;
+    projInverse    = tile.projInverse;
+    imageCoords    = imageCoords % rtxState.atlasTile;
+    sizeImage      = rtxState.atlasTile;
+  }
 
   // Compute sampling position between [-1 .. 1]
   const vec2 pixelCenter = vec2(imageCoords) + subpixel_jitter;
@@ -358,30 +567,42 @@ vec3 samplePixel(ivec2 imageCoords, ivec2 sizeImage)
   vec2       d           = inUV * 2.0 - 1.0;
 
   // Compute ray origin and direction
-  vec4 origin    = sceneCamera.viewInverse * vec4(0, 0, 0, 1);
-  vec4 target    = sceneCamera.projInverse * vec4(d.x, d.y, 1, 1);
-  vec4 direction = sceneCamera.viewInverse * vec4(normalize(target.xyz), 0);
+  vec4 origin    = viewInverse * vec4(0, 0, 0, 1);
+  vec4 target    = projInverse * vec4(d.x, d.y, 1, 1);
+  vec4 direction = viewInverse * vec4(normalize(target.xyz), 0);
 
   // Depth-of-Field
   vec3  focalPoint        = sceneCamera.focalDist * direction.xyz;
   float cam_r1            = rand(prd.seed) * M_TWO_PI;
   float cam_r2            = rand(prd.seed) * sceneCamera.aperture;
-  vec4  cam_right         = sceneCamera.viewInverse * vec4(1, 0, 0, 0);
-  vec4  cam_up            = sceneCamera.viewInverse * vec4(0, 1, 0, 0);
+  vec4  cam_right         = viewInverse * vec4(1, 0, 0, 0);
+  vec4  cam_up            = viewInverse * vec4(0, 1, 0, 0);
   vec3  randomAperturePos = (cos(cam_r1) * cam_right.xyz + sin(cam_r1) * cam_up.xyz) * sqrt(cam_r2);
   vec3  finalRayDir       = normalize(focalPoint - randomAperturePos);
 
   Ray ray = Ray(origin.xyz + randomAperturePos, finalRayDir);
 
 
+  if(rtxState.relight != 0)
+    for(int g = 0; g < int(eRelightLayerCount); g++)
+      relightSample[g] = vec3(0);
+
   vec3 radiance = PathTrace(ray);
 
   // Removing fireflies
-  float lum = dot(radiance, vec3(0.212671f, 0.715160f, 0.072169f));
-  if(lum > rtxState.fireflyClampThreshold)
+  float lum        = dot(radiance, vec3(0.212671f, 0.715160f, 0.072169f));
+  float threshold  = FireflyThreshold(bufferCoords, lum);
+  float clampScale = 1.0;
+  if(lum > threshold)
   {
-    radiance *= rtxState.fireflyClampThreshold / lum;
+    clampScale = threshold / lum;
+    radiance *= clampScale;
   }
 
+  // The groups are clamped as the sum, they add up to the color
+  if(rtxState.relight != 0)
+    for(int g = 0; g < int(eRelightLayerCount); g++)
+      relightPixel[g] += relightSample[g] * clampScale;
+
   return radiance;
 }
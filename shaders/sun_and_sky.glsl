@@ -438,6 +438,12 @@ vec2 calc_physical_scale(float sun_disk_scale, float sun_glow_intensity, float s
 }
 
 
+// Irradiance of the ground, it only depends on the sun direction and can be cached by the host
+#ifndef SUN_AND_SKY_IRRAD
+#define SUN_AND_SKY_IRRAD(sun_dir) calc_irrad(sun_dir, 2.0)
+#endif
+
+
 float night_brightness_adjustment(vec3 sun_dir)
 {
   float lmt = 0.30901699437494742410229341718282;
@@ -549,7 +555,7 @@ vec3 sun_and_sky(in SunAndSky ss, in vec3 in_direction)
     vec3 irrad     = vec3(0.0);
     vec3 downcolor = ss.ground_color;
 
-    irrad = calc_irrad(sun_dir, 2.0);
+    irrad = SUN_AND_SKY_IRRAD(sun_dir);
     downcolor *= (irrad + data_sun_color * sun_dir.z) * rgb_scale;
     // apply 1+sun_dir.z night factor to downcolor
     // otherwise at sun_dir.z==-1 (midnight) we get a brightly
@@ -24,6 +24,7 @@
 // This is used in pathtrace.glsl (Ray-Generation shader)
 
 #include "shade_state.glsl"
+#include "atlas.glsl"
 
 //----------------------------------------------------------
 // Testing if the hit is opaque or alpha-transparent
@@ -34,6 +35,10 @@ bool HitTest(in rayQueryEXT rayQuery, in Ray r)
   int InstanceCustomIndexEXT = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false);
   int PrimitiveID            = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, false);
 
+  // Thumbnail atlas: the instances of other tiles are ignored
+  if(!AtlasVisible(ivec2(gl_GlobalInvocationID.xy) + rtxState.tileOffset, rayQueryGetIntersectionInstanceIdEXT(rayQuery, false)))
+    return false;
+
   // Retrieve the Primitive mesh buffer information
   InstanceData      pinfo    = geoInfo[InstanceCustomIndexEXT];
   const uint        matIndex = max(0, pinfo.materialIndex);  // material of primitive mesh
@@ -52,6 +57,10 @@ bool HitTest(in rayQueryEXT rayQuery, in Ray r)
   //  return true;
   //}
 
+  // With an atlas, the opaque instances are also tested (gl_RayFlagsNoOpaqueEXT)
+  if(rtxState.atlasTile.x > 0 && mat.alphaMode == ALPHA_OPAQUE)
+    return true;
+
   float baseColorAlpha = mat.pbrBaseColorFactor.a;
   if(mat.pbrBaseColorTexture > -1)
   {
@@ -108,6 +117,8 @@ bool HitTest(in rayQueryEXT rayQuery, in Ray r)
 void ClosestHit(Ray r)
 {
   uint rayFlags = gl_RayFlagsCullBackFacingTrianglesEXT;  // gl_RayFlagsNoneEXT
+  if(rtxState.atlasTile.x > 0)
+    rayFlags |= gl_RayFlagsNoOpaqueEXT;  // Instances are selected per tile by HitTest()
   prd.hitT      = INFINITY;
 
   // Initializes a ray query object but does not start traversal
@@ -155,6 +166,8 @@ bool AnyHit(Ray r, float maxDist)
   shadow_payload.isHit = true;      // Asume hit, will be set to false if hit nothing (miss shader)
   shadow_payload.seed  = prd.seed;  // don't care for the update - but won't affect the rahit shader
   uint rayFlags = gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT | gl_RayFlagsCullBackFacingTrianglesEXT;
+  if(rtxState.atlasTile.x > 0)
+    rayFlags |= gl_RayFlagsNoOpaqueEXT;  // Instances are selected per tile by HitTest()
 
   // Initializes a ray query object but does not start traversal
   rayQueryEXT rayQuery;
@@ -31,6 +31,8 @@
 void ClosestHit(Ray r)
 {
   uint rayFlags = gl_RayFlagsCullBackFacingTrianglesEXT;
+  if(rtxState.atlasTile.x > 0)
+    rayFlags |= gl_RayFlagsNoOpaqueEXT;  // Instances are selected per tile by the any-hit test
   prd.hitT      = INFINITY;
   traceRayEXT(topLevelAS,   // acceleration structure
               rayFlags,     // rayFlags
@@ -55,6 +57,8 @@ bool AnyHit(Ray r, float maxDist)
   shadow_payload.isHit = true;      // Asume hit, will be set to false if hit nothing (miss shader)
   shadow_payload.seed  = prd.seed;  // don't care for the update - but won't affect the rahit shader
   uint rayFlags = gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT | gl_RayFlagsCullBackFacingTrianglesEXT;
+  if(rtxState.atlasTile.x > 0)
+    rayFlags |= gl_RayFlagsNoOpaqueEXT;  // Instances are selected per tile by the any-hit test
 
   traceRayEXT(topLevelAS,   // acceleration structure
               rayFlags,     // rayFlags
@@ -61,7 +61,7 @@ void AccelStructure::create(nvh::GltfScene& gltfScene, const std::vector<nvvk::B
   createBottomLevelAS(gltfScene, vertex, index);
   createTopLevelAS(gltfScene);
   createRtDescriptorSet();
-  timer.print();
+  timer.print("acceleration structures");
 }
 
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "camera_path.hpp"
+#include "json_utils.hpp"
+#include "nvh/nvprint.hpp"
+
+namespace {
+
+// Uniform Catmull-Rom between p1 (t = 0) and p2 (t = 1)
+nvmath::vec3f catmullRom(const nvmath::vec3f& p0, const nvmath::vec3f& p1, const nvmath::vec3f& p2, const nvmath::vec3f& p3, float t)
+{
+  const float t2 = t * t;
+  const float t3 = t2 * t;
+  return 0.5f * ((2.f * p1) + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+}  // namespace
+
+
+bool CameraPath::load(const std::string& filename)
+{
+  std::ifstream file(filename);
+  if(!file)
+  {
+    LOGE("Cannot open the camera path %s\n", filename.c_str());
+    return false;
+  }
+
+  m_keys.clear();
+  try
+  {
+    json        root = json::parse(file);
+    const float fov  = root.value("fov", CameraKey().fov);
+
+    if(root.contains("matrices"))
+    {
+      int frame = root.value("start", 0);
+      for(const json& m : root["matrices"])
+      {
+        if(!m.is_array() || m.size() != 16)
+          throw std::runtime_error("expecting matrices of 16 numbers");
+        CameraKey key;
+        key.frame  = frame++;
+        key.eye    = {m[12].get<float>(), m[13].get<float>(), m[14].get<float>()};
+        key.up     = {m[4].get<float>(), m[5].get<float>(), m[6].get<float>()};
+        key.center = key.eye - nvmath::vec3f(m[8].get<float>(), m[9].get<float>(), m[10].get<float>());
+        key.fov    = fov;
+        m_keys.push_back(key);
+      }
+    }
+    else
+    {
+      for(const json& k : root.at("keyframes"))
+      {
+        CameraKey key;
+        key.frame  = k.at("frame").get<int>();
+        key.eye    = vec3FromJson(k.at("eye"));
+        key.center = vec3FromJson(k.at("center"));
+        key.up     = k.contains("up") ? vec3FromJson(k["up"]) : key.up;
+        key.fov    = k.value("fov", fov);
+        m_keys.push_back(key);
+      }
+      std::stable_sort(m_keys.begin(), m_keys.end(), [](const CameraKey& a, const CameraKey& b) { return a.frame < b.frame; });
+    }
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid camera path %s: %s\n", filename.c_str(), e.what());
+    m_keys.clear();
+    return false;
+  }
+
+  if(m_keys.empty())
+  {
+    LOGE("No camera in %s\n", filename.c_str());
+    return false;
+  }
+  LOGI("Camera path of %zu keys, frames %d to %d\n", m_keys.size(), firstFrame(), lastFrame());
+  return true;
+}
+
+CameraKey CameraPath::at(int frame) const
+{
+  if(m_keys.empty())
+    return {};
+
+  // First key after `frame`
+  auto it = std::upper_bound(m_keys.begin(), m_keys.end(), frame, [](int f, const CameraKey& k) { return f < k.frame; });
+  if(it == m_keys.begin())
+    return m_keys.front();
+  if(it == m_keys.end())
+    return m_keys.back();
+
+  const size_t     i2 = it - m_keys.begin();
+  const size_t     i1 = i2 - 1;
+  const CameraKey& k0 = m_keys[i1 > 0 ? i1 - 1 : i1];
+  const CameraKey& k1 = m_keys[i1];
+  const CameraKey& k2 = m_keys[i2];
+  const CameraKey& k3 = m_keys[std::min(i2 + 1, m_keys.size() - 1)];
+  const float      t  = float(frame - k1.frame) / float(k2.frame - k1.frame);
+
+  CameraKey key;
+  key.frame  = frame;
+  key.eye    = catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, t);
+  key.center = catmullRom(k0.center, k1.center, k2.center, k3.center, t);
+  key.up     = nvmath::normalize(k1.up * (1.f - t) + k2.up * t);
+  key.fov    = k1.fov * (1.f - t) + k2.fov * t;
+  return key;
+}
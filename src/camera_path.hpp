@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+
+//--------------------------------------------------------------------------------------------------
+// Camera of each frame of a sequence, read from a JSON file with either keyframes, interpolated
+// with a Catmull-Rom spline (the up vector and the field of view linearly):
+//
+//  {
+//    "fov": 45,
+//    "keyframes": [
+//      { "frame": 0,  "eye": [0, 1, 5], "center": [0, 1, 0], "up": [0, 1, 0] },
+//      { "frame": 48, "eye": [5, 2, 0], "center": [0, 1, 0], "fov": 30 }
+//    ]
+//  }
+//
+// or one matrix per frame from "start" (default 0): the world matrix of the camera, column-major
+// as in glTF, looking down -Z.
+//
+//  { "start": 0, "fov": 45, "matrices": [ [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 5, 1], ... ] }
+//
+struct CameraKey
+{
+  int           frame{0};
+  nvmath::vec3f eye{0.f, 0.f, 1.f};
+  nvmath::vec3f center{0.f, 0.f, 0.f};
+  nvmath::vec3f up{0.f, 1.f, 0.f};
+  float         fov{60.f};  // Vertical, in degrees
+};
+
+class CameraPath
+{
+public:
+  bool load(const std::string& filename);
+
+  bool empty() const { return m_keys.empty(); }
+  int  firstFrame() const { return m_keys.empty() ? 0 : m_keys.front().frame; }
+  int  lastFrame() const { return m_keys.empty() ? 0 : m_keys.back().frame; }
+
+  // Camera at `frame`, the first and last keys are held outside of the path
+  CameraKey at(int frame) const;
+
+private:
+  std::vector<CameraKey> m_keys;  // Sorted by frame
+};
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "checkpoint.hpp"
+#include "nvh/nvprint.hpp"
+#include "tools.hpp"
+
+
+namespace {
+
+constexpr char     kMagic[8] = {'V', 'K', 'R', 'T', 'C', 'K', 'P', 'T'};
+constexpr uint32_t kVersion  = 2;
+
+struct Header
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t nbAovs;
+  int32_t  frame;
+  int32_t  maxSamples;
+  uint32_t nbFireflyCounts;
+  uint64_t jobKey;
+};
+
+}  // namespace
+
+
+namespace checkpoint {
+
+uint64_t makeJobKey(const std::string& settings)
+{
+  uint64_t h = 14695981039346656037ull;
+  for(unsigned char c : settings)
+  {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Header, then the color, the AOVs and the sample counts, rows from top to bottom, and the
+// firefly histograms
+//
+bool save(const std::string& filename, const Checkpoint& ckpt)
+{
+  MilliTimer timer;
+  const std::string tmpName = filename + ".tmp";
+
+  FILE* f = fopen(tmpName.c_str(), "wb");
+  if(f == nullptr)
+  {
+    LOGE("Failed to create %s\n", tmpName.c_str());
+    return false;
+  }
+
+  Header header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version         = kVersion;
+  header.width           = ckpt.color.width;
+  header.height          = ckpt.color.height;
+  header.nbAovs          = static_cast<uint32_t>(ckpt.aovs.size());
+  header.frame           = ckpt.frame;
+  header.maxSamples      = ckpt.maxSamples;
+  header.nbFireflyCounts = static_cast<uint32_t>(ckpt.fireflyHistogram.size());
+  header.jobKey          = ckpt.jobKey;
+
+  auto writeFloats = [&](const std::vector<float>& v) { return fwrite(v.data(), sizeof(float), v.size(), f) == v.size(); };
+  bool written     = fwrite(&header, sizeof(header), 1, f) == 1;
+  written          = written && writeFloats(ckpt.color.pixels);
+  for(const auto& aov : ckpt.aovs)
+    written = written && writeFloats(aov.pixels);
+  written = written && fwrite(ckpt.sampleCount.data(), sizeof(uint32_t), ckpt.sampleCount.size(), f) == ckpt.sampleCount.size();
+  written = written
+            && fwrite(ckpt.fireflyHistogram.data(), sizeof(uint32_t), ckpt.fireflyHistogram.size(), f) == ckpt.fireflyHistogram.size();
+
+  // The data must be on disk before the rename makes it the checkpoint
+  written = written && fflush(f) == 0;
+#ifdef _WIN32
+  written = written && _commit(_fileno(f)) == 0;
+#else
+  written = written && fsync(fileno(f)) == 0;
+#endif
+  written = (fclose(f) == 0) && written;
+
+  std::error_code ec;
+  if(written)
+    std::filesystem::rename(tmpName, filename, ec);
+  if(!written || ec)
+  {
+    LOGE("Failed to write the checkpoint %s\n", filename.c_str());
+    std::filesystem::remove(tmpName, ec);
+    return false;
+  }
+
+  LOGI("Checkpoint at frame %d saved to %s (%.3f ms)\n", ckpt.frame, filename.c_str(), timer.elapsed());
+  return true;
+}
+
+bool load(const std::string& filename, Checkpoint& ckpt)
+{
+  FILE* f = fopen(filename.c_str(), "rb");
+  if(f == nullptr)
+    return false;
+
+  Header header{};
+  bool   valid = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+               && header.version == kVersion && header.width > 0 && header.height > 0 && header.nbAovs < 16;
+  if(valid)
+  {
+    const size_t pixelCount = size_t(header.width) * header.height;
+    auto         readImage  = [&](FloatImage& image) {
+      image.width    = header.width;
+      image.height   = header.height;
+      image.channels = 4;
+      image.pixels.resize(pixelCount * 4);
+      return fread(image.pixels.data(), sizeof(float), image.pixels.size(), f) == image.pixels.size();
+    };
+    ckpt.jobKey     = header.jobKey;
+    ckpt.frame      = header.frame;
+    ckpt.maxSamples = header.maxSamples;
+    valid           = readImage(ckpt.color);
+    ckpt.aovs.resize(header.nbAovs);
+    for(auto& aov : ckpt.aovs)
+      valid = valid && readImage(aov);
+    ckpt.sampleCount.resize(pixelCount);
+    valid = valid && fread(ckpt.sampleCount.data(), sizeof(uint32_t), pixelCount, f) == pixelCount;
+    ckpt.fireflyHistogram.resize(header.nbFireflyCounts);
+    valid = valid && fread(ckpt.fireflyHistogram.data(), sizeof(uint32_t), header.nbFireflyCounts, f) == header.nbFireflyCounts;
+  }
+  fclose(f);
+
+  if(!valid)
+    LOGE("%s is not a valid checkpoint\n", filename.c_str());
+  return valid;
+}
+
+}  // namespace checkpoint
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image_io.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Checkpoint of a progressive render, to resume it in another process.
+//
+// The accumulation buffer and the AOVs are stored as they are in RenderOutput (RGBA float), with
+// the number of samples of each pixel and the index of the last accumulated frame. The random
+// sequences of the shaders are only seeded from the pixel and the frame (see initRandom()), so
+// continuing at `frame + 1` draws new samples and the result is the same as without interruption.
+// The histograms of the adaptive firefly clamp are kept as well, the thresholds of the next frame
+// are the ones the uninterrupted render would use.
+//
+// The file is written next to the destination and renamed once complete: a crash or preemption
+// while saving keeps the previous checkpoint.
+//
+struct Checkpoint
+{
+  uint64_t                jobKey{0};  // Hash of the settings affecting the image, see makeJobKey()
+  int32_t                 frame{-1};  // Last accumulated frame
+  int32_t                 maxSamples{0};
+  FloatImage              color;             // RGBA
+  std::vector<FloatImage> aovs;              // RGBA, layers of AovLayers
+  std::vector<uint32_t>   sampleCount;       // Per pixel
+  std::vector<uint32_t>   fireflyHistogram;  // Tiles * eFireflyBins counts, empty without the adaptive clamp
+};
+
+namespace checkpoint {
+
+// FNV-1a of the settings, a checkpoint is only resumed with the same key
+uint64_t makeJobKey(const std::string& settings);
+
+bool save(const std::string& filename, const Checkpoint& ckpt);
+bool load(const std::string& filename, Checkpoint& ckpt);
+
+}  // namespace checkpoint
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "convergence.hpp"
+#include "tools.hpp"
+
+
+ConvergenceError estimateConvergence(const FloatImage& color,
+                                     const FloatImage& even,
+                                     const FloatImage& sampling,
+                                     uint32_t          blockSize)
+{
+  ConvergenceError result;
+  if(color.width != even.width || color.height != even.height || color.width != sampling.width
+     || color.height != sampling.height || color.channels < 3 || even.channels < 4 || sampling.channels < 1)
+    return result;
+
+  const uint32_t blocksX = (color.width + blockSize - 1) / blockSize;
+  const uint32_t blocksY = (color.height + blockSize - 1) / blockSize;
+
+  std::vector<float>    blockError(size_t(blocksX) * blocksY, 0.f);
+  std::vector<uint64_t> rowPixels(blocksY, 0);
+  parallelRanges(blocksY, [&](uint64_t begin, uint64_t end) {
+    std::vector<float> diff(blocksX), sum(blocksX);
+    for(uint64_t by = begin; by < end; by++)
+    {
+      std::fill(diff.begin(), diff.end(), 0.f);
+      std::fill(sum.begin(), sum.end(), 0.f);
+      const uint32_t y1 = std::min(color.height, uint32_t(by + 1) * blockSize);
+      for(uint32_t y = uint32_t(by) * blockSize; y < y1; y++)
+      {
+        const float* c = color.row(y);
+        const float* e = even.row(y);
+        const float* s = sampling.row(y);
+        for(uint32_t x = 0; x < color.width; x++, c += color.channels, e += even.channels, s += sampling.channels)
+        {
+          // all = (nbEven * even + nbOdd * odd) / (nbEven + nbOdd), in samples
+          const float nbAll  = s[0];
+          const float nbEven = e[3];
+          const float nbOdd  = nbAll - nbEven;
+          if(nbEven <= 0.f || nbOdd <= 0.f)
+            continue;
+          const float lumAll  = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+          const float lumEven = 0.2126f * e[0] + 0.7152f * e[1] + 0.0722f * e[2];
+          const float lumOdd  = std::max(0.f, (nbAll * lumAll - nbEven * lumEven) / nbOdd);
+          diff[x / blockSize] += std::abs(lumEven - lumOdd);
+          sum[x / blockSize] += lumEven + lumOdd;
+          rowPixels[by]++;
+        }
+      }
+      // A small bias for the dark blocks, black is converged
+      const float bias = 1e-4f * float(blockSize * blockSize);
+      for(uint32_t bx = 0; bx < blocksX; bx++)
+        blockError[by * blocksX + bx] = diff[bx] / (sum[bx] + bias);
+    }
+  });
+
+  // Nothing to compare yet (first frame)
+  if(std::accumulate(rowPixels.begin(), rowPixels.end(), uint64_t(0)) == 0)
+    return result;
+
+  double total = 0.;
+  result.max   = 0.f;
+  for(float e : blockError)
+  {
+    total += e;
+    result.max = std::max(result.max, e);
+  }
+  result.mean = float(total / blockError.size());
+  return result;
+}
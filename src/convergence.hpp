@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "image_io.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Convergence of a progressive render, estimated from two independent halves of its frames: the
+// frames of even index, accumulated in the eAovEven layer, and the odd ones, derived from the
+// accumulation of all frames. Where the halves agree the image doesn't change with more samples.
+// The halves are weighted by their samples in each pixel, which differ with a sample mask or
+// progressive passes.
+//
+// The difference is relative to the luminance and taken per block of pixels: a small noisy region
+// is not hidden by a converged background, and a few dark pixels don't dominate.
+//
+struct ConvergenceError
+{
+  float mean{1.f};  // Average over the blocks
+  float max{1.f};   // Worst block, the render is converged when it is below the target
+};
+
+// `color`, `even` and `sampling` are RGBA: the samples of the even frames are in the alpha of
+// `even` and the ones of all frames in the red of `sampling` (eAovSampling). Pixels without
+// samples in both halves are left out.
+ConvergenceError estimateConvergence(const FloatImage& color,
+                                     const FloatImage& even,
+                                     const FloatImage& sampling,
+                                     uint32_t          blockSize = 32);
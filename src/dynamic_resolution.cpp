@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "dynamic_resolution.hpp"
+#include "nvh/nvprint.hpp"
+
+
+bool DynamicResolution::update(double frameMs)
+{
+  if(!enabled() || frameMs <= 0.)
+    return false;
+
+  // The first frames after a change pay for the new allocation and caches
+  if(m_settle > 0)
+  {
+    m_settle--;
+    return false;
+  }
+
+  m_averageMs = m_averageMs > 0. ? m_averageMs + (frameMs - m_averageMs) * m_smoothing : frameMs;
+  if(std::abs(m_averageMs - m_targetMs) <= m_tolerance * m_targetMs)
+    return false;
+
+  // Work of a frame in full resolution single-sample frames, and what fits in the target
+  const double work       = m_samples / double(m_level * m_level);
+  const double msPerWork  = m_averageMs / work;
+  const double targetWork = m_targetMs / msPerWork;
+
+  float level   = 1.f;
+  int   samples = 1;
+  if(targetWork >= 1.)
+    samples = std::min(m_maxSamples, int(targetWork));
+  else
+    level = std::min(m_maxLevel, float(std::sqrt(1. / targetWork)));
+  level = std::ceil(level * 8.f) / 8.f;  // Steps of 1/8, not to resize on noise
+
+  if(level == m_level && samples == m_samples)
+    return false;
+
+  LOGI("Dynamic resolution: %.2f ms for %.2f ms, level %.3f -> %.3f, %d -> %d samples\n", m_averageMs, m_targetMs,
+       m_level, level, m_samples, samples);
+  m_level     = level;
+  m_samples   = samples;
+  m_averageMs = 0.;  // Measured again once settled
+  m_settle    = m_settleFrames;
+  return true;
+}
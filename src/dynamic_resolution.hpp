@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Closed loop on the frame time: the render resolution (descaling level, the post pass upscales)
+// and the samples per pass are chosen so that a frame takes about the target time.
+//
+// The cost of a frame is taken as proportional to samples / level^2. The measured times are
+// smoothed, and nothing changes while they stay within `m_tolerance` of the target: the
+// accumulation restarts when the resolution changes. Full resolution comes first, the samples per
+// pass only go up once the level is 1.
+//
+class DynamicResolution
+{
+public:
+  // Starting at full resolution with `samples` per pass
+  void setTarget(double frameMs, int samples = 1)
+  {
+    m_targetMs  = frameMs;
+    m_averageMs = 0.;
+    m_level     = 1.f;
+    m_samples   = samples;
+  }
+  bool enabled() const { return m_targetMs > 0.; }
+
+  // Time of the last frame rendered with level() and samples(), true when they changed
+  bool update(double frameMs);
+
+  float level() const { return m_level; }
+  int   samples() const { return m_samples; }
+
+  float  m_maxLevel{4.f};     // Lowest resolution: 1/4 of the width and height
+  int    m_maxSamples{16};    // Per pass
+  double m_tolerance{0.15};   // Relative, around the target
+  double m_smoothing{0.25};   // Weight of the last frame in the average
+  int    m_settleFrames{2};   // Frames ignored after a change
+
+private:
+  double m_targetMs{0.};
+  double m_averageMs{0.};  // 0: no measure yet
+  int    m_settle{0};
+  float  m_level{1.f};
+  int    m_samples{1};
+};
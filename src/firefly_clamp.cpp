@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "firefly_clamp.hpp"
+#include "shaders/host_device.h"
+#include "tools.hpp"
+
+
+namespace {
+
+//--------------------------------------------------------------------------------------------------
+// Luminance at quantile `q` of the histogram, interpolated in the log2 domain in its bin. The last
+// bin has no upper bound: no clamp.
+//
+template <typename T>
+float histogramQuantile(const T* bins, uint64_t count, float q)
+{
+  const double target = double(q) * double(count);
+  double       sum    = 0.;
+  for(uint32_t b = 0; b < eFireflyBins - 1; b++)
+  {
+    if(bins[b] > 0 && sum + double(bins[b]) >= target)
+    {
+      const double fraction = (target - sum) / double(bins[b]);
+      return float(std::exp2((double(b) - double(eFireflyBins / 2) + fraction) * 0.5));
+    }
+    sum += double(bins[b]);
+  }
+  return FLT_MAX;
+}
+
+}  // namespace
+
+
+void FireflyClamp::setup(uint32_t width, uint32_t height)
+{
+  m_tilesX = std::max(1u, (width + eFireflyTileSize - 1) / eFireflyTileSize);
+  m_tilesY = std::max(1u, (height + eFireflyTileSize - 1) / eFireflyTileSize);
+}
+
+void FireflyClamp::update(const uint32_t* histogram, std::vector<float>& thresholds) const
+{
+  const uint32_t tiles = tileCount();
+  thresholds.assign(tiles, FLT_MAX);
+
+  // Samples needed for `m_minAbove` above the quantile
+  const double minCount = double(m_minAbove) / std::max(1e-6, 1. - double(m_quantile));
+
+  // The whole image, for the tiles with too few samples
+  std::vector<uint64_t> image(eFireflyBins, 0);
+  uint64_t              imageCount = 0;
+  for(uint32_t t = 0; t < tiles; t++)
+    for(uint32_t b = 0; b < eFireflyBins; b++)
+    {
+      image[b] += histogram[size_t(t) * eFireflyBins + b];
+      imageCount += histogram[size_t(t) * eFireflyBins + b];
+    }
+  if(double(imageCount) < minCount)
+    return;
+  const float fallback = histogramQuantile(image.data(), imageCount, m_quantile);
+
+  parallelRanges(tiles, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t t = begin; t < end; t++)
+    {
+      const uint32_t* bins  = histogram + t * eFireflyBins;
+      uint64_t        count = 0;
+      for(uint32_t b = 0; b < eFireflyBins; b++)
+        count += bins[b];
+      thresholds[t] = double(count) < minCount ? fallback : histogramQuantile(bins, count, m_quantile);
+    }
+  });
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Adaptive firefly clamp: the path tracer counts the luminance of every sample in a histogram per
+// tile of eFireflyTileSize pixels (eFireflyBins logarithmic bins), and between the frames the
+// threshold of each tile becomes the `m_quantile` of its samples so far. The clamp follows the
+// lighting of each region instead of the average radiance of the environment.
+//
+// A tile with too few samples for the quantile takes the one of the whole image, and no clamp is
+// done without any statistics (the first frame).
+//
+class FireflyClamp
+{
+public:
+  // Tiles covering the buffers
+  void     setup(uint32_t width, uint32_t height);
+  uint32_t tilesX() const { return m_tilesX; }
+  uint32_t tilesY() const { return m_tilesY; }
+  uint32_t tileCount() const { return m_tilesX * m_tilesY; }
+  bool     enabled() const { return m_quantile > 0.f; }
+
+  // Threshold of each tile from the histograms of tileCount() * eFireflyBins counts
+  void update(const uint32_t* histogram, std::vector<float>& thresholds) const;
+
+  float    m_quantile{0.999f};  // 0: off, fireflyClampThreshold for all pixels
+  uint32_t m_minAbove{4};       // Samples above the quantile for a tile to have its own threshold
+
+private:
+  uint32_t m_tilesX{0};
+  uint32_t m_tilesY{0};
+};
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "frame_stream.hpp"
+#include "image_io.hpp"
+#include "nvh/nvprint.hpp"
+#include "tools.hpp"
+
+
+namespace {
+
+constexpr size_t kAlignment = 64;
+
+size_t alignUp(size_t size)
+{
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+size_t ringHeaderSize()
+{
+  return alignUp(sizeof(StreamRingHeader));
+}
+
+}  // namespace
+
+
+bool FrameStream::open(const std::string& target, StreamFormat format, uint32_t width, uint32_t height, bool framed, uint32_t slots)
+{
+  close();
+  m_format = format;
+  m_width  = width;
+  m_height = height;
+  m_framed = framed;
+
+  if(target.compare(0, 4, "shm:") == 0)
+    return openRing(target.substr(4), slots);
+
+#ifndef _WIN32
+  // A reader going away makes the writes fail instead of terminating the process
+  signal(SIGPIPE, SIG_IGN);
+#endif
+
+  if(target == "-")
+  {
+    // The frames keep the real stdout, everything else printed goes to stderr
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    _dup2(_fileno(stderr), _fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    m_file = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    m_file = fdopen(fd, "wb");
+#endif
+    m_stdout = true;
+  }
+  else
+  {
+    // Opening a named pipe waits for the reader
+    m_file = fopen(target.c_str(), "wb");
+  }
+
+  if(m_file == nullptr)
+  {
+    LOGE("Failed to open the frame stream %s\n", target.c_str());
+    return false;
+  }
+  LOGI("Streaming %ux%u %s frames to %s\n", width, height, format == StreamFormat::eRgba8 ? "rgba" : "rgba half",
+       m_stdout ? "stdout" : target.c_str());
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Shared memory ring, the slots are overwritten in turn: a slow reader skips frames but never
+// blocks the rendering.
+//
+bool FrameStream::openRing(const std::string& name, uint32_t slots)
+{
+#ifdef _WIN32
+  LOGE("Shared memory frame streams are not supported on Windows\n");
+  return false;
+#else
+  const size_t frameSize = size_t(m_width) * m_height * (m_format == StreamFormat::eRgba8 ? 4 : 8);
+  const size_t slotSize  = alignUp(sizeof(StreamRingSlot) + frameSize);
+  slots                  = std::max(slots, 1u);
+
+  m_ringName = name[0] == '/' ? name : "/" + name;
+  m_ringSize = ringHeaderSize() + slotSize * slots;
+
+  int fd = shm_open(m_ringName.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0 || ftruncate(fd, static_cast<off_t>(m_ringSize)) != 0)
+  {
+    LOGE("Failed to create the shared memory %s\n", m_ringName.c_str());
+    if(fd >= 0)
+      ::close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(data == MAP_FAILED)
+  {
+    LOGE("Failed to map the shared memory %s\n", m_ringName.c_str());
+    shm_unlink(m_ringName.c_str());
+    return false;
+  }
+
+  memset(data, 0, m_ringSize);
+  m_ring = static_cast<StreamRingHeader*>(data);
+  memcpy(m_ring->magic, "VKRTRING", 8);
+  m_ring->version   = 1;
+  m_ring->slotCount = slots;
+  m_ring->slotSize  = slotSize;
+  m_ring->published.store(0, std::memory_order_release);
+
+  LOGI("Streaming %ux%u frames to the shared memory %s (%u slots)\n", m_width, m_height, m_ringName.c_str(), slots);
+  return true;
+#endif
+}
+
+void FrameStream::close()
+{
+  if(m_file)
+    fclose(m_file);  // End of stream for the reader
+  m_file   = nullptr;
+  m_stdout = false;
+
+#ifndef _WIN32
+  if(m_ring)
+  {
+    munmap(m_ring, m_ringSize);
+    shm_unlink(m_ringName.c_str());  // Readers keep their mapping
+  }
+#endif
+  m_ring = nullptr;
+}
+
+bool FrameStream::push(uint64_t frame, const uint8_t* rgba8)
+{
+  if(m_format != StreamFormat::eRgba8)
+  {
+    LOGE("Frame stream: expecting half float frames\n");
+    return false;
+  }
+  return write(frame, rgba8);
+}
+
+bool FrameStream::push(uint64_t frame, const float* rgba32f)
+{
+  if(m_format != StreamFormat::eRgba16f)
+  {
+    LOGE("Frame stream: expecting 8-bit frames\n");
+    return false;
+  }
+
+  const size_t rowSize = size_t(m_width) * 4;
+  m_half.resize(rowSize * m_height);
+  parallelRanges(m_height, [&](uint64_t begin, uint64_t end) {
+    imageio::floatToHalf(rgba32f + begin * rowSize, (end - begin) * rowSize, m_half.data() + begin * rowSize);
+  });
+  return write(frame, m_half.data());
+}
+
+bool FrameStream::write(uint64_t frame, const void* pixels)
+{
+  if(!isOpen())
+    return false;
+
+  StreamFrameHeader header{};
+  memcpy(header.magic, "VKRF", 4);
+  header.width  = m_width;
+  header.height = m_height;
+  header.format = static_cast<uint32_t>(m_format);
+  header.frame  = frame;
+  header.size   = uint64_t(m_width) * m_height * (m_format == StreamFormat::eRgba8 ? 4 : 8);
+
+  if(m_ring)
+  {
+    const uint64_t index = m_ring->published.load(std::memory_order_relaxed);
+    uint8_t* base = reinterpret_cast<uint8_t*>(m_ring) + ringHeaderSize() + (index % m_ring->slotCount) * m_ring->slotSize;
+    auto*    slot = reinterpret_cast<StreamRingSlot*>(base);
+
+    // Odd while writing, readers seeing it or a change retry
+    const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->header = header;
+    memcpy(base + sizeof(StreamRingSlot), pixels, header.size);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    m_ring->published.store(index + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool written = !m_framed || fwrite(&header, sizeof(header), 1, m_file) == 1;
+  written      = written && fwrite(pixels, 1, header.size, m_file) == header.size;
+  written      = written && fflush(m_file) == 0;
+  if(!written)
+  {
+    LOGE("Frame stream closed by the reader\n");
+    close();
+  }
+  return written;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Streaming the frames as raw pixels, for encoders or viewers reading them as they are rendered.
+//
+// Targets:
+// - "-"          : stdout, the log is redirected to stderr
+// - "shm:<name>" : POSIX shared memory ring of `slots` frames (see StreamRingHeader)
+// - other        : a file or a named pipe (mkfifo)
+//
+// Pipes carry the raw pixels only, ready for ffmpeg:
+//   ffmpeg -f rawvideo -pix_fmt rgba -s 1008x660 -i - out.mp4   (eRgba8)
+//   ffmpeg -f rawvideo -pix_fmt rgbaf16le -s 1008x660 -i - ...  (eRgba16f)
+// With `framed`, each frame is preceded by a StreamFrameHeader.
+//
+
+enum class StreamFormat : uint32_t
+{
+  eRgba8   = 0,  // Tonemapped, 4 bytes per pixel
+  eRgba16f = 1,  // Accumulation buffer, 4 half floats per pixel
+};
+
+struct StreamFrameHeader
+{
+  char     magic[4];  // "VKRF"
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;  // StreamFormat
+  uint64_t frame;   // Index of the frame in the sequence, or accumulated frame
+  uint64_t size;    // Bytes of pixels following the header, rows from top to bottom
+};
+
+// Shared memory layout: the header, then `slotCount` slots of `slotSize` bytes. A slot is a
+// StreamRingSlot followed by the pixels. The `sequence` of a slot is odd while it is written: a
+// reader copies the frame of slot `(published - 1) % slotCount` and keeps it if the sequence is
+// even and didn't change.
+struct StreamRingHeader
+{
+  char                  magic[8];  // "VKRTRING"
+  uint32_t              version;
+  uint32_t              slotCount;
+  uint64_t              slotSize;
+  std::atomic<uint64_t> published;  // Number of frames written
+};
+
+struct StreamRingSlot
+{
+  std::atomic<uint64_t> sequence;
+  StreamFrameHeader     header;
+};
+
+class FrameStream
+{
+public:
+  ~FrameStream() { close(); }
+
+  bool open(const std::string& target, StreamFormat format, uint32_t width, uint32_t height, bool framed = false, uint32_t slots = 3);
+  void close();
+  bool isOpen() const { return m_file != nullptr || m_ring != nullptr; }
+  StreamFormat format() const { return m_format; }
+
+  // width * height RGBA pixels, matching the format
+  bool push(uint64_t frame, const uint8_t* rgba8);
+  bool push(uint64_t frame, const float* rgba32f);
+
+private:
+  bool write(uint64_t frame, const void* pixels);
+  bool openRing(const std::string& name, uint32_t slots);
+
+  StreamFormat          m_format{StreamFormat::eRgba8};
+  uint32_t              m_width{0};
+  uint32_t              m_height{0};
+  bool                  m_framed{false};
+  FILE*                 m_file{nullptr};
+  bool                  m_stdout{false};
+  StreamRingHeader*     m_ring{nullptr};
+  size_t                m_ringSize{0};
+  std::string           m_ringName;
+  std::vector<uint16_t> m_half;  // Conversion of the float frames
+};
@@ -28,18 +28,21 @@
 #include <cmath>
 #include <numeric>
 
-#include "stb_image.h"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvh/fileoperations.hpp"
 #include "hdr_sampling.hpp"
+#include "image_io.hpp"
+#include "sun_and_sky.hpp"
+#include "tools.hpp"
 
 
 void HdrSampling::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex, nvvk::ResourceAllocator* allocator)
 {
-  m_device      = device;
-  m_alloc       = allocator;
-  m_familyIndex = familyIndex;
+  m_device         = device;
+  m_physicalDevice = physicalDevice;
+  m_alloc          = allocator;
+  m_familyIndex    = familyIndex;
   m_debug.setup(device);
 }
 
@@ -47,6 +50,8 @@ void HdrSampling::destroy()
 {
   m_alloc->destroy(m_texHdr);
   m_alloc->destroy(m_accelImpSmpl);
+  m_alloc->destroy(m_accelPyramid);
+  m_alloc->destroy(m_shIrradiance);
 }
 
 
@@ -57,13 +62,62 @@ void HdrSampling::loadEnvironment(const std::string& hrdImage)
 {
   destroy();
 
-  int32_t width{0};
-  int32_t height{0};
-  int32_t component{0};
+  FloatImage hdr;
+  if(!imageio::loadRgb(hrdImage, hdr))
+  {
+    // Keeping a valid, uniform environment
+    hdr.width = hdr.height = 1;
+    hdr.channels           = 3;
+    hdr.pixels             = {1.f, 1.f, 1.f};
+  }
+  m_sunSampling = 0.f;
+  createEnvironment(hdr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Baking the Sun & Sky in a lat-long environment and create its importance sampling data.
+// The part of the importance in the sun cone is the probability to sample the cone explicitly,
+// keeping some samples for the sky when the sun dominates.
+//
+void HdrSampling::loadSunAndSky(const SunAndSky& ss, uint32_t width)
+{
+  destroy();
 
-  float*       pixels     = stbi_loadf(hrdImage.c_str(), &width, &height, &component, STBI_rgb_alpha);
-  VkDeviceSize bufferSize = width * height * 4 * sizeof(float);
-  VkExtent2D   imgSize{(uint32_t)width, (uint32_t)height};
+  FloatImage sky;
+  sunsky::bake(ss, width, sky);
+  m_sunSampling = std::min(sunsky::coneImportance(ss, sky), 0.9f);
+  createEnvironment(sky);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Upload of the environment texture and of the data for the selected sampling method
+//
+void HdrSampling::createEnvironment(const FloatImage& hdr)
+{
+  VkExtent2D imgSize{hdr.width, hdr.height};
+
+  // RGB float images are not sampled by all devices, expanding to RGBA only in that case
+  VkFormatProperties         formatProperties;
+  const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                                        | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  vkGetPhysicalDeviceFormatProperties(m_physicalDevice, VK_FORMAT_R32G32B32_SFLOAT, &formatProperties);
+  const bool         rgbTexture = (formatProperties.optimalTilingFeatures & features) == features;
+  std::vector<float> rgba;
+  if(!rgbTexture)
+  {
+    rgba.resize(size_t(hdr.width) * hdr.height * 4);
+    parallelRanges(hdr.height, [&](uint64_t begin, uint64_t end) {
+      for(size_t i = begin * hdr.width; i < end * hdr.width; i++)
+      {
+        rgba[i * 4 + 0] = hdr.pixels[i * 3 + 0];
+        rgba[i * 4 + 1] = hdr.pixels[i * 3 + 1];
+        rgba[i * 4 + 2] = hdr.pixels[i * 3 + 2];
+        rgba[i * 4 + 3] = 1.f;
+      }
+    });
+  }
+  const float* pixels     = hdr.pixels.data();
+  VkDeviceSize bufferSize = (rgbTexture ? hdr.pixels.size() : rgba.size()) * sizeof(float);
 
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_LINEAR;
@@ -73,7 +127,7 @@ void HdrSampling::loadEnvironment(const std::string& hrdImage)
   // Therefore, in U the sampler will use VK_SAMPLER_ADDRESS_MODE_REPEAT (default), but V needs to use
   // CLAMP_TO_EDGE to avoid having light leaking from one pole to another.
   samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  VkFormat          format       = VK_FORMAT_R32G32B32A32_SFLOAT;
+  VkFormat          format       = rgbTexture ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
   VkImageCreateInfo icInfo       = nvvk::makeImage2DCreateInfo(imgSize, format);
 
   {
@@ -83,19 +137,31 @@ void HdrSampling::loadEnvironment(const std::string& hrdImage)
     vkGetDeviceQueue(m_device, m_familyIndex, 0, &queue);
 
     nvvk::ScopeCommandBuffer cmdBuf(m_device, m_familyIndex, queue);
-    nvvk::Image              image  = m_alloc->createImage(cmdBuf, bufferSize, pixels, icInfo);
+    nvvk::Image              image  = m_alloc->createImage(cmdBuf, bufferSize, rgbTexture ? hdr.pixels.data() : rgba.data(), icInfo);
     VkImageViewCreateInfo    ivInfo = nvvk::makeImageViewCreateInfo(image.image, icInfo);
     m_texHdr                        = m_alloc->createTexture(image, ivInfo, samplerCreateInfo);
     NAME_VK(m_texHdr.image);
 
-    auto envAccel  = createEnvironmentAccel(pixels, imgSize);
-    m_accelImpSmpl = m_alloc->createBuffer(cmdBuf, envAccel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    // Only the data of the selected sampling method is built, the other buffer is a
+    // placeholder to keep the descriptor set valid
+    if(m_samplingMode == eEnvMipPyramid)
+    {
+      auto pyramid   = createEnvironmentPyramid(pixels, imgSize, hdr.channels);
+      m_accelPyramid = m_alloc->createBuffer(cmdBuf, pyramid, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+      m_accelImpSmpl = m_alloc->createBuffer(cmdBuf, std::vector<EnvAccel>(1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+    else
+    {
+      auto envAccel  = createEnvironmentAccel(pixels, imgSize, hdr.channels);
+      m_accelImpSmpl = m_alloc->createBuffer(cmdBuf, envAccel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+      m_accelPyramid = m_alloc->createBuffer(cmdBuf, std::vector<float>(2, 1.f), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+    m_shIrradiance = m_alloc->createBuffer(cmdBuf, projectIrradianceSH(pixels, imgSize, hdr.channels), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     NAME_VK(m_accelImpSmpl.buffer);
+    NAME_VK(m_accelPyramid.buffer);
+    NAME_VK(m_shIrradiance.buffer);
   }
   m_alloc->finalizeAndReleaseStaging();
-
-
-  stbi_image_free(pixels);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -181,10 +247,54 @@ inline float luminance(const float* color)
   return color[0] * 0.2126f + color[1] * 0.7152f + color[2] * 0.0722f;
 }
 
+//--------------------------------------------------------------------------------------------------
+// MIS compensation: see "MIS Compensation: Optimizing Sampling Techniques in Multiple Importance
+// Sampling", Karlik et al. 2019.
+// When the environment sampling is combined with BSDF sampling, removing a fraction of the average
+// radiance from the sampling distribution concentrates the samples on the bright features,
+// leaving the smooth parts to the BSDF sampling which handles them well.
+// Returns the value to subtract from the max component of each texel, 0 when disabled or if nothing
+// would be left to sample.
+//
+float HdrSampling::computeMisCompensation(const float* pixels, const VkExtent2D& size, uint32_t nbChannels)
+{
+  if(m_misCompensation <= 0.f)
+    return 0.f;
+
+  const uint32_t      rx        = size.width;
+  const uint32_t      ry        = size.height;
+  const float         stepPhi   = float(2.0 * M_PI) / float(rx);
+  const float         stepTheta = float(M_PI) / float(ry);
+  std::vector<double> rowIntegral(ry, 0.0);
+  std::vector<float>  rowMax(ry, 0.f);
+  parallelRanges(ry, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; ++y)
+    {
+      const float area = (std::cos(float(y) * stepTheta) - std::cos(float(y + 1) * stepTheta)) * stepPhi;
+      double      sum  = 0.0;
+      for(uint32_t x = 0; x < rx; ++x)
+      {
+        const float* p = &pixels[(y * rx + x) * nbChannels];
+        float        m = std::max(p[0], std::max(p[1], p[2]));
+        rowMax[y]      = std::max(rowMax[y], m);
+        sum += m;
+      }
+      rowIntegral[y] = sum * area;
+    }
+  });
+
+  // Average over the sphere (the integral is weighted by the solid angle)
+  double average      = std::accumulate(rowIntegral.begin(), rowIntegral.end(), 0.0) / (4.0 * M_PI);
+  float  compensation = static_cast<float>(average) * std::min(m_misCompensation, 1.f);
+  if(compensation >= *std::max_element(rowMax.begin(), rowMax.end()))
+    return 0.f;
+  return compensation;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Create acceleration data for importance sampling
 // See:  https://arxiv.org/pdf/1901.05423.pdf
-std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, VkExtent2D& size)
+std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, VkExtent2D& size, uint32_t nbChannels)
 {
   const uint32_t rx = size.width;
   const uint32_t ry = size.height;
@@ -196,6 +306,10 @@ std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, V
   const float           stepPhi   = float(2.0 * M_PI) / float(rx);
   const float           stepTheta = float(M_PI) / float(ry);
   double                total     = 0;
+  double                integral  = 0;
+
+  // Importance is lowered by this amount when MIS compensation is on
+  const float compensation = computeMisCompensation(pixels, size, nbChannels);
 
   // For each texel of the environment map, we compute the related solid angle
   // subtended by the texel, and store the weighted luminance in importance_data,
@@ -211,10 +325,12 @@ std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, V
     for(uint32_t x = 0; x < rx; ++x)
     {
       const uint32_t idx          = y * rx + x;
-      const uint32_t idx4         = idx * 4;
-      float          cieLuminance = luminance(&pixels[idx4]);
-      importanceData[idx]         = area * std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2]));
+      const float*   p            = &pixels[size_t(idx) * nbChannels];
+      float          cieLuminance = luminance(p);
+      float          maxComponent = std::max(p[0], std::max(p[1], p[2]));
+      importanceData[idx]         = area * std::max(maxComponent - compensation, 0.f);
       total += cieLuminance;
+      integral += area * maxComponent;
     }
   }
 
@@ -224,14 +340,17 @@ std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, V
   // so that all couples emit roughly the same amount of energy. To this aim,
   // each smaller radiance texel will be assigned an "alias" with higher emitted radiance
   // As a byproduct this function also returns the integral of the radiance emitted by the environment
-  m_integral = buildAliasmap(importanceData, envAccel);
+  // (or of the compensated importance)
+  const float importanceIntegral = buildAliasmap(importanceData, envAccel);
+  m_integral                     = static_cast<float>(integral);
 
   // We deduce the PDF of each texel by normalizing its emitted radiance by the radiance integral
-  const float invEnvIntegral = 1.0f / m_integral;
+  const float invEnvIntegral = 1.0f / importanceIntegral;
   for(uint32_t i = 0; i < rx * ry; ++i)
   {
-    const uint32_t idx4 = i * 4;
-    envAccel[i].pdf     = std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2])) * invEnvIntegral;
+    const float* p            = &pixels[size_t(i) * nbChannels];
+    const float  maxComponent = std::max(p[0], std::max(p[1], p[2]));
+    envAccel[i].pdf             = std::max(maxComponent - compensation, 0.f) * invEnvIntegral;
   }
 
   // At runtime a texel will be uniformly chosen. Whether that texel or its alias is
@@ -246,3 +365,165 @@ std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, V
 
   return envAccel;
 }
+
+//--------------------------------------------------------------------------------------------------
+// Create the luminance pyramid for hierarchical sample warping.
+// The finest level is a power of two, twice as wide as high (lat-long), and each of its texels
+// accumulates the solid angle weighted importance of the environment texels whose center falls in it.
+// Each coarser level is the sum of the 2x2 texels below, up to the 2x1 top level.
+// Sampling descends from the top level, choosing at each level one of the four children in
+// proportion to their importance and rescaling the random numbers, which keeps the stratification
+// of the incoming samples. Nothing else than the mip levels is needed, and each level is built in
+// parallel, making it much faster to rebuild than the alias map.
+//
+std::vector<float> HdrSampling::createEnvironmentPyramid(const float* pixels, const VkExtent2D& size, uint32_t nbChannels, uint32_t maxWidth)
+{
+  const uint32_t rx = size.width;
+  const uint32_t ry = size.height;
+
+  // Number of levels, the finest is (2<<(levels-1)) x (1<<(levels-1))
+  uint32_t levels = 1;
+  while((2u << levels) <= std::min(rx, maxWidth))
+    levels++;
+  const uint32_t bw = 2u << (levels - 1);
+  const uint32_t bh = 1u << (levels - 1);
+
+  std::vector<float> pyramid(pyramidOffset(levels), 0.f);
+  float*             finest = &pyramid[pyramidOffset(levels - 1)];
+
+  // Pyramid row and column of each environment texel center, and first environment row of each pyramid row
+  std::vector<uint32_t> colMap(rx);
+  std::vector<uint32_t> rowStart(bh + 1, ry);
+  for(uint32_t x = 0; x < rx; ++x)
+    colMap[x] = static_cast<uint32_t>((uint64_t(2 * x + 1) * bw) / (uint64_t(2) * rx));
+  for(uint32_t y = ry; y-- > 0;)
+    rowStart[static_cast<uint32_t>((uint64_t(2 * y + 1) * bh) / (uint64_t(2) * ry))] = y;
+  for(uint32_t by = bh; by-- > 0;)
+    rowStart[by] = std::min(rowStart[by], rowStart[by + 1]);
+
+  // Importance is lowered by this amount when MIS compensation is on
+  const float compensation = computeMisCompensation(pixels, size, nbChannels);
+
+  // Finest level: each thread works on its own pyramid rows
+  const float         stepPhi   = float(2.0 * M_PI) / float(rx);
+  const float         stepTheta = float(M_PI) / float(ry);
+  std::vector<double> rowIntegral(bh, 0.0);
+  std::vector<double> rowLuminance(bh, 0.0);
+  parallelRanges(bh, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t by = begin; by < end; ++by)
+    {
+      float* dst = &finest[by * bw];
+      for(uint32_t y = rowStart[by]; y < rowStart[by + 1]; ++y)
+      {
+        const float area = (std::cos(float(y) * stepTheta) - std::cos(float(y + 1) * stepTheta)) * stepPhi;  // solid angle
+        for(uint32_t x = 0; x < rx; ++x)
+        {
+          const float* p = &pixels[(uint64_t(y) * rx + x) * nbChannels];
+          float        m = std::max(p[0], std::max(p[1], p[2]));
+          dst[colMap[x]] += area * std::max(m - compensation, 0.f);
+          rowIntegral[by] += area * m;
+          rowLuminance[by] += p[0] * 0.2126f + p[1] * 0.7152f + p[2] * 0.0722f;
+        }
+      }
+    }
+  });
+
+  // Coarser levels, sum of the four children
+  for(uint32_t level = levels - 1; level-- > 0;)
+  {
+    const uint32_t w   = 2u << level;
+    const uint32_t h   = 1u << level;
+    float*         dst = &pyramid[pyramidOffset(level)];
+    const float*   src = &pyramid[pyramidOffset(level + 1)];
+    parallelRanges(h, [&](uint64_t begin, uint64_t end) {
+      for(uint64_t y = begin; y < end; ++y)
+      {
+        const float* r0 = &src[(2 * y) * (2 * w)];
+        const float* r1 = r0 + 2 * w;
+        for(uint32_t x = 0; x < w; ++x)
+          dst[y * w + x] = r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1];
+      }
+    });
+  }
+
+  m_integral = static_cast<float>(std::accumulate(rowIntegral.begin(), rowIntegral.end(), 0.0));
+  m_average  = static_cast<float>(std::accumulate(rowLuminance.begin(), rowLuminance.end(), 0.0) / (double(rx) * double(ry)));
+
+  return pyramid;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Projection of the environment on the real spherical harmonics of bands 0 to 2, each texel
+// weighted by its solid angle, then convolved with the clamped cosine lobe (Ramamoorthi & Hanrahan,
+// "An Efficient Representation for Irradiance Environment Maps", 2001).
+// The irradiance for a normal n is then: sum_i coef[i] * Y_i(n)
+//
+std::vector<vec4> HdrSampling::projectIrradianceSH(const float* pixels, const VkExtent2D& size, uint32_t nbChannels)
+{
+  const uint32_t rx        = size.width;
+  const uint32_t ry        = size.height;
+  const float    stepPhi   = float(2.0 * M_PI) / float(rx);
+  const float    stepTheta = float(M_PI) / float(ry);
+
+  // Each row accumulates its own coefficients
+  std::vector<std::array<double, 27>> rowSH(ry);
+  parallelRanges(ry, [&](uint64_t begin, uint64_t end) {
+    std::vector<float> cosPhi(rx), sinPhi(rx);
+    for(uint32_t x = 0; x < rx; ++x)
+    {
+      const float phi = (float(x) + 0.5f) * stepPhi - float(M_PI);
+      cosPhi[x]       = std::cos(phi);
+      sinPhi[x]       = std::sin(phi);
+    }
+
+    for(uint64_t y = begin; y < end; ++y)
+    {
+      const float theta    = (float(y) + 0.5f) * stepTheta;
+      const float area     = (std::cos(float(y) * stepTheta) - std::cos(float(y + 1) * stepTheta)) * stepPhi;
+      const float sinTheta = std::sin(theta);
+      const float cosTheta = std::cos(theta);
+      auto&       sh       = rowSH[y];
+      sh.fill(0.0);
+      for(uint32_t x = 0; x < rx; ++x)
+      {
+        // Same direction as Environment_sample()
+        const float  dx = cosPhi[x] * sinTheta;
+        const float  dy = cosTheta;
+        const float  dz = sinPhi[x] * sinTheta;
+        const float  basis[9]{0.282095f,
+                             0.488603f * dy,
+                             0.488603f * dz,
+                             0.488603f * dx,
+                             1.092548f * dx * dy,
+                             1.092548f * dy * dz,
+                             0.315392f * (3.f * dz * dz - 1.f),
+                             1.092548f * dx * dz,
+                             0.546274f * (dx * dx - dy * dy)};
+        const float* p = &pixels[(uint64_t(y) * rx + x) * nbChannels];
+        for(uint32_t i = 0; i < 9; ++i)
+        {
+          sh[i * 3 + 0] += p[0] * basis[i];
+          sh[i * 3 + 1] += p[1] * basis[i];
+          sh[i * 3 + 2] += p[2] * basis[i];
+        }
+      }
+      for(auto& c : sh)
+        c *= area;
+    }
+  });
+
+  // Convolution with the clamped cosine, per band
+  const double      band[3]{M_PI, 2.0 * M_PI / 3.0, M_PI / 4.0};
+  const uint32_t    bandOf[9]{0, 1, 1, 1, 2, 2, 2, 2, 2};
+  std::vector<vec4> coef(9);
+  for(uint32_t i = 0; i < 9; ++i)
+  {
+    double rgb[3]{0, 0, 0};
+    for(uint32_t y = 0; y < ry; ++y)
+      for(uint32_t c = 0; c < 3; ++c)
+        rgb[c] += rowSH[y][i * 3 + c];
+    const double a = band[bandOf[i]];
+    coef[i]        = vec4(float(rgb[0] * a), float(rgb[1] * a), float(rgb[2] * a), 0.f);
+  }
+  return coef;
+}
@@ -28,11 +28,17 @@
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/images_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "image_io.hpp"
 #include "shaders/host_device.h"
 
 //--------------------------------------------------------------------------------------------------
 // Load an environment image (HDR) and create an acceleration structure for
 // important light sampling.
+// Two sampling methods are available (see EnvSampling), only the data of the selected one is built:
+// - eEnvAliasMap   : m_accelImpSmpl holds one EnvAccel per texel
+// - eEnvMipPyramid : m_accelPyramid holds the solid angle weighted importance, all mip levels
+// The environment is either an image or the Sun & Sky baked in a lat-long image (loadSunAndSky).
+// The irradiance of the environment is also projected on spherical harmonics (m_shIrradiance).
 class HdrSampling
 {
 public:
@@ -40,26 +46,53 @@ public:
 
   void setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex, nvvk::ResourceAllocator* allocator);
   void loadEnvironment(const std::string& hrdImage);
+  // Bakes the Sun & Sky model (width x width/2), to be done again when `ss` changes
+  void loadSunAndSky(const SunAndSky& ss, uint32_t width = 1024);
 
 
-  void  destroy();
-  float getIntegral() { return m_integral; }
-  float getAverage() { return m_average; }
+  void        destroy();
+  float       getIntegral() { return m_integral; }
+  float       getAverage() { return m_average; }
+  void        setSamplingMode(EnvSampling mode) { m_samplingMode = mode; }
+  EnvSampling getSamplingMode() const { return m_samplingMode; }
+  // Fraction [0..1] of the average radiance removed from the sampling distribution (0: off)
+  void  setMisCompensation(float fraction) { m_misCompensation = fraction; }
+  float getMisCompensation() const { return m_misCompensation; }
+  // Probability of sampling the sun cone, 0 for HDR images
+  float getSunSampling() const { return m_sunSampling; }
+
+  // Host side construction of the sampling data (no Vulkan involved)
+  float                 buildAliasmap(const std::vector<float>& data, std::vector<EnvAccel>& accel);
+  // `pixels` are RGB or RGBA floats (nbChannels)
+  std::vector<EnvAccel> createEnvironmentAccel(const float* pixels, VkExtent2D& size, uint32_t nbChannels = 3);
+  std::vector<float> createEnvironmentPyramid(const float* pixels, const VkExtent2D& size, uint32_t nbChannels = 3, uint32_t maxWidth = 8192);
+
+  // Irradiance of the environment as 9 SH coefficients (RGB, w unused): the radiance projected on
+  // the bands 0..2 and convolved with the clamped cosine. See shIrradiance() in env_sampling.glsl.
+  std::vector<vec4> projectIrradianceSH(const float* pixels, const VkExtent2D& size, uint32_t nbChannels = 3);
+
+  // Level k of the pyramid is (2<<k) x (1<<k) and levels are stored from the coarsest
+  static uint32_t pyramidOffset(uint32_t level) { return 2u * ((1u << (2u * level)) - 1u) / 3u; }
 
   // Resources
   nvvk::Texture m_texHdr;
   nvvk::Buffer  m_accelImpSmpl;
+  nvvk::Buffer  m_accelPyramid;
+  nvvk::Buffer  m_shIrradiance;
 
 private:
+  void  createEnvironment(const FloatImage& hdr);
+  float computeMisCompensation(const float* pixels, const VkExtent2D& size, uint32_t nbChannels);
+
   VkDevice                 m_device{VK_NULL_HANDLE};
+  VkPhysicalDevice         m_physicalDevice{VK_NULL_HANDLE};
   uint32_t                 m_familyIndex{0};
   nvvk::ResourceAllocator* m_alloc{nullptr};
   nvvk::DebugUtil          m_debug;
 
-  float m_integral{1.f};
-  float m_average{1.f};
-
-
-  float                 buildAliasmap(const std::vector<float>& data, std::vector<EnvAccel>& accel);
-  std::vector<EnvAccel> createEnvironmentAccel(const float* pixels, VkExtent2D& size);
+  float       m_integral{1.f};
+  float       m_average{1.f};
+  EnvSampling m_samplingMode{eEnvAliasMap};
+  float       m_misCompensation{0.f};
+  float       m_sunSampling{0.f};
 };
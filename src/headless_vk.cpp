@@ -321,6 +321,23 @@ void HeadlessAppVK::submitWork(const VkCommandBuffer& cmdBuffer)
   vkDestroyFence(m_device, fence, nullptr);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Changing the size of the color and depth buffers, the derived class is called by onResize()
+// to recreate what depends on the size
+//
+void HeadlessAppVK::setSize(uint32_t width, uint32_t height)
+{
+  if(width == m_size.width && height == m_size.height)
+    return;
+
+  vkDeviceWaitIdle(m_device);
+  m_size = {width, height};
+  createColorBuffer();
+  createDepthBuffer();
+  createFrameBuffer();
+  onResize(width, height);
+}
+
 //--------------------------------------------------------------------------------------------------
 // When the pipeline is set for using dynamic, this becomes useful
 //
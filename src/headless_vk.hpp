@@ -47,6 +47,8 @@ public:
   virtual void createColorBuffer();
   virtual void createCommandBuffer();
   virtual void submitWork(const VkCommandBuffer& cmdBuffer);  
+  void         setSize(uint32_t width, uint32_t height);
+  virtual void onResize(int /*w*/, int /*h*/){};  // To implement when the size of the buffers changes
 
   void         setViewport(const VkCommandBuffer& cmdBuf);
   void         fitCamera(const nvmath::vec3f& boxMin, const nvmath::vec3f& boxMax, bool instantFit = true);
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define HOSTTM_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "host_tonemapper.hpp"
+#include "nvh/nvprint.hpp"
+#include "tools.hpp"
+
+
+namespace {
+
+//--------------------------------------------------------------------------------------------------
+// Four floats, with SSE2 when available. log2 and exp2 are polynomial approximations (relative
+// error around 1e-5), the same on both paths.
+//
+#ifdef HOSTTM_SSE2
+struct Vec4
+{
+  __m128 v;
+  Vec4(__m128 x)
+      : v(x)
+  {
+  }
+  Vec4(float x)
+      : v(_mm_set1_ps(x))
+  {
+  }
+  static Vec4 load(const float* p) { return _mm_loadu_ps(p); }
+  void        store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b) { return _mm_add_ps(a.v, b.v); }
+inline Vec4 operator-(Vec4 a, Vec4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Vec4 operator/(Vec4 a, Vec4 b) { return _mm_div_ps(a.v, b.v); }
+inline Vec4 vmin(Vec4 a, Vec4 b) { return _mm_min_ps(a.v, b.v); }
+inline Vec4 vmax(Vec4 a, Vec4 b) { return _mm_max_ps(a.v, b.v); }
+inline Vec4 lessThan(Vec4 a, Vec4 b) { return _mm_cmplt_ps(a.v, b.v); }
+// mask ? a : b
+inline Vec4 select(Vec4 mask, Vec4 a, Vec4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline Vec4 vfloor(Vec4 x)
+{
+  Vec4 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x.v));
+  return t - select(lessThan(x, t), 1.0f, 0.0f);
+}
+inline Vec4 exponentOf(Vec4 x)  // floor(log2(x)) for normal x > 0
+{
+  __m128i e = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x.v), 23), _mm_set1_epi32(127));
+  return _mm_cvtepi32_ps(e);
+}
+inline Vec4 mantissaOf(Vec4 x)  // [1, 2)
+{
+  __m128i m = _mm_and_si128(_mm_castps_si128(x.v), _mm_set1_epi32(0x007fffff));
+  return _mm_castsi128_ps(_mm_or_si128(m, _mm_set1_epi32(0x3f800000)));
+}
+inline Vec4 pow2i(Vec4 i)  // 2^i for integer i in [-126, 127]
+{
+  return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(i.v), _mm_set1_epi32(127)), 23));
+}
+#else
+struct Vec4
+{
+  float v[4];
+  Vec4(float x) { v[0] = v[1] = v[2] = v[3] = x; }
+  Vec4() = default;
+  static Vec4 load(const float* p)
+  {
+    Vec4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  void store(float* p) const { memcpy(p, v, sizeof(v)); }
+};
+
+template <typename F>
+inline Vec4 apply(Vec4 a, Vec4 b, F f)
+{
+  Vec4 r;
+  for(int i = 0; i < 4; i++)
+    r.v[i] = f(a.v[i], b.v[i]);
+  return r;
+}
+inline Vec4 operator+(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+inline Vec4 operator-(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+inline Vec4 operator/(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+inline Vec4 vmin(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline Vec4 vmax(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline Vec4 lessThan(Vec4 a, Vec4 b) { return apply(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; }); }
+inline Vec4 select(Vec4 mask, Vec4 a, Vec4 b)
+{
+  Vec4 r;
+  for(int i = 0; i < 4; i++)
+    r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+  return r;
+}
+inline Vec4 vfloor(Vec4 x) { return apply(x, x, [](float a, float) { return std::floor(a); }); }
+inline Vec4 exponentOf(Vec4 x)
+{
+  return apply(x, x, [](float a, float) {
+    uint32_t u;
+    memcpy(&u, &a, 4);
+    return float(int32_t(u >> 23) - 127);
+  });
+}
+inline Vec4 mantissaOf(Vec4 x)
+{
+  return apply(x, x, [](float a, float) {
+    uint32_t u;
+    memcpy(&u, &a, 4);
+    u = (u & 0x007fffff) | 0x3f800000;
+    memcpy(&a, &u, 4);
+    return a;
+  });
+}
+inline Vec4 pow2i(Vec4 i)
+{
+  return apply(i, i, [](float a, float) {
+    uint32_t u = uint32_t(int32_t(a) + 127) << 23;
+    float    f;
+    memcpy(&f, &u, 4);
+    return f;
+  });
+}
+#endif
+
+inline Vec4 clamp01(Vec4 x)
+{
+  return vmin(vmax(x, 0.0f), 1.0f);
+}
+
+// Minimax polynomials of log2 on [1, 2) and exp2 on [0, 1)
+inline Vec4 log2v(Vec4 x)
+{
+  x        = vmax(x, 1e-30f);
+  Vec4 m   = mantissaOf(x);
+  Vec4 p   = Vec4(0.0596515482674574969533f);
+  p        = p * m + Vec4(-0.465725644288844778798f);
+  p        = p * m + Vec4(1.48116647521213171641f);
+  p        = p * m + Vec4(-2.52074962577807006663f);
+  p        = p * m + Vec4(2.8882704548164776201f);
+  return p * (m - 1.0f) + exponentOf(x);
+}
+
+inline Vec4 exp2v(Vec4 x)
+{
+  x      = vmin(vmax(x, -126.0f), 127.0f);
+  Vec4 i = vfloor(x);
+  Vec4 f = x - i;
+  Vec4 p = Vec4(1.8775767e-3f);
+  p      = p * f + Vec4(8.9893397e-3f);
+  p      = p * f + Vec4(5.5826318e-2f);
+  p      = p * f + Vec4(2.4015361e-1f);
+  p      = p * f + Vec4(6.9315308e-1f);
+  p      = p * f + Vec4(9.9999994e-1f);
+  return p * pow2i(i);
+}
+
+// x^y for x >= 0
+inline Vec4 powv(Vec4 x, float y)
+{
+  return select(lessThan(0.0f, x), exp2v(log2v(x) * y), 0.0f);
+}
+
+// tonemapping.glsl
+constexpr float kGamma = 2.2f;
+
+inline Vec4 uncharted2Impl(Vec4 c)
+{
+  const float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+  return ((c * (c * A + Vec4(C * B)) + Vec4(D * E)) / (c * (c * A + Vec4(B)) + Vec4(D * F))) - Vec4(E / F);
+}
+
+float uncharted2Impl(float c)
+{
+  float r[4];
+  uncharted2Impl(Vec4(c)).store(r);
+  return r[0];
+}
+
+// random.glsl
+inline void pcg3d(uint32_t v[3])
+{
+  for(int i = 0; i < 3; i++)
+    v[i] = v[i] * 1664525u + 1013904223u;
+  v[0] += v[1] * v[2];
+  v[1] += v[2] * v[0];
+  v[2] += v[0] * v[1];
+  for(int i = 0; i < 3; i++)
+    v[i] ^= v[i] >> 16u;
+  v[0] += v[1] * v[2];
+  v[1] += v[2] * v[0];
+  v[2] += v[0] * v[1];
+}
+
+inline float luminance(const float* rgb)
+{
+  return rgb[0] * 0.2126f + rgb[1] * 0.7152f + rgb[2] * 0.0722f;
+}
+
+// Luminance histogram: log2 in [kMinLog2, kMinLog2 + kBins / kBinsPerStop)
+constexpr int   kBins        = 256;
+constexpr int   kBinsPerStop = 8;
+constexpr float kMinLog2     = -16.0f;
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Histogram of the luminance, with the sum of the luminance in each bin to average exactly.
+// Bins are split when a percentile falls inside them.
+//
+float HostTonemapper::averageLuminance(const FloatImage& hdr) const
+{
+  std::array<double, kBins>   sums{};
+  std::array<uint64_t, kBins> counts{};
+  std::mutex                  mutex;
+
+  parallelRanges(hdr.height, [&](uint64_t begin, uint64_t end) {
+    std::array<double, kBins>   localSums{};
+    std::array<uint64_t, kBins> localCounts{};
+    for(uint64_t y = begin; y < end; y++)
+    {
+      const float* src = hdr.row(static_cast<uint32_t>(y));
+      for(uint32_t x = 0; x < hdr.width; x++, src += hdr.channels)
+      {
+        const float lum = std::max(luminance(src), 0.0f);  // NaN to 0
+        const int bin = lum > 0.0f ? std::clamp(int((std::log2(lum) - kMinLog2) * kBinsPerStop), 0, kBins - 1) : 0;
+        localSums[bin] += lum;
+        localCounts[bin]++;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for(int i = 0; i < kBins; i++)
+    {
+      sums[i] += localSums[i];
+      counts[i] += localCounts[i];
+    }
+  });
+
+  const double total = double(hdr.width) * hdr.height;
+  const double low   = total * std::clamp(m_lowPercentile, 0.0f, 1.0f);
+  const double high  = total * std::clamp(std::max(m_highPercentile, m_lowPercentile), 0.0f, 1.0f);
+  double       sum   = 0.0;
+  double       count = 0.0;
+  double       seen  = 0.0;
+  for(int i = 0; i < kBins && seen < high; i++)
+  {
+    if(counts[i] == 0)
+      continue;
+    // Part of the bin within [low, high)
+    const double n = std::min(seen + counts[i], high) - std::max(seen, low);
+    if(n > 0.0)
+    {
+      sum += sums[i] * (n / counts[i]);
+      count += n;
+    }
+    seen += counts[i];
+  }
+
+  return count > 0.0 ? std::max(float(sum / count), 1e-6f) : 1.0f;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same steps as post.frag, zoom and local exposure aside: the local exposure needs the mip chain
+// and is replaced by the global one.
+//
+void HostTonemapper::run(const FloatImage& hdr, const Tonemapper& tm, uint32_t channels, std::vector<uint8_t>& out) const
+{
+  MilliTimer timer;
+
+  float exposureScale = 0.0f;  // 0: no auto-exposure
+  if(tm.autoExposure & 1)
+  {
+    if(tm.autoExposure & 2)
+      LOGW("Host tonemapper: local exposure isn't supported, using the global exposure\n");
+    exposureScale = tm.key / averageLuminance(hdr);
+  }
+
+  const float    whiteScale = 1.0f / uncharted2Impl(11.2f);
+  const float    quant      = 1.0f / 255.0f;
+  const uint32_t width      = hdr.width;
+  const uint32_t padded     = (width + 3) & ~3u;
+  out.resize(size_t(width) * hdr.height * channels);
+
+  parallelRanges(hdr.height, [&](uint64_t begin, uint64_t end) {
+    // Row in planes: r, g, b, noise r, g, b
+    std::vector<float> planes(padded * 6, 0.0f);
+    float*             rgb[3]   = {&planes[0], &planes[padded], &planes[padded * 2]};
+    float*             noise[3] = {&planes[padded * 3], &planes[padded * 4], &planes[padded * 5]};
+
+    for(uint64_t y = begin; y < end; y++)
+    {
+      const float* src = hdr.row(static_cast<uint32_t>(y));
+      for(uint32_t x = 0; x < width; x++)
+      {
+        for(int c = 0; c < 3; c++)
+          rgb[c][x] = src[x * hdr.channels + c];
+        uint32_t r[3] = {x, uint32_t(y), 0u};
+        pcg3d(r);
+        for(int c = 0; c < 3; c++)
+        {
+          const uint32_t bits = 0x3f800000u | (r[c] >> 9);
+          memcpy(&noise[c][x], &bits, 4);
+          noise[c][x] -= 1.0f;
+        }
+      }
+
+      const float v = ((float(y) + 0.5f) / hdr.height * tm.renderingRatio.y - 0.5f) * 2.0f;
+      for(uint32_t x = 0; x < padded; x += 4)
+      {
+        Vec4 color[3] = {Vec4::load(rgb[0] + x), Vec4::load(rgb[1] + x), Vec4::load(rgb[2] + x)};
+
+        if(exposureScale > 0.0f)
+        {
+          Vec4 Y  = color[0] * 0.2126729f + color[1] * 0.7151522f + color[2] * 0.0721750f;
+          Vec4 Ys = Y * exposureScale;
+          Vec4 Yd = (Ys * (Vec4(1.0f) + Ys / (tm.Ywhite * tm.Ywhite))) / (Vec4(1.0f) + Ys);
+          Vec4 s  = select(lessThan(0.0f, Y), Yd / Y, 0.0f);
+          for(auto& c : color)
+            c = c * s;
+        }
+
+        for(int c = 0; c < 3; c++)
+        {
+          // Tonemap + linear to sRGB
+          Vec4 col = uncharted2Impl(vmax(color[c], 0.0f) * (tm.avgLum * 2.0f)) * whiteScale;
+          col      = powv(vmax(col, 0.0f), 1.0f / kGamma);
+
+          // Dithering between the two closest 8-bit values
+          Vec4 linear = powv(col, kGamma);
+          Vec4 c0     = vfloor(col * 255.0f) * quant;
+          Vec4 c1     = c0 + quant;
+          Vec4 l0     = powv(c0, kGamma);
+          Vec4 discr  = l0 + (powv(c1, kGamma) - l0) * Vec4::load(noise[c] + x);
+          color[c]    = select(lessThan(discr, linear), c1, c0);
+
+          // Contrast and brightness
+          color[c] = clamp01((color[c] - 0.5f) * tm.contrast + 0.5f);
+          if(tm.brightness != 1.0f)
+            color[c] = powv(color[c], 1.0f / tm.brightness);
+        }
+
+        // Saturation
+        Vec4 grey = color[0] * 0.299f + color[1] * 0.587f + color[2] * 0.114f;
+        for(auto& c : color)
+          c = grey + (c - grey) * tm.saturation;
+
+        // Vignette
+        float u[4];
+        for(int i = 0; i < 4; i++)
+          u[i] = ((float(x + i) + 0.5f) / width * tm.renderingRatio.x - 0.5f) * 2.0f;
+        Vec4 uv       = Vec4::load(u);
+        Vec4 vignette = Vec4(1.0f) - (uv * uv + v * v) * tm.vignette;
+        for(int c = 0; c < 3; c++)
+          (clamp01(color[c] * vignette) * 255.0f + 0.5f).store(rgb[c] + x);
+      }
+
+      uint8_t* dst = &out[y * width * channels];
+      for(uint32_t x = 0; x < width; x++, dst += channels)
+      {
+        for(int c = 0; c < 3; c++)
+          dst[c] = static_cast<uint8_t>(rgb[c][x]);
+        if(channels == 4)
+          dst[3] = static_cast<uint8_t>(std::clamp(hdr.channels == 4 ? src[x * 4 + 3] : 1.0f, 0.0f, 1.0f) * 255.0f + 0.5f);
+      }
+    }
+  });
+
+  LOGI("Host tonemapping (%.3f ms)\n", timer.elapsed());
+  stages::record("tonemap", timer.elapsed());
+}
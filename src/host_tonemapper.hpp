@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+
+#include "image_io.hpp"
+#include "shaders/host_device.h"
+
+//--------------------------------------------------------------------------------------------------
+// The tonemapper of post.frag, on the host: Uncharted 2 curve, dithering, contrast, brightness,
+// saturation and vignette applied to the read-back accumulation buffer, 4 pixels at a time and
+// rows in parallel. Headless jobs don't need the post render pass, and images can be tonemapped
+// without a GPU.
+//
+// The auto-exposure comes from a histogram of the luminance instead of the mip chain: the average
+// is taken between two percentiles, a few fireflies don't darken the image.
+//
+class HostTonemapper
+{
+public:
+  // Average luminance of the pixels between m_lowPercentile and m_highPercentile
+  float averageLuminance(const FloatImage& hdr) const;
+
+  // `hdr` of 3 or 4 channels to 8-bit RGB or RGBA (alpha of `hdr`, or 1)
+  void run(const FloatImage& hdr, const Tonemapper& tm, uint32_t channels, std::vector<uint8_t>& out) const;
+
+  float m_lowPercentile{0.10f};
+  float m_highPercentile{0.95f};
+};
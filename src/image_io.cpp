@@ -0,0 +1,2124 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/*
+ *  Loading of HDR images (Radiance, OpenEXR) without going through stb_image, which is
+ *  single threaded and expands everything to RGBA.
+ *
+ *  Multi-byte values in the files are little-endian, as the host.
+ */
+
+
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define IMAGEIO_SSE2
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+#ifdef NVP_SUPPORTS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "stb_image.h"
+#include "image_io.hpp"
+#include "tools.hpp"
+
+
+namespace imageio {
+
+//--------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a whole file
+//
+class MappedFile
+{
+public:
+  ~MappedFile() { close(); }
+
+  bool open(const std::string& filename)
+  {
+#ifdef _WIN32
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(m_file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+      return false;
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mapping == nullptr)
+      return false;
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+      return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping stays valid
+    if(data == MAP_FAILED)
+      return false;
+    madvise(data, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+    return m_data != nullptr;
+  }
+
+  void close()
+  {
+#ifdef _WIN32
+    if(m_data)
+      UnmapViewOfFile(m_data);
+    if(m_mapping)
+      CloseHandle(m_mapping);
+    if(m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file    = INVALID_HANDLE_VALUE;
+#else
+    if(m_data)
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+  const uint8_t* data() const { return m_data; }
+  size_t         size() const { return m_size; }
+
+private:
+  const uint8_t* m_data{nullptr};
+  size_t         m_size{0};
+#ifdef _WIN32
+  HANDLE m_file{INVALID_HANDLE_VALUE};
+  HANDLE m_mapping{nullptr};
+#endif
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Format detection, and stb_image for everything which isn't Radiance or OpenEXR
+//
+bool loadRgb(const std::string& filename, FloatImage& image)
+{
+  uint8_t magic[4]{};
+  if(FILE* f = fopen(filename.c_str(), "rb"))
+  {
+    size_t read = fread(magic, 1, 4, f);
+    fclose(f);
+    if(read == 4 && magic[0] == 0x76 && magic[1] == 0x2f && magic[2] == 0x31 && magic[3] == 0x01)
+      return loadExr(filename, image);
+    if(read >= 2 && magic[0] == '#' && magic[1] == '?')
+      return loadRadiance(filename, image);
+  }
+
+  int    width{0};
+  int    height{0};
+  int    component{0};
+  float* pixels = stbi_loadf(filename.c_str(), &width, &height, &component, STBI_rgb);
+  if(pixels == nullptr)
+  {
+    LOGE("Failed to load %s: %s\n", filename.c_str(), stbi_failure_reason());
+    return false;
+  }
+  image.width    = static_cast<uint32_t>(width);
+  image.height   = static_cast<uint32_t>(height);
+  image.channels = 3;
+  image.pixels.assign(pixels, pixels + size_t(width) * height * 3);
+  stbi_image_free(pixels);
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Radiance RGBE
+//
+
+// 2^(e-136) built directly in the exponent bits, exponents below 10 (< 2^-126) are flushed to 0
+inline float rgbeScale(uint8_t e)
+{
+  uint32_t bits = e > 9 ? uint32_t(e - 9) << 23 : 0u;
+  float    f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+void rgbeToFloat(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, uint32_t count, float* rgb)
+{
+  uint32_t i = 0;
+#ifdef IMAGEIO_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i nine = _mm_set1_epi32(9);
+  auto          load = [&zero](const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+  };
+
+  // Four pixels at a time, the last store writes one float beyond them, hence the +5
+  for(; i + 5 <= count; i += 4)
+  {
+    __m128i ex    = _mm_sub_epi32(load(e + i), nine);
+    ex            = _mm_and_si128(ex, _mm_cmpgt_epi32(ex, zero));
+    __m128  scale = _mm_castsi128_ps(_mm_slli_epi32(ex, 23));
+    __m128  p0    = _mm_mul_ps(_mm_cvtepi32_ps(load(r + i)), scale);
+    __m128  p1    = _mm_mul_ps(_mm_cvtepi32_ps(load(g + i)), scale);
+    __m128  p2    = _mm_mul_ps(_mm_cvtepi32_ps(load(b + i)), scale);
+    __m128  p3    = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);  // p0 = (r0, g0, b0, 0) ...
+    float* out = rgb + size_t(i) * 3;
+    _mm_storeu_ps(out, p0);
+    _mm_storeu_ps(out + 3, p1);
+    _mm_storeu_ps(out + 6, p2);
+    _mm_storeu_ps(out + 9, p3);
+  }
+#endif
+  for(; i < count; i++)
+  {
+    const float scale = rgbeScale(e[i]);
+    rgb[i * 3 + 0]    = float(r[i]) * scale;
+    rgb[i * 3 + 1]    = float(g[i]) * scale;
+    rgb[i * 3 + 2]    = float(b[i]) * scale;
+  }
+}
+
+bool loadRadiance(const std::string& filename, FloatImage& image)
+{
+  MappedFile file;
+  if(!file.open(filename))
+  {
+    LOGE("Failed to open %s\n", filename.c_str());
+    return false;
+  }
+  const uint8_t* p   = file.data();
+  const uint8_t* end = p + file.size();
+
+  auto readLine = [&](std::string& line) {
+    line.clear();
+    while(p < end && *p != '\n')
+      line.push_back(static_cast<char>(*p++));
+    if(p == end)
+      return false;
+    p++;
+    return true;
+  };
+  auto fail = [&](const char* reason) {
+    LOGE("Failed to load %s: %s\n", filename.c_str(), reason);
+    return false;
+  };
+
+  // Header, terminated by an empty line, followed by the resolution
+  std::string line;
+  if(!readLine(line) || (line.rfind("#?RADIANCE", 0) != 0 && line.rfind("#?RGBE", 0) != 0))
+    return fail("not a Radiance file");
+  while(readLine(line) && !line.empty())
+  {
+    if(line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe")
+      return fail("unsupported format, only 32-bit_rle_rgbe");
+  }
+  char ySign{0}, xSign{0};
+  int  w{0}, h{0};
+  if(!readLine(line) || sscanf(line.c_str(), "%cY %d %cX %d", &ySign, &h, &xSign, &w) != 4 || xSign != '+' || w <= 0 || h <= 0)
+    return fail("unsupported resolution line, only -Y h +X w and +Y h +X w");
+  const bool     flipY  = ySign == '+';
+  const uint32_t width  = static_cast<uint32_t>(w);
+  const uint32_t height = static_cast<uint32_t>(h);
+
+  // Locating the scanlines. The RLE scanlines have a variable size, but finding them only needs to
+  // read the run lengths, which is fast compared to the decoding done in parallel afterward.
+  std::vector<const uint8_t*> lines(height);
+  bool rle = width >= 8 && width < 32768 && end - p >= 4 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0;
+  if(rle)
+  {
+    for(uint32_t y = 0; y < height; y++)
+    {
+      lines[y] = p;
+      if(end - p < 4 || p[0] != 2 || p[1] != 2 || uint32_t((p[2] << 8) | p[3]) != width)
+        return fail("invalid RLE scanline");
+      p += 4;
+      for(int c = 0; c < 4; c++)
+      {
+        for(uint32_t x = 0; x < width;)
+        {
+          if(p >= end)
+            return fail("truncated file");
+          uint32_t count = *p++;
+          if(count > 128)
+          {
+            count -= 128;
+            p++;
+          }
+          else
+            p += count;
+          if(count == 0 || x + count > width || p > end)
+            return fail("corrupt RLE data");
+          x += count;
+        }
+      }
+    }
+  }
+  else
+  {
+    // Flat RGBE pixels
+    if(uint64_t(end - p) < uint64_t(width) * height * 4)
+      return fail("truncated file");
+    for(uint32_t y = 0; y < height; y++)
+      lines[y] = p + size_t(y) * width * 4;
+  }
+
+  image.width    = width;
+  image.height   = height;
+  image.channels = 3;
+  image.pixels.resize(size_t(width) * height * 3);
+
+  // Decoding the components to planes and converting them to float, in parallel
+  parallelRanges(height, [&](uint64_t begin, uint64_t endY) {
+    std::vector<uint8_t> planes(size_t(width) * 4);
+    for(uint64_t y = begin; y < endY; y++)
+    {
+      const uint8_t* src = lines[y];
+      if(rle)
+      {
+        src += 4;
+        for(uint32_t c = 0; c < 4; c++)
+        {
+          uint8_t* plane = &planes[c * width];
+          for(uint32_t x = 0; x < width;)
+          {
+            uint32_t count = *src++;
+            if(count > 128)
+            {
+              count -= 128;
+              memset(plane + x, *src++, count);
+            }
+            else
+            {
+              memcpy(plane + x, src, count);
+              src += count;
+            }
+            x += count;
+          }
+        }
+      }
+      else
+      {
+        for(uint32_t x = 0; x < width; x++)
+          for(uint32_t c = 0; c < 4; c++)
+            planes[c * width + x] = src[x * 4 + c];
+      }
+      float* dst = image.row(static_cast<uint32_t>(flipY ? height - 1 - y : y));
+      rgbeToFloat(&planes[0], &planes[width], &planes[2 * width], &planes[3 * width], width, dst);
+    }
+  });
+
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// OpenEXR
+// See "OpenEXR File Layout" and "Technical Introduction to OpenEXR"
+//
+namespace {
+
+enum ExrPixelType
+{
+  eExrUint  = 0,
+  eExrHalf  = 1,
+  eExrFloat = 2,
+};
+
+enum ExrCompressionType
+{
+  eExrNone  = 0,
+  eExrRle   = 1,
+  eExrZips  = 2,
+  eExrZip   = 3,
+  eExrPiz   = 4,
+  eExrPxr24 = 5,
+  eExrB44   = 6,
+  eExrB44a  = 7,
+  eExrDwaa  = 8,
+  eExrDwab  = 9,
+};
+
+struct ExrChannel
+{
+  std::string name;
+  int32_t     type{eExrHalf};
+  int32_t     xSampling{1};
+  int32_t     ySampling{1};
+};
+
+struct ExrPart
+{
+  std::vector<ExrChannel> channels;
+  int32_t                 compression{eExrNone};
+  int32_t                 xMin{0}, yMin{0}, xMax{-1}, yMax{-1};
+  bool                    tiled{false};
+  bool                    deep{false};
+  uint32_t                tileWidth{0}, tileHeight{0};
+  uint8_t                 levelMode{0};  // 0: one level, 1: mipmap, 2: ripmap
+  uint8_t                 roundingMode{0};
+  int32_t                 chunkCount{-1};
+  std::vector<uint64_t>   offsets;
+};
+
+// Little-endian reader with bounds checks
+struct ByteReader
+{
+  const uint8_t* p{nullptr};
+  const uint8_t* end{nullptr};
+  bool           ok{true};
+
+  template <typename T>
+  T read()
+  {
+    T v{};
+    if(end - p < static_cast<ptrdiff_t>(sizeof(T)))
+    {
+      ok = false;
+      return v;
+    }
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+  }
+  std::string readString()
+  {
+    const uint8_t* s = p;
+    while(p < end && *p != 0)
+      p++;
+    if(p == end)
+    {
+      ok = false;
+      return {};
+    }
+    return std::string(reinterpret_cast<const char*>(s), reinterpret_cast<const char*>(p++));
+  }
+};
+
+inline int32_t pixelTypeSize(int32_t type)
+{
+  return type == eExrHalf ? 2 : 4;
+}
+
+inline int32_t linesPerBlock(int32_t compression)
+{
+  switch(compression)
+  {
+    case eExrZip:
+    case eExrPxr24:
+      return 16;
+    case eExrPiz:
+    case eExrB44:
+    case eExrB44a:
+    case eExrDwaa:
+      return 32;
+    case eExrDwab:
+      return 256;
+    default:
+      return 1;
+  }
+}
+
+inline int32_t floorDiv(int32_t a, int32_t b)
+{
+  return (a >= 0) ? a / b : -((b - a - 1) / b);
+}
+
+inline bool isSampled(int32_t y, int32_t s)
+{
+  return ((y % s) + s) % s == 0;
+}
+
+// Number of samples of a channel with sampling s in [a, b]
+inline int32_t numSamples(int32_t s, int32_t a, int32_t b)
+{
+  int32_t a1 = floorDiv(a, s);
+  int32_t b1 = floorDiv(b, s);
+  return b1 - a1 + ((a1 * s < a) ? 0 : 1);
+}
+
+inline float halfToFloat(uint16_t h)
+{
+  uint32_t sign     = uint32_t(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t bits;
+  if(exponent == 0)
+  {
+    if(mantissa == 0)
+      bits = sign;
+    else
+    {
+      // Denormal, renormalizing
+      exponent = 127 - 15 + 1;
+      while((mantissa & 0x400) == 0)
+      {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+  }
+  else if(exponent == 31)
+    bits = sign | 0x7f800000 | (mantissa << 13);  // Inf, NaN
+  else
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+bool parseHeader(ByteReader& in, ExrPart& part)
+{
+  for(;;)
+  {
+    std::string name = in.readString();
+    if(!in.ok)
+      return false;
+    if(name.empty())
+      return true;
+    std::string type = in.readString();
+    int32_t     size = in.read<int32_t>();
+    if(!in.ok || size < 0 || in.end - in.p < size)
+      return false;
+    ByteReader attr{in.p, in.p + size};
+    in.p += size;
+
+    if(name == "channels")
+    {
+      for(;;)
+      {
+        ExrChannel c;
+        c.name = attr.readString();
+        if(c.name.empty())
+          break;
+        c.type = attr.read<int32_t>();
+        attr.read<uint32_t>();  // pLinear + reserved
+        c.xSampling = attr.read<int32_t>();
+        c.ySampling = attr.read<int32_t>();
+        if(!attr.ok || c.xSampling < 1 || c.ySampling < 1 || c.type < eExrUint || c.type > eExrFloat)
+          return false;
+        part.channels.push_back(c);
+      }
+    }
+    else if(name == "compression")
+      part.compression = attr.read<uint8_t>();
+    else if(name == "dataWindow")
+    {
+      part.xMin = attr.read<int32_t>();
+      part.yMin = attr.read<int32_t>();
+      part.xMax = attr.read<int32_t>();
+      part.yMax = attr.read<int32_t>();
+    }
+    else if(name == "tiles")
+    {
+      part.tileWidth    = attr.read<uint32_t>();
+      part.tileHeight   = attr.read<uint32_t>();
+      uint8_t mode      = attr.read<uint8_t>();
+      part.levelMode    = mode & 0xf;
+      part.roundingMode = mode >> 4;
+      part.tiled        = true;
+    }
+    else if(name == "type")
+    {
+      std::string value(reinterpret_cast<const char*>(attr.p), size_t(size));
+      part.tiled = value.find("tile") != std::string::npos;
+      part.deep  = value.rfind("deep", 0) == 0;
+    }
+    else if(name == "chunkCount")
+      part.chunkCount = attr.read<int32_t>();
+
+    if(!attr.ok)
+      return false;
+  }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Decompressors, `out` receives `outSize` bytes with the same layout as uncompressed data
+//
+
+// ZIP and RLE are storing the bytes split in two halves (even and odd) and delta encoded
+void undoPredictorAndInterleave(const uint8_t* in, size_t size, uint8_t* out, std::vector<uint8_t>& tmp)
+{
+  tmp.assign(in, in + size);
+  for(size_t i = 1; i < size; i++)
+    tmp[i] = static_cast<uint8_t>(int(tmp[i - 1]) + int(tmp[i]) - 128);
+
+  const uint8_t* t1 = tmp.data();
+  const uint8_t* t2 = tmp.data() + (size + 1) / 2;
+  for(size_t i = 0; i < size; i++)
+    out[i] = (i & 1) ? *t2++ : *t1++;
+}
+
+bool rleDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize, std::vector<uint8_t>& scratch)
+{
+  std::vector<uint8_t> decoded(outSize);
+  const uint8_t*       end = in + inSize;
+  size_t               o   = 0;
+  while(in < end)
+  {
+    int8_t count = static_cast<int8_t>(*in++);
+    if(count < 0)
+    {
+      size_t n = size_t(-int(count));
+      if(o + n > outSize || size_t(end - in) < n)
+        return false;
+      memcpy(&decoded[o], in, n);
+      in += n;
+      o += n;
+    }
+    else
+    {
+      size_t n = size_t(count) + 1;
+      if(o + n > outSize || in >= end)
+        return false;
+      memset(&decoded[o], *in++, n);
+      o += n;
+    }
+  }
+  if(o != outSize)
+    return false;
+  undoPredictorAndInterleave(decoded.data(), outSize, out, scratch);
+  return true;
+}
+
+bool zipDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize, std::vector<uint8_t>& scratch)
+{
+#ifdef NVP_SUPPORTS_ZLIB
+  std::vector<uint8_t> decoded(outSize);
+  uLongf               size = static_cast<uLongf>(outSize);
+  if(uncompress(decoded.data(), &size, in, static_cast<uLong>(inSize)) != Z_OK || size != outSize)
+    return false;
+  undoPredictorAndInterleave(decoded.data(), outSize, out, scratch);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// PIZ: Huffman coded wavelet transform of the 16-bit values, after a range reduction through a LUT.
+// Follows the reference implementation (ImfPizCompressor, ImfHuf, ImfWav).
+//
+constexpr int32_t kUshortRange      = 1 << 16;
+constexpr int32_t kBitmapSize       = kUshortRange >> 3;
+constexpr int32_t kHufEncBits       = 16;
+constexpr int32_t kHufDecBits       = 14;
+constexpr int32_t kHufEncSize       = (1 << kHufEncBits) + 1;
+constexpr int32_t kHufDecSize       = 1 << kHufDecBits;
+constexpr int32_t kHufDecMask       = kHufDecSize - 1;
+constexpr int32_t kShortZeroCodeRun = 59;
+constexpr int32_t kLongZeroCodeRun  = 63;
+constexpr int32_t kShortestLongRun  = 2 + kLongZeroCodeRun - kShortZeroCodeRun;
+
+struct HufDec
+{
+  int32_t          len{0};
+  int32_t          lit{0};  // Symbol for short codes, number of long codes otherwise
+  std::vector<int> p;       // Symbols of the long codes with this prefix
+};
+
+struct PizScratch
+{
+  std::vector<uint16_t> data;
+  std::vector<uint16_t> lut;
+  std::vector<uint64_t> hcode;
+  std::vector<HufDec>   hdec;
+};
+
+inline int32_t  hufLength(uint64_t code) { return static_cast<int32_t>(code & 63); }
+inline uint64_t hufCode(uint64_t code) { return code >> 6; }
+
+// Building the canonical codes from the code lengths
+void hufCanonicalCodeTable(uint64_t* hcode)
+{
+  uint64_t n[59]{};
+  for(int i = 0; i < kHufEncSize; ++i)
+    n[hcode[i]] += 1;
+
+  uint64_t c = 0;
+  for(int i = 58; i > 0; --i)
+  {
+    uint64_t nc = (c + n[i]) >> 1;
+    n[i]        = c;
+    c           = nc;
+  }
+  for(int i = 0; i < kHufEncSize; ++i)
+  {
+    int l = static_cast<int>(hcode[i]);
+    if(l > 0)
+      hcode[i] = l | (n[l]++ << 6);
+  }
+}
+
+struct BitReader
+{
+  const uint8_t* p;
+  const uint8_t* end;
+  uint64_t       c{0};
+  int32_t        lc{0};
+
+  bool getChar()
+  {
+    if(p >= end)
+      return false;
+    c = (c << 8) | *p++;
+    lc += 8;
+    return true;
+  }
+  bool getBits(int32_t n, uint64_t& v)
+  {
+    while(lc < n)
+      if(!getChar())
+        return false;
+    lc -= n;
+    v = (c >> lc) & ((uint64_t(1) << n) - 1);
+    return true;
+  }
+};
+
+bool hufUnpackEncTable(BitReader& in, int32_t im, int32_t iM, uint64_t* hcode)
+{
+  for(; im <= iM; im++)
+  {
+    uint64_t l;
+    if(!in.getBits(6, l))
+      return false;
+    hcode[im] = l;
+    if(l == kLongZeroCodeRun || l >= kShortZeroCodeRun)
+    {
+      uint64_t zerun = l - kShortZeroCodeRun + 2;
+      if(l == kLongZeroCodeRun)
+      {
+        if(!in.getBits(8, zerun))
+          return false;
+        zerun += kShortestLongRun;
+      }
+      if(im + int64_t(zerun) > iM + 1)
+        return false;
+      while(zerun--)
+        hcode[im++] = 0;
+      im--;
+    }
+  }
+  hufCanonicalCodeTable(hcode);
+  return true;
+}
+
+bool hufBuildDecTable(const uint64_t* hcode, int32_t im, int32_t iM, std::vector<HufDec>& hdec)
+{
+  for(; im <= iM; im++)
+  {
+    uint64_t c = hufCode(hcode[im]);
+    int32_t  l = hufLength(hcode[im]);
+    if(c >> l)
+      return false;  // Code longer than its length
+    if(l > kHufDecBits)
+    {
+      // Long code: the prefix entry lists all the candidates
+      HufDec& pl = hdec[c >> (l - kHufDecBits)];
+      if(pl.len)
+        return false;
+      pl.lit++;
+      pl.p.push_back(im);
+    }
+    else if(l)
+    {
+      // Short code: filling all entries starting with the code
+      HufDec* pl = &hdec[c << (kHufDecBits - l)];
+      for(uint64_t i = uint64_t(1) << (kHufDecBits - l); i > 0; i--, pl++)
+      {
+        if(pl->len || !pl->p.empty())
+          return false;
+        pl->len = l;
+        pl->lit = im;
+      }
+    }
+  }
+  return true;
+}
+
+bool hufDecode(const uint64_t* hcode, const std::vector<HufDec>& hdec, const uint8_t* in, int32_t nBits, int32_t rlc, uint16_t* out, size_t no)
+{
+  BitReader      bits{in, in + (nBits + 7) / 8};
+  uint16_t*      outb = out;
+  uint16_t*      oe   = out + no;
+  auto           getCode = [&](int32_t po) {
+    if(po == rlc)
+    {
+      // Run of the previous symbol
+      if(bits.lc < 8 && !bits.getChar())
+        return false;
+      bits.lc -= 8;
+      uint8_t cs = static_cast<uint8_t>(bits.c >> bits.lc);
+      if(out + cs > oe || out == outb)
+        return false;
+      uint16_t s = out[-1];
+      while(cs-- > 0)
+        *out++ = s;
+    }
+    else if(out < oe)
+      *out++ = static_cast<uint16_t>(po);
+    else
+      return false;
+    return true;
+  };
+
+  while(bits.p < bits.end)
+  {
+    bits.getChar();
+    while(bits.lc >= kHufDecBits)
+    {
+      const HufDec& pl = hdec[(bits.c >> (bits.lc - kHufDecBits)) & kHufDecMask];
+      if(pl.len)
+      {
+        bits.lc -= pl.len;
+        if(!getCode(pl.lit))
+          return false;
+      }
+      else
+      {
+        if(pl.p.empty())
+          return false;
+        int32_t j;
+        for(j = 0; j < pl.lit; j++)
+        {
+          int32_t l = hufLength(hcode[pl.p[j]]);
+          while(bits.lc < l && bits.p < bits.end)
+            bits.getChar();
+          if(bits.lc >= l && hufCode(hcode[pl.p[j]]) == ((bits.c >> (bits.lc - l)) & ((uint64_t(1) << l) - 1)))
+          {
+            bits.lc -= l;
+            if(!getCode(pl.p[j]))
+              return false;
+            break;
+          }
+        }
+        if(j == pl.lit)
+          return false;
+      }
+    }
+  }
+
+  // Remaining short codes
+  int32_t i = (8 - nBits) & 7;
+  bits.c >>= i;
+  bits.lc -= i;
+  while(bits.lc > 0)
+  {
+    const HufDec& pl = hdec[(bits.c << (kHufDecBits - bits.lc)) & kHufDecMask];
+    if(!pl.len)
+      return false;
+    bits.lc -= pl.len;
+    if(!getCode(pl.lit))
+      return false;
+  }
+  return size_t(out - outb) == no;
+}
+
+bool hufUncompress(const uint8_t* in, size_t inSize, uint16_t* out, size_t no, PizScratch& scratch)
+{
+  if(inSize == 0)
+    return no == 0;
+  if(inSize < 20)
+    return false;
+  int32_t im, iM, nBits;
+  memcpy(&im, in, 4);
+  memcpy(&iM, in + 4, 4);
+  memcpy(&nBits, in + 12, 4);
+  if(im < 0 || im >= kHufEncSize || iM < 0 || iM >= kHufEncSize)
+    return false;
+
+  scratch.hcode.assign(kHufEncSize, 0);
+  scratch.hdec.resize(kHufDecSize);
+  for(auto& d : scratch.hdec)
+  {
+    d.len = 0;
+    d.lit = 0;
+    d.p.clear();
+  }
+
+  BitReader table{in + 20, in + inSize};
+  if(!hufUnpackEncTable(table, im, iM, scratch.hcode.data()))
+    return false;
+  const uint8_t* data = table.p;
+  if(nBits < 0 || int64_t(nBits) > 8 * int64_t(in + inSize - data))
+    return false;
+  if(!hufBuildDecTable(scratch.hcode.data(), im, iM, scratch.hdec))
+    return false;
+  return hufDecode(scratch.hcode.data(), scratch.hdec, data, nBits, iM, out, no);
+}
+
+inline void wdec14(uint16_t l, uint16_t h, uint16_t& a, uint16_t& b)
+{
+  int16_t ls = static_cast<int16_t>(l);
+  int16_t hs = static_cast<int16_t>(h);
+  int     hi = hs;
+  int     ai = ls + (hi & 1) + (hi >> 1);
+  a          = static_cast<uint16_t>(static_cast<int16_t>(ai));
+  b          = static_cast<uint16_t>(static_cast<int16_t>(ai - hi));
+}
+
+inline void wdec16(uint16_t l, uint16_t h, uint16_t& a, uint16_t& b)
+{
+  const int offset = 1 << 15;
+  const int mask   = (1 << 16) - 1;
+  int       m      = l;
+  int       d      = h;
+  int       bb     = (m - (d >> 1)) & mask;
+  int       aa     = (d + bb - offset) & mask;
+  b                = static_cast<uint16_t>(bb);
+  a                = static_cast<uint16_t>(aa);
+}
+
+// 2D inverse wavelet transform of nx x ny values, ox and oy being the strides
+void wav2Decode(uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
+{
+  const bool w14 = mx < (1 << 14);
+  auto       dec = [w14](uint16_t l, uint16_t h, uint16_t& a, uint16_t& b) { w14 ? wdec14(l, h, a, b) : wdec16(l, h, a, b); };
+  int        n   = std::min(nx, ny);
+  int        p   = 1;
+  int        p2;
+
+  // Search max level
+  while(p <= n)
+    p <<= 1;
+  p >>= 1;
+  p2 = p;
+  p >>= 1;
+
+  // Hierarchical loop on the smaller dimension
+  while(p >= 1)
+  {
+    uint16_t* py  = in;
+    uint16_t* ey  = in + oy * (ny - p2);
+    int       oy1 = oy * p;
+    int       oy2 = oy * p2;
+    int       ox1 = ox * p;
+    int       ox2 = ox * p2;
+    uint16_t  i00, i01, i10, i11;
+
+    for(; py <= ey; py += oy2)
+    {
+      uint16_t* px = py;
+      uint16_t* ex = py + ox * (nx - p2);
+      for(; px <= ex; px += ox2)
+      {
+        uint16_t* p01 = px + ox1;
+        uint16_t* p10 = px + oy1;
+        uint16_t* p11 = p10 + ox1;
+        dec(*px, *p10, i00, i10);
+        dec(*p01, *p11, i01, i11);
+        dec(i00, i01, *px, *p01);
+        dec(i10, i11, *p10, *p11);
+      }
+      // Odd column
+      if(nx & p)
+      {
+        uint16_t* p10 = px + oy1;
+        dec(*px, *p10, i00, *p10);
+        *px = i00;
+      }
+    }
+    // Odd line
+    if(ny & p)
+    {
+      uint16_t* px = py;
+      uint16_t* ex = py + ox * (nx - p2);
+      for(; px <= ex; px += ox2)
+      {
+        uint16_t* p01 = px + ox1;
+        dec(*px, *p01, i00, *p01);
+        *px = i00;
+      }
+    }
+    p2 = p;
+    p >>= 1;
+  }
+}
+
+bool pizDecompress(const uint8_t* in,
+                   size_t                         inSize,
+                   uint8_t*                       out,
+                   size_t                         outSize,
+                   const std::vector<ExrChannel>& channels,
+                   int32_t                        x0,
+                   int32_t                        x1,
+                   int32_t                        y0,
+                   int32_t                        y1,
+                   PizScratch&                    scratch)
+{
+  struct ChannelData
+  {
+    size_t start, end;
+    int    nx, ny, ys, size;
+  };
+  std::vector<ChannelData> cds(channels.size());
+  size_t                   total = 0;
+  for(size_t i = 0; i < channels.size(); i++)
+  {
+    ChannelData& cd = cds[i];
+    cd.start = cd.end = total;
+    cd.nx             = numSamples(channels[i].xSampling, x0, x1);
+    cd.ny             = numSamples(channels[i].ySampling, y0, y1);
+    cd.ys             = channels[i].ySampling;
+    cd.size           = pixelTypeSize(channels[i].type) / 2;
+    total += size_t(cd.nx) * cd.ny * cd.size;
+  }
+  if(total * 2 != outSize)
+    return false;
+  scratch.data.resize(total);
+
+  // Range compression: bitmap of the values in use
+  ByteReader reader{in, in + inSize};
+  uint8_t    bitmap[kBitmapSize]{};
+  uint16_t   minNonZero = reader.read<uint16_t>();
+  uint16_t   maxNonZero = reader.read<uint16_t>();
+  if(!reader.ok || maxNonZero >= kBitmapSize)
+    return false;
+  if(minNonZero <= maxNonZero)
+  {
+    size_t n = size_t(maxNonZero) - minNonZero + 1;
+    if(size_t(reader.end - reader.p) < n)
+      return false;
+    memcpy(bitmap + minNonZero, reader.p, n);
+    reader.p += n;
+  }
+  scratch.lut.assign(kUshortRange, 0);
+  int32_t k = 0;
+  for(int32_t i = 0; i < kUshortRange; ++i)
+    if(i == 0 || (bitmap[i >> 3] & (1 << (i & 7))))
+      scratch.lut[k++] = static_cast<uint16_t>(i);
+  const uint16_t maxValue = static_cast<uint16_t>(k - 1);
+
+  // Huffman
+  int32_t length = reader.read<int32_t>();
+  if(!reader.ok || length < 0 || length > reader.end - reader.p)
+    return false;
+  if(!hufUncompress(reader.p, size_t(length), scratch.data.data(), total, scratch))
+    return false;
+
+  // Wavelet
+  for(auto& cd : cds)
+    for(int j = 0; j < cd.size; ++j)
+      wav2Decode(&scratch.data[cd.start + j], cd.nx, cd.size, cd.ny, cd.nx * cd.size, maxValue);
+
+  // Back to the original range and to the interleaved lines
+  for(auto& v : scratch.data)
+    v = scratch.lut[v];
+  uint8_t* o = out;
+  for(int32_t y = y0; y <= y1; ++y)
+  {
+    for(auto& cd : cds)
+    {
+      if(!isSampled(y, cd.ys))
+        continue;
+      size_t n = size_t(cd.nx) * cd.size;
+      memcpy(o, &scratch.data[cd.end], n * 2);
+      o += n * 2;
+      cd.end += n;
+    }
+  }
+  return true;
+}
+
+inline uint32_t levelSize(uint32_t size, uint32_t level, uint8_t roundingMode)
+{
+  uint32_t s = roundingMode == 1 ? (size + (1u << level) - 1) >> level : size >> level;
+  return std::max(s, 1u);
+}
+
+inline uint32_t numLevels(uint32_t size, uint8_t roundingMode)
+{
+  uint32_t n = 1;
+  while(levelSize(size, n - 1, roundingMode) > 1)
+    n++;
+  return n;
+}
+
+// Number of chunks in the part, and how many of them belong to the full resolution level
+void countChunks(const ExrPart& part, uint32_t& total, uint32_t& level0)
+{
+  const uint32_t w = uint32_t(part.xMax - part.xMin + 1);
+  const uint32_t h = uint32_t(part.yMax - part.yMin + 1);
+  if(!part.tiled)
+  {
+    total = level0 = (h + linesPerBlock(part.compression) - 1) / linesPerBlock(part.compression);
+    return;
+  }
+  auto tiles = [&](uint32_t lw, uint32_t lh) {
+    return ((lw + part.tileWidth - 1) / part.tileWidth) * ((lh + part.tileHeight - 1) / part.tileHeight);
+  };
+  level0 = tiles(w, h);
+  total  = 0;
+  if(part.levelMode == 0)
+    total = level0;
+  else if(part.levelMode == 1)
+  {
+    uint32_t n = numLevels(std::max(w, h), part.roundingMode);
+    for(uint32_t l = 0; l < n; l++)
+      total += tiles(levelSize(w, l, part.roundingMode), levelSize(h, l, part.roundingMode));
+  }
+  else
+  {
+    uint32_t nx = numLevels(w, part.roundingMode);
+    uint32_t ny = numLevels(h, part.roundingMode);
+    for(uint32_t ly = 0; ly < ny; ly++)
+      for(uint32_t lx = 0; lx < nx; lx++)
+        total += tiles(levelSize(w, lx, part.roundingMode), levelSize(h, ly, part.roundingMode));
+  }
+}
+
+}  // namespace
+
+
+bool loadExr(const std::string& filename, FloatImage& image)
+{
+  MappedFile file;
+  if(!file.open(filename))
+  {
+    LOGE("Failed to open %s\n", filename.c_str());
+    return false;
+  }
+  auto fail = [&](const char* reason) {
+    LOGE("Failed to load %s: %s\n", filename.c_str(), reason);
+    return false;
+  };
+
+  ByteReader     in{file.data(), file.data() + file.size()};
+  const uint32_t magic   = in.read<uint32_t>();
+  const uint32_t version = in.read<uint32_t>();
+  if(magic != 20000630 || (version & 0xff) != 2)
+    return fail("not an OpenEXR file");
+  const bool multiPart = (version & 0x1000) != 0;
+
+  // Headers, a multi-part file ends the list with an empty header
+  std::vector<ExrPart> parts;
+  do
+  {
+    ExrPart part;
+    part.tiled = (version & 0x200) != 0;
+    part.deep  = (version & 0x800) != 0;
+    if(!parseHeader(in, part))
+      return fail("invalid header");
+    parts.push_back(part);
+  } while(multiPart && in.p < in.end && *in.p != 0);
+  if(multiPart)
+    in.p++;
+
+  // Offset tables, we only keep the full resolution chunks
+  for(auto& part : parts)
+  {
+    if(part.xMax < part.xMin || part.yMax < part.yMin || (part.tiled && (part.tileWidth == 0 || part.tileHeight == 0)))
+      return fail("invalid data window or tiles");
+    uint32_t total, level0;
+    countChunks(part, total, level0);
+    if(part.chunkCount >= 0)
+      total = uint32_t(part.chunkCount);
+    if(uint64_t(in.end - in.p) < uint64_t(total) * sizeof(uint64_t))
+      return fail("truncated offset table");
+    part.offsets.resize(std::min(total, level0));
+    for(auto& o : part.offsets)
+      o = in.read<uint64_t>();
+    in.p += sizeof(uint64_t) * (total - part.offsets.size());
+  }
+
+  // First part with colors, the channels can have a layer prefix ("diffuse.R")
+  int32_t partIndex = -1;
+  int32_t rgb[3]{-1, -1, -1};
+  for(size_t p = 0; p < parts.size() && partIndex < 0; p++)
+  {
+    if(parts[p].deep)
+      continue;
+    int32_t y = -1;
+    rgb[0] = rgb[1] = rgb[2] = -1;
+    for(size_t c = 0; c < parts[p].channels.size(); c++)
+    {
+      const std::string& name  = parts[p].channels[c].name;
+      const size_t       dot   = name.rfind('.');
+      const std::string  base  = dot == std::string::npos ? name : name.substr(dot + 1);
+      const bool         first = dot == std::string::npos;  // Prefer the channels without layer
+      int32_t*           slot  = base == "R" ? &rgb[0] : base == "G" ? &rgb[1] : base == "B" ? &rgb[2] : base == "Y" ? &y : nullptr;
+      if(slot && (*slot < 0 || first))
+        *slot = int32_t(c);
+    }
+    if(rgb[0] < 0 || rgb[1] < 0 || rgb[2] < 0)
+      rgb[0] = rgb[1] = rgb[2] = y;
+    if(rgb[0] >= 0)
+      partIndex = int32_t(p);
+  }
+  if(partIndex < 0)
+    return fail("no RGB or Y channels");
+
+  const ExrPart& part = parts[partIndex];
+  for(int32_t c : rgb)
+    if(part.channels[c].xSampling != 1 || part.channels[c].ySampling != 1)
+      return fail("sub-sampled color channels are not supported");
+  switch(part.compression)
+  {
+    case eExrNone:
+    case eExrRle:
+    case eExrPiz:
+      break;
+    case eExrZips:
+    case eExrZip:
+#ifdef NVP_SUPPORTS_ZLIB
+      break;
+#else
+      return fail("ZIP compression needs zlib");
+#endif
+    default:
+      return fail("unsupported compression (NONE, RLE, ZIPS, ZIP and PIZ are supported)");
+  }
+
+  image.width    = uint32_t(part.xMax - part.xMin + 1);
+  image.height   = uint32_t(part.yMax - part.yMin + 1);
+  image.channels = 3;
+  image.pixels.assign(size_t(image.width) * image.height * 3, 0.f);
+
+  // Each chunk is independent, they are decompressed and converted in parallel
+  std::atomic<bool> ok{true};
+  parallelRanges(part.offsets.size(), [&](uint64_t begin, uint64_t end) {
+    std::vector<uint8_t> block;
+    std::vector<uint8_t> scratch;
+    PizScratch           piz;
+    for(uint64_t i = begin; i < end && ok; i++)
+    {
+      ByteReader chunk{file.data() + std::min<uint64_t>(part.offsets[i], file.size()), file.data() + file.size()};
+      if(multiPart && chunk.read<int32_t>() != partIndex)
+      {
+        ok = false;
+        break;
+      }
+      int32_t x0 = part.xMin, x1 = part.xMax, y0, y1;
+      if(part.tiled)
+      {
+        int32_t tx = chunk.read<int32_t>();
+        int32_t ty = chunk.read<int32_t>();
+        chunk.read<uint64_t>();  // Level, always 0 here
+        x0 = part.xMin + tx * int32_t(part.tileWidth);
+        x1 = std::min(x0 + int32_t(part.tileWidth) - 1, part.xMax);
+        y0 = part.yMin + ty * int32_t(part.tileHeight);
+        y1 = std::min(y0 + int32_t(part.tileHeight) - 1, part.yMax);
+      }
+      else
+      {
+        y0 = chunk.read<int32_t>();
+        y1 = std::min(y0 + linesPerBlock(part.compression) - 1, part.yMax);
+      }
+      int32_t dataSize = chunk.read<int32_t>();
+      if(!chunk.ok || dataSize < 0 || dataSize > chunk.end - chunk.p || x0 < part.xMin || x0 > x1 || y0 < part.yMin || y0 > y1)
+      {
+        ok = false;
+        break;
+      }
+
+      // Uncompressed size of the block
+      size_t blockSize = 0;
+      for(int32_t y = y0; y <= y1; y++)
+        for(const auto& c : part.channels)
+          if(isSampled(y, c.ySampling))
+            blockSize += size_t(numSamples(c.xSampling, x0, x1)) * pixelTypeSize(c.type);
+
+      // Data isn't compressed when it wouldn't get smaller
+      const uint8_t* data = chunk.p;
+      if(size_t(dataSize) < blockSize)
+      {
+        block.resize(blockSize);
+        bool decoded = false;
+        if(part.compression == eExrRle)
+          decoded = rleDecompress(chunk.p, dataSize, block.data(), blockSize, scratch);
+        else if(part.compression == eExrZip || part.compression == eExrZips)
+          decoded = zipDecompress(chunk.p, dataSize, block.data(), blockSize, scratch);
+        else if(part.compression == eExrPiz)
+          decoded = pizDecompress(chunk.p, dataSize, block.data(), blockSize, part.channels, x0, x1, y0, y1, piz);
+        if(!decoded)
+        {
+          ok = false;
+          break;
+        }
+        data = block.data();
+      }
+      else if(size_t(dataSize) != blockSize)
+      {
+        ok = false;
+        break;
+      }
+
+      // Lines of the block: for each channel, all its samples
+      const uint32_t width = uint32_t(x1 - x0 + 1);
+      for(int32_t y = y0; y <= y1; y++)
+      {
+        float* dst = image.row(uint32_t(y - part.yMin)) + size_t(x0 - part.xMin) * 3;
+        for(size_t c = 0; c < part.channels.size(); c++)
+        {
+          const ExrChannel& ch = part.channels[c];
+          if(!isSampled(y, ch.ySampling))
+            continue;
+          const size_t n = size_t(numSamples(ch.xSampling, x0, x1));
+          for(int32_t k = 0; k < 3; k++)
+          {
+            if(rgb[k] != int32_t(c))
+              continue;
+            for(uint32_t x = 0; x < width; x++)
+            {
+              float v;
+              if(ch.type == eExrHalf)
+              {
+                uint16_t h;
+                memcpy(&h, data + x * 2, 2);
+                v = halfToFloat(h);
+              }
+              else if(ch.type == eExrFloat)
+                memcpy(&v, data + x * 4, 4);
+              else
+              {
+                uint32_t u;
+                memcpy(&u, data + x * 4, 4);
+                v = float(u);
+              }
+              dst[x * 3 + k] = v;
+            }
+          }
+          data += n * pixelTypeSize(ch.type);
+        }
+      }
+    }
+  });
+
+  if(!ok)
+    return fail("corrupt or unsupported chunk");
+  return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Writing OpenEXR: single part scanline images, the chunks are compressed in parallel
+//
+namespace {
+
+// Round to nearest even, overflow to infinity
+inline uint16_t floatToHalf(float f)
+{
+  const uint32_t f32infty = 255u << 23;
+  const uint32_t f16max   = (127u + 16u) << 23;
+  const uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+  uint32_t       u;
+  memcpy(&u, &f, 4);
+  const uint32_t sign = u & 0x80000000u;
+  u ^= sign;
+  uint16_t o;
+  if(u >= f16max)
+    o = (u > f32infty) ? 0x7e00 : 0x7c00;  // NaN, Inf
+  else if(u < (113u << 23))
+  {
+    // Denormal: the addition of the magic number does the rounding
+    float fu, magic;
+    memcpy(&fu, &u, 4);
+    memcpy(&magic, &denormMagic, 4);
+    fu += magic;
+    memcpy(&u, &fu, 4);
+    o = static_cast<uint16_t>(u - denormMagic);
+  }
+  else
+  {
+    const uint32_t mantOdd = (u >> 13) & 1;
+    u += ((15u - 127u) << 23) + 0xfff;
+    u += mantOdd;
+    o = static_cast<uint16_t>(u >> 13);
+  }
+  return static_cast<uint16_t>(o | (sign >> 16));
+}
+
+struct ByteWriter
+{
+  std::vector<uint8_t> data;
+
+  template <typename T>
+  void write(const T& v)
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+    data.insert(data.end(), p, p + sizeof(T));
+  }
+  void writeString(const std::string& s) { data.insert(data.end(), s.c_str(), s.c_str() + s.size() + 1); }
+  void attribute(const std::string& name, const std::string& type, const std::vector<uint8_t>& value)
+  {
+    writeString(name);
+    writeString(type);
+    write(int32_t(value.size()));
+    data.insert(data.end(), value.begin(), value.end());
+  }
+};
+
+#ifdef NVP_SUPPORTS_ZLIB
+// ZIP and RLE: bytes split in two halves (even and odd) and delta encoded
+void predictorAndInterleave(const uint8_t* in, size_t size, std::vector<uint8_t>& out)
+{
+  out.resize(size);
+  uint8_t* t1 = out.data();
+  uint8_t* t2 = out.data() + (size + 1) / 2;
+  for(size_t i = 0; i < size; i++)
+    ((i & 1) ? *t2++ : *t1++) = in[i];
+  uint8_t prev = out.empty() ? 0 : out[0];
+  for(size_t i = 1; i < size; i++)
+  {
+    uint8_t cur = out[i];
+    out[i]      = static_cast<uint8_t>(int(cur) - int(prev) + 128);
+    prev        = cur;
+  }
+}
+
+bool zipCompress(const uint8_t* in, size_t inSize, std::vector<uint8_t>& out, std::vector<uint8_t>& scratch)
+{
+  predictorAndInterleave(in, inSize, scratch);
+  uLongf size = compressBound(static_cast<uLong>(inSize));
+  out.resize(size);
+  if(compress2(out.data(), &size, scratch.data(), static_cast<uLong>(inSize), Z_DEFAULT_COMPRESSION) != Z_OK)
+    return false;
+  out.resize(size);
+  return true;
+}
+#endif
+
+// Most significant bits first, as read by BitReader
+struct BitWriter
+{
+  std::vector<uint8_t>& out;
+  uint64_t              c{0};
+  int32_t               lc{0};
+
+  void put(int32_t n, uint64_t v)
+  {
+    if(n > 32)
+    {
+      put(n - 32, v >> 32);
+      n = 32;
+      v &= 0xffffffffull;
+    }
+    c = (c << n) | v;
+    lc += n;
+    while(lc >= 8)
+    {
+      lc -= 8;
+      out.push_back(static_cast<uint8_t>(c >> lc));
+    }
+    c &= (uint64_t(1) << lc) - 1;
+  }
+  void flush()
+  {
+    if(lc > 0)
+      out.push_back(static_cast<uint8_t>(c << (8 - lc)));
+  }
+};
+
+// Huffman code lengths from the frequencies, the longest code must fit in 58 bits
+bool hufBuildEncTable(const std::vector<uint64_t>& freq, std::vector<uint64_t>& hcode)
+{
+  std::vector<int32_t> symbols;
+  for(int32_t i = 0; i < kHufEncSize; i++)
+    if(freq[i])
+      symbols.push_back(i);
+
+  hcode.assign(kHufEncSize, 0);
+  if(symbols.size() == 1)
+  {
+    hcode[symbols[0]] = 1;
+  }
+  else
+  {
+    // Merging the two least frequent nodes, leaves first then internal nodes
+    using Node = std::pair<uint64_t, int32_t>;
+    std::vector<int32_t> parent(symbols.size() * 2, -1);
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+    for(size_t i = 0; i < symbols.size(); i++)
+      heap.push({freq[symbols[i]], int32_t(i)});
+    int32_t next = int32_t(symbols.size());
+    while(heap.size() > 1)
+    {
+      Node a = heap.top();
+      heap.pop();
+      Node b = heap.top();
+      heap.pop();
+      parent[a.second] = parent[b.second] = next;
+      heap.push({a.first + b.first, next++});
+    }
+    // Depths, parents are always created after their children
+    std::vector<int32_t> depth(next, 0);
+    for(int32_t n = next - 2; n >= 0; n--)
+      depth[n] = depth[parent[n]] + 1;
+    for(size_t i = 0; i < symbols.size(); i++)
+    {
+      if(depth[i] > 58)
+        return false;
+      hcode[symbols[i]] = uint64_t(depth[i]);
+    }
+  }
+  hufCanonicalCodeTable(hcode.data());
+  return true;
+}
+
+// Code lengths, with runs of zeros
+void hufPackEncTable(const std::vector<uint64_t>& hcode, int32_t im, int32_t iM, BitWriter& out)
+{
+  const int32_t kLongestLongRun = 255 + kShortestLongRun;
+  for(; im <= iM; im++)
+  {
+    int32_t l = hufLength(hcode[im]);
+    if(l == 0)
+    {
+      int32_t zerun = 1;
+      while(im < iM && zerun < kLongestLongRun && hufLength(hcode[im + 1]) == 0)
+      {
+        im++;
+        zerun++;
+      }
+      if(zerun >= 2)
+      {
+        if(zerun >= kShortestLongRun)
+        {
+          out.put(6, kLongZeroCodeRun);
+          out.put(8, uint64_t(zerun - kShortestLongRun));
+        }
+        else
+          out.put(6, uint64_t(kShortZeroCodeRun + zerun - 2));
+        continue;
+      }
+    }
+    out.put(6, uint64_t(l));
+  }
+}
+
+bool hufCompress(const uint16_t* in, size_t count, std::vector<uint8_t>& out)
+{
+  out.clear();
+  if(count == 0)
+    return true;
+
+  std::vector<uint64_t> freq(kHufEncSize, 0);
+  for(size_t i = 0; i < count; i++)
+    freq[in[i]]++;
+  int32_t im = 0;
+  while(!freq[im])
+    im++;
+  int32_t iM = kHufEncSize - 2;
+  while(!freq[iM])
+    iM--;
+  iM++;
+  freq[iM] = 1;  // Run length code
+
+  std::vector<uint64_t> hcode;
+  if(!hufBuildEncTable(freq, hcode))
+    return false;
+
+  out.resize(20, 0);
+  BitWriter table{out};
+  hufPackEncTable(hcode, im, iM, table);
+  table.flush();
+  const int32_t tableLength = int32_t(out.size() - 20);
+
+  // Runs of the same symbol are coded with the run length code when shorter
+  BitWriter  bits{out};
+  const auto send = [&](uint16_t s, int32_t runCount) {
+    const uint64_t sc = hcode[s];
+    const uint64_t rc = hcode[iM];
+    if(hufLength(sc) + hufLength(rc) + 8 < hufLength(sc) * runCount)
+    {
+      bits.put(hufLength(sc), hufCode(sc));
+      bits.put(hufLength(rc), hufCode(rc));
+      bits.put(8, uint64_t(runCount));
+    }
+    else
+    {
+      for(int32_t i = 0; i <= runCount; i++)
+        bits.put(hufLength(sc), hufCode(sc));
+    }
+  };
+  const size_t dataStart = out.size();
+  uint16_t     s         = in[0];
+  int32_t      cs        = 0;
+  for(size_t i = 1; i < count; i++)
+  {
+    if(s == in[i] && cs < 255)
+      cs++;
+    else
+    {
+      send(s, cs);
+      cs = 0;
+    }
+    s = in[i];
+  }
+  send(s, cs);
+  const int32_t nBits = int32_t((out.size() - dataStart) * 8 + bits.lc);
+  bits.flush();
+
+  const int32_t header[5]{im, iM, tableLength, nBits, 0};
+  memcpy(out.data(), header, sizeof(header));
+  return true;
+}
+
+inline void wenc14(uint16_t a, uint16_t b, uint16_t& l, uint16_t& h)
+{
+  int16_t as = static_cast<int16_t>(a);
+  int16_t bs = static_cast<int16_t>(b);
+  int     ms = (as + bs) >> 1;
+  int     ds = as - bs;
+  l          = static_cast<uint16_t>(ms);
+  h          = static_cast<uint16_t>(ds);
+}
+
+inline void wenc16(uint16_t a, uint16_t b, uint16_t& l, uint16_t& h)
+{
+  const int offset = 1 << 15;
+  const int modMask = (1 << 16) - 1;
+  int       ao      = (a + offset) & modMask;
+  int       m       = (ao + b) >> 1;
+  int       d       = ao - b;
+  if(d < 0)
+    m = (m + offset) & modMask;
+  d &= modMask;
+  l = static_cast<uint16_t>(m);
+  h = static_cast<uint16_t>(d);
+}
+
+// 2D wavelet transform of nx x ny values, inverse of wav2Decode
+void wav2Encode(uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
+{
+  const bool w14 = mx < (1 << 14);
+  auto       enc = [w14](uint16_t a, uint16_t b, uint16_t& l, uint16_t& h) { w14 ? wenc14(a, b, l, h) : wenc16(a, b, l, h); };
+  int        n   = std::min(nx, ny);
+  int        p   = 1;
+  int        p2  = 2;
+
+  while(p2 <= n)
+  {
+    uint16_t* py  = in;
+    uint16_t* ey  = in + oy * (ny - p2);
+    int       oy1 = oy * p;
+    int       oy2 = oy * p2;
+    int       ox1 = ox * p;
+    int       ox2 = ox * p2;
+    uint16_t  i00, i01, i10, i11;
+
+    for(; py <= ey; py += oy2)
+    {
+      uint16_t* px = py;
+      uint16_t* ex = py + ox * (nx - p2);
+      for(; px <= ex; px += ox2)
+      {
+        uint16_t* p01 = px + ox1;
+        uint16_t* p10 = px + oy1;
+        uint16_t* p11 = p10 + ox1;
+        enc(*px, *p01, i00, i01);
+        enc(*p10, *p11, i10, i11);
+        enc(i00, i10, *px, *p10);
+        enc(i01, i11, *p01, *p11);
+      }
+      // Odd column
+      if(nx & p)
+      {
+        uint16_t* p10 = px + oy1;
+        enc(*px, *p10, i00, *p10);
+        *px = i00;
+      }
+    }
+    // Odd line
+    if(ny & p)
+    {
+      uint16_t* px = py;
+      uint16_t* ex = py + ox * (nx - p2);
+      for(; px <= ex; px += ox2)
+      {
+        uint16_t* p01 = px + ox1;
+        enc(*px, *p01, i00, *p01);
+        *px = i00;
+      }
+    }
+    p = p2;
+    p2 <<= 1;
+  }
+}
+
+// `in` is a block of lines with all the channels of each line, as uncompressed
+bool pizCompress(const uint8_t* in, size_t inSize, const std::vector<ExrChannel>& channels, int32_t nx, int32_t ny, std::vector<uint8_t>& out, PizScratch& scratch)
+{
+  // Grouping the values per channel
+  std::vector<size_t> start(channels.size());
+  size_t              total = 0;
+  for(size_t c = 0; c < channels.size(); c++)
+  {
+    start[c] = total;
+    total += size_t(nx) * ny * (pixelTypeSize(channels[c].type) / 2);
+  }
+  if(total * 2 != inSize)
+    return false;
+  scratch.data.resize(total);
+  std::vector<size_t> pos(start);
+  const uint8_t*      src = in;
+  for(int32_t y = 0; y < ny; y++)
+    for(size_t c = 0; c < channels.size(); c++)
+    {
+      const size_t n = size_t(nx) * (pixelTypeSize(channels[c].type) / 2);
+      memcpy(&scratch.data[pos[c]], src, n * 2);
+      src += n * 2;
+      pos[c] += n;
+    }
+
+  // Range compression: bitmap of the values in use and forward LUT
+  uint8_t bitmap[kBitmapSize]{};
+  for(uint16_t v : scratch.data)
+    bitmap[v >> 3] |= uint8_t(1 << (v & 7));
+  bitmap[0] &= ~1;  // Zero is always in the LUT
+  uint16_t minNonZero = kBitmapSize - 1;
+  uint16_t maxNonZero = 0;
+  for(int32_t i = 0; i < kBitmapSize; i++)
+    if(bitmap[i])
+    {
+      minNonZero = std::min(minNonZero, uint16_t(i));
+      maxNonZero = std::max(maxNonZero, uint16_t(i));
+    }
+  scratch.lut.assign(kUshortRange, 0);
+  uint16_t k = 0;
+  for(int32_t i = 0; i < kUshortRange; ++i)
+    if(i == 0 || (bitmap[i >> 3] & (1 << (i & 7))))
+      scratch.lut[i] = k++;
+  const uint16_t maxValue = static_cast<uint16_t>(k - 1);
+  for(auto& v : scratch.data)
+    v = scratch.lut[v];
+
+  // Wavelet
+  for(size_t c = 0; c < channels.size(); c++)
+  {
+    const int size = pixelTypeSize(channels[c].type) / 2;
+    for(int j = 0; j < size; ++j)
+      wav2Encode(&scratch.data[start[c] + j], nx, size, ny, nx * size, maxValue);
+  }
+
+  // Huffman
+  std::vector<uint8_t> huf;
+  if(!hufCompress(scratch.data.data(), total, huf))
+    return false;
+
+  ByteWriter w;
+  w.write(minNonZero);
+  w.write(maxNonZero);
+  if(minNonZero <= maxNonZero)
+    w.data.insert(w.data.end(), bitmap + minNonZero, bitmap + maxNonZero + 1);
+  w.write(int32_t(huf.size()));
+  w.data.insert(w.data.end(), huf.begin(), huf.end());
+  out = std::move(w.data);
+  return true;
+}
+
+int32_t exrCompressionType(ExrCompression compression)
+{
+  switch(compression)
+  {
+    case ExrCompression::eNone:
+      return eExrNone;
+    case ExrCompression::eZips:
+    case ExrCompression::eZip:
+#ifdef NVP_SUPPORTS_ZLIB
+      return compression == ExrCompression::eZip ? eExrZip : eExrZips;
+#else
+      LOGW("EXR: ZIP compression needs zlib, using PIZ\n");
+      return eExrPiz;
+#endif
+    case ExrCompression::ePiz:
+      return eExrPiz;
+    case ExrCompression::eDwaa:
+      LOGW("EXR: DWAA compression is not supported, using PIZ (lossless)\n");
+      return eExrPiz;
+  }
+  return eExrPiz;
+}
+
+// The channels are stored in alphabetical order
+std::vector<ExrChannel> sortExrChannels(std::vector<ImageChannel>& channels)
+{
+  std::sort(channels.begin(), channels.end(), [](const ImageChannel& a, const ImageChannel& b) { return a.name < b.name; });
+  std::vector<ExrChannel> exrChannels;
+  for(const auto& c : channels)
+    exrChannels.push_back({c.name, c.half ? eExrHalf : eExrFloat, 1, 1});
+  return exrChannels;
+}
+
+// Single part header, scanlines or tiles of `tileSize` (one level)
+std::vector<uint8_t> exrHeader(uint32_t width, uint32_t height, const std::vector<ExrChannel>& exrChannels, int32_t type, uint32_t tileSize)
+{
+  ByteWriter header;
+  header.write(uint32_t(20000630));
+  header.write(uint32_t(tileSize > 0 ? 2 | 0x200 : 2));
+  {
+    ByteWriter chlist;
+    for(const auto& c : exrChannels)
+    {
+      chlist.writeString(c.name);
+      chlist.write(c.type);
+      chlist.write(uint32_t(0));  // pLinear and reserved
+      chlist.write(int32_t(1));
+      chlist.write(int32_t(1));
+    }
+    chlist.write(uint8_t(0));
+    header.attribute("channels", "chlist", chlist.data);
+  }
+  header.attribute("compression", "compression", {uint8_t(type)});
+  {
+    ByteWriter box;
+    box.write(int32_t(0));
+    box.write(int32_t(0));
+    box.write(int32_t(width - 1));
+    box.write(int32_t(height - 1));
+    header.attribute("dataWindow", "box2i", box.data);
+    header.attribute("displayWindow", "box2i", box.data);
+  }
+  header.attribute("lineOrder", "lineOrder", {0});  // Increasing Y
+  {
+    ByteWriter v;
+    v.write(1.f);
+    header.attribute("pixelAspectRatio", "float", v.data);
+    header.attribute("screenWindowWidth", "float", v.data);
+    ByteWriter c;
+    c.write(0.f);
+    c.write(0.f);
+    header.attribute("screenWindowCenter", "v2f", c.data);
+  }
+  if(tileSize > 0)
+  {
+    ByteWriter tiles;
+    tiles.write(tileSize);
+    tiles.write(tileSize);
+    tiles.write(uint8_t(0));  // One level, rounding down
+    header.attribute("tiles", "tiledesc", tiles.data);
+  }
+  header.write(uint8_t(0));
+  return std::move(header.data);
+}
+
+struct ExrBlockScratch
+{
+  std::vector<uint8_t> block;
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> scratch;
+  PizScratch           piz;
+};
+
+// Lines [y0, y1) of the channels (sorted), converted and compressed: a scanline block or a tile.
+// Returns the data to store.
+const std::vector<uint8_t>& exrBlock(const std::vector<ImageChannel>& channels,
+                                     const std::vector<ExrChannel>&   exrChannels,
+                                     int32_t                          type,
+                                     uint32_t                         width,
+                                     uint32_t                         y0,
+                                     uint32_t                         y1,
+                                     ExrBlockScratch&                 s)
+{
+  // Lines of the block: for each channel, all its values
+  s.block.clear();
+  for(uint32_t y = y0; y < y1; y++)
+    for(const auto& c : channels)
+    {
+      const float* src = c.data + (size_t(y) * width) * c.stride;
+      if(c.half)
+      {
+        for(uint32_t x = 0; x < width; x++)
+        {
+          uint16_t h = floatToHalf(src[size_t(x) * c.stride]);
+          s.block.insert(s.block.end(), reinterpret_cast<uint8_t*>(&h), reinterpret_cast<uint8_t*>(&h) + 2);
+        }
+      }
+      else
+      {
+        for(uint32_t x = 0; x < width; x++)
+        {
+          float v = src[size_t(x) * c.stride];
+          s.block.insert(s.block.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + 4);
+        }
+      }
+    }
+
+  bool packed = false;
+#ifdef NVP_SUPPORTS_ZLIB
+  if(type == eExrZip || type == eExrZips)
+    packed = zipCompress(s.block.data(), s.block.size(), s.compressed, s.scratch);
+#endif
+  if(type == eExrPiz)
+    packed = pizCompress(s.block.data(), s.block.size(), exrChannels, int32_t(width), int32_t(y1 - y0), s.compressed, s.piz);
+
+  // Data is kept uncompressed when it doesn't get smaller
+  return (packed && s.compressed.size() < s.block.size()) ? s.compressed : s.block;
+}
+
+}  // namespace
+
+
+bool encodeExr(uint32_t width, uint32_t height, std::vector<ImageChannel> channels, ExrCompression compression, std::vector<uint8_t>& out)
+{
+  if(width == 0 || height == 0 || channels.empty())
+    return false;
+
+  const int32_t                 type        = exrCompressionType(compression);
+  const std::vector<ExrChannel> exrChannels = sortExrChannels(channels);
+  std::vector<uint8_t>          header      = exrHeader(width, height, exrChannels, type, 0);
+
+  // Chunks, converted and compressed in parallel
+  const uint32_t                    lines      = uint32_t(linesPerBlock(type));
+  const uint32_t                    chunkCount = (height + lines - 1) / lines;
+  std::vector<std::vector<uint8_t>> chunks(chunkCount);
+  parallelRanges(chunkCount, [&](uint64_t begin, uint64_t end) {
+    ExrBlockScratch scratch;
+    for(uint64_t i = begin; i < end; i++)
+    {
+      const uint32_t y0   = uint32_t(i) * lines;
+      const uint32_t y1   = std::min(y0 + lines, height);
+      const auto&    data = exrBlock(channels, exrChannels, type, width, y0, y1, scratch);
+
+      auto& chunk = chunks[i];
+      chunk.resize(8 + data.size());
+      const int32_t chunkHeader[2]{int32_t(y0), int32_t(data.size())};
+      memcpy(chunk.data(), chunkHeader, 8);
+      memcpy(chunk.data() + 8, data.data(), data.size());
+    }
+  });
+
+  // Offset table and chunks
+  std::vector<uint64_t> offsets(chunkCount);
+  uint64_t              offset = header.size() + chunkCount * sizeof(uint64_t);
+  for(uint32_t i = 0; i < chunkCount; i++)
+  {
+    offsets[i] = offset;
+    offset += chunks[i].size();
+  }
+
+  out = std::move(header);
+  out.reserve(offset);
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(offsets.data()), reinterpret_cast<const uint8_t*>(offsets.data() + chunkCount));
+  for(const auto& chunk : chunks)
+    out.insert(out.end(), chunk.begin(), chunk.end());
+  return true;
+}
+
+bool saveExr(const std::string& filename, uint32_t width, uint32_t height, std::vector<ImageChannel> channels, ExrCompression compression)
+{
+  std::vector<uint8_t> data;
+  return encodeExr(width, height, std::move(channels), compression, data) && writeFile(filename, data);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Tiled OpenEXR written as the tiles come: the offset table is reserved after the header and
+// filled when closing, only one tile is held in memory.
+//
+TiledExrWriter::~TiledExrWriter()
+{
+  close();
+}
+
+bool TiledExrWriter::open(const std::string&        filename,
+                          uint32_t                  width,
+                          uint32_t                  height,
+                          uint32_t                  tileSize,
+                          std::vector<ImageChannel> channels,
+                          ExrCompression            compression)
+{
+  close();
+  if(width == 0 || height == 0 || tileSize == 0 || channels.empty())
+    return false;
+
+  m_file = fopen(filename.c_str(), "wb");
+  if(m_file == nullptr)
+  {
+    LOGE("Failed to create %s\n", filename.c_str());
+    return false;
+  }
+
+  m_filename = filename;
+  m_width    = width;
+  m_height   = height;
+  m_tileSize = tileSize;
+  m_type     = exrCompressionType(compression);
+  m_channels = std::move(channels);
+  m_order.resize(m_channels.size());
+  for(size_t i = 0; i < m_order.size(); i++)
+    m_order[i] = i;
+  // Channels are given in the caller's order and written sorted
+  std::sort(m_order.begin(), m_order.end(), [&](size_t a, size_t b) { return m_channels[a].name < m_channels[b].name; });
+  std::vector<ImageChannel> sorted = m_channels;
+  const auto                header = exrHeader(width, height, sortExrChannels(sorted), m_type, tileSize);
+
+  m_offsets.assign(size_t(tilesX()) * tilesY(), 0);
+  m_tableOffset = header.size();
+  bool written  = fwrite(header.data(), 1, header.size(), m_file) == header.size();
+  written       = written && fwrite(m_offsets.data(), sizeof(uint64_t), m_offsets.size(), m_file) == m_offsets.size();
+  m_offset      = m_tableOffset + m_offsets.size() * sizeof(uint64_t);
+  if(!written)
+  {
+    LOGE("Failed to write %s\n", filename.c_str());
+    fclose(m_file);
+    m_file = nullptr;
+  }
+  return written;
+}
+
+bool TiledExrWriter::writeTile(uint32_t tx, uint32_t ty, const std::vector<ImageChannel>& channels)
+{
+  if(m_file == nullptr || tx >= tilesX() || ty >= tilesY() || channels.size() != m_channels.size())
+    return false;
+
+  std::vector<ImageChannel> sorted;
+  for(size_t i : m_order)
+  {
+    sorted.push_back(channels[i]);
+    sorted.back().name = m_channels[i].name;
+    sorted.back().half = m_channels[i].half;
+  }
+  const auto exrChannels = sortExrChannels(sorted);  // Already sorted, only the descriptions
+
+  ExrBlockScratch scratch;
+  const auto&     data = exrBlock(sorted, exrChannels, m_type, tileWidth(tx), 0, tileHeight(ty), scratch);
+
+  const int32_t chunkHeader[5]{int32_t(tx), int32_t(ty), 0, 0, int32_t(data.size())};
+  bool          written = fwrite(chunkHeader, sizeof(chunkHeader), 1, m_file) == 1;
+  written               = written && fwrite(data.data(), 1, data.size(), m_file) == data.size();
+  if(!written)
+  {
+    LOGE("Failed to write a tile of %s\n", m_filename.c_str());
+    return false;
+  }
+
+  m_offsets[size_t(ty) * tilesX() + tx] = m_offset;
+  m_offset += sizeof(chunkHeader) + data.size();
+  return true;
+}
+
+bool TiledExrWriter::close()
+{
+  if(m_file == nullptr)
+    return false;
+
+  const bool complete = std::find(m_offsets.begin(), m_offsets.end(), 0) == m_offsets.end();
+  if(!complete)
+    LOGW("%s: some tiles were not written\n", m_filename.c_str());
+
+#ifdef _WIN32
+  bool written = _fseeki64(m_file, int64_t(m_tableOffset), SEEK_SET) == 0
+#else
+  bool written = fseeko(m_file, off_t(m_tableOffset), SEEK_SET) == 0
+#endif
+                 && fwrite(m_offsets.data(), sizeof(uint64_t), m_offsets.size(), m_file) == m_offsets.size();
+  written = (fclose(m_file) == 0) && written;
+  m_file  = nullptr;
+  if(!written)
+    LOGE("Failed to write %s\n", m_filename.c_str());
+  return written && complete;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Portable Float Map: "PF" RGB or "Pf" grey, little-endian (negative scale), rows from bottom to top
+//
+bool encodePfm(uint32_t width, uint32_t height, const std::vector<ImageChannel>& channels, std::vector<uint8_t>& out)
+{
+  if(channels.size() != 1 && channels.size() != 3)
+  {
+    LOGE("PFM images have 1 or 3 channels\n");
+    return false;
+  }
+
+  const size_t nc = channels.size();
+  char         header[64];
+  const size_t headerSize = snprintf(header, sizeof(header), "%s\n%u %u\n-1.0\n", nc == 3 ? "PF" : "Pf", width, height);
+  out.resize(headerSize + size_t(width) * height * nc * sizeof(float));
+  memcpy(out.data(), header, headerSize);
+
+  float* pixels = reinterpret_cast<float*>(out.data() + headerSize);
+  parallelRanges(height, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; y++)
+    {
+      float* dst = &pixels[(size_t(height - 1 - y) * width) * nc];
+      for(size_t c = 0; c < nc; c++)
+      {
+        const float* src = channels[c].data + (size_t(y) * width) * channels[c].stride;
+        for(uint32_t x = 0; x < width; x++)
+          memcpy(&dst[x * nc + c], &src[size_t(x) * channels[c].stride], sizeof(float));  // Unaligned after the text header
+      }
+    }
+  });
+  return true;
+}
+
+bool savePfm(const std::string& filename, uint32_t width, uint32_t height, const std::vector<ImageChannel>& channels)
+{
+  std::vector<uint8_t> data;
+  return encodePfm(width, height, channels, data) && writeFile(filename, data);
+}
+
+
+bool writeFile(const std::string& filename, const std::vector<uint8_t>& data)
+{
+  FILE* f = fopen(filename.c_str(), "wb");
+  if(f == nullptr)
+  {
+    LOGE("Failed to create %s\n", filename.c_str());
+    return false;
+  }
+  bool written = fwrite(data.data(), 1, data.size(), f) == data.size();
+  written      = (fclose(f) == 0) && written;
+  if(!written)
+    LOGE("Failed to write %s\n", filename.c_str());
+  return written;
+}
+
+void floatToHalf(const float* src, size_t count, uint16_t* dst)
+{
+  for(size_t i = 0; i < count; i++)
+    dst[i] = floatToHalf(src[i]);
+}
+
+}  // namespace imageio
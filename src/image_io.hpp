@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Reading and writing of floating point images
+//
+// - Radiance (.hdr): the file is memory mapped, the RLE scanlines are located in a first pass
+//   and then decoded and converted to float in parallel.
+// - OpenEXR (.exr): scanline and tiled images, single and multi-part, compressed with
+//   NONE, RLE, ZIPS, ZIP (needs zlib) or PIZ. Chunks are decompressed in parallel.
+// - Other formats are read with stb_image.
+//
+// Writing is for OpenEXR (scanline, single part, half and float channels, chunks compressed in
+// parallel, or tiled and streamed to the file tile by tile) and PFM.
+//
+// The images are kept with their own number of channels, environments are RGB, there is no
+// expansion to RGBA.
+//
+
+// Float image, channels are interleaved, rows from top to bottom
+struct FloatImage
+{
+  uint32_t           width{0};
+  uint32_t           height{0};
+  uint32_t           channels{0};
+  std::vector<float> pixels;
+
+  float*       row(uint32_t y) { return &pixels[size_t(y) * width * channels]; }
+  const float* row(uint32_t y) const { return &pixels[size_t(y) * width * channels]; }
+};
+
+namespace imageio {
+
+// Loading a HDR image as RGB float. The format is deduced from the file content.
+// Returns false and logs the error on failure.
+bool loadRgb(const std::string& filename, FloatImage& image);
+
+bool loadRadiance(const std::string& filename, FloatImage& image);
+bool loadExr(const std::string& filename, FloatImage& image);
+
+// One channel of an image to write: element (x, y) is data[(y * width + x) * stride]
+struct ImageChannel
+{
+  std::string  name;
+  const float* data{nullptr};
+  uint32_t     stride{1};
+  bool         half{true};  // EXR: stored as 16-bit float
+};
+
+enum class ExrCompression
+{
+  eNone,
+  eZips,
+  eZip,  // ZIP and ZIPS need zlib, otherwise PIZ is used
+  ePiz,
+  eDwaa,  // Lossy, not implemented: PIZ is used
+};
+
+// The channels are sorted by name, as required by the format (ex. "A", "B", "G", "R", "Z")
+bool encodeExr(uint32_t width, uint32_t height, std::vector<ImageChannel> channels, ExrCompression compression, std::vector<uint8_t>& out);
+bool saveExr(const std::string& filename, uint32_t width, uint32_t height, std::vector<ImageChannel> channels, ExrCompression compression);
+
+// Tiled OpenEXR, for images too large to be held in memory: each tile is compressed and appended
+// to the file when written. Tiles are `tileSize` squares, smaller on the right and bottom edges.
+class TiledExrWriter
+{
+public:
+  ~TiledExrWriter();
+
+  // Names and types of `channels`, their data is not used
+  bool open(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize, std::vector<ImageChannel> channels, ExrCompression compression);
+  // Channels in the same order as open(), of tileWidth(tx) x tileHeight(ty) values
+  bool writeTile(uint32_t tx, uint32_t ty, const std::vector<ImageChannel>& channels);
+  // Returns false if the file couldn't be written or tiles are missing
+  bool close();
+
+  uint32_t tilesX() const { return (m_width + m_tileSize - 1) / m_tileSize; }
+  uint32_t tilesY() const { return (m_height + m_tileSize - 1) / m_tileSize; }
+  uint32_t tileWidth(uint32_t tx) const { return std::min(m_tileSize, m_width - tx * m_tileSize); }
+  uint32_t tileHeight(uint32_t ty) const { return std::min(m_tileSize, m_height - ty * m_tileSize); }
+
+private:
+  FILE*                     m_file{nullptr};
+  std::string               m_filename;
+  uint32_t                  m_width{0};
+  uint32_t                  m_height{0};
+  uint32_t                  m_tileSize{1};
+  int32_t                   m_type{0};
+  std::vector<ImageChannel> m_channels;
+  std::vector<size_t>       m_order;  // Sorted channels
+  std::vector<uint64_t>     m_offsets;
+  uint64_t                  m_tableOffset{0};
+  uint64_t                  m_offset{0};
+};
+
+// 1 channel (Pf) or 3 channels (PF)
+bool encodePfm(uint32_t width, uint32_t height, const std::vector<ImageChannel>& channels, std::vector<uint8_t>& out);
+bool savePfm(const std::string& filename, uint32_t width, uint32_t height, const std::vector<ImageChannel>& channels);
+
+// Writing `data` in one call, logs the error on failure
+bool writeFile(const std::string& filename, const std::vector<uint8_t>& data);
+
+// IEEE half floats, rounding to nearest even
+void floatToHalf(const float* src, size_t count, uint16_t* dst);
+
+// Radiance RGBE to float, same as stb_image: ldexp(mantissa, e - 136)
+void rgbeToFloat(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, uint32_t count, float* rgb);
+
+}  // namespace imageio
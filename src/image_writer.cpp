@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cctype>
+#include <cstring>
+
+#include "image_writer.hpp"
+#include "ldr_encoders.hpp"
+#include "nvh/nvprint.hpp"
+#include "tools.hpp"
+
+
+namespace {
+
+//--------------------------------------------------------------------------------------------------
+// PPM: P6 (RGB) or P5 (grey), the alpha is dropped
+//
+bool encodePpm(const OutputImage& image, const EncodeOptions&, std::vector<uint8_t>& out)
+{
+  if(image.ldr.empty() || image.channels == 2 || image.channels > 4)
+  {
+    LOGE("PPM: needs a 8-bit grey, RGB or RGBA image\n");
+    return false;
+  }
+
+  const uint32_t nc = image.channels == 1 ? 1 : 3;
+  char           header[64];
+  const size_t   headerSize = snprintf(header, sizeof(header), "P%d\n%u %u\n255\n", nc == 1 ? 5 : 6, image.width, image.height);
+  out.resize(headerSize + size_t(image.width) * image.height * nc);
+  memcpy(out.data(), header, headerSize);
+
+  uint8_t* pixels = out.data() + headerSize;
+  if(image.channels == nc)
+  {
+    memcpy(pixels, image.ldr.data(), out.size() - headerSize);
+    return true;
+  }
+  parallelRanges(image.height, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; y++)
+    {
+      const uint8_t* src = &image.ldr[y * image.width * 4];
+      uint8_t*       dst = &pixels[y * image.width * 3];
+      for(uint32_t x = 0; x < image.width; x++, src += 4, dst += 3)
+      {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+      }
+    }
+  });
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// PNG and JPEG, compressed in parallel strips
+//
+bool encodePng(const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out)
+{
+  if(image.ldr.empty())
+  {
+    LOGE("PNG: needs a 8-bit image\n");
+    return false;
+  }
+  return ldr::encodePng(image.ldr.data(), image.width, image.height, image.channels, options.pngLevel, out);
+}
+
+bool encodeJpeg(const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out)
+{
+  if(image.ldr.empty())
+  {
+    LOGE("JPEG: needs a 8-bit image\n");
+    return false;
+  }
+  return ldr::encodeJpeg(image.ldr.data(), image.width, image.height, image.channels, options.jpegQuality, out);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Float images, channels are referenced in place
+//
+std::vector<imageio::ImageChannel> floatChannels(const OutputImage& image)
+{
+  static const char* defaultNames[4] = {"R", "G", "B", "A"};
+  std::vector<imageio::ImageChannel> channels;
+  for(uint32_t c = 0; c < image.channels; c++)
+  {
+    imageio::ImageChannel ch;
+    ch.name   = c < image.names.size() ? image.names[c] : (image.channels == 1 ? "Y" : defaultNames[std::min(c, 3u)]);
+    ch.data   = image.hdr.data() + c;
+    ch.stride = image.channels;
+    ch.half   = ch.name != "Z" && ch.name != "samples";
+    channels.push_back(ch);
+  }
+  return channels;
+}
+
+bool encodeExr(const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out)
+{
+  if(image.hdr.empty())
+  {
+    LOGE("EXR: needs a float image\n");
+    return false;
+  }
+  return imageio::encodeExr(image.width, image.height, floatChannels(image), options.exrCompression, out);
+}
+
+bool encodePfm(const OutputImage& image, const EncodeOptions&, std::vector<uint8_t>& out)
+{
+  if(image.hdr.empty() || image.channels == 2)
+  {
+    LOGE("PFM: needs a float image of 1, 3 or 4 channels\n");
+    return false;
+  }
+  auto channels = floatChannels(image);
+  channels.resize(image.channels == 1 ? 1 : 3);  // Alpha is dropped
+  return imageio::encodePfm(image.width, image.height, channels, out);
+}
+
+// The pixels as they are in memory
+bool encodeRaw(const OutputImage& image, const EncodeOptions&, std::vector<uint8_t>& out)
+{
+  if(!image.ldr.empty())
+    out = image.ldr;
+  else
+    out.assign(reinterpret_cast<const uint8_t*>(image.hdr.data()), reinterpret_cast<const uint8_t*>(image.hdr.data() + image.hdr.size()));
+  return true;
+}
+
+std::string extension(const std::string& filename)
+{
+  const size_t dot = filename.find_last_of('.');
+  if(dot == std::string::npos || filename.find_first_of("/\\", dot) != std::string::npos)
+    return {};
+  std::string ext = filename.substr(dot);
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext;
+}
+
+}  // namespace
+
+
+ImageWriter::ImageWriter()
+{
+  m_encoders[".ppm"]  = encodePpm;
+  m_encoders[".png"]  = encodePng;
+  m_encoders[".jpg"]  = encodeJpeg;
+  m_encoders[".jpeg"] = encodeJpeg;
+  m_encoders[".exr"]  = encodeExr;
+  m_encoders[".pfm"]  = encodePfm;
+  m_encoders[".raw"]  = encodeRaw;
+
+  m_thread = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exit = true;
+  }
+  m_cond.notify_all();
+  m_thread.join();
+}
+
+void ImageWriter::addEncoder(const std::string& extension, Encoder encoder)
+{
+  m_encoders[extension] = std::move(encoder);
+}
+
+bool ImageWriter::push(const std::string& filename, OutputImage&& image, const EncodeOptions& options)
+{
+  auto it = m_encoders.find(extension(filename));
+  if(it == m_encoders.end())
+  {
+    LOGE("No image encoder for %s\n", filename.c_str());
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [&] { return m_jobs.size() < m_maxPending; });
+  m_jobs.push_back({filename, std::move(image), options, it->second});
+  m_cond.notify_all();
+  return true;
+}
+
+bool ImageWriter::encode(const std::string& filename, const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out) const
+{
+  auto it = m_encoders.find(extension(filename));
+  if(it == m_encoders.end())
+  {
+    LOGE("No image encoder for %s\n", filename.c_str());
+    return false;
+  }
+  return it->second(image, options, out);
+}
+
+bool ImageWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [&] { return m_jobs.empty() && !m_busy; });
+  bool success = m_success;
+  m_success    = true;
+  return success;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Background thread: encoding and writing the images in the order they were pushed. The file is
+// written in one call, the encoders can use more threads.
+//
+void ImageWriter::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true)
+  {
+    m_cond.wait(lock, [&] { return m_exit || !m_jobs.empty(); });
+    if(m_jobs.empty())
+      break;  // Exiting once everything is written
+
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    m_busy = true;
+    lock.unlock();
+    m_cond.notify_all();  // Room for one more image
+
+    MilliTimer           timer;
+    std::vector<uint8_t> data;
+    bool                 success = job.encoder(job.image, job.options, data) && imageio::writeFile(job.filename, data);
+    stages::record("write", timer.elapsed());
+    if(success)
+      LOGI("Image saved to %s (%.3f ms)\n", job.filename.c_str(), timer.elapsed());
+    else
+      LOGE("Failed to save %s\n", job.filename.c_str());
+
+    lock.lock();
+    m_busy = false;
+    m_success &= success;
+    m_cond.notify_all();
+  }
+}
+
+
+void convertRgba8(const uint8_t* src, size_t rowPitch, uint32_t width, uint32_t height, bool bgra, uint32_t channels, uint8_t* dst)
+{
+  parallelRanges(height, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; y++)
+    {
+      const uint8_t* s = src + y * rowPitch;
+      uint8_t*       d = dst + y * width * channels;
+      for(uint32_t x = 0; x < width; x++, s += 4, d += channels)
+      {
+        d[0] = s[bgra ? 2 : 0];
+        d[1] = s[1];
+        d[2] = s[bgra ? 0 : 2];
+        if(channels == 4)
+          d[3] = s[3];
+      }
+    }
+  });
+}
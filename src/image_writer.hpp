@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_io.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Output stage of the rendered images: the pixels are handed to a background thread which encodes
+// and writes the file, so the rendering of the next job continues in the meantime.
+//
+// The encoder is chosen from the file extension: .ppm, .png, .jpg, .exr, .pfm and .raw (the pixels
+// as they are, without header). Other formats can be added with addEncoder().
+//
+
+// Image to encode, either 8-bit or float
+struct OutputImage
+{
+  uint32_t                 width{0};
+  uint32_t                 height{0};
+  uint32_t                 channels{0};
+  std::vector<uint8_t>     ldr;    // 8-bit, interleaved, rows from top to bottom
+  std::vector<float>       hdr;    // Float, same layout, used when `ldr` is empty
+  std::vector<std::string> names;  // EXR channel names, default is R, G, B, A. "Z" is stored as float, others as half.
+};
+
+// Per image settings of the encoders
+struct EncodeOptions
+{
+  imageio::ExrCompression exrCompression{imageio::ExrCompression::ePiz};
+  int                     pngLevel{6};      // zlib level, 0 (fastest) to 9 (smallest), see ldr::encodePng()
+  int                     jpegQuality{90};  // 1 to 100
+};
+
+class ImageWriter
+{
+public:
+  using Encoder = std::function<bool(const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out)>;
+
+  ImageWriter();
+  ~ImageWriter();  // Writes the pending images
+
+  // Extension in lower case with the dot, ex. ".ppm". To be called before pushing images.
+  void addEncoder(const std::string& extension, Encoder encoder);
+
+  // Queues the image to be written. Blocks while `maxPending` images are already waiting, which
+  // bounds the memory when encoding is slower than rendering.
+  bool push(const std::string& filename, OutputImage&& image, const EncodeOptions& options = {});
+
+  // Encodes the image in the calling thread, with the encoder of the extension of `filename`
+  bool encode(const std::string& filename, const OutputImage& image, const EncodeOptions& options, std::vector<uint8_t>& out) const;
+
+  // Blocks until all images are written. Returns false if any failed since the last call.
+  bool wait();
+
+  void setMaxPending(uint32_t count) { m_maxPending = std::max(count, 1u); }
+
+private:
+  struct Job
+  {
+    std::string   filename;
+    OutputImage   image;
+    EncodeOptions options;
+    Encoder       encoder;
+  };
+
+  void run();
+
+  std::map<std::string, Encoder> m_encoders;
+  std::deque<Job>                m_jobs;
+  std::mutex                     m_mutex;
+  std::condition_variable        m_cond;
+  std::thread                    m_thread;
+  uint32_t                       m_maxPending{2};
+  bool                           m_busy{false};    // Encoding a job which is no longer in m_jobs
+  bool                           m_exit{false};
+  bool                           m_success{true};  // No failure since the last wait()
+};
+
+// Converting rows of 8-bit RGBA or BGRA pixels, `rowPitch` bytes apart (ex. a mapped linear image),
+// to tightly packed RGB (channels = 3) or RGBA (channels = 4). The rows are converted in parallel.
+void convertRgba8(const uint8_t* src, size_t rowPitch, uint32_t width, uint32_t height, bool bgra, uint32_t channels, uint8_t* dst);
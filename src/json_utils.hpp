@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <stdexcept>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvmath/nvmath.h"
+
+using json = nlohmann::json;
+
+//--------------------------------------------------------------------------------------------------
+// Parsing helpers shared by the JSON inputs (render jobs, thumbnails, camera paths). They throw
+// std::runtime_error on invalid values, the loaders report them with the name of the file.
+//
+
+// [x, y, z]
+inline nvmath::vec3f vec3FromJson(const json& j)
+{
+  if(!j.is_array() || j.size() != 3)
+    throw std::runtime_error("expecting an array of 3 numbers");
+  return {j[0].get<float>(), j[1].get<float>(), j[2].get<float>()};
+}
+
+// "camera" of a render job or a thumbnail: the index of a glTF camera, or an explicit camera
+// { "eye": [x, y, z], "center": [x, y, z], "up": [x, y, z], "fov": degrees } where "up" and "fov"
+// are optional. `T` has the members cameraIndex, hasCamera, eye, center, up and fov.
+template <typename T>
+void cameraFromJson(const json& cam, T& target)
+{
+  if(cam.is_number_integer())
+  {
+    target.cameraIndex = cam.get<int>();
+    target.hasCamera   = false;
+    return;
+  }
+
+  target.cameraIndex = -1;
+  target.hasCamera   = true;
+  target.eye         = vec3FromJson(cam.at("eye"));
+  target.center      = vec3FromJson(cam.at("center"));
+  if(cam.contains("up"))
+    target.up = vec3FromJson(cam["up"]);
+  target.fov = cam.value("fov", target.fov);
+}
@@ -0,0 +1,658 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#ifdef NVP_SUPPORTS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ldr_encoders.hpp"
+#include "nvh/nvprint.hpp"
+#include "tools.hpp"
+
+
+namespace ldr {
+
+namespace {
+
+// Number of strips of `units` (rows, rows of blocks): a few per thread, not smaller than
+// `minStripSize` bytes, as each strip starts without history and compresses a bit less.
+uint32_t stripCount(uint32_t units, size_t unitSize, size_t minStripSize)
+{
+  const uint64_t bySize    = std::max<uint64_t>(1, uint64_t(units) * unitSize / minStripSize);
+  const uint64_t maxStrips = uint64_t(std::max(1u, std::thread::hardware_concurrency())) * 4;
+  return static_cast<uint32_t>(std::min<uint64_t>({bySize, maxStrips, units}));
+}
+
+void writeU16(std::vector<uint8_t>& out, uint32_t v)
+{
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+void writeU32(std::vector<uint8_t>& out, uint32_t v)
+{
+  writeU16(out, v >> 16);
+  writeU16(out, v & 0xffff);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// PNG
+//
+inline int paeth(int a, int b, int c)
+{
+  int p  = a + b - c;
+  int pa = std::abs(p - a);
+  int pb = std::abs(p - b);
+  int pc = std::abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+// Writes the filter type and the filtered row in `out` (size + 1 bytes), `prev` is null for the
+// first row. The filter is the one giving the smallest sum of absolute differences, or Up if `fast`.
+void filterRow(const uint8_t* row, const uint8_t* prev, uint32_t size, uint32_t bpp, bool fast, uint8_t* out, std::vector<uint8_t>& scratch)
+{
+  if(fast)
+  {
+    out[0] = 2;
+    for(uint32_t i = 0; i < size; i++)
+      out[i + 1] = static_cast<uint8_t>(row[i] - (prev ? prev[i] : 0));
+    return;
+  }
+
+  scratch.resize(size);
+  uint64_t bestSum = ~0ull;
+  for(int type = 0; type < 5; type++)
+  {
+    uint64_t sum = 0;
+    for(uint32_t i = 0; i < size; i++)
+    {
+      const int a = i >= bpp ? row[i - bpp] : 0;
+      const int b = prev ? prev[i] : 0;
+      const int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+      int       p = 0;
+      switch(type)
+      {
+        case 1:
+          p = a;
+          break;
+        case 2:
+          p = b;
+          break;
+        case 3:
+          p = (a + b) >> 1;
+          break;
+        case 4:
+          p = paeth(a, b, c);
+          break;
+      }
+      const uint8_t v = static_cast<uint8_t>(row[i] - p);
+      scratch[i]      = v;
+      sum += v < 128 ? v : 256 - v;
+    }
+    if(sum < bestSum)
+    {
+      bestSum = sum;
+      out[0]  = static_cast<uint8_t>(type);
+      memcpy(out + 1, scratch.data(), size);
+    }
+  }
+}
+
+uint32_t crc32Png(const uint8_t* data, size_t size)
+{
+#ifdef NVP_SUPPORTS_ZLIB
+  return static_cast<uint32_t>(crc32(0, data, static_cast<uInt>(size)));
+#else
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for(uint32_t n = 0; n < 256; n++)
+    {
+      uint32_t c = n;
+      for(int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = ~0u;
+  for(size_t i = 0; i < size; i++)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+#endif
+}
+
+void writePngChunk(const char* type, const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+  writeU32(out, static_cast<uint32_t>(size));
+  const size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  if(size > 0)
+    out.insert(out.end(), data, data + size);
+  writeU32(out, crc32Png(&out[start], size + 4));
+}
+
+#ifdef NVP_SUPPORTS_ZLIB
+// Raw deflate of one strip. The last strip ends the stream, the others end with a sync flush so
+// the next one starts on a byte boundary.
+bool deflateStrip(const std::vector<uint8_t>& in, int level, bool last, std::vector<uint8_t>& out)
+{
+  z_stream zs{};
+  if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+  out.resize(deflateBound(&zs, static_cast<uLong>(in.size())) + 16);  // + sync flush marker
+  zs.next_in   = const_cast<Bytef*>(in.data());
+  zs.avail_in  = static_cast<uInt>(in.size());
+  zs.next_out  = out.data();
+  zs.avail_out = static_cast<uInt>(out.size());
+  const int  ret     = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+  const bool success = (last ? ret == Z_STREAM_END : ret == Z_OK) && zs.avail_in == 0;
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return success;
+}
+#else
+// zlib stream made of stored blocks
+void storeZlib(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+  out = {0x78, 0x01};
+  size_t pos = 0;
+  do
+  {
+    const uint16_t len = static_cast<uint16_t>(std::min<size_t>(data.size() - pos, 65535));
+    out.push_back(pos + len == data.size() ? 1 : 0);  // Last block, stored
+    out.push_back(static_cast<uint8_t>(len));
+    out.push_back(static_cast<uint8_t>(len >> 8));
+    out.push_back(static_cast<uint8_t>(~len));
+    out.push_back(static_cast<uint8_t>(~len >> 8));
+    out.insert(out.end(), data.begin() + pos, data.begin() + pos + len);
+    pos += len;
+  } while(pos < data.size());
+
+  uint32_t s1 = 1, s2 = 0;
+  for(uint8_t v : data)
+  {
+    s1 = (s1 + v) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  writeU32(out, (s2 << 16) | s1);
+}
+#endif
+
+
+//--------------------------------------------------------------------------------------------------
+// JPEG
+//
+// Position in the block (row major) of the coefficients in zigzag order
+const uint8_t kZigzag[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+                             41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+                             30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Annex K quantization tables, row major
+const uint8_t kLumQuant[64] = {16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+                               14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+                               18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+                               49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+
+const uint8_t kChromaQuant[64] = {17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99,
+                                  99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+                                  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Annex K Huffman tables: number of codes of each length (1 to 16) and symbols
+const uint8_t kDcLumBits[16]      = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const uint8_t kDcChromaBits[16]   = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const uint8_t kDcValues[12]       = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t kAcLumBits[16]      = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const uint8_t kAcLumValues[162]   = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14,
+    0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09,
+    0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+    0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65,
+    0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
+    0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9,
+    0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca,
+    0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+const uint8_t kAcChromaBits[16]    = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32,
+    0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16,
+    0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64,
+    0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86,
+    0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8,
+    0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+    0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+struct HuffTable
+{
+  uint16_t code[256]{};
+  uint8_t  size[256]{};
+
+  HuffTable(const uint8_t* bits, const uint8_t* values)
+  {
+    uint32_t c = 0, k = 0;
+    for(uint32_t len = 1; len <= 16; len++, c <<= 1)
+      for(uint32_t i = 0; i < bits[len - 1]; i++, c++, k++)
+      {
+        code[values[k]] = static_cast<uint16_t>(c);
+        size[values[k]] = static_cast<uint8_t>(len);
+      }
+  }
+};
+
+// Entropy coded data, with the 0xFF bytes stuffed
+struct JpegBits
+{
+  std::vector<uint8_t>& out;
+  uint32_t              acc{0};
+  int32_t               count{0};
+
+  void put(uint32_t bits, int32_t n)
+  {
+    acc = (acc << n) | (bits & ((1u << n) - 1));
+    count += n;
+    while(count >= 8)
+    {
+      count -= 8;
+      const uint8_t b = static_cast<uint8_t>(acc >> count);
+      out.push_back(b);
+      if(b == 0xff)
+        out.push_back(0);
+    }
+    acc &= (1u << count) - 1;
+  }
+  // Padding with ones, as at the end of each restart interval
+  void flush()
+  {
+    if(count > 0)
+      put((1u << (8 - count)) - 1, 8 - count);
+  }
+};
+
+// AAN forward DCT of 8 values `stride` apart, scaled by 8 * aanScale[u] (removed with the quantization)
+inline void fdct8(float* d, int stride)
+{
+  float d0 = d[0], d1 = d[stride], d2 = d[2 * stride], d3 = d[3 * stride];
+  float d4 = d[4 * stride], d5 = d[5 * stride], d6 = d[6 * stride], d7 = d[7 * stride];
+
+  float tmp0 = d0 + d7, tmp7 = d0 - d7;
+  float tmp1 = d1 + d6, tmp6 = d1 - d6;
+  float tmp2 = d2 + d5, tmp5 = d2 - d5;
+  float tmp3 = d3 + d4, tmp4 = d3 - d4;
+
+  // Even part
+  float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+  float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+  d0          = tmp10 + tmp11;
+  d4          = tmp10 - tmp11;
+  float z1    = (tmp12 + tmp13) * 0.707106781f;
+  d2          = tmp13 + z1;
+  d6          = tmp13 - z1;
+
+  // Odd part
+  tmp10    = tmp4 + tmp5;
+  tmp11    = tmp5 + tmp6;
+  tmp12    = tmp6 + tmp7;
+  float z5 = (tmp10 - tmp12) * 0.382683433f;
+  float z2 = tmp10 * 0.541196100f + z5;
+  float z4 = tmp12 * 1.306562965f + z5;
+  float z3 = tmp11 * 0.707106781f;
+  float z11 = tmp7 + z3, z13 = tmp7 - z3;
+
+  d[0]          = d0;
+  d[stride]     = z11 + z4;
+  d[2 * stride] = d2;
+  d[3 * stride] = z13 - z2;
+  d[4 * stride] = d4;
+  d[5 * stride] = z13 + z2;
+  d[6 * stride] = d6;
+  d[7 * stride] = z11 - z4;
+}
+
+struct JpegComponent
+{
+  const HuffTable* dc;
+  const HuffTable* ac;
+  const float*     scale;  // Inverse of the quantization and of the DCT scale, row major
+  int32_t          pred{0};
+};
+
+inline uint32_t magnitude(int32_t v)
+{
+  uint32_t a = static_cast<uint32_t>(v < 0 ? -v : v);
+  uint32_t n = 0;
+  while(a)
+  {
+    n++;
+    a >>= 1;
+  }
+  return n;
+}
+
+// `block` holds the samples minus 128, row major
+void encodeBlock(float* block, JpegComponent& comp, JpegBits& bits)
+{
+  for(int i = 0; i < 8; i++)
+    fdct8(block + i * 8, 1);
+  for(int i = 0; i < 8; i++)
+    fdct8(block + i, 8);
+
+  int32_t q[64];
+  for(int i = 0; i < 64; i++)
+    q[i] = static_cast<int32_t>(std::lround(block[kZigzag[i]] * comp.scale[kZigzag[i]]));
+
+  // DC, difference with the previous block of the component
+  const int32_t  diff = q[0] - comp.pred;
+  const uint32_t n    = magnitude(diff);
+  comp.pred           = q[0];
+  bits.put(comp.dc->code[n], comp.dc->size[n]);
+  if(n)
+    bits.put(static_cast<uint32_t>(diff < 0 ? diff - 1 : diff), n);
+
+  // AC, run-lengths of zeros
+  int last = 63;
+  while(last > 0 && q[last] == 0)
+    last--;
+  uint32_t run = 0;
+  for(int i = 1; i <= last; i++)
+  {
+    if(q[i] == 0)
+    {
+      run++;
+      continue;
+    }
+    for(; run >= 16; run -= 16)
+      bits.put(comp.ac->code[0xf0], comp.ac->size[0xf0]);
+    const uint32_t m   = magnitude(q[i]);
+    const uint32_t sym = (run << 4) | m;
+    bits.put(comp.ac->code[sym], comp.ac->size[sym]);
+    bits.put(static_cast<uint32_t>(q[i] < 0 ? q[i] - 1 : q[i]), m);
+    run = 0;
+  }
+  if(last < 63)
+    bits.put(comp.ac->code[0x00], comp.ac->size[0x00]);  // End of block
+}
+
+void makeQuantTable(const uint8_t* base, int quality, uint8_t* table, float* scale)
+{
+  static const float aanScale[8] = {1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+                                    1.0f, 0.785694958f, 0.541196100f, 0.275899379f};
+
+  const int s = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  for(int i = 0; i < 64; i++)
+  {
+    table[i] = static_cast<uint8_t>(std::min(std::max((base[i] * s + 50) / 100, 1), 255));
+    scale[i] = 1.f / (table[i] * aanScale[i / 8] * aanScale[i % 8] * 8.f);
+  }
+}
+
+void writeMarker(std::vector<uint8_t>& out, uint8_t marker, uint32_t length)
+{
+  out.push_back(0xff);
+  out.push_back(marker);
+  writeU16(out, length);
+}
+
+}  // namespace
+
+
+bool encodePng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, int level, std::vector<uint8_t>& out)
+{
+  if(pixels == nullptr || width == 0 || height == 0 || channels < 1 || channels > 4)
+  {
+    LOGE("PNG: needs a 8-bit image of 1 to 4 channels\n");
+    return false;
+  }
+
+  level                       = std::min(std::max(level, 0), 9);
+  const bool     fast         = level <= 2;
+  const size_t   rowSize      = size_t(width) * channels;
+  const uint32_t count        = stripCount(height, rowSize + 1, 256 * 1024);
+  const uint32_t rowsPerStrip = (height + count - 1) / count;
+  const uint32_t strips       = (height + rowsPerStrip - 1) / rowsPerStrip;
+
+  std::vector<std::vector<uint8_t>> data(strips);
+  std::vector<uint32_t>             adler(strips);
+  std::atomic<bool>                 success{true};
+  parallelRanges(strips, [&](uint64_t begin, uint64_t end) {
+    std::vector<uint8_t> filtered, scratch;
+    for(uint64_t s = begin; s < end; s++)
+    {
+      const uint32_t y0 = static_cast<uint32_t>(s) * rowsPerStrip;
+      const uint32_t y1 = std::min(y0 + rowsPerStrip, height);
+      filtered.resize((y1 - y0) * (rowSize + 1));
+      for(uint32_t y = y0; y < y1; y++)
+      {
+        const uint8_t* row = pixels + y * rowSize;
+        filterRow(row, y > 0 ? row - rowSize : nullptr, static_cast<uint32_t>(rowSize), channels, fast,
+                  &filtered[(y - y0) * (rowSize + 1)], scratch);
+      }
+#ifdef NVP_SUPPORTS_ZLIB
+      adler[s] = static_cast<uint32_t>(adler32(adler32(0, nullptr, 0), filtered.data(), static_cast<uInt>(filtered.size())));
+      if(!deflateStrip(filtered, level, s + 1 == strips, data[s]))
+        success = false;
+#else
+      data[s].swap(filtered);
+#endif
+    }
+  });
+  if(!success)
+  {
+    LOGE("PNG: deflate failed\n");
+    return false;
+  }
+
+  // Stitching the strips in one zlib stream
+  std::vector<uint8_t> idat;
+#ifdef NVP_SUPPORTS_ZLIB
+  static const uint8_t levelFlags[4] = {0x01, 0x5e, 0x9c, 0xda};  // FLEVEL, with the header check bits
+  idat = {0x78, levelFlags[level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3]};
+  uint32_t check = adler[0];
+  for(uint32_t s = 0; s < strips; s++)
+  {
+    idat.insert(idat.end(), data[s].begin(), data[s].end());
+    if(s > 0)
+      check = static_cast<uint32_t>(adler32_combine(check, adler[s], static_cast<z_off_t>((std::min((s + 1) * rowsPerStrip, height) - s * rowsPerStrip) * (rowSize + 1))));
+  }
+  writeU32(idat, check);
+#else
+  std::vector<uint8_t> filtered;
+  filtered.reserve(height * (rowSize + 1));
+  for(const auto& d : data)
+    filtered.insert(filtered.end(), d.begin(), d.end());
+  storeZlib(filtered, idat);
+#endif
+
+  static const uint8_t colorTypes[] = {0, 4, 2, 6};  // Grey, grey + alpha, RGB, RGBA
+  std::vector<uint8_t> ihdr;
+  writeU32(ihdr, width);
+  writeU32(ihdr, height);
+  ihdr.insert(ihdr.end(), {8, colorTypes[channels - 1], 0, 0, 0});  // Depth, color, compression, filter, no interlace
+
+  out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  out.reserve(idat.size() + 64);
+  writePngChunk("IHDR", ihdr.data(), ihdr.size(), out);
+  writePngChunk("IDAT", idat.data(), idat.size(), out);
+  writePngChunk("IEND", nullptr, 0, out);
+  return true;
+}
+
+
+bool encodeJpeg(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, int quality, std::vector<uint8_t>& out)
+{
+  if(pixels == nullptr || width == 0 || height == 0 || width > 65535 || height > 65535 || channels < 1 || channels > 4)
+  {
+    LOGE("JPEG: needs a 8-bit image of 1 to 4 channels, up to 65535 x 65535\n");
+    return false;
+  }
+
+  quality               = std::min(std::max(quality, 1), 100);
+  const bool     color  = channels >= 3;
+  const bool     sub420 = color && quality < 90;
+  const uint32_t mcu    = sub420 ? 16 : 8;
+  const uint32_t mcusX  = (width + mcu - 1) / mcu;
+  const uint32_t mcusY  = (height + mcu - 1) / mcu;
+
+  // Strips of MCU rows are the restart intervals, the interval is stored on 16 bits
+  const uint32_t count           = stripCount(mcusY, size_t(mcu) * width * channels, 128 * 1024);
+  const uint32_t mcuRowsPerStrip = std::max(1u, std::min((mcusY + count - 1) / count, 65535 / mcusX));
+  const uint32_t strips          = (mcusY + mcuRowsPerStrip - 1) / mcuRowsPerStrip;
+
+  uint8_t lumTable[64], chromaTable[64];
+  float   lumScale[64], chromaScale[64];
+  makeQuantTable(kLumQuant, quality, lumTable, lumScale);
+  makeQuantTable(kChromaQuant, quality, chromaTable, chromaScale);
+  static const HuffTable dcLum(kDcLumBits, kDcValues);
+  static const HuffTable acLum(kAcLumBits, kAcLumValues);
+  static const HuffTable dcChroma(kDcChromaBits, kDcValues);
+  static const HuffTable acChroma(kAcChromaBits, kAcChromaValues);
+
+  std::vector<std::vector<uint8_t>> data(strips);
+  parallelRanges(strips, [&](uint64_t begin, uint64_t end) {
+    float y[4][64], cb[64], cr[64];
+    for(uint64_t s = begin; s < end; s++)
+    {
+      JpegComponent comps[3] = {{&dcLum, &acLum, lumScale}, {&dcChroma, &acChroma, chromaScale}, {&dcChroma, &acChroma, chromaScale}};
+      JpegBits      bits{data[s]};
+      const uint32_t my1 = std::min(mcusY, static_cast<uint32_t>(s + 1) * mcuRowsPerStrip);
+      for(uint32_t my = static_cast<uint32_t>(s) * mcuRowsPerStrip; my < my1; my++)
+        for(uint32_t mx = 0; mx < mcusX; mx++)
+        {
+          if(sub420)
+          {
+            memset(cb, 0, sizeof(cb));
+            memset(cr, 0, sizeof(cr));
+          }
+
+          // Pixels of the MCU, the border ones are repeated
+          for(uint32_t py = 0; py < mcu; py++)
+          {
+            const uint8_t* row = pixels + size_t(std::min(my * mcu + py, height - 1)) * width * channels;
+            for(uint32_t px = 0; px < mcu; px++)
+            {
+              const uint8_t* p = row + size_t(std::min(mx * mcu + px, width - 1)) * channels;
+              const uint32_t b = (py / 8) * 2 + (px / 8);  // Luma block of the MCU
+              const uint32_t i = (py % 8) * 8 + (px % 8);
+              if(!color)
+              {
+                y[0][i] = p[0] - 128.f;
+                continue;
+              }
+              const float r = p[0], g = p[1], bl = p[2];
+              y[b][i]       = 0.299f * r + 0.587f * g + 0.114f * bl - 128.f;
+              const float u = -0.168736f * r - 0.331264f * g + 0.5f * bl;
+              const float v = 0.5f * r - 0.418688f * g - 0.081312f * bl;
+              if(sub420)
+              {
+                const uint32_t c = (py / 2) * 8 + px / 2;
+                cb[c] += u * 0.25f;
+                cr[c] += v * 0.25f;
+              }
+              else
+              {
+                cb[i] = u;
+                cr[i] = v;
+              }
+            }
+          }
+
+          for(uint32_t b = 0; b < (sub420 ? 4u : 1u); b++)
+            encodeBlock(y[b], comps[0], bits);
+          if(color)
+          {
+            encodeBlock(cb, comps[1], bits);
+            encodeBlock(cr, comps[2], bits);
+          }
+        }
+      bits.flush();
+    }
+  });
+
+  // Headers
+  const uint32_t nbComps = color ? 3 : 1;
+  out                    = {0xff, 0xd8};  // SOI
+  writeMarker(out, 0xe0, 16);             // APP0, JFIF 1.1, no units, 1:1 aspect ratio, no thumbnail
+  out.insert(out.end(), {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0});
+
+  const uint32_t nbTables = color ? 2 : 1;
+  writeMarker(out, 0xdb, 2 + 65 * nbTables);  // DQT, in zigzag order
+  for(uint32_t t = 0; t < nbTables; t++)
+  {
+    out.push_back(static_cast<uint8_t>(t));
+    for(int i = 0; i < 64; i++)
+      out.push_back((t == 0 ? lumTable : chromaTable)[kZigzag[i]]);
+  }
+
+  writeMarker(out, 0xc0, 8 + 3 * nbComps);  // SOF0, baseline
+  out.push_back(8);
+  writeU16(out, height);
+  writeU16(out, width);
+  out.push_back(static_cast<uint8_t>(nbComps));
+  for(uint32_t c = 0; c < nbComps; c++)
+    out.insert(out.end(), {static_cast<uint8_t>(c + 1), static_cast<uint8_t>(c == 0 && sub420 ? 0x22 : 0x11), static_cast<uint8_t>(c == 0 ? 0 : 1)});
+
+  auto writeHuffman = [&](uint8_t id, const uint8_t* bits, const uint8_t* values, uint32_t count) {
+    out.push_back(id);
+    out.insert(out.end(), bits, bits + 16);
+    out.insert(out.end(), values, values + count);
+  };
+  writeMarker(out, 0xc4, 2 + nbTables * (2 * 17 + 12 + 162));  // DHT
+  writeHuffman(0x00, kDcLumBits, kDcValues, 12);
+  writeHuffman(0x10, kAcLumBits, kAcLumValues, 162);
+  if(color)
+  {
+    writeHuffman(0x01, kDcChromaBits, kDcValues, 12);
+    writeHuffman(0x11, kAcChromaBits, kAcChromaValues, 162);
+  }
+
+  writeMarker(out, 0xdd, 4);  // DRI
+  writeU16(out, mcusX * mcuRowsPerStrip);
+
+  writeMarker(out, 0xda, 6 + 2 * nbComps);  // SOS
+  out.push_back(static_cast<uint8_t>(nbComps));
+  for(uint32_t c = 0; c < nbComps; c++)
+    out.insert(out.end(), {static_cast<uint8_t>(c + 1), static_cast<uint8_t>(c == 0 ? 0x00 : 0x11)});
+  out.insert(out.end(), {0, 63, 0});  // Spectral selection, successive approximation
+
+  // Restart intervals
+  size_t total = out.size() + 2 * strips + 2;
+  for(const auto& d : data)
+    total += d.size();
+  out.reserve(total);
+  for(uint32_t s = 0; s < strips; s++)
+  {
+    if(s > 0)
+      out.insert(out.end(), {0xff, static_cast<uint8_t>(0xd0 + ((s - 1) & 7))});  // RSTn
+    out.insert(out.end(), data[s].begin(), data[s].end());
+  }
+  out.insert(out.end(), {0xff, 0xd9});  // EOI
+  return true;
+}
+
+}  // namespace ldr
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Encoders of 8-bit images (interleaved channels, rows from top to bottom) for the deliverables.
+// The image is split in strips of rows which are compressed in parallel and stitched together:
+//
+// - PNG: each strip is filtered and deflated independently (raw deflate ending with a sync flush),
+//   the streams are concatenated in one zlib stream and their Adler-32 combined. Without zlib the
+//   data is stored uncompressed.
+// - JPEG: baseline, standard Huffman tables. The strips are restart intervals, each one is encoded
+//   on its own and they are joined with RSTn markers.
+//
+namespace ldr {
+
+// `level` is the zlib level: 0 (stored) to 9 (smallest). Up to level 2, the rows use the Up filter
+// instead of testing the five filters, which is several times faster.
+bool encodePng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, int level, std::vector<uint8_t>& out);
+
+// `quality` from 1 to 100, the quantization tables are scaled as libjpeg does. Below 90 the chroma
+// is subsampled 2x2 (4:2:0). Grey and grey-alpha images are encoded with one component, alpha is dropped.
+bool encodeJpeg(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, int quality, std::vector<uint8_t>& out);
+
+}  // namespace ldr
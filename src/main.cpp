@@ -18,6 +18,9 @@
  */
 
 
+#include <cstdio>
+#include <map>
+#include <sstream>
 #include <thread>
 
 #include "nvh/cameramanipulator.hpp"
@@ -26,6 +29,7 @@
 #include "nvvk/context_vk.hpp"
 #include "nvvk/structs_vk.hpp"            // For nvvk::make
 #include "sample_example.hpp"
+#include "tools.hpp"
 
 // Default search path for shaders
 std::vector<std::string> defaultSearchPaths;
@@ -44,10 +48,156 @@ int main(int argc, char** argv)
   InputParser parser(argc, argv);
   std::string sceneFile   = parser.getString("-f", "robot_toon/robot-toon.gltf");
   std::string hdrFilename = parser.getString("-e", "std_env.hdr");
-  int samples             = std::stoi(parser.getString("-s", "64"));
+  int samples             = std::stoi(parser.getString("-s", "64"));  // Samples per pixel, in passes of -passsamples
+  int passSamples         = std::max(1, std::min(samples, std::stoi(parser.getString("-passsamples", "4"))));
+  std::string envSampling = parser.getString("-envsampling", "alias");  // alias | mip
+  float envMisComp        = std::stof(parser.getString("-envmiscomp", "0"));  // fraction of the average radiance, 0: off
+  bool sunAndSky          = parser.exist("-sunsky");  // Sun & Sky instead of the HDR image
+  int shDepth             = std::stoi(parser.getString("-shdepth", "0"));  // SH irradiance fallback from this depth, 0: off
+  float fireflyQuantile   = std::stof(parser.getString("-fireflyquantile", "0.999"));  // Adaptive clamp, 0: from the environment
+  std::string hdrOutput   = parser.getString("-o", "");  // Accumulation buffer and AOVs: .exr | .pfm
+  std::string exrCompression = parser.getString("-exrcompression", "piz");  // none | zips | zip | piz | dwaa
+  std::string ldrOutput   = parser.getString("-ldr", "headless.ppm");  // Tonemapped image: .ppm | .png | .jpg
+  EncodeOptions ldrOptions;
+  ldrOptions.pngLevel    = std::stoi(parser.getString("-pnglevel", "6"));  // 0: fastest .. 9: smallest
+  ldrOptions.jpegQuality = std::stoi(parser.getString("-jpegquality", "90"));
+  int frames              = std::stoi(parser.getString("-frames", std::to_string((samples + passSamples - 1) / passSamples)));  // Passes
+  float convergence       = std::stof(parser.getString("-convergence", "0"));  // Stopping below this error, 0: off
+  int convergenceEvery    = std::max(2, std::stoi(parser.getString("-convergenceevery", "4")));  // Passes between estimates
+  double targetFrameMs    = std::stod(parser.getString("-targetms", "0"));  // Dynamic resolution frame time, 0: off
+  std::string checkpointFile = parser.getString("-checkpoint", "");  // Periodic save of the accumulation
+  double checkpointInterval  = std::stod(parser.getString("-checkpointinterval", "300"));  // Seconds
+  bool resume                = parser.exist("-resume");  // Continuing from the checkpoint, if it matches
+  std::string cacheDir       = parser.getString("-cache", "");  // Finished renders, reused by jobs with the same settings
+  double cacheSizeMb         = std::stod(parser.getString("-cachesize", "4096"));  // Least recently used entries are removed above it
+  std::string streamTarget   = parser.getString("-stream", "");  // Raw frames: - (stdout) | shm:<name> | <file or fifo>
+  std::string streamFormat   = parser.getString("-streamformat", "rgba");  // rgba (tonemapped) | half (accumulation)
+  bool streamHeader          = parser.exist("-streamheader");  // Header before each frame in pipes
+  int streamEvery            = std::max(1, std::stoi(parser.getString("-streamevery", "1")));  // Frames between updates
+  bool hostTonemap           = parser.exist("-hosttonemap");  // Tonemapping on the CPU, no post pass
+  bool autoExposure          = parser.exist("-autoexposure");
+  std::string tonemapInput   = parser.getString("-tonemap", "");  // Only tonemapping this HDR image to -ldr, no GPU
+  bool relightGroups         = parser.exist("-relight");  // Light groups written next to -o, see relight.hpp
+  std::string relightInput   = parser.getString("-relightfrom", "");  // Only summing the light groups of this -o, no GPU
+  std::string lightScales    = parser.getString("-lightscales", "");  // Scale of the groups: "sun=2;lights0_indirect=1,0.5,0.5"
+  std::string lightSets      = parser.getString("-lightsets", "");  // Set of each punctual light: 0,0,1,2
+  uint32_t width             = std::stoi(parser.getString("-width", std::to_string(SAMPLE_WIDTH)));
+  uint32_t height            = std::stoi(parser.getString("-height", std::to_string(SAMPLE_HEIGHT)));
+  uint32_t tileSize          = std::stoi(parser.getString("-tile", "0"));  // Tiled rendering to the -o EXR, 0: off
+  std::string sampleMask     = parser.getString("-samplemask", "");  // Importance image, more samples where it is 1
+  std::string roiInstances   = parser.getString("-roiinstances", "");  // Or glTF nodes getting more samples: 1,4,7
+  float roiRatio             = std::stof(parser.getString("-roiratio", "16"));  // Samples in the region / outside
+  std::string jobFile        = parser.getString("-job", "");  // JSON batch of renders of the scene, see RenderJob
+  std::string thumbnailFile  = parser.getString("-thumbnails", "");  // JSON thumbnails rendered as an atlas, see ThumbnailFarm
+  std::string cameraPathFile = parser.getString("-camerapath", "");  // JSON sequence, see CameraPath
+  std::string frameRange     = parser.getString("-range", "");  // first:last frames of the camera path, default: all
+  std::string stagesFile     = parser.getString("-stages", "");  // JSON time of the stages of the run, see stage_times.hpp
+  std::string predictFile    = parser.getString("-predict", "");  // JSON time and memory of the render, from a probe. - for stdout
+  int probeFrames            = std::stoi(parser.getString("-probeframes", "8"));  // Frames of -passsamples in the probe
+  float probeLevel           = std::stof(parser.getString("-probelevel", "4"));  // Probe at 1/level of the width and height
+
+  // Tonemapping an image on the host, without Vulkan
+  if(!tonemapInput.empty())
+  {
+    FloatImage hdr;
+    if(!imageio::loadRgb(tonemapInput, hdr))
+      return 1;
+    Tonemapper tm   = RenderOutput().m_tonemapper;
+    tm.autoExposure = autoExposure ? 1 : 0;
+
+    OutputImage image;
+    image.width    = hdr.width;
+    image.height   = hdr.height;
+    image.channels = 3;
+    HostTonemapper().run(hdr, tm, image.channels, image.ldr);
+    ImageWriter writer;
+    writer.push(ldrOutput, std::move(image), ldrOptions);
+    return writer.wait() ? 0 : 1;
+  }
+
+  // Relighting from the light groups of a previous render, without Vulkan
+  if(!relightInput.empty())
+  {
+    relight::Scales scales;
+    FloatImage      hdr;
+    if(!relight::parseScales(lightScales, scales) || !relight::combine(relightInput, scales, hdr))
+      return 1;
+    Tonemapper tm   = RenderOutput().m_tonemapper;
+    tm.autoExposure = autoExposure ? 1 : 0;
+
+    OutputImage image;
+    image.width    = hdr.width;
+    image.height   = hdr.height;
+    image.channels = 3;
+    HostTonemapper().run(hdr, tm, image.channels, image.ldr);
+    ImageWriter writer;
+    writer.push(ldrOutput, std::move(image), ldrOptions);
+    if(!hdrOutput.empty())
+    {
+      OutputImage relit;
+      relit.width    = hdr.width;
+      relit.height   = hdr.height;
+      relit.channels = 3;
+      relit.hdr      = std::move(hdr.pixels);
+      writer.push(hdrOutput, std::move(relit));
+    }
+    return writer.wait() ? 0 : 1;
+  }
+  if(relightGroups && hdrOutput.empty())
+  {
+    LOGE("-relight writes the light groups next to the -o image\n");
+    return 1;
+  }
+  if(relightGroups && (resume || !cacheDir.empty()))
+  {
+    LOGW("The light groups are not in checkpoints, -resume and -cache are not used with -relight\n");
+    resume = false;
+    cacheDir.clear();
+  }
+
+  // Batch of renders, the command line settings are the defaults
+  std::vector<RenderJob> jobs;
+  if(!jobFile.empty())
+  {
+    RenderJob defaults;
+    defaults.width       = width;
+    defaults.height      = height;
+    defaults.samples     = passSamples;
+    defaults.frames      = frames;
+    defaults.convergence = convergence;
+    if(!loadRenderJobs(jobFile, defaults, jobs))
+      return 1;
+  }
+
+  // Thumbnails, -passsamples and -frames are the defaults
+  ThumbnailFarm thumbnails;
+  if(!thumbnailFile.empty())
+  {
+    ThumbnailFarm defaults;
+    defaults.samples = passSamples;
+    defaults.frames  = frames;
+    if(!loadThumbnails(thumbnailFile, defaults, thumbnails))
+      return 1;
+  }
+
+  // Sequence, -ldr and -o are the names of the frames (frame_%04d.png)
+  CameraPath cameraPath;
+  int        firstFrame = 0, lastFrame = 0;
+  if(!cameraPathFile.empty())
+  {
+    if(!cameraPath.load(cameraPathFile))
+      return 1;
+    firstFrame = cameraPath.firstFrame();
+    lastFrame  = cameraPath.lastFrame();
+    if(!frameRange.empty() && sscanf(frameRange.c_str(), "%d:%d", &firstFrame, &lastFrame) != 2)
+    {
+      LOGE("Invalid frame range %s, expecting first:last\n", frameRange.c_str());
+      return 1;
+    }
+  }
 
   // Setup camera
-  CameraManip.setWindowSize(SAMPLE_WIDTH, SAMPLE_HEIGHT);
+  CameraManip.setWindowSize(width, height);
   CameraManip.setLookat({2.0, 2.0, -5.0}, {-1.0, 2.0, -1.0}, {0.000, 1.000, 0.000});
 
   // Setup logging file
@@ -81,6 +231,7 @@ int main(int argc, char** argv)
   contextInfo.addDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME, true, &rayQueryFeatures);  // Optional extension
   contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
   contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+  contextInfo.addDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, true);  // Optional, memory of the prediction
 
   // Extra queues for parallel load/build
   contextInfo.addRequestedQueue(contextInfo.defaultQueueGCT, 1, 1.0f);  // Loading scene - mipmap generation
@@ -112,6 +263,7 @@ int main(int argc, char** argv)
   //
   SampleExample sample;
   sample.supportRayQuery(vkctx.hasDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME));
+  sample.m_memoryBudget = vkctx.hasDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
   // Collecting all the Queues the sample will need.
   // - 3 default queues are created, but need extra for load/generate mip-maps
@@ -127,15 +279,28 @@ int main(int argc, char** argv)
   queues.push_back({vkctx.m_queueT.queue, vkctx.m_queueT.familyIndex, vkctx.m_queueT.queueIndex});
 
   // Create example
-  sample.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, queues, SAMPLE_WIDTH, SAMPLE_HEIGHT);
+  // When rendering tiles, the buffers are only the size of a tile
+  const bool     tiled        = tileSize > 0;
+  const uint32_t bufferWidth  = tiled ? std::min(tileSize, std::max(width, height)) : width;
+  const uint32_t bufferHeight = tiled ? bufferWidth : height;
+  sample.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, queues, bufferWidth, bufferHeight);
   sample.createColorBuffer();
   sample.createDepthBuffer();
   sample.createRenderPass();
   sample.createFrameBuffer();
+  sample.m_offscreen.m_relight = relightGroups;
   sample.createOffscreenRender();
   
   // Creation of the example - loading scene in separate thread
-  sample.loadEnvironmentHdr(nvh::findFile(hdrFilename, defaultSearchPaths, true));
+  sample.m_skydome.setSamplingMode(envSampling == "mip" ? eEnvMipPyramid : eEnvAliasMap);
+  sample.m_skydome.setMisCompensation(envMisComp);
+  if(sunAndSky)
+    sample.loadSunAndSky();
+  else
+    sample.loadEnvironmentHdr(nvh::findFile(hdrFilename, defaultSearchPaths, true));
+  std::stringstream lightSetList(lightSets);
+  for(std::string item; std::getline(lightSetList, item, ',');)
+    sample.m_scene.m_lightSets.push_back(std::stoi(item));
   std::thread([&] {
     sample.loadScene(nvh::findFile(sceneFile, defaultSearchPaths, true));
     sample.createUniformBuffer();
@@ -144,60 +309,194 @@ int main(int argc, char** argv)
     sample.resetFrame();
   }).join();
 
-  sample.m_rtxState.maxSamples = samples;
+  sample.m_rtxState.maxSamples = passSamples;
+  sample.m_rtxState.relight    = relightGroups ? 1 : 0;
+  sample.m_convergenceTarget = convergence;
+  sample.m_convergenceEvery = convergenceEvery;
+  if(targetFrameMs > 0.)
+  {
+    // Only the tonemapped framebuffer is upscaled, the accumulation has the reduced resolution
+    if(hostTonemap || !hdrOutput.empty() || streamFormat == "half")
+      LOGW("Dynamic resolution: the accumulation buffer (-o, -hosttonemap, -streamformat half) is not upscaled\n");
+    sample.m_dynamicResolution.m_maxSamples = passSamples;
+    sample.m_dynamicResolution.setTarget(targetFrameMs, passSamples);
+  }
   sample.m_rtxState.maxDepth = 10;
-  sample.setRenderRegion({{0, 0},{SAMPLE_WIDTH, SAMPLE_HEIGHT}});
+  sample.m_rtxState.shDepth = shDepth;
+  sample.m_fireflyClamp.m_quantile = fireflyQuantile;
+  sample.m_hostTonemap = hostTonemap;
+  sample.m_offscreen.m_tonemapper.autoExposure = autoExposure ? 1 : 0;
+  sample.setRenderRegion({{0, 0},{bufferWidth, bufferHeight}});
 
   // Profiler measure the execution time on the GPU
   nvvk::ProfilerVK profiler;
   std::string      profilerStats;
   profiler.init(vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
   profiler.setLabelUsage(true);  // depends on VK_EXT_debug_utils
-  profiler.beginFrame();  // GPU performance timer
-
-  // Start command buffer
-  sample.createCommandBuffer();
-  const VkCommandBuffer& cmdBuf   = sample.getCommandBuffer();
-
-  sample.updateUniformBuffer(cmdBuf);  // Updating UBOs
 
-  // Rendering Scene (ray tracing)
-  sample.renderScene(cmdBuf, profiler);
-
-  // Rendering pass in swapchain framebuffer + tone mapper, UI
+  const std::map<std::string, imageio::ExrCompression> compressions{
+      {"none", imageio::ExrCompression::eNone}, {"zips", imageio::ExrCompression::eZips},
+      {"zip", imageio::ExrCompression::eZip},   {"piz", imageio::ExrCompression::ePiz},
+      {"dwaa", imageio::ExrCompression::eDwaa},
+  };
+  auto it = compressions.find(exrCompression);
+  if(it == compressions.end())
+    LOGE("Unknown EXR compression %s, using PIZ\n", exrCompression.c_str());
+  const imageio::ExrCompression compression = it != compressions.end() ? it->second : imageio::ExrCompression::ePiz;
+
+  // Raw frames of the single image, or one per frame of a -camerapath sequence. The other modes
+  // render images of other sizes.
+  if(!streamTarget.empty() && (!predictFile.empty() || !jobFile.empty() || !thumbnailFile.empty() || tiled))
+    LOGW("-stream is only used for a single image or a -camerapath sequence\n");
+  else if(!streamTarget.empty())
+    sample.m_frameStream.open(streamTarget, streamFormat == "half" ? StreamFormat::eRgba16f : StreamFormat::eRgba8,
+                              width, height, streamHeader);
+
+  if(!predictFile.empty())
   {
-    auto sec = profiler.timeRecurring("Tonemap", cmdBuf);
-
-    std::array<VkClearValue, 2> clearValues;
-    clearValues[0].color        = {{0.0f, 0.0f, 0.0f, 0.0f}};
-    clearValues[1].depthStencil = {1.0f, 0};
-
-    VkRenderPassBeginInfo postRenderPassBeginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-    postRenderPassBeginInfo.clearValueCount = 2;
-    postRenderPassBeginInfo.pClearValues    = clearValues.data();
-    postRenderPassBeginInfo.renderPass      = sample.getRenderPass();
-    postRenderPassBeginInfo.framebuffer     = sample.getFramebuffer();
-    postRenderPassBeginInfo.renderArea      = {{}, sample.getSize()};
-
-    vkCmdBeginRenderPass(cmdBuf, &postRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    // Draw the rendering result + tonemapper
-    sample.drawPost(cmdBuf);
-
-    vkCmdEndRenderPass(cmdBuf);
-  }  
-
-  profiler.endFrame();
-
-  vkEndCommandBuffer(cmdBuf);
-  sample.submitWork(cmdBuf);
-  vkDeviceWaitIdle(sample.getDevice());
-  sample.dumpImage();
-  
+    // Only the prediction of the render the other options describe
+    PredictionTarget target;
+    target.width      = width;
+    target.height     = height;
+    target.samples    = passSamples;
+    target.frames     = frames;
+    target.error      = convergence;
+    target.errorEvery = convergenceEvery;
+    target.hdrOutput  = !hdrOutput.empty();
+    RenderProbe probe = sample.runProbe(probeFrames, probeLevel, profiler);
+    writePrediction(predictFile, probe, target, predictRender(probe, target));
+  }
+  else if(!jobFile.empty())
+  {
+    for(size_t i = 0; i < jobs.size(); i++)
+    {
+      LOGI("Render %zu/%zu\n", i + 1, jobs.size());
+      sample.renderJob(jobs[i], profiler, ldrOptions, compression);
+    }
+  }
+  else if(!thumbnailFile.empty())
+  {
+    sample.renderThumbnails(thumbnails, profiler, ldrOptions, compression);
+  }
+  else if(!cameraPathFile.empty())
+  {
+    sample.renderSequence(cameraPath, firstFrame, lastFrame, frames, ldrOutput, hdrOutput, profiler, ldrOptions, compression);
+  }
+  else if(tiled)
+  {
+    // Images of any size: only the tiled OpenEXR is written, there is no full frame to tonemap
+    if(hdrOutput.size() < 4 || hdrOutput.substr(hdrOutput.size() - 4) != ".exr")
+      LOGE("Tiled rendering needs an OpenEXR output (-o image.exr)\n");
+    else
+      sample.renderTiled(hdrOutput, width, height, frames, profiler, compression);
+  }
+  else
+  {
+    // The settings changing the image, a checkpoint is only resumed with the same ones
+    std::string jobSettings = sceneFile + "|" + (sunAndSky ? std::string("sunsky") : hdrFilename) + "|" + envSampling + "|"
+                              + std::to_string(envMisComp) + "|" + std::to_string(passSamples) + "|" + std::to_string(shDepth)
+                              + "|" + std::to_string(width) + "x" + std::to_string(height);
+    jobSettings += "|" + sampleMask + "|" + roiInstances + "|" + std::to_string(roiRatio) + "|" + std::to_string(fireflyQuantile);
+    uint64_t jobKey = checkpoint::makeJobKey(jobSettings);
+
+    // Region of interest, the samples of each pixel are in the "samples" channel of -o. The mask
+    // is at full resolution, it would not match the buffers descaled by -targetms.
+    if((!sampleMask.empty() || !roiInstances.empty()) && targetFrameMs > 0.)
+      LOGW("The sample mask is not used with -targetms, the resolution changes during the rendering\n");
+    else if(!sampleMask.empty())
+    {
+      FloatImage mask;
+      if(imageio::loadRgb(sampleMask, mask))
+        sample.setSampleMask(samplemask::fromImage(mask, width, height, roiRatio));
+    }
+    else if(!roiInstances.empty())
+    {
+      std::vector<int>  instances;
+      std::stringstream list(roiInstances);
+      for(std::string item; std::getline(list, item, ',');)
+        instances.push_back(std::stoi(item));
+      sample.sampleMaskFromInstances(instances, roiRatio, profiler);
+    }
+    // A cached result is only tonemapped, or continued when it has fewer frames and is not converged
+    uint64_t    cacheKey = 0;
+    std::string cacheFile;
+    bool        cached = false;
+    if(!cacheDir.empty() && targetFrameMs > 0.)
+      LOGW("The render cache is not used with -targetms, the resolution changes during the rendering\n");
+    else if(!cacheDir.empty() && sample.m_renderCache.open(cacheDir, uint64_t(cacheSizeMb * 1024.0 * 1024.0)))
+    {
+      // Inputs that cannot be hashed have no key, rendering without the cache
+      uint64_t contentHash = rendercache::kHashSeed;
+      bool     hashed      = rendercache::hashScene(nvh::findFile(sceneFile, defaultSearchPaths, true), contentHash);
+      if(hashed && !sunAndSky)
+        hashed = rendercache::hashFile(nvh::findFile(hdrFilename, defaultSearchPaths, true), contentHash);
+      if(!hashed)
+        LOGW("The render cache is not used, the scene or the environment cannot be hashed\n");
+      else
+      {
+        cacheKey  = sample.renderCacheKey(contentHash, jobSettings);
+        cacheFile = sample.m_renderCache.filename(cacheKey);
+        cached    = sample.m_renderCache.contains(cacheKey) && sample.loadCheckpoint(cacheFile, cacheKey);
+      }
+    }
+    const int cachedFrame = sample.m_rtxState.frame;
+    bool      restored    = cached;
+    if(!cached && resume && !checkpointFile.empty())
+      restored = sample.loadCheckpoint(checkpointFile, jobKey);
+
+    // A restored result that stopped on the convergence target already meets it: the render of
+    // an exact repeat is the cached one
+    bool converged = restored && sample.m_convergenceTarget > 0.f && sample.convergenceError().max < sample.m_convergenceTarget;
+
+    // Accumulating the frames, saving the checkpoint every `checkpointInterval` seconds
+    // Passes of `passSamples` until `frames` or the convergence target. A finished checkpoint is only tonemapped.
+    MilliTimer checkpointTimer;
+    MilliTimer renderTimer;
+    sample.m_maxFrames = converged ? sample.m_rtxState.frame + 1 : frames;
+    if(converged)
+    {
+      LOGI("Restored render at frame %d is converged\n", sample.m_rtxState.frame);
+      sample.renderFrame(profiler);  // Only the tonemapping
+      sample.streamFrame();
+    }
+    else
+    {
+      do
+      {
+        MilliTimer frameTimer;
+        sample.renderFrame(profiler);
+        sample.updateDynamicResolution(frameTimer.elapsed());
+        converged = sample.checkConvergence();
+        // Progressive updates, and the final frame
+        if((sample.m_rtxState.frame + 1) % streamEvery == 0 || sample.m_rtxState.frame + 1 >= frames || converged)
+          sample.streamFrame();
+        if(!checkpointFile.empty() && checkpointTimer.elapsed() > checkpointInterval * 1000.0)
+        {
+          sample.saveCheckpoint(checkpointFile, jobKey);
+          checkpointTimer.reset();
+        }
+      } while(!converged && sample.m_rtxState.frame + 1 < frames);
+    }
+    stages::record("render", renderTimer.elapsed());
+    if(!checkpointFile.empty())
+      sample.saveCheckpoint(checkpointFile, jobKey);
+    if(!cacheFile.empty() && sample.m_rtxState.frame > cachedFrame)
+      sample.saveCheckpoint(cacheFile, cacheKey);
+
+    vkDeviceWaitIdle(sample.getDevice());
+    sample.dumpImage(ldrOutput, ldrOptions);
+    if(!hdrOutput.empty())
+      sample.saveImageHdr(hdrOutput, compression);
+    if(relightGroups)
+      sample.saveRelight(hdrOutput, compression);
+  }
 
   // Cleanup
+  sample.m_frameStream.close();
   vkDeviceWaitIdle(sample.getDevice());
-  sample.destroyResources();
+  sample.destroyResources();  // Waiting for the images being written
+  if(!stagesFile.empty())
+    stages::writeJson(stagesFile);
   sample.destroy();
   profiler.deinit();
   vkctx.deinit();
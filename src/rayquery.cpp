@@ -87,7 +87,7 @@ void RayQuery::create(const VkExtent2D& size, const std::vector<VkDescriptorSetL
 
   m_debug.setObjectName(m_pipeline, "RayQuery");
   vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
-  timer.print();
+  timer.print("pipeline");
 }
 
 
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+
+#include "nvh/nvprint.hpp"
+#include "relight.hpp"
+#include "tools.hpp"
+
+namespace relight {
+
+std::string groupName(uint32_t group)
+{
+  switch(group)
+  {
+    case eLightGroupEnvironment:
+      return "environment";
+    case eLightGroupSun:
+      return "sun";
+    case eLightGroupEmissive:
+      return "emissive";
+    default:
+      return "lights" + std::to_string(group - eLightGroupPunctual);
+  }
+}
+
+std::string layerName(uint32_t layer)
+{
+  if(layer < eLightGroupCount)
+    return groupName(layer) + "_direct";
+  return groupName(layer - eLightGroupCount) + "_indirect";
+}
+
+std::string layerFilename(const std::string& filename, uint32_t layer)
+{
+  const size_t dot = filename.find_last_of('.');
+  if(dot == std::string::npos || filename.find_first_of("/\\", dot) != std::string::npos)
+    return filename + "_" + layerName(layer);
+  return filename.substr(0, dot) + "_" + layerName(layer) + filename.substr(dot);
+}
+
+bool parseScales(const std::string& text, Scales& scales)
+{
+  scales.fill(nvmath::vec3f(1.f));
+
+  std::stringstream list(text);
+  for(std::string item; std::getline(list, item, ';');)
+  {
+    if(item.empty())
+      continue;
+    const size_t equal = item.find('=');
+    const std::string name = item.substr(0, equal);
+
+    // A group, both of its layers, or a single layer
+    std::vector<uint32_t> layers;
+    for(uint32_t g = 0; g < eLightGroupCount; g++)
+      if(groupName(g) == name)
+        layers = {g, g + eLightGroupCount};
+    for(uint32_t l = 0; l < eRelightLayerCount; l++)
+      if(layerName(l) == name)
+        layers = {l};
+    if(equal == std::string::npos || layers.empty())
+    {
+      LOGE("Unknown light group in %s\n", item.c_str());
+      return false;
+    }
+
+    float rgb[3];
+    int   count = sscanf(item.c_str() + equal + 1, "%f,%f,%f", &rgb[0], &rgb[1], &rgb[2]);
+    if(count != 1 && count != 3)
+    {
+      LOGE("Invalid scale in %s, expecting a value or r,g,b\n", item.c_str());
+      return false;
+    }
+    for(uint32_t l : layers)
+      scales[l] = count == 1 ? nvmath::vec3f(rgb[0]) : nvmath::vec3f(rgb[0], rgb[1], rgb[2]);
+  }
+  return true;
+}
+
+bool combine(const std::string& filename, const Scales& scales, FloatImage& result)
+{
+  MilliTimer timer;
+  result        = {};
+  uint32_t used = 0;
+  for(uint32_t g = 0; g < eRelightLayerCount; g++)
+  {
+    const std::string layerFile = layerFilename(filename, g);
+    std::error_code   ec;
+    if(!std::filesystem::exists(layerFile, ec))
+      continue;
+
+    FloatImage layer;
+    if(!imageio::loadRgb(layerFile, layer))
+      return false;
+    if(used == 0)
+    {
+      result.width    = layer.width;
+      result.height   = layer.height;
+      result.channels = 3;
+      result.pixels.assign(size_t(layer.width) * layer.height * 3, 0.f);
+    }
+    else if(layer.width != result.width || layer.height != result.height)
+    {
+      LOGE("%s is %ux%u, expecting %ux%u\n", layerFile.c_str(), layer.width, layer.height, result.width, result.height);
+      return false;
+    }
+
+    const nvmath::vec3f scale = scales[g];
+    parallelRanges(result.height, [&](uint64_t begin, uint64_t end) {
+      for(size_t i = begin * result.width; i < end * result.width; i++)
+        for(uint32_t c = 0; c < 3; c++)
+          result.pixels[i * 3 + c] += layer.pixels[i * 3 + c] * scale[c];
+    });
+    used++;
+  }
+
+  if(used == 0)
+  {
+    LOGE("No light layer of %s\n", filename.c_str());
+    return false;
+  }
+  LOGI("Relighting %u light layers of %s (%.3f ms)\n", used, filename.c_str(), timer.elapsed());
+  return true;
+}
+
+}  // namespace relight
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "image_io.hpp"
+#include "shaders/host_device.h"
+
+//--------------------------------------------------------------------------------------------------
+// Relighting without rendering: with -relight, the radiance of each light group (see LightGroups)
+// is written as two images next to the output, its direct and its indirect light
+// (image_sun_direct.exr, image_sun_indirect.exr, image_lights0_direct.exr, ...). The color is their
+// sum, changing the intensity or color of a group is scaling its images. Direct light reaches the
+// first hit without bouncing, or the camera: the split allows grading the bounce light apart.
+//
+// Scales are "name=s" or "name=r,g,b" separated by ';', the layers not listed keep 1. A group name
+// scales both of its layers, "group_direct" and "group_indirect" only one:
+//   "sun=2;lights1=1,0.8,0.6;environment_indirect=0"
+//
+namespace relight {
+
+using Scales = std::array<nvmath::vec3f, eRelightLayerCount>;
+
+// environment, sun, emissive, lights0 .. lights3
+std::string groupName(uint32_t group);
+
+// Group name with _direct or _indirect, `layer` below eRelightLayerCount
+std::string layerName(uint32_t layer);
+
+// `filename` with the name of the layer before the extension
+std::string layerFilename(const std::string& filename, uint32_t layer);
+
+// Returns false and logs the error for an unknown group or layer, or an invalid scale
+bool parseScales(const std::string& text, Scales& scales);
+
+// Sum of the layers of `filename` with their scales, RGB. Missing layers are black.
+bool combine(const std::string& filename, const Scales& scales, FloatImage& result);
+
+}  // namespace relight
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvh/nvprint.hpp"
+#include "render_cache.hpp"
+
+namespace fs = std::filesystem;
+using json   = nlohmann::json;
+
+namespace {
+const char* kExtension = ".vkrtcache";
+}
+
+
+bool RenderCache::open(const std::string& directory, uint64_t maxBytes)
+{
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+  if(ec)
+  {
+    LOGE("Cannot create the render cache %s\n", directory.c_str());
+    m_directory.clear();
+    return false;
+  }
+  m_directory = directory;
+  m_maxBytes  = maxBytes;
+  trim();
+  return true;
+}
+
+std::string RenderCache::filename(uint64_t key) const
+{
+  char name[32];
+  snprintf(name, sizeof(name), "%016" PRIx64, key);
+  return (fs::path(m_directory) / (std::string(name) + kExtension)).string();
+}
+
+bool RenderCache::contains(uint64_t key) const
+{
+  std::error_code ec;
+  const fs::path  path = filename(key);
+  if(!enabled() || !fs::is_regular_file(path, ec))
+    return false;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Removing the entries the longest unused (oldest modification time) until the size is below
+// m_maxBytes
+//
+void RenderCache::trim()
+{
+  struct Entry
+  {
+    fs::path           path;
+    uint64_t           size;
+    fs::file_time_type time;
+  };
+  std::vector<Entry> entries;
+  uint64_t           total = 0;
+  std::error_code    ec;
+  for(const auto& file : fs::directory_iterator(m_directory, ec))
+  {
+    if(!file.is_regular_file(ec) || file.path().extension() != kExtension)
+      continue;
+    entries.push_back({file.path(), file.file_size(ec), file.last_write_time(ec)});
+    total += entries.back().size;
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+  size_t removed = 0;
+  for(const auto& entry : entries)
+  {
+    if(total <= m_maxBytes)
+      break;
+    if(fs::remove(entry.path, ec))
+    {
+      total -= entry.size;
+      removed++;
+    }
+  }
+  LOGI("Render cache %s: %zu entries, %.1f MB\n", m_directory.c_str(), entries.size() - removed, total / (1024.0 * 1024.0));
+}
+
+
+namespace rendercache {
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+  constexpr uint64_t prime = 1099511628211ull;
+  const uint8_t*     bytes = static_cast<const uint8_t*>(data);
+
+  size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for(; i < size; i++)
+    hash = (hash ^ bytes[i]) * prime;
+  return hash;
+}
+
+bool hashFile(const std::string& filename, uint64_t& hash)
+{
+  FILE* f = fopen(filename.c_str(), "rb");
+  if(f == nullptr)
+  {
+    LOGW("Cannot read %s for the render cache key\n", filename.c_str());
+    return false;
+  }
+
+  std::vector<uint8_t> buffer(size_t(1) << 20);
+  size_t               read;
+  while((read = fread(buffer.data(), 1, buffer.size(), f)) > 0)
+    hash = hashBytes(buffer.data(), read, hash);
+  const bool valid = ferror(f) == 0;
+  fclose(f);
+  if(!valid)
+    LOGW("Error reading %s for the render cache key\n", filename.c_str());
+  return valid;
+}
+
+bool hashScene(const std::string& filename, uint64_t& hash)
+{
+  if(!hashFile(filename, hash))
+    return false;
+  if(fs::path(filename).extension() != ".gltf")
+    return true;
+
+  // External buffers and images, embedded data is already in the file
+  try
+  {
+    std::ifstream  file(filename);
+    json           root = json::parse(file);
+    const fs::path base = fs::path(filename).parent_path();
+    for(const char* list : {"buffers", "images"})
+    {
+      if(!root.contains(list))
+        continue;
+      for(const json& item : root[list])
+      {
+        const std::string uri = item.value("uri", std::string());
+        if(!uri.empty() && uri.compare(0, 5, "data:") != 0 && !hashFile((base / uri).string(), hash))
+          return false;
+      }
+    }
+  }
+  catch(const std::exception& e)
+  {
+    LOGW("Render cache: cannot parse %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace rendercache
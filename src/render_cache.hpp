@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+// Cache of finished renders, to answer repeated jobs without rendering them again.
+//
+// A result is a Checkpoint (see checkpoint.hpp) named after the hash of everything changing the
+// accumulation: scene and environment content, camera, RtxState, SunAndSky and the other render
+// settings. The Tonemapper is not part of it, a tonemap-only change reuses the result as it is.
+// A cached result with fewer frames than asked is continued, then replaces the entry, unless it
+// already meets the convergence target it stopped on.
+//
+// The directory is bounded: when opened, the least recently used entries are removed until it
+// fits in the size limit.
+//
+class RenderCache
+{
+public:
+  bool open(const std::string& directory, uint64_t maxBytes);
+  bool enabled() const { return !m_directory.empty(); }
+
+  std::string filename(uint64_t key) const;
+  bool        contains(uint64_t key) const;  // Also marks the entry as recently used
+
+private:
+  void trim();
+
+  std::string m_directory;
+  uint64_t    m_maxBytes{0};
+};
+
+namespace rendercache {
+
+constexpr uint64_t kHashSeed = 14695981039346656037ull;  // FNV-1a offset basis, the start of a chain
+
+// FNV-1a on 8-byte words, chained through `hash`
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kHashSeed);
+
+// Content of a file chained into `hash`. False when it cannot be read: there is no key, the cache
+// is not used rather than matching the results of other unreadable inputs.
+bool hashFile(const std::string& filename, uint64_t& hash);
+
+// Content of a scene: a .gltf with the buffers and images it references, other files as they are.
+// False when any of them cannot be read or the .gltf cannot be parsed.
+bool hashScene(const std::string& filename, uint64_t& hash);
+
+}  // namespace rendercache
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "json_utils.hpp"
+#include "nvh/nvprint.hpp"
+#include "render_job.hpp"
+#include "shaders/host_device.h"
+
+namespace {
+
+// Debug modes by name, or their DebugMode value
+int debugModeFromJson(const json& j)
+{
+  static const std::map<std::string, int> modes{
+      {"none", eNoDebug},       {"basecolor", eBaseColor}, {"normal", eNormal},   {"metallic", eMetallic},
+      {"emissive", eEmissive},  {"alpha", eAlpha},         {"roughness", eRoughness}, {"texcoord", eTexcoord},
+      {"tangent", eTangent},    {"radiance", eRadiance},   {"weight", eWeight},   {"raydir", eRayDir},
+      {"heatmap", eHeatmap},
+  };
+  if(j.is_number_integer())
+    return j.get<int>();
+  auto it = modes.find(j.get<std::string>());
+  if(it == modes.end())
+  {
+    LOGW("Unknown debug mode %s\n", j.get<std::string>().c_str());
+    return eNoDebug;
+  }
+  return it->second;
+}
+
+// The keys present in `j` override the ones of `job`
+void applyJson(const json& j, RenderJob& job)
+{
+  job.output      = j.value("output", job.output);
+  job.hdr         = j.value("hdr", job.hdr);
+  job.width       = j.value("width", job.width);
+  job.height      = j.value("height", job.height);
+  job.samples     = j.value("samples", job.samples);
+  job.frames      = j.value("frames", job.frames);
+  job.timeBudget  = j.value("time", job.timeBudget);
+  job.convergence = j.value("convergence", job.convergence);
+  job.envRotation = j.value("envRotation", job.envRotation);
+  if(j.contains("debug"))
+    job.debugMode = debugModeFromJson(j["debug"]);
+
+  if(j.contains("camera"))
+    cameraFromJson(j["camera"], job);
+}
+
+}  // namespace
+
+
+bool loadRenderJobs(const std::string& filename, const RenderJob& defaults, std::vector<RenderJob>& jobs)
+{
+  std::ifstream file(filename);
+  if(!file)
+  {
+    LOGE("Cannot open the job file %s\n", filename.c_str());
+    return false;
+  }
+
+  try
+  {
+    json root = json::parse(file);
+
+    RenderJob base = defaults;
+    if(root.contains("defaults"))
+      applyJson(root["defaults"], base);
+
+    jobs.clear();
+    for(const json& render : root.at("renders"))
+    {
+      RenderJob job = base;
+      applyJson(render, job);
+      if(job.width == 0 || job.height == 0 || job.samples < 1 || job.frames < 1)
+        throw std::runtime_error("render " + std::to_string(jobs.size()) + ": invalid size, samples or frames");
+      if(job.output.empty() && job.hdr.empty())
+        LOGW("Render %zu of %s has no output\n", jobs.size(), filename.c_str());
+      jobs.push_back(job);
+    }
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid job file %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+
+  LOGI("%zu renders in %s\n", jobs.size(), filename.c_str());
+  return true;
+}
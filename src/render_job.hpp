@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+
+//--------------------------------------------------------------------------------------------------
+// Batch of renders of the same scene, read from a JSON job file:
+//
+//  {
+//    "defaults": { "width": 1920, "height": 1080, "samples": 64 },
+//    "renders": [
+//      { "camera": 0, "output": "front.png" },
+//      { "camera": { "eye": [2, 2, -5], "center": [0, 1, 0], "up": [0, 1, 0], "fov": 45 },
+//        "time": 30, "envRotation": 90, "output": "side.jpg", "hdr": "side.exr" },
+//      { "camera": 1, "debug": "normal", "samples": 1, "output": "normals.png" }
+//    ]
+//  }
+//
+// The keys of "defaults" apply to all renders, the ones missing in both are taken from the command
+// line. "camera" is an index in the glTF cameras or an explicit one, -1 or none is the default
+// camera of the scene, the same for every job.
+// "time" is a budget in seconds and "convergence" an error target: frames are accumulated until
+// the budget is spent, the target is reached or "frames" are done.
+//
+struct RenderJob
+{
+  std::string output;  // Tonemapped image, empty: none
+  std::string hdr;     // Accumulation buffer and AOVs (.exr | .pfm), empty: none
+
+  int           cameraIndex{-1};  // In gltf.m_cameras, -1: explicit camera or the default one
+  bool          hasCamera{false};
+  nvmath::vec3f eye{0.f, 0.f, 1.f};
+  nvmath::vec3f center{0.f, 0.f, 0.f};
+  nvmath::vec3f up{0.f, 1.f, 0.f};
+  float         fov{60.f};  // Vertical, in degrees
+
+  uint32_t width{0};
+  uint32_t height{0};
+  int      samples{1};      // Samples per pixel in each frame
+  int      frames{1};       // Accumulated frames
+  double   timeBudget{0.};  // Seconds, 0: no limit
+  float    convergence{0.f};  // Error target, see estimateConvergence(), 0: off
+  int      debugMode{0};    // DebugMode
+  float    envRotation{0.f};  // Degrees around the up axis
+};
+
+// Renders of `filename`, starting from `defaults` (the command line settings)
+bool loadRenderJobs(const std::string& filename, const RenderJob& defaults, std::vector<RenderJob>& jobs);
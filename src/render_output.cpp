@@ -24,6 +24,9 @@
  */
 
 
+#include <algorithm>
+#include <cstring>
+
 #include "nvh/fileoperations.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/images_vk.hpp"
@@ -51,6 +54,8 @@ void RenderOutput::setup(const VkDevice& device, const VkPhysicalDevice& physica
 void RenderOutput::destroy()
 {
   m_pAlloc->destroy(m_offscreenColor);
+  m_pAlloc->destroy(m_offscreenAov);
+  m_pAlloc->destroy(m_offscreenRelight);
 
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
@@ -64,7 +69,7 @@ void RenderOutput::create(const VkExtent2D& size, const VkRenderPass& renderPass
   LOGI("Create Offscreen");
   createOffscreenRender(size);
   createPostPipeline(renderPass);
-  timer.print();
+  timer.print("offscreen");
 }
 
 void RenderOutput::update(const VkExtent2D& size)
@@ -81,6 +86,8 @@ void RenderOutput::createOffscreenRender(const VkExtent2D& size)
   if(m_offscreenColor.image != VK_NULL_HANDLE)
   {
     m_pAlloc->destroy(m_offscreenColor);
+    m_pAlloc->destroy(m_offscreenAov);
+    m_pAlloc->destroy(m_offscreenRelight);
   }
 
   // Creating the color image
@@ -99,11 +106,48 @@ void RenderOutput::createOffscreenRender(const VkExtent2D& size)
     m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
   }
 
+  // Creating the AOV image, only written by ray tracing and read back
+  {
+    auto aovCreateInfo = nvvk::makeImage2DCreateInfo(size, m_offscreenColorFormat,
+                                                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    aovCreateInfo.arrayLayers = eAovCount;
+
+    nvvk::Image image = m_pAlloc->createImage(aovCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo       = nvvk::makeImageViewCreateInfo(image.image, aovCreateInfo);
+    ivInfo.viewType                    = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    ivInfo.subresourceRange.layerCount = eAovCount;
+
+    m_offscreenAov                        = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenAov.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // Creating the light group image, a single texel when relighting is off
+  {
+    const VkExtent2D relightSize       = m_relight ? size : VkExtent2D{1, 1};
+    auto             relightCreateInfo = nvvk::makeImage2DCreateInfo(relightSize, m_offscreenColorFormat,
+                                                                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    relightCreateInfo.arrayLayers = relightLayers();
+
+    nvvk::Image image = m_pAlloc->createImage(relightCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo       = nvvk::makeImageViewCreateInfo(image.image, relightCreateInfo);
+    ivInfo.viewType                    = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    ivInfo.subresourceRange.layerCount = relightLayers();
+
+    m_offscreenRelight                        = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenRelight.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
   // Setting the image layout for both color and depth
   {
     nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
     auto              cmdBuf = genCmdBuf.createCommandBuffer();
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenAov.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, eAovCount});
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenRelight.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, relightLayers()});
 
     genCmdBuf.submitAndWait(cmdBuf);
   }
@@ -158,6 +202,10 @@ void RenderOutput::createPostDescriptor()
   bind.addBinding({OutputBindings::eSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT});
   bind.addBinding({OutputBindings::eStore, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
                    VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eAov, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eRelight, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
   m_postDescSetLayout = bind.createLayout(m_device);
   m_postDescPool      = bind.createPool(m_device);
   m_postDescSet       = nvvk::allocateDescriptorSet(m_device, m_postDescPool, m_postDescSetLayout);
@@ -165,6 +213,8 @@ void RenderOutput::createPostDescriptor()
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eSampler, &m_offscreenColor.descriptor));  // This is use by the tonemapper
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eStore, &m_offscreenColor.descriptor));  // This will be used by the ray trace to write the image
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eAov, &m_offscreenAov.descriptor));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eRelight, &m_offscreenRelight.descriptor));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -191,3 +241,180 @@ void RenderOutput::genMipmap(VkCommandBuffer cmdBuf)
   nvvk::cmdGenerateMipmaps(cmdBuf, m_offscreenColor.image, m_offscreenColorFormat, m_size, nvvk::mipLevels(m_size), 1,
                            VK_IMAGE_LAYOUT_GENERAL);
 }
+
+//--------------------------------------------------------------------------------------------------
+// Reading back the accumulated values, before tonemapping: the first mip level of the color and
+// all the AOV layers are copied in a host visible buffer.
+//
+void RenderOutput::readback(FloatImage& color, std::vector<FloatImage>& aovs)
+{
+  MilliTimer timer;
+  LOGI("Reading back the accumulation buffer");
+  readback(color, &aovs);
+  timer.print("readback");
+}
+
+void RenderOutput::readback(FloatImage& color)
+{
+  readback(color, nullptr);
+}
+
+void RenderOutput::readback(FloatImage& color, std::vector<FloatImage>* aovs)
+{
+  const uint32_t     nbAovs    = aovs ? eAovCount : 0;
+  const VkDeviceSize layerSize = VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  nvvk::Buffer       buffer    = m_pAlloc->createBuffer(layerSize * (1 + nbAovs), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                            | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  {
+    nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
+    auto              cmdBuf = genCmdBuf.createCommandBuffer();
+
+    // Ray tracing writes are done before the copy
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent      = {m_size.width, m_size.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_GENERAL, buffer.buffer, 1, &region);
+
+    if(nbAovs > 0)
+    {
+      region.bufferOffset     = layerSize;
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, nbAovs};
+      vkCmdCopyImageToBuffer(cmdBuf, m_offscreenAov.image, VK_IMAGE_LAYOUT_GENERAL, buffer.buffer, 1, &region);
+    }
+
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  auto setImage = [&](FloatImage& image, const float* src) {
+    image.width    = m_size.width;
+    image.height   = m_size.height;
+    image.channels = 4;
+    image.pixels.assign(src, src + layerSize / sizeof(float));
+  };
+
+  const float* data = static_cast<const float*>(m_pAlloc->map(buffer));
+  setImage(color, data);
+  if(aovs)
+  {
+    aovs->resize(nbAovs);
+    for(uint32_t i = 0; i < nbAovs; i++)
+      setImage((*aovs)[i], data + (i + 1) * (layerSize / sizeof(float)));
+  }
+  m_pAlloc->unmap(buffer);
+  m_pAlloc->destroy(buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading back the light groups, direct then indirect (RGBA each, see eRelightLayerCount), empty
+// when relighting is off
+//
+void RenderOutput::readbackRelight(std::vector<FloatImage>& groups)
+{
+  groups.clear();
+  if(!m_relight)
+    return;
+
+  const VkDeviceSize layerSize = VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  nvvk::Buffer       buffer    = m_pAlloc->createBuffer(layerSize * eRelightLayerCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                            | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  {
+    nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
+    auto              cmdBuf = genCmdBuf.createCommandBuffer();
+
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, eRelightLayerCount};
+    region.imageExtent      = {m_size.width, m_size.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, m_offscreenRelight.image, VK_IMAGE_LAYOUT_GENERAL, buffer.buffer, 1, &region);
+
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  const float* data = static_cast<const float*>(m_pAlloc->map(buffer));
+  groups.resize(eRelightLayerCount);
+  for(uint32_t g = 0; g < eRelightLayerCount; g++)
+  {
+    const float* src   = data + g * (layerSize / sizeof(float));
+    groups[g].width    = m_size.width;
+    groups[g].height   = m_size.height;
+    groups[g].channels = 4;
+    groups[g].pixels.assign(src, src + layerSize / sizeof(float));
+  }
+  m_pAlloc->unmap(buffer);
+  m_pAlloc->destroy(buffer);
+}
+
+void RenderOutput::upload(const FloatImage& color, const std::vector<FloatImage>& aovs)
+{
+  const VkDeviceSize layerSize = VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  nvvk::Buffer       buffer    = m_pAlloc->createBuffer(layerSize * (1 + eAovCount), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  // Missing AOVs are cleared
+  float* data = static_cast<float*>(m_pAlloc->map(buffer));
+  memset(data, 0, layerSize * (1 + eAovCount));
+  memcpy(data, color.pixels.data(), std::min<size_t>(layerSize, color.pixels.size() * sizeof(float)));
+  for(uint32_t i = 0; i < eAovCount && i < aovs.size(); i++)
+    memcpy(data + (i + 1) * (layerSize / sizeof(float)), aovs[i].pixels.data(),
+           std::min<size_t>(layerSize, aovs[i].pixels.size() * sizeof(float)));
+  m_pAlloc->unmap(buffer);
+
+  VkBufferImageCopy colorRegion{};
+  colorRegion.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  colorRegion.imageExtent      = {m_size.width, m_size.height, 1};
+  VkBufferImageCopy aovRegion  = colorRegion;
+  aovRegion.bufferOffset       = layerSize;
+  aovRegion.imageSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, eAovCount};
+  copyToImages(buffer.buffer, {{m_offscreenColor.image, colorRegion}, {m_offscreenAov.image, aovRegion}});
+  m_pAlloc->destroy(buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Replacing one AOV layer, RGBA
+//
+void RenderOutput::uploadAov(uint32_t layer, const FloatImage& image)
+{
+  const VkDeviceSize layerSize = VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  nvvk::Buffer       buffer    = m_pAlloc->createBuffer(layerSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  float* data = static_cast<float*>(m_pAlloc->map(buffer));
+  memset(data, 0, layerSize);
+  memcpy(data, image.pixels.data(), std::min<size_t>(layerSize, image.pixels.size() * sizeof(float)));
+  m_pAlloc->unmap(buffer);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1};
+  region.imageExtent      = {m_size.width, m_size.height, 1};
+  copyToImages(buffer.buffer, {{m_offscreenAov.image, region}});
+  m_pAlloc->destroy(buffer);
+}
+
+void RenderOutput::copyToImages(VkBuffer buffer, std::initializer_list<std::pair<VkImage, VkBufferImageCopy>> copies)
+{
+  nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
+  auto              cmdBuf = genCmdBuf.createCommandBuffer();
+  for(const auto& copy : copies)
+    vkCmdCopyBufferToImage(cmdBuf, buffer, copy.first, VK_IMAGE_LAYOUT_GENERAL, 1, &copy.second);
+
+  // The copy is done before ray tracing reads the accumulation
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  genCmdBuf.submitAndWait(cmdBuf);
+}
@@ -25,8 +25,13 @@
 
 #pragma once
 
+#include <initializer_list>
+#include <utility>
+
 #include "nvmath/nvmath.h"
 
+#include "image_io.hpp"
+
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
@@ -57,13 +62,27 @@ public:
   void run(VkCommandBuffer cmdBuf);
   void genMipmap(VkCommandBuffer cmdBuf);
 
+  // Copy of the accumulation buffer (RGBA) and of the AOV layers (RGBA each, see AovLayers)
+  void readback(FloatImage& color, std::vector<FloatImage>& aovs);
+  void readback(FloatImage& color);  // Without the AOVs
+  // Restoring them, to continue accumulating (see Checkpoint)
+  void upload(const FloatImage& color, const std::vector<FloatImage>& aovs);
+  void uploadAov(uint32_t layer, const FloatImage& image);  // One layer, RGBA
+  // Radiance by light group, direct then indirect (RGBA each, see eRelightLayerCount), when m_relight is set
+  void readbackRelight(std::vector<FloatImage>& groups);
+
+  bool m_relight{false};  // Allocating the light groups, before create() or update()
+
   VkDescriptorSetLayout getDescLayout() { return m_postDescSetLayout; }
   VkDescriptorSet       getDescSet() { return m_postDescSet; }
 
 private:
+  void readback(FloatImage& color, std::vector<FloatImage>* aovs);
+  void copyToImages(VkBuffer buffer, std::initializer_list<std::pair<VkImage, VkBufferImageCopy>> copies);
   void createOffscreenRender(const VkExtent2D& size);
   void createPostPipeline(const VkRenderPass& renderPass);
   void createPostDescriptor();
+  uint32_t relightLayers() const { return m_relight ? eRelightLayerCount : 1; }
 
   VkDescriptorPool      m_postDescPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout m_postDescSetLayout{VK_NULL_HANDLE};
@@ -71,6 +90,8 @@ private:
   VkPipeline            m_postPipeline{VK_NULL_HANDLE};
   VkPipelineLayout      m_postPipelineLayout{VK_NULL_HANDLE};
   nvvk::Texture         m_offscreenColor;
+  nvvk::Texture         m_offscreenAov;      // Array of eAovCount layers
+  nvvk::Texture         m_offscreenRelight;  // Array of eRelightLayerCount layers, or 1 texel
   //VkFormat m_offscreenColorFormat{VkFormat::eR16G16B16A16Sfloat};  // Darkening the scene over 5000 iterations
   VkFormat m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};  // Will be replaced by best supported format
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "convergence.hpp"
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvh/nvprint.hpp"
+#include "render_prediction.hpp"
+#include "shaders/host_device.h"
+
+using json = nlohmann::json;
+
+
+RenderPrediction predictRender(const RenderProbe& probe, const PredictionTarget& target)
+{
+  RenderPrediction prediction;
+  const double     probePixels  = double(probe.width) * probe.height;
+  const double     targetPixels = double(target.width) * target.height;
+  const int        probeSpp     = probe.frames * probe.samples;
+
+  // Time of a sample, and its spread over the pixels from the shader clock
+  if(probe.timedFrames > 0 && probePixels > 0.)
+    prediction.usPerSample = probe.ms * 1000. / (double(probe.timedFrames) * probe.samples * probePixels);
+
+  std::vector<float> costs;
+  costs.reserve(size_t(probePixels));
+  for(size_t i = 0; i < size_t(probePixels) && !probe.sampling.pixels.empty(); i++)
+  {
+    const float* s = &probe.sampling.pixels[i * probe.sampling.channels];
+    if(s[0] > 0.f)
+      costs.push_back(s[3] / s[0]);
+  }
+  if(!costs.empty())
+  {
+    double total = 0.;
+    for(float c : costs)
+      total += c;
+    prediction.costMean = total / double(costs.size());
+    auto quantile       = [&](double q) {
+      auto nth = costs.begin() + std::min(costs.size() - 1, size_t(q * double(costs.size())));
+      std::nth_element(costs.begin(), nth, costs.end());
+      return double(*nth);
+    };
+    prediction.costMedian = quantile(0.5);
+    prediction.costP95    = quantile(0.95);
+    prediction.costMax    = *std::max_element(costs.begin(), costs.end());
+  }
+
+  // Frames to the error target, checked every `errorEvery` frames, or all of them
+  prediction.probeError = estimateConvergence(probe.color, probe.even, probe.sampling).max;
+  prediction.frames     = std::max(1, target.frames);
+  if(target.error > 0.f && probeSpp > 0)
+  {
+    const double ratio  = double(prediction.probeError) / double(target.error);
+    const double spp    = double(probeSpp) * ratio * ratio;
+    const int    every  = std::max(2, target.errorEvery);
+    int          frames = int(std::ceil(spp / double(std::max(1, target.samples))));
+    frames              = std::max(every, (frames + every - 1) / every * every);
+    if(frames < prediction.frames)
+    {
+      prediction.frames    = frames;
+      prediction.converged = true;
+    }
+  }
+  prediction.spp = prediction.frames * std::max(1, target.samples);
+  if(probeSpp > 0)
+    prediction.error = prediction.probeError * float(std::sqrt(double(probeSpp) / double(prediction.spp)));
+
+  prediction.frameMs = prediction.usPerSample * target.samples * targetPixels / 1000.;
+  prediction.seconds = prediction.frameMs * prediction.frames / 1000.;
+
+  // The device memory does not depend on the frames. On the host: the tonemapped image read back
+  // and converted, and with an HDR output the RGBA32F color and AOVs read back, copied and packed
+  prediction.deviceBytes = probe.deviceBytes;
+  double hostPerPixel    = 8.;
+  if(target.hdrOutput)
+    hostPerPixel += 2. * 16. * (1 + eAovCount) + 12. * sizeof(float);
+  prediction.hostBytes = uint64_t(hostPerPixel * targetPixels);
+  return prediction;
+}
+
+bool writePrediction(const std::string&      filename,
+                     const RenderProbe&      probe,
+                     const PredictionTarget& target,
+                     const RenderPrediction& prediction)
+{
+  json j;
+  j["probe"]           = {{"width", probe.width},
+                          {"height", probe.height},
+                          {"frames", probe.frames},
+                          {"samples", probe.samples},
+                          {"timedFrames", probe.timedFrames},
+                          {"ms", probe.ms},
+                          {"error", prediction.probeError}};
+  j["target"]          = {{"width", target.width},
+                          {"height", target.height},
+                          {"samples", target.samples},
+                          {"frames", target.frames},
+                          {"error", target.error}};
+  j["costPerSampleUs"] = {{"wall", prediction.usPerSample},
+                          {"mean", prediction.costMean},
+                          {"median", prediction.costMedian},
+                          {"p95", prediction.costP95},
+                          {"max", prediction.costMax}};
+  j["prediction"]      = {{"frames", prediction.frames},
+                          {"spp", prediction.spp},
+                          {"error", prediction.error},
+                          {"converged", prediction.converged},
+                          {"frameMs", prediction.frameMs},
+                          {"seconds", prediction.seconds}};
+  j["memory"]          = {{"deviceBytes", prediction.deviceBytes}, {"hostBytes", prediction.hostBytes}};
+
+  if(filename == "-")
+  {
+    std::cout << j.dump(2) << std::endl;
+    return true;
+  }
+  std::ofstream file(filename);
+  file << j.dump(2) << std::endl;
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.c_str());
+    return false;
+  }
+  LOGI("Prediction written to %s: %d frames, %.1f s\n", filename.c_str(), prediction.frames, prediction.seconds);
+  return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "image_io.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Render-time prediction: a short probe (a few frames at a reduced resolution) gives the cost of a
+// sample and the noise, from which the time and memory of the full render are extrapolated.
+//
+// - Time: the cost of a sample per pixel is taken as independent of the resolution, the frames of
+//   the render take samples * pixels times that cost. The first probe frame (warm-up) is not timed.
+// - Error: the convergence error (see convergence.hpp) decreases as 1/sqrt(spp). It is measured
+//   per block of the probe image, the blocks having the same pixel count as in the full render.
+// - Memory: the probe renders in the full size buffers, the device memory it uses is the one of
+//   the render. The host memory is the read-back and the encoded outputs.
+//
+// The prediction is conservative for small probes: the GPU is less occupied at low resolution.
+//
+struct RenderProbe
+{
+  uint32_t   width{0};  // Rendered in the probe, the images are cropped to this size
+  uint32_t   height{0};
+  int        frames{0};   // Accumulated, at least 2 for the error
+  int        samples{1};  // Per pixel and frame
+  int        timedFrames{0};
+  double     ms{0.};          // Wall time of the timed frames
+  uint64_t   deviceBytes{0};  // Device local memory in use, 0: unknown (no VK_EXT_memory_budget)
+  FloatImage color;
+  FloatImage even;      // eAovEven
+  FloatImage sampling;  // eAovSampling, the time of the pixels in w
+};
+
+struct PredictionTarget
+{
+  uint32_t width{0};
+  uint32_t height{0};
+  int      samples{1};        // Per pixel and frame
+  int      frames{1};         // At most
+  float    error{0.f};        // Convergence target, stopping before `frames`. 0: off
+  int      errorEvery{4};     // Frames between convergence checks
+  bool     hdrOutput{false};  // The accumulation and AOVs are read back and written
+};
+
+struct RenderPrediction
+{
+  float    probeError{1.f};  // Convergence error of the probe, the worst block
+  double   usPerSample{0.};  // Wall time of a sample of a pixel
+  double   costMean{0.};     // Per sample of a pixel in the shader (us), relative: the pixels run in parallel
+  double   costMedian{0.};
+  double   costP95{0.};
+  double   costMax{0.};
+  int      frames{0};  // Until the frame limit or the error target
+  int      spp{0};
+  float    error{1.f};        // Expected at `spp`
+  bool     converged{false};  // The error target is reached before the frame limit
+  double   frameMs{0.};
+  double   seconds{0.};
+  uint64_t deviceBytes{0};
+  uint64_t hostBytes{0};
+};
+
+RenderPrediction predictRender(const RenderProbe& probe, const PredictionTarget& target);
+
+// Probe, target and prediction as JSON, "-" for stdout
+bool writePrediction(const std::string&      filename,
+                     const RenderProbe&      probe,
+                     const PredictionTarget& target,
+                     const RenderPrediction& prediction);
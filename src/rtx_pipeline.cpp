@@ -86,7 +86,7 @@ void RtxPipeline::create(const VkExtent2D& size, const std::vector<VkDescriptorS
 
   createPipelineLayout(rtDescSetLayouts);
   createPipeline();
-  timer.print();
+  timer.print("pipeline");
 }
 
 
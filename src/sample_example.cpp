@@ -25,7 +25,9 @@
 
 #define VMA_IMPLEMENTATION
 
-#include <fstream>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 
 #include "shaders/host_device.h"
@@ -36,6 +38,8 @@
 
 #include "nvml_monitor.hpp"
 #include "fileformats/tiny_gltf_freeimage.h"
+#include "nvh/cameramanipulator.hpp"
+#include "nvvk/commands_vk.hpp"
 
 
 #if defined(NVP_SUPPORTS_NVML)
@@ -107,9 +111,30 @@ void SampleExample::loadEnvironmentHdr(const std::string& hdrFilename)
   MilliTimer timer;
   LOGI("Loading HDR and converting %s\n", hdrFilename.c_str());
   m_skydome.loadEnvironment(hdrFilename);
-  timer.print();
+  timer.print("environment");
 
-  m_rtxState.fireflyClampThreshold = m_skydome.getIntegral() * 4.f;  // magic
+  m_rtxState.envSampling = m_skydome.getSamplingMode();
+
+  m_rtxState.fireflyClampThreshold = m_skydome.getIntegral() * 4.f;  // Without the adaptive clamp
+  m_rtxState.sunSampling           = 0;
+  m_sunAndSky.in_use               = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Using the Sun & Sky: the current parameters are baked in the environment texture and its
+// importance sampling data. Must be called again when m_sunAndSky changes.
+//
+void SampleExample::loadSunAndSky()
+{
+  MilliTimer timer;
+  LOGI("Baking Sun & Sky\n");
+  m_sunAndSky.in_use = 1;
+  m_skydome.loadSunAndSky(m_sunAndSky);
+  timer.print("environment");
+
+  m_rtxState.envSampling           = m_skydome.getSamplingMode();
+  m_rtxState.sunSampling           = m_skydome.getSunSampling();
+  m_rtxState.fireflyClampThreshold = m_skydome.getIntegral() * 4.f;  // Without the adaptive clamp
 }
 
 
@@ -119,7 +144,8 @@ void SampleExample::loadEnvironmentHdr(const std::string& hdrFilename)
 void SampleExample::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
 {
   LABEL_SCOPE_VK(cmdBuf);
-  const float aspectRatio = m_renderRegion.extent.width / static_cast<float>(m_renderRegion.extent.height);
+  const VkExtent2D& image       = m_imageSize.width > 0 ? m_imageSize : m_renderRegion.extent;
+  const float       aspectRatio = image.width / static_cast<float>(image.height);
 
   m_scene.updateCamera(cmdBuf, aspectRatio);
   vkCmdUpdateBuffer(cmdBuf, m_sunAndSkyBuffer.buffer, 0, sizeof(SunAndSky), &m_sunAndSky);
@@ -133,6 +159,14 @@ void SampleExample::resetFrame()
   m_rtxState.frame = -1;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Next frame to accumulate, also selecting the random sequence (see initRandom)
+//
+void SampleExample::updateFrame()
+{
+  m_rtxState.frame++;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Descriptors for the Sun&Sky buffer
 //
@@ -145,6 +179,11 @@ void SampleExample::createDescriptorSetLayout()
   m_bind.addBinding({EnvBindings::eSunSky, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_MISS_BIT_KHR | flags});
   m_bind.addBinding({EnvBindings::eHdr, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, flags});  // HDR image
   m_bind.addBinding({EnvBindings::eImpSamples, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});   // importance sampling
+  m_bind.addBinding({EnvBindings::eImpPyramid, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});   // importance pyramid
+  m_bind.addBinding({EnvBindings::eShIrradiance, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});  // SH irradiance
+  m_bind.addBinding({EnvBindings::eAtlasTiles, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});    // thumbnail atlas
+  m_bind.addBinding({EnvBindings::eFireflyHistogram, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});  // firefly clamp
+  m_bind.addBinding({EnvBindings::eFireflyThreshold, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});
 
 
   m_descPool = m_bind.createPool(m_device, 1);
@@ -155,9 +194,19 @@ void SampleExample::createDescriptorSetLayout()
   std::vector<VkWriteDescriptorSet> writes;
   VkDescriptorBufferInfo            sunskyDesc{m_sunAndSkyBuffer.buffer, 0, VK_WHOLE_SIZE};
   VkDescriptorBufferInfo            accelImpSmpl{m_skydome.m_accelImpSmpl.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            accelPyramid{m_skydome.m_accelPyramid.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            shIrradiance{m_skydome.m_shIrradiance.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            atlasTiles{m_atlasBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            fireflyHistogram{m_fireflyHistogram.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            fireflyThreshold{m_fireflyThreshold.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eSunSky, &sunskyDesc));
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eHdr, &m_skydome.m_texHdr.descriptor));
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eImpSamples, &accelImpSmpl));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eImpPyramid, &accelPyramid));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eShIrradiance, &shIrradiance));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eAtlasTiles, &atlasTiles));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eFireflyHistogram, &fireflyHistogram));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eFireflyThreshold, &fireflyThreshold));
 
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
@@ -169,9 +218,13 @@ void SampleExample::updateHdrDescriptors()
 {
   std::vector<VkWriteDescriptorSet> writes;
   VkDescriptorBufferInfo            accelImpSmpl{m_skydome.m_accelImpSmpl.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            accelPyramid{m_skydome.m_accelPyramid.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            shIrradiance{m_skydome.m_shIrradiance.buffer, 0, VK_WHOLE_SIZE};
 
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eHdr, &m_skydome.m_texHdr.descriptor));
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eImpSamples, &accelImpSmpl));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eImpPyramid, &accelPyramid));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eShIrradiance, &shIrradiance));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -184,6 +237,112 @@ void SampleExample::createUniformBuffer()
   m_sunAndSkyBuffer = m_alloc.createBuffer(sizeof(SunAndSky), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   NAME_VK(m_sunAndSkyBuffer.buffer);
+
+  // Placeholder until thumbnails are rendered, see uploadAtlasTiles()
+  m_atlasBuffer = m_alloc.createBuffer(sizeof(AtlasTile), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  NAME_VK(m_atlasBuffer.buffer);
+
+  createFireflyBuffers();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Buffers of the adaptive firefly clamp, for the tiles of the current size. The counts start at 0.
+//
+void SampleExample::createFireflyBuffers()
+{
+  vkDeviceWaitIdle(m_device);
+  m_alloc.destroy(m_fireflyHistogram);
+  m_alloc.destroy(m_fireflyReadback);
+  m_alloc.destroy(m_fireflyThreshold);
+  m_alloc.destroy(m_fireflyStaging);
+
+  m_fireflyClamp.setup(m_size.width, m_size.height);
+  const VkDeviceSize          countSize     = VkDeviceSize(m_fireflyClamp.tileCount()) * eFireflyBins * sizeof(uint32_t);
+  const VkDeviceSize          thresholdSize = VkDeviceSize(m_fireflyClamp.tileCount()) * sizeof(float);
+  const VkBufferUsageFlags    storage       = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  const VkMemoryPropertyFlags host          = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  m_fireflyHistogram = m_alloc.createBuffer(countSize, storage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_fireflyReadback  = m_alloc.createBuffer(countSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                            host | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  m_fireflyThreshold = m_alloc.createBuffer(thresholdSize, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_fireflyStaging   = m_alloc.createBuffer(thresholdSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, host);
+  NAME_VK(m_fireflyHistogram.buffer);
+  NAME_VK(m_fireflyReadback.buffer);
+  NAME_VK(m_fireflyThreshold.buffer);
+  NAME_VK(m_fireflyStaging.buffer);
+
+  memset(m_alloc.map(m_fireflyReadback), 0, countSize);
+  m_alloc.unmap(m_fireflyReadback);
+  {
+    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex, m_queue);
+    vkCmdFillBuffer(cmdBuf, m_fireflyHistogram.buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(cmdBuf, m_fireflyThreshold.buffer, 0, VK_WHOLE_SIZE, 0x7f7fffff);  // FLT_MAX
+  }
+
+  // Created again after a resize
+  if(m_descSet != VK_NULL_HANDLE)
+  {
+    VkDescriptorBufferInfo            fireflyHistogram{m_fireflyHistogram.buffer, 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo            fireflyThreshold{m_fireflyThreshold.buffer, 0, VK_WHOLE_SIZE};
+    std::vector<VkWriteDescriptorSet> writes;
+    writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eFireflyHistogram, &fireflyHistogram));
+    writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eFireflyThreshold, &fireflyThreshold));
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Before a frame: a new accumulation starts without statistics nor clamp, the next frames use the
+// thresholds from the counts of all the previous ones.
+//
+void SampleExample::updateFireflyClamp(const VkCommandBuffer& cmdBuf)
+{
+  m_rtxState.fireflyTiles = m_fireflyClamp.enabled() ? int(m_fireflyClamp.tilesX()) : 0;
+  if(!m_fireflyClamp.enabled())
+    return;
+
+  if(m_rtxState.frame == 0)
+  {
+    vkCmdFillBuffer(cmdBuf, m_fireflyHistogram.buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(cmdBuf, m_fireflyThreshold.buffer, 0, VK_WHOLE_SIZE, 0x7f7fffff);  // FLT_MAX
+  }
+  else
+  {
+    m_fireflyClamp.update(static_cast<const uint32_t*>(m_alloc.map(m_fireflyReadback)), m_fireflyThresholds);
+    m_alloc.unmap(m_fireflyReadback);
+    const VkDeviceSize size = m_fireflyThresholds.size() * sizeof(float);
+    memcpy(m_alloc.map(m_fireflyStaging), m_fireflyThresholds.data(), size);
+    m_alloc.unmap(m_fireflyStaging);
+    VkBufferCopy region{0, 0, size};
+    vkCmdCopyBuffer(cmdBuf, m_fireflyStaging.buffer, m_fireflyThreshold.buffer, 1, &region);
+  }
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// After a frame: the counts are copied for the host, read before the next frame
+//
+void SampleExample::readFireflyHistogram(const VkCommandBuffer& cmdBuf)
+{
+  if(m_rtxState.fireflyTiles == 0)
+    return;
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+  VkBufferCopy region{0, 0, VkDeviceSize(m_fireflyClamp.tileCount()) * eFireflyBins * sizeof(uint32_t)};
+  vkCmdCopyBuffer(cmdBuf, m_fireflyHistogram.buffer, m_fireflyReadback.buffer, 1, &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -191,8 +350,17 @@ void SampleExample::createUniformBuffer()
 //
 void SampleExample::destroyResources()
 {
+  // Images and checkpoint still being written
+  m_imageWriter.wait();
+  waitCheckpoint();
+
   // Resources
   m_alloc.destroy(m_sunAndSkyBuffer);
+  m_alloc.destroy(m_atlasBuffer);
+  m_alloc.destroy(m_fireflyHistogram);
+  m_alloc.destroy(m_fireflyReadback);
+  m_alloc.destroy(m_fireflyThreshold);
+  m_alloc.destroy(m_fireflyStaging);
 
   // Descriptors
   vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
@@ -255,6 +423,17 @@ void SampleExample::createOffscreenRender()
   m_offscreen.create(m_size, m_renderPass);
 }
 
+//--------------------------------------------------------------------------------------------------
+// The buffers changed size (setSize), the offscreen images follow and the rendering restarts
+//
+void SampleExample::onResize(int /*w*/, int /*h*/)
+{
+  m_offscreen.update(m_size);
+  createFireflyBuffers();
+  setRenderRegion({{0, 0}, m_size});
+  resetFrame();
+}
+
 //--------------------------------------------------------------------------------------------------
 // This will draw the result of the rendering and apply the tonemapper.
 // If enabled, draw orientation axis in the lower left corner.
@@ -302,24 +481,98 @@ void SampleExample::renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK&
   // Handling de-scaling by reducing the size to render
   VkExtent2D render_size = m_renderRegion.extent;
   if(m_descaling)
-    render_size = VkExtent2D{render_size.width / m_descalingLevel, render_size.height / m_descalingLevel};
+    render_size = VkExtent2D{std::max(1u, uint32_t(render_size.width / m_descalingLevel)),
+                             std::max(1u, uint32_t(render_size.height / m_descalingLevel))};
 
-  m_rtxState.size = {m_size.width, m_size.height};
+  // Whole image, larger than the render buffer when rendering tiles, or smaller when de-scaling
+  const VkExtent2D& image = m_imageSize.width > 0 ? m_imageSize : (m_descaling ? render_size : m_size);
+  m_rtxState.size         = {image.width, image.height};
+  updateFireflyClamp(cmdBuf);
   // State is the push constant structure
   m_pRender[m_rndMethod]->setPushContants(m_rtxState);
   // Running the renderer
   m_pRender[m_rndMethod]->run(cmdBuf, render_size, profiler,
                               {m_accelStruct.getDescSet(), m_offscreen.getDescSet(), m_scene.getDescSet(), m_descSet});
+  readFireflyHistogram(cmdBuf);
 
 
-  // For automatic brightness tonemapping
-  if(m_offscreen.m_tonemapper.autoExposure)
+  // For automatic brightness tonemapping, the host tonemapper uses a histogram instead
+  if(m_offscreen.m_tonemapper.autoExposure && !m_hostTonemap)
   {
     auto slot = profiler.timeRecurring("Mipmap", cmdBuf);
     m_offscreen.genMipmap(cmdBuf);
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Applying the resolution and samples per pass of the controller, after the time of a frame. A
+// new resolution restarts the accumulation.
+//
+void SampleExample::updateDynamicResolution(double frameMs)
+{
+  if(!m_dynamicResolution.update(frameMs))
+    return;
+
+  const float level = m_dynamicResolution.level();
+  if(level != m_descalingLevel)
+  {
+    m_descaling      = level > 1.f;
+    m_descalingLevel = level;
+    resetFrame();
+  }
+  m_rtxState.maxSamples = m_dynamicResolution.samples();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Rendering one frame: accumulating the samples and tonemapping the result in the framebuffer,
+// unless it is done on the host. Once m_maxFrames are accumulated, only the tonemapping is done.
+//
+void SampleExample::renderFrame(nvvk::ProfilerVK& profiler, bool post)
+{
+  profiler.beginFrame();  // GPU performance timer
+
+  createCommandBuffer();
+  const VkCommandBuffer& cmdBuf = getCommandBuffer();
+
+  updateUniformBuffer(cmdBuf);  // Updating UBOs
+
+  // Rendering Scene (ray tracing)
+  if(m_rtxState.frame + 1 < m_maxFrames)
+  {
+    updateFrame();
+    renderScene(cmdBuf, profiler);
+  }
+
+  // Rendering pass in the framebuffer + tone mapper
+  if(post && !m_hostTonemap)
+  {
+    auto sec = profiler.timeRecurring("Tonemap", cmdBuf);
+
+    std::array<VkClearValue, 2> clearValues;
+    clearValues[0].color        = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo postRenderPassBeginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    postRenderPassBeginInfo.clearValueCount = 2;
+    postRenderPassBeginInfo.pClearValues    = clearValues.data();
+    postRenderPassBeginInfo.renderPass      = getRenderPass();
+    postRenderPassBeginInfo.framebuffer     = getFramebuffer();
+    postRenderPassBeginInfo.renderArea      = {{}, getSize()};
+
+    vkCmdBeginRenderPass(cmdBuf, &postRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Draw the rendering result + tonemapper
+    drawPost(cmdBuf);
+
+    vkCmdEndRenderPass(cmdBuf);
+  }
+
+  profiler.endFrame();
+
+  vkEndCommandBuffer(cmdBuf);
+  submitWork(cmdBuf);
+}
+
 void insertImageMemoryBarrier(
   VkCommandBuffer cmdbuffer,
   VkImage image,
@@ -349,7 +602,39 @@ void insertImageMemoryBarrier(
     1, &imageMemoryBarrier);
 }
 
-void SampleExample::dumpImage()
+void SampleExample::dumpImage(const std::string& filename, const EncodeOptions& options)
+{
+  // Packing the rows to RGB, the encoding and writing is done in the background
+  MilliTimer  timer;
+  OutputImage image;
+  readTonemapped(image, 3);
+  stages::record("ldr readback", timer.elapsed());
+  m_imageWriter.push(filename, std::move(image), options);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tonemapped image, from the post pass or tonemapped on the host
+//
+void SampleExample::readTonemapped(OutputImage& image, uint32_t channels)
+{
+  if(!m_hostTonemap)
+  {
+    readFramebuffer(image, channels);
+    return;
+  }
+
+  FloatImage color;
+  m_offscreen.readback(color);
+  image.width    = color.width;
+  image.height   = color.height;
+  image.channels = channels;
+  m_hostTonemapper.run(color, m_offscreen.m_tonemapper, channels, image.ldr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tonemapped framebuffer, as RGB or RGBA 8-bit
+//
+void SampleExample::readFramebuffer(OutputImage& image, uint32_t channels)
 {
 	/*
 			Copy framebuffer image to host visible image
@@ -451,45 +736,783 @@ void SampleExample::dumpImage()
     vkMapMemory(m_device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&imagedata);
     imagedata += subResourceLayout.offset;
 
-    /*
-      Save host visible framebuffer image to disk (ppm format)
-    */
+    // Packing the rows in parallel
+    image.width    = m_size.width;
+    image.height   = m_size.height;
+    image.channels = channels;
+    image.ldr.resize(size_t(image.width) * image.height * image.channels);
 
+    static const std::array<VkFormat, 3> formatsBGR{VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM};
+    bool colorSwizzle = std::find(formatsBGR.begin(), formatsBGR.end(), m_colorFormat) != formatsBGR.end();
+    convertRgba8(reinterpret_cast<const uint8_t*>(imagedata), subResourceLayout.rowPitch, image.width, image.height,
+                 colorSwizzle, image.channels, image.ldr.data());
+    vkUnmapMemory(m_device, dstImageMemory);
 
-    const char* filename = "headless.ppm";
+    // Clear buffers
+    vkDestroyImage(m_device, dstImage, nullptr);
+    vkFreeMemory(m_device, dstImageMemory, nullptr);
+    vkFreeCommandBuffers(m_device, m_cmdPool, 1, &copyCmd);
+  }
+}
 
-    std::ofstream file(filename, std::ios::out | std::ios::binary);
+//--------------------------------------------------------------------------------------------------
+// Samples per pixel following an importance layer (see samplemask), from the next frame on
+//
+void SampleExample::setSampleMask(const FloatImage& layer)
+{
+  m_offscreen.uploadAov(eAovSampling, layer);
+  m_rtxState.sampleMask = 1;
+  resetFrame();
+}
 
-    // ppm header
-    file << "P6\n" << m_size.width << "\n" << m_size.height << "\n" << 255 << "\n";
+//--------------------------------------------------------------------------------------------------
+// The region of interest is where `instances` are visible: a frame of one sample finds the first
+// hit of each pixel.
+//
+void SampleExample::sampleMaskFromInstances(const std::vector<int>& instances, float ratio, nvvk::ProfilerVK& profiler)
+{
+  MilliTimer timer;
+  const int  maxSamples = m_rtxState.maxSamples;
+  m_rtxState.maxSamples = 1;
+  m_rtxState.sampleMask = 0;
+  resetFrame();
+  renderFrame(profiler, false);
+  m_rtxState.maxSamples = maxSamples;
+
+  FloatImage              color;
+  std::vector<FloatImage> aovs;
+  m_offscreen.readback(color, aovs);
+  setSampleMask(samplemask::fromInstances(aovs[eAovSampling], instances, ratio));
+  LOGI("Sample mask of %zu instances (%.3f ms)\n", instances.size(), timer.elapsed());
+}
 
-    std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-    bool colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
-    colorSwizzle = true;
-    
-    // ppm binary pixel data
-    for (int32_t y = 0; y < m_size.height; y++) {
-      unsigned int *row = (unsigned int*)imagedata;
-      for (int32_t x = 0; x < m_size.width; x++) {
-        if (colorSwizzle) {
-          file.write((char*)row + 2, 1);
-          file.write((char*)row + 1, 1);
-          file.write((char*)row, 1);
+//--------------------------------------------------------------------------------------------------
+// Error of the accumulation, from the frames of even index against the others. The accumulation
+// is read back, this is done every few frames.
+//
+ConvergenceError SampleExample::convergenceError()
+{
+  FloatImage              color;
+  std::vector<FloatImage> aovs;
+  m_offscreen.readback(color, aovs);
+  return estimateConvergence(color, aovs[eAovEven], aovs[eAovSampling]);
+}
+
+bool SampleExample::checkConvergence()
+{
+  const int frames = m_rtxState.frame + 1;
+  if(m_convergenceTarget <= 0.f || frames < 2 || frames % m_convergenceEvery != 0)
+    return false;
+
+  ConvergenceError error = convergenceError();
+  LOGI("Frame %d: error %.4f (mean %.4f), target %.4f\n", frames, error.max, error.mean, m_convergenceTarget);
+  return error.max < m_convergenceTarget;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Probe of the render for the prediction: the frames are rendered as usual but at a reduced
+// resolution, the first one is not timed. The accumulation restarts afterward.
+//
+RenderProbe SampleExample::runProbe(int frames, float level, nvvk::ProfilerVK& profiler)
+{
+  const bool  descaling      = m_descaling;
+  const float descalingLevel = m_descalingLevel;
+  const int   maxFrames      = m_maxFrames;
+  m_descaling                = level > 1.f;
+  m_descalingLevel           = std::max(1.f, level);
+
+  RenderProbe probe;
+  probe.frames  = std::max(2, frames);
+  probe.samples = m_rtxState.maxSamples;
+  probe.width   = std::max(1u, uint32_t(m_renderRegion.extent.width / m_descalingLevel));
+  probe.height  = std::max(1u, uint32_t(m_renderRegion.extent.height / m_descalingLevel));
+
+  m_maxFrames = probe.frames;
+  resetFrame();
+  renderFrame(profiler, false);  // Warm-up
+  MilliTimer timer;
+  for(int f = 1; f < probe.frames; f++)
+    renderFrame(profiler, false);
+  vkDeviceWaitIdle(m_device);
+  probe.ms          = timer.elapsed();
+  probe.timedFrames = probe.frames - 1;
+  probe.deviceBytes = deviceMemoryUsage();
+
+  // The descaled frames are in the top-left corner of the buffers
+  FloatImage              color;
+  std::vector<FloatImage> aovs;
+  m_offscreen.readback(color, aovs);
+  auto crop = [&](const FloatImage& src, FloatImage& dst) {
+    dst.width    = probe.width;
+    dst.height   = probe.height;
+    dst.channels = src.channels;
+    dst.pixels.resize(size_t(dst.width) * dst.height * dst.channels);
+    for(uint32_t y = 0; y < dst.height; y++)
+      memcpy(dst.row(y), src.row(y), size_t(dst.width) * dst.channels * sizeof(float));
+  };
+  crop(color, probe.color);
+  crop(aovs[eAovEven], probe.even);
+  crop(aovs[eAovSampling], probe.sampling);
+
+  m_descaling      = descaling;
+  m_descalingLevel = descalingLevel;
+  m_maxFrames      = maxFrames;
+  resetFrame();
+  LOGI("Probe: %d frames of %ux%u in %.3f ms\n", probe.frames, probe.width, probe.height, probe.ms);
+  return probe;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Device local memory used by the process, 0 without VK_EXT_memory_budget
+//
+uint64_t SampleExample::deviceMemoryUsage()
+{
+  if(!m_memoryBudget)
+    return 0;
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2         properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  properties.pNext = &budget;
+  vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &properties);
+
+  uint64_t usage = 0;
+  for(uint32_t h = 0; h < properties.memoryProperties.memoryHeapCount; h++)
+    if(properties.memoryProperties.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+      usage += budget.heapUsage[h];
+  return usage;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Raw frame to the stream, without encoding nor disk access
+//
+bool SampleExample::streamFrame(int64_t index)
+{
+  if(!m_frameStream.isOpen())
+    return false;
+
+  const uint64_t frame = static_cast<uint64_t>(index >= 0 ? index : std::max(m_rtxState.frame, 0));
+  if(m_frameStream.format() == StreamFormat::eRgba8)
+  {
+    OutputImage image;
+    readTonemapped(image, 4);
+    return m_frameStream.push(frame, image.ldr.data());
+  }
+
+  FloatImage color;
+  m_offscreen.readback(color);
+  return m_frameStream.push(frame, color.pixels.data());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Saving the accumulation buffer, before tonemapping, with the AOVs.
+// - .exr: R, G, B, A (half), albedo.R/G/B, N.X/Y/Z (half), Z and samples (float) in one file
+// - .pfm: the color, and the AOVs in <name>_albedo.pfm, <name>_normal.pfm, <name>_depth.pfm and
+//   <name>_samples.pfm
+// The files are encoded and written in the background by m_imageWriter.
+//
+bool SampleExample::saveImageHdr(const std::string& filename, imageio::ExrCompression compression)
+{
+  FloatImage              color;
+  std::vector<FloatImage> aovs;
+  m_offscreen.readback(color, aovs);
+
+  // Image made of channels [first, first + count) of RGBA images
+  struct Source
+  {
+    const FloatImage* image;
+    uint32_t          first;
+    uint32_t          count;
+  };
+  auto makeImage = [&](std::initializer_list<Source> sources, std::vector<std::string> names) {
+    OutputImage image;
+    image.width    = color.width;
+    image.height   = color.height;
+    image.channels = static_cast<uint32_t>(names.size());
+    image.names    = std::move(names);
+    image.hdr.resize(size_t(image.width) * image.height * image.channels);
+    parallelRanges(image.height, [&](uint64_t begin, uint64_t end) {
+      for(uint64_t i = begin * image.width; i < end * image.width; i++)
+      {
+        float* dst = &image.hdr[i * image.channels];
+        for(const auto& src : sources)
+          for(uint32_t c = src.first; c < src.first + src.count; c++)
+            *dst++ = src.image->pixels[i * 4 + c];
+      }
+    });
+    return image;
+  };
+
+  const FloatImage* albedo      = &aovs[eAovAlbedo];
+  const FloatImage* normalDepth = &aovs[eAovNormalDepth];
+  const FloatImage* sampling    = &aovs[eAovSampling];
+  EncodeOptions     options;
+  options.exrCompression = compression;
+
+  if(filename.size() > 4 && filename.substr(filename.size() - 4) == ".pfm")
+  {
+    const std::string base = filename.substr(0, filename.size() - 4);
+    bool result = m_imageWriter.push(filename, makeImage({{&color, 0, 3}}, {"R", "G", "B"}));
+    result      = m_imageWriter.push(base + "_albedo.pfm", makeImage({{albedo, 0, 3}}, {"R", "G", "B"})) && result;
+    result      = m_imageWriter.push(base + "_normal.pfm", makeImage({{normalDepth, 0, 3}}, {"R", "G", "B"})) && result;
+    result      = m_imageWriter.push(base + "_depth.pfm", makeImage({{normalDepth, 3, 1}}, {"Z"})) && result;
+    result      = m_imageWriter.push(base + "_samples.pfm", makeImage({{sampling, 0, 1}}, {"samples"})) && result;
+    return result;
+  }
+
+  return m_imageWriter.push(filename,
+                            makeImage({{&color, 0, 4}, {albedo, 0, 3}, {normalDepth, 0, 4}, {sampling, 0, 1}},
+                                      {"R", "G", "B", "A", "albedo.R", "albedo.G", "albedo.B", "N.X", "N.Y", "N.Z", "Z", "samples"}),
+                            options);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Relighting: the direct and indirect images of each light group next to `filename`, see
+// relight::layerFilename(). The layers without any contribution are not written.
+//
+bool SampleExample::saveRelight(const std::string& filename, imageio::ExrCompression compression)
+{
+  std::vector<FloatImage> groups;
+  m_offscreen.readbackRelight(groups);
+  if(groups.empty())
+  {
+    LOGE("Relighting was not enabled, no light groups to save\n");
+    return false;
+  }
+
+  EncodeOptions options;
+  options.exrCompression = compression;
+  bool result            = true;
+  for(uint32_t g = 0; g < static_cast<uint32_t>(groups.size()); g++)
+  {
+    const FloatImage& group = groups[g];
+    OutputImage       image;
+    image.width    = group.width;
+    image.height   = group.height;
+    image.channels = 3;
+    image.hdr.resize(size_t(image.width) * image.height * 3);
+    bool empty = true;
+    for(size_t i = 0; i < size_t(image.width) * image.height; i++)
+      for(uint32_t c = 0; c < 3; c++)
+      {
+        image.hdr[i * 3 + c] = group.pixels[i * 4 + c];
+        empty &= group.pixels[i * 4 + c] == 0.f;
+      }
+    if(!empty)
+      result = m_imageWriter.push(relight::layerFilename(filename, g), std::move(image), options) && result;
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Checkpoint of the accumulation, written in the background while the rendering continues. Only
+// one save is in flight, the previous one is finished first.
+//
+void SampleExample::saveCheckpoint(const std::string& filename, uint64_t jobKey)
+{
+  waitCheckpoint();
+
+  auto ckpt        = std::make_shared<Checkpoint>();
+  ckpt->jobKey     = jobKey;
+  ckpt->frame      = m_rtxState.frame;
+  ckpt->maxSamples = m_rtxState.maxSamples;
+  m_offscreen.readback(ckpt->color, ckpt->aovs);
+  // Samples of each pixel, from the eAovSampling layer: they differ with a sample mask
+  ckpt->sampleCount.resize(size_t(m_size.width) * m_size.height);
+  for(size_t i = 0; i < ckpt->sampleCount.size(); i++)
+    ckpt->sampleCount[i] = uint32_t(ckpt->aovs[eAovSampling].pixels[i * 4]);
+  // Counts of the firefly clamp, copied after the frame (the readback above waited for it)
+  if(m_rtxState.fireflyTiles != 0)
+  {
+    const auto* counts = static_cast<const uint32_t*>(m_alloc.map(m_fireflyReadback));
+    ckpt->fireflyHistogram.assign(counts, counts + size_t(m_fireflyClamp.tileCount()) * eFireflyBins);
+    m_alloc.unmap(m_fireflyReadback);
+  }
+
+  m_checkpointSave = std::async(std::launch::async, [filename, ckpt] { return checkpoint::save(filename, *ckpt); });
+}
+
+bool SampleExample::waitCheckpoint()
+{
+  return m_checkpointSave.valid() ? m_checkpointSave.get() : true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Restoring the accumulation, the frame and the firefly histograms: the next frame continues the
+// random sequence where the checkpoint left it, with the same clamp. A checkpoint of another job
+// or size is ignored.
+//
+bool SampleExample::loadCheckpoint(const std::string& filename, uint64_t jobKey)
+{
+  Checkpoint ckpt;
+  if(!checkpoint::load(filename, ckpt))
+    return false;
+
+  const size_t fireflyCounts = m_fireflyClamp.enabled() ? size_t(m_fireflyClamp.tileCount()) * eFireflyBins : 0;
+  if(ckpt.jobKey != jobKey || ckpt.color.width != m_size.width || ckpt.color.height != m_size.height
+     || ckpt.maxSamples != m_rtxState.maxSamples || ckpt.fireflyHistogram.size() != fireflyCounts)
+  {
+    LOGW("Checkpoint %s is from different settings, restarting the rendering\n", filename.c_str());
+    return false;
+  }
+
+  m_offscreen.upload(ckpt.color, ckpt.aovs);
+  if(fireflyCounts != 0)
+  {
+    // The next frame makes the thresholds from the read-back counts and adds to the ones on the device
+    memcpy(m_alloc.map(m_fireflyReadback), ckpt.fireflyHistogram.data(), fireflyCounts * sizeof(uint32_t));
+    m_alloc.unmap(m_fireflyReadback);
+    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex, m_queue);
+    VkBufferCopy             region{0, 0, fireflyCounts * sizeof(uint32_t)};
+    vkCmdCopyBuffer(cmdBuf, m_fireflyReadback.buffer, m_fireflyHistogram.buffer, 1, &region);
+  }
+  m_rtxState.frame = ckpt.frame;
+  LOGI("Resuming from %s at frame %d\n", filename.c_str(), ckpt.frame);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Key of the render cache: `contentHash` (scene and environment files) with the state the
+// accumulation depends on. The tonemapper is left out, a cached result only needs the post pass.
+//
+uint64_t SampleExample::renderCacheKey(uint64_t contentHash, const std::string& settings)
+{
+  RtxState state = m_rtxState;
+  state.frame    = 0;       // Progress, not a setting
+  state.size     = {0, 0};  // Set by the first frame, the image size is in `settings`
+
+  nvmath::vec3f eye, center, up;
+  CameraManip.getLookat(eye, center, up);
+  const float camera[10] = {eye.x, eye.y, eye.z, center.x, center.y, center.z, up.x, up.y, up.z, CameraManip.getFov()};
+
+  uint64_t key = rendercache::hashBytes(&state, sizeof(state), contentHash);
+  key          = rendercache::hashBytes(&m_sunAndSky, sizeof(m_sunAndSky), key);
+  key          = rendercache::hashBytes(camera, sizeof(camera), key);
+  key          = rendercache::hashBytes(&m_rndMethod, sizeof(m_rndMethod), key);
+  key          = rendercache::hashBytes(settings.data(), settings.size(), key);
+  return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Rendering an image larger than the render buffer, tile by tile: each tile accumulates `frames`
+// frames in the buffer, is read back and appended to a tiled OpenEXR while the next one renders.
+// The memory is bounded by the size of the buffer, whatever the size of the image.
+//
+bool SampleExample::renderTiled(const std::string&      filename,
+                                uint32_t                width,
+                                uint32_t                height,
+                                int                     frames,
+                                nvvk::ProfilerVK&       profiler,
+                                imageio::ExrCompression compression)
+{
+  MilliTimer timer;
+
+  // Same channels as saveImageHdr()
+  static const std::vector<std::string> names{"R",   "G",   "B",   "A", "albedo.R", "albedo.G", "albedo.B",
+                                              "N.X", "N.Y", "N.Z", "Z", "samples"};
+  std::vector<imageio::ImageChannel> channels(names.size());
+  for(size_t c = 0; c < names.size(); c++)
+  {
+    channels[c].name = names[c];
+    channels[c].half = names[c] != "Z" && names[c] != "samples";
+  }
+
+  const uint32_t          tileSize = std::min(m_size.width, m_size.height);
+  imageio::TiledExrWriter writer;
+  if(!writer.open(filename, width, height, tileSize, channels, compression))
+    return false;
+  LOGI("Rendering %ux%u in %u tiles of %u\n", width, height, writer.tilesX() * writer.tilesY(), tileSize);
+
+  struct Tile
+  {
+    FloatImage              color;
+    std::vector<FloatImage> aovs;
+  };
+
+  m_imageSize = {width, height};
+  m_maxFrames = frames;
+  std::future<bool> pending;  // Previous tile being written
+  bool              result = true;
+  for(uint32_t ty = 0; ty < writer.tilesY(); ty++)
+  {
+    for(uint32_t tx = 0; tx < writer.tilesX(); tx++)
+    {
+      const uint32_t tw = writer.tileWidth(tx);
+      const uint32_t th = writer.tileHeight(ty);
+      setRenderRegion({{0, 0}, {tw, th}});
+      m_rtxState.tileOffset = {int(tx * tileSize), int(ty * tileSize)};
+      resetFrame();
+      do
+      {
+        renderFrame(profiler, false);
+      } while(m_rtxState.frame + 1 < frames);
+
+      auto tile = std::make_shared<Tile>();
+      m_offscreen.readback(tile->color, tile->aovs);
+
+      if(pending.valid())
+        result = pending.get() && result;
+      pending = std::async(std::launch::async, [&writer, tile, tx, ty, tw, th] {
+        // Channels of the tile, without the unused part of the buffer
+        const uint32_t     nc = 12;
+        std::vector<float> pixels(size_t(tw) * th * nc);
+        for(uint32_t y = 0; y < th; y++)
+          for(uint32_t x = 0; x < tw; x++)
+          {
+            const size_t src = (size_t(y) * tile->color.width + x) * 4;
+            float*       dst = &pixels[(size_t(y) * tw + x) * nc];
+            memcpy(dst, &tile->color.pixels[src], 4 * sizeof(float));
+            memcpy(dst + 4, &tile->aovs[eAovAlbedo].pixels[src], 3 * sizeof(float));
+            memcpy(dst + 7, &tile->aovs[eAovNormalDepth].pixels[src], 4 * sizeof(float));
+            dst[11] = tile->aovs[eAovSampling].pixels[src];
+          }
+        std::vector<imageio::ImageChannel> tileChannels(nc);
+        for(uint32_t c = 0; c < nc; c++)
+        {
+          tileChannels[c].data   = pixels.data() + c;
+          tileChannels[c].stride = nc;
         }
-        else {
-          file.write((char*)row, 3);
+        return writer.writeTile(tx, ty, tileChannels);
+      });
+      LOGI("Tile %u/%u\n", ty * writer.tilesX() + tx + 1, writer.tilesX() * writer.tilesY());
+    }
+  }
+  if(pending.valid())
+    result = pending.get() && result;
+  result = writer.close() && result;
+
+  // Back to rendering the buffer
+  m_imageSize           = {};
+  m_rtxState.tileOffset = {0, 0};
+  setRenderRegion({{0, 0}, m_size});
+
+  LOGI("Tiled image saved to %s (%.3f ms)\n", filename.c_str(), timer.elapsed());
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One render of a batch (see RenderJob): only the camera, the size of the buffers and the render
+// settings change, the scene, acceleration structures and pipelines are the ones already created.
+//
+bool SampleExample::renderJob(const RenderJob&        job,
+                              nvvk::ProfilerVK&       profiler,
+                              const EncodeOptions&    ldrOptions,
+                              imageio::ExrCompression compression)
+{
+  MilliTimer timer;
+
+  const auto& cameras = m_scene.getScene().m_cameras;
+  if(job.cameraIndex >= static_cast<int>(cameras.size()))
+  {
+    LOGE("Camera %d is not in the scene (%zu cameras)\n", job.cameraIndex, cameras.size());
+    return false;
+  }
+  if(job.cameraIndex >= 0)
+  {
+    auto& c = cameras[job.cameraIndex];
+    CameraManip.setCamera({c.eye, c.center, c.up, (float)rad2deg(c.cam.perspective.yfov)});
+  }
+  else if(job.hasCamera)
+    CameraManip.setCamera({job.eye, job.center, job.up, job.fov});
+  else if(!cameras.empty())
+  {
+    // Default camera of the scene as when loaded (see Scene::setCameraFromScene), not the previous job's
+    auto& c = cameras[0];
+    CameraManip.setCamera({c.eye, c.center, c.up, (float)rad2deg(c.cam.perspective.yfov)});
+  }
+  else
+  {
+    auto& dimensions = m_scene.getScene().m_dimensions;
+    CameraManip.fit(dimensions.min, dimensions.max, true);
+  }
+
+  setSize(job.width, job.height);
+  m_rtxState.maxSamples     = job.samples;
+  m_rtxState.debugging_mode = job.debugMode;
+  m_rtxState.envRotation    = (float)deg2rad(job.envRotation);
+  m_maxFrames               = job.frames;
+  resetFrame();
+
+  // Accumulating until all frames are done, the time budget is spent or the image converged
+  MilliTimer renderTimer;
+  bool       converged = false;
+  m_convergenceTarget  = job.convergence;
+  do
+  {
+    renderFrame(profiler);
+    converged = checkConvergence();
+  } while(!converged && m_rtxState.frame + 1 < m_maxFrames && (job.timeBudget <= 0. || renderTimer.elapsed() < job.timeBudget * 1000.));
+  vkDeviceWaitIdle(m_device);
+  LOGI("Rendered %d frames of %d samples in %.3f ms\n", m_rtxState.frame + 1, job.samples, renderTimer.elapsed());
+  stages::record("render", renderTimer.elapsed());
+
+  bool result = true;
+  if(!job.output.empty())
+    dumpImage(job.output, ldrOptions);
+  if(!job.hdr.empty())
+    result = saveImageHdr(job.hdr, compression);
+
+  LOGI("Render job done (%.3f ms)\n", timer.elapsed());
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Camera of a thumbnail: a glTF camera, the explicit one, or fitted on the bounds of the instances
+// from the direction and field of view of the current camera.
+//
+AtlasTile SampleExample::thumbnailCamera(const Thumbnail& thumb, float aspectRatio)
+{
+  auto&         gltf = m_scene.getScene();
+  nvmath::vec3f eye, center, up;
+  float         fov = CameraManip.getFov();
+  CameraManip.getLookat(eye, center, up);
+
+  if(thumb.cameraIndex >= 0 && thumb.cameraIndex < static_cast<int>(gltf.m_cameras.size()))
+  {
+    auto& c = gltf.m_cameras[thumb.cameraIndex];
+    eye     = c.eye;
+    center  = c.center;
+    up      = c.up;
+    fov     = (float)rad2deg(c.cam.perspective.yfov);
+  }
+  else if(thumb.cameraIndex >= 0)
+    LOGW("Camera %d is not in the scene, fitting the instances\n", thumb.cameraIndex);
+
+  if(thumb.hasCamera)
+  {
+    eye    = thumb.eye;
+    center = thumb.center;
+    up     = thumb.up;
+    fov    = thumb.fov;
+  }
+  else if(thumb.cameraIndex < 0 || thumb.cameraIndex >= static_cast<int>(gltf.m_cameras.size()))
+  {
+    // World bounds of the primitives of the nodes
+    const size_t  first = thumb.nbInstances > 0 ? thumb.firstInstance : 0;
+    const size_t  last  = thumb.nbInstances > 0 ? std::min(first + thumb.nbInstances, gltf.m_nodes.size()) : gltf.m_nodes.size();
+    nvmath::vec3f bmin(std::numeric_limits<float>::max());
+    nvmath::vec3f bmax(-std::numeric_limits<float>::max());
+    for(size_t i = first; i < last; i++)
+    {
+      const auto& node = gltf.m_nodes[i];
+      const auto& prim = gltf.m_primMeshes[node.primMesh];
+      for(int corner = 0; corner < 8; corner++)
+      {
+        nvmath::vec4f p = node.worldMatrix
+                          * nvmath::vec4f((corner & 1) ? prim.posMax.x : prim.posMin.x, (corner & 2) ? prim.posMax.y : prim.posMin.y,
+                                          (corner & 4) ? prim.posMax.z : prim.posMin.z, 1.f);
+        for(int k = 0; k < 3; k++)
+        {
+          bmin[k] = std::min(bmin[k], p[k]);
+          bmax[k] = std::max(bmax[k], p[k]);
         }
-        row++;
       }
-      imagedata += subResourceLayout.rowPitch;
     }
-    file.close();
 
-    LOGI("Framebuffer image saved to %s\n", filename);
+    if(first < last)
+    {
+      // The bounding sphere fills the narrowest field of view
+      const nvmath::vec3f dir     = nvmath::normalize(eye - center);
+      const float         radius  = std::max(nvmath::length(bmax - bmin) * 0.5f, 1e-4f);
+      float               halfFov = (float)deg2rad(fov) * 0.5f;
+      if(aspectRatio < 1.f)
+        halfFov = std::atan(std::tan(halfFov) * aspectRatio);
+      center = (bmin + bmax) * 0.5f;
+      eye    = center + dir * (radius / std::sin(halfFov));
+    }
+    else
+      LOGW("Instances [%d, %d) are not in the scene (%zu nodes)\n", thumb.firstInstance,
+           thumb.firstInstance + thumb.nbInstances, gltf.m_nodes.size());
+  }
 
-    // Clear buffers
-    vkDestroyImage(m_device, dstImage, nullptr);
-    vkFreeMemory(m_device, dstImageMemory, nullptr);
-    vkFreeCommandBuffers(m_device, m_cmdPool, 1, &copyCmd);
+  AtlasTile tile{};
+  tile.viewInverse   = nvmath::invert(nvmath::look_at(eye, center, up));
+  tile.projInverse   = nvmath::invert(nvmath::perspectiveVK(fov, aspectRatio, 0.001f, 100000.0f));
+  tile.firstInstance = thumb.firstInstance;
+  tile.nbInstances   = thumb.nbInstances;
+  return tile;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Replacing the buffer of the atlas tiles, the descriptor follows
+//
+void SampleExample::uploadAtlasTiles(const std::vector<AtlasTile>& tiles)
+{
+  vkDeviceWaitIdle(m_device);  // The previous tiles may still be in use
+  m_alloc.destroy(m_atlasBuffer);
+  {
+    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex, m_queue);
+    m_atlasBuffer = m_alloc.createBuffer(cmdBuf, tiles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    NAME_VK(m_atlasBuffer.buffer);
   }
-}
\ No newline at end of file
+  m_alloc.finalizeAndReleaseStaging();
+
+  VkDescriptorBufferInfo atlasTiles{m_atlasBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkWriteDescriptorSet   write = m_bind.makeWrite(m_descSet, EnvBindings::eAtlasTiles, &atlasTiles);
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Thumbnail farm: the thumbnails are the tiles of one image, rendered in the same launch with
+// their own camera and instances (see atlas.glsl). The image is then split, each tile encoded and
+// written by m_imageWriter. More thumbnails than fit in farm.maxSize take several launches.
+//
+bool SampleExample::renderThumbnails(const ThumbnailFarm&    farm,
+                                     nvvk::ProfilerVK&       profiler,
+                                     const EncodeOptions&    ldrOptions,
+                                     imageio::ExrCompression compression)
+{
+  MilliTimer  timer;
+  const auto& thumbs      = farm.thumbnails;
+  const float aspectRatio = farm.tileWidth / static_cast<float>(farm.tileHeight);
+
+  EncodeOptions hdrOptions  = ldrOptions;
+  hdrOptions.exrCompression = compression;
+
+  size_t first = 0;
+  while(first < thumbs.size())
+  {
+    MilliTimer launchTimer;
+    uint32_t   columns, rows;
+    atlasGrid(farm, static_cast<uint32_t>(thumbs.size() - first), columns, rows);
+    const size_t count = std::min(thumbs.size() - first, size_t(columns) * rows);
+
+    // Tiles after the last thumbnail only show the environment
+    std::vector<AtlasTile> tiles(size_t(columns) * rows);
+    for(size_t i = 0; i < tiles.size(); i++)
+    {
+      if(i < count)
+        tiles[i] = thumbnailCamera(thumbs[first + i], aspectRatio);
+      else
+      {
+        tiles[i]             = tiles[0];
+        tiles[i].nbInstances = -1;
+      }
+    }
+    uploadAtlasTiles(tiles);
+
+    setSize(columns * farm.tileWidth, rows * farm.tileHeight);
+    m_rtxState.atlasTile  = {static_cast<int>(farm.tileWidth), static_cast<int>(farm.tileHeight)};
+    m_rtxState.maxSamples = farm.samples;
+    m_maxFrames           = farm.frames;
+    resetFrame();
+    do
+    {
+      renderFrame(profiler);
+    } while(m_rtxState.frame + 1 < m_maxFrames);
+    vkDeviceWaitIdle(m_device);
+
+    // Reading back only what the thumbnails need
+    bool needLdr = false, needHdr = false;
+    for(size_t i = first; i < first + count; i++)
+    {
+      needLdr |= !thumbs[i].output.empty();
+      needHdr |= !thumbs[i].hdr.empty();
+    }
+    OutputImage ldr, hdr;
+    if(needLdr)
+      readTonemapped(ldr, 3);
+    if(needHdr)
+    {
+      FloatImage color;
+      m_offscreen.readback(color);
+      hdr.width    = color.width;
+      hdr.height   = color.height;
+      hdr.channels = color.channels;
+      hdr.hdr      = std::move(color.pixels);
+    }
+
+    for(size_t i = 0; i < count; i++)
+    {
+      const Thumbnail& thumb = thumbs[first + i];
+      const uint32_t   x     = static_cast<uint32_t>(i % columns) * farm.tileWidth;
+      const uint32_t   y     = static_cast<uint32_t>(i / columns) * farm.tileHeight;
+      OutputImage      tile;
+      if(!thumb.output.empty())
+      {
+        cropImage(ldr, x, y, farm.tileWidth, farm.tileHeight, tile);
+        m_imageWriter.push(thumb.output, std::move(tile), ldrOptions);
+      }
+      if(!thumb.hdr.empty())
+      {
+        cropImage(hdr, x, y, farm.tileWidth, farm.tileHeight, tile);
+        m_imageWriter.push(thumb.hdr, std::move(tile), hdrOptions);
+      }
+    }
+
+    LOGI("Atlas of %zu thumbnails, %ux%u tiles (%.3f ms)\n", count, columns, rows, launchTimer.elapsed());
+    first += count;
+  }
+
+  // Back to rendering one camera
+  m_rtxState.atlasTile = {0, 0};
+  bool result          = m_imageWriter.wait();
+
+  LOGI("%zu thumbnails done (%.3f ms)\n", thumbs.size(), timer.elapsed());
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Name of a frame of a sequence: `pattern` is a printf format (frame_%04d.png), or the frame
+// number is added before the extension.
+//
+static std::string sequenceFilename(const std::string& pattern, int frame)
+{
+  if(pattern.find('%') != std::string::npos)
+  {
+    char name[1024];
+    snprintf(name, sizeof(name), pattern.c_str(), frame);
+    return name;
+  }
+  char number[16];
+  snprintf(number, sizeof(number), "_%04d", frame);
+  const size_t dot = pattern.find_last_of('.');
+  if(dot == std::string::npos || pattern.find_first_of("/\\", dot) != std::string::npos)
+    return pattern + number;
+  return pattern.substr(0, dot) + number + pattern.substr(dot);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Rendering a fly-through: only the camera changes between frames, updateUniformBuffer() uploads
+// it with the next render. The images are encoded and written by m_imageWriter while the next
+// frame renders, and each finished frame goes to m_frameStream when it is open.
+//
+bool SampleExample::renderSequence(const CameraPath&       path,
+                                   int                     first,
+                                   int                     last,
+                                   int                     passes,
+                                   const std::string&      ldrPattern,
+                                   const std::string&      hdrPattern,
+                                   nvvk::ProfilerVK&       profiler,
+                                   const EncodeOptions&    ldrOptions,
+                                   imageio::ExrCompression compression)
+{
+  MilliTimer timer;
+  bool       result = true;
+  for(int frame = first; frame <= last; frame++)
+  {
+    MilliTimer      frameTimer;
+    const CameraKey key = path.at(frame);
+    CameraManip.setCamera({key.eye, key.center, key.up, key.fov});
+
+    resetFrame();
+    m_maxFrames    = passes;
+    bool converged = false;
+    do
+    {
+      renderFrame(profiler);
+      converged = checkConvergence();
+    } while(!converged && m_rtxState.frame + 1 < passes);
+
+    if(!ldrPattern.empty())
+      dumpImage(sequenceFilename(ldrPattern, frame), ldrOptions);
+    if(!hdrPattern.empty())
+      result = saveImageHdr(sequenceFilename(hdrPattern, frame), compression) && result;
+    if(m_frameStream.isOpen())
+      result = streamFrame(frame) && result;
+    LOGI("Sequence frame %d [%d, %d] (%.3f ms)\n", frame, first, last, frameTimer.elapsed());
+  }
+  result = m_imageWriter.wait() && result;
+
+  LOGI("Sequence of %d frames done (%.3f ms)\n", last - first + 1, timer.elapsed());
+  return result;
+}
@@ -19,7 +19,23 @@
 
 
 #pragma once
+#include <future>
+
+#include "camera_path.hpp"
+#include "checkpoint.hpp"
+#include "convergence.hpp"
+#include "dynamic_resolution.hpp"
+#include "firefly_clamp.hpp"
+#include "frame_stream.hpp"
 #include "hdr_sampling.hpp"
+#include "host_tonemapper.hpp"
+#include "image_writer.hpp"
+#include "relight.hpp"
+#include "render_cache.hpp"
+#include "render_job.hpp"
+#include "render_prediction.hpp"
+#include "sample_mask.hpp"
+#include "thumbnail_atlas.hpp"
 #include "nvvk/gizmos_vk.hpp"
 #include "renderer.h"
 
@@ -93,17 +109,66 @@ public:
   void destroyResources();
   void loadAssets(const char* filename);
   void loadEnvironmentHdr(const std::string& hdrFilename);
+  void loadSunAndSky();
   void loadScene(const std::string& filename);
   void createRender(RndMethod method);
   void resetFrame();
+  void updateFrame();
   void updateHdrDescriptors();
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
-  void dumpImage();
+  void dumpImage(const std::string& filename = "headless.ppm", const EncodeOptions& options = {});
+  void readFramebuffer(OutputImage& image, uint32_t channels);
+  void readTonemapped(OutputImage& image, uint32_t channels);
+  bool saveImageHdr(const std::string& filename, imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+  bool saveRelight(const std::string& filename, imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+
+  // Sending the current frame to m_frameStream, tonemapped or the accumulation buffer. `index` is
+  // the frame of a sequence, -1: the accumulated frame.
+  bool streamFrame(int64_t index = -1);
+
+  // #Convergence: every m_convergenceEvery frames, true when the error is below m_convergenceTarget
+  bool             checkConvergence();
+  ConvergenceError convergenceError();
+  float            m_convergenceTarget{0.f};  // 0: off
+  int              m_convergenceEvery{4};
+
+  // #Prediction: a few frames at 1/level of the resolution, see render_prediction.hpp
+  RenderProbe runProbe(int frames, float level, nvvk::ProfilerVK& profiler);
+  uint64_t    deviceMemoryUsage();
+  bool        m_memoryBudget{false};  // VK_EXT_memory_budget is enabled
+
+  // #FireflyClamp: thresholds of the tiles from the luminance histograms of the previous frames
+  void               createFireflyBuffers();
+  void               updateFireflyClamp(const VkCommandBuffer& cmdBuf);
+  void               readFireflyHistogram(const VkCommandBuffer& cmdBuf);
+  FireflyClamp       m_fireflyClamp;
+  std::vector<float> m_fireflyThresholds;
+  nvvk::Buffer       m_fireflyHistogram;  // Counts of the samples, eFireflyBins per tile
+  nvvk::Buffer       m_fireflyReadback;   // Copy of the counts after each frame, host visible
+  nvvk::Buffer       m_fireflyThreshold;  // Threshold of each tile
+  nvvk::Buffer       m_fireflyStaging;    // Thresholds uploaded before each frame, host visible
+
+  // #SampleMask: region of interest getting more samples, see samplemask
+  void setSampleMask(const FloatImage& layer);
+  void sampleMaskFromInstances(const std::vector<int>& instances, float ratio, nvvk::ProfilerVK& profiler);
+
+  // #Checkpoint: the accumulation is read back and written in the background
+  void saveCheckpoint(const std::string& filename, uint64_t jobKey);
+  bool loadCheckpoint(const std::string& filename, uint64_t jobKey);
+  bool waitCheckpoint();
+
+  // #RenderCache: finished renders stored as checkpoints, reused by the same settings
+  uint64_t    renderCacheKey(uint64_t contentHash, const std::string& settings);
+  RenderCache m_renderCache;
 
   Scene              m_scene;
   AccelStructure     m_accelStruct;
   RenderOutput       m_offscreen;
   HdrSampling        m_skydome;
+  ImageWriter        m_imageWriter;  // Encoding and writing images in the background
+  FrameStream        m_frameStream;  // Raw frames for external encoders
+  HostTonemapper     m_hostTonemapper;
+  bool               m_hostTonemap{false};  // Tonemapping the read-back image instead of the post pass
   nvvk::RayPickerKHR m_picker;
 
   // It is possible that ray query isn't supported (ex. Titan)
@@ -131,24 +196,71 @@ public:
 
   // #Post
   void createOffscreenRender();
+  void onResize(int w, int h) override;
   void drawPost(VkCommandBuffer cmdBuf);
 
   // #VKRay
   void renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& profiler);
+  void renderFrame(nvvk::ProfilerVK& profiler, bool post = true);
+
+  // #Tiles: images of any size, rendered with the buffer as a tile
+  bool renderTiled(const std::string&      filename,
+                   uint32_t                width,
+                   uint32_t                height,
+                   int                     frames,
+                   nvvk::ProfilerVK&       profiler,
+                   imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+  VkExtent2D m_imageSize{};  // Size of the image when rendering tiles, 0: the buffer is the image
+
+  // #Sequence: frames [first, last] of a camera path, each accumulating `passes` frames
+  bool renderSequence(const CameraPath&       path,
+                      int                     first,
+                      int                     last,
+                      int                     passes,
+                      const std::string&      ldrPattern,
+                      const std::string&      hdrPattern,
+                      nvvk::ProfilerVK&       profiler,
+                      const EncodeOptions&    ldrOptions,
+                      imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+
+  // #Batch: one render of a job file, reusing the loaded scene and pipelines
+  bool renderJob(const RenderJob&        job,
+                 nvvk::ProfilerVK&       profiler,
+                 const EncodeOptions&    ldrOptions,
+                 imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+
+  // #Atlas: thumbnails rendered together as the tiles of one image, see ThumbnailFarm
+  bool         renderThumbnails(const ThumbnailFarm&    farm,
+                                nvvk::ProfilerVK&       profiler,
+                                const EncodeOptions&    ldrOptions,
+                                imageio::ExrCompression compression = imageio::ExrCompression::ePiz);
+  AtlasTile    thumbnailCamera(const Thumbnail& thumb, float aspectRatio);
+  void         uploadAtlasTiles(const std::vector<AtlasTile>& tiles);
+  nvvk::Buffer m_atlasBuffer;  // AtlasTile of each tile, a placeholder without an atlas
 
 
   RtxState m_rtxState{
-      0,       // frame;
-      10,      // maxDepth;
-      1,       // maxSamples;
-      1,       // fireflyClampThreshold;
-      1,       // hdrMultiplier;
-      0,       // debugging_mode;
-      0,       // pbrMode;
-      0,       // _pad0;
-      {0, 0},  // size;
-      0,       // minHeatmap;
-      65000    // maxHeatmap;
+      0,             // frame;
+      10,            // maxDepth;
+      1,             // maxSamples;
+      1,             // fireflyClampThreshold;
+      1,             // hdrMultiplier;
+      0,             // debugging_mode;
+      0,             // pbrMode;
+      0,             // _pad0;
+      {0, 0},        // size;
+      0,             // minHeatmap;
+      65000,         // maxHeatmap;
+      eEnvAliasMap,  // envSampling;
+      0,             // sunSampling;
+      0,             // shDepth;
+      0,             // _pad1;
+      {0, 0},        // tileOffset;
+      0,             // envRotation;
+      0,             // sampleMask;
+      {0, 0},        // atlasTile;
+      0,             // relight;
+      0,             // fireflyTiles;
   };
 
   SunAndSky m_sunAndSky{
@@ -170,8 +282,14 @@ public:
       0,                    // in_use;
   };
 
+  std::future<bool> m_checkpointSave;
+
   int         m_maxFrames{100000};
   bool        m_showAxis{true};
   bool        m_descaling{false};
-  int         m_descalingLevel{1};
+  float       m_descalingLevel{1.f};  // Rendering 1/level of the width and height, the post pass upscales
+
+  // #DynamicResolution: m_descalingLevel and the samples per pass following a frame time target
+  DynamicResolution m_dynamicResolution;
+  void              updateDynamicResolution(double frameMs);
 };
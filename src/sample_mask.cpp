@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "sample_mask.hpp"
+#include "tools.hpp"
+
+namespace samplemask {
+
+namespace {
+
+// Importance in [1, ratio] to the eAovSampling layer, normalized to an average of 1
+FloatImage normalize(const std::vector<float>& importance, uint32_t width, uint32_t height)
+{
+  double sum = 0.;
+  for(float i : importance)
+    sum += i;
+  const float scale = sum > 0. ? float(importance.size() / sum) : 1.f;
+
+  FloatImage layer;
+  layer.width    = width;
+  layer.height   = height;
+  layer.channels = 4;
+  layer.pixels.assign(size_t(width) * height * 4, 0.f);
+  for(size_t i = 0; i < importance.size(); i++)
+    layer.pixels[i * 4 + 1] = importance[i] * scale;
+  return layer;
+}
+
+}  // namespace
+
+
+FloatImage fromImage(const FloatImage& mask, uint32_t width, uint32_t height, float ratio)
+{
+  std::vector<float> importance(size_t(width) * height, 1.f);
+  if(mask.width == 0 || mask.height == 0 || mask.channels == 0)
+    return normalize(importance, width, height);
+
+  parallelRanges(height, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; y++)
+    {
+      const float* row = mask.row(uint32_t(y * mask.height / height));
+      for(uint32_t x = 0; x < width; x++)
+      {
+        const float* m     = row + size_t(x) * mask.width / width * mask.channels;
+        float        value = *std::max_element(m, m + mask.channels);
+        importance[y * width + x] = 1.f + (ratio - 1.f) * std::clamp(value, 0.f, 1.f);
+      }
+    }
+  });
+  return normalize(importance, width, height);
+}
+
+FloatImage fromInstances(const FloatImage& sampling, const std::vector<int>& instances, float ratio)
+{
+  const std::unordered_set<int> selection(instances.begin(), instances.end());
+  std::vector<float>            importance(size_t(sampling.width) * sampling.height);
+  for(size_t i = 0; i < importance.size(); i++)
+  {
+    const int instance = int(sampling.pixels[i * sampling.channels + 2]) - 1;  // -1: environment
+    importance[i]      = selection.count(instance) ? ratio : 1.f;
+  }
+  return normalize(importance, sampling.width, sampling.height);
+}
+
+}  // namespace samplemask
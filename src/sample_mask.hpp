@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "image_io.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Region of interest: the samples per pixel follow an importance mask instead of being uniform.
+//
+// The importance of a pixel goes from 1 (mask at 0) to `ratio` (mask at 1). It is normalized to
+// an average of 1 so the budget of the frame stays maxSamples per pixel: with a ratio of 16, the
+// masked pixels get 16 times the samples of the others. The result is the eAovSampling layer
+// (see PixelSamples() in pathtrace.glsl), the importance in the green channel.
+//
+namespace samplemask {
+
+// `mask` of any size and channel count (the maximum of the channels), resampled to width x height
+FloatImage fromImage(const FloatImage& mask, uint32_t width, uint32_t height, float ratio);
+
+// The pixels whose first hit is one of `instances` (nodes of the glTF scene) are the region of
+// interest. `sampling` is a read-back eAovSampling layer, holding the instance + 1 in blue.
+FloatImage fromInstances(const FloatImage& sampling, const std::vector<int>& instances, float ratio);
+
+}  // namespace samplemask
@@ -24,6 +24,7 @@
  */
 
 
+#include <algorithm>
 #include <sstream>
 
 #include "imgui/imgui_camera_widget.h"
@@ -35,7 +36,7 @@
 
 #include "shaders/host_device.h"
 #include "scene.hpp"
-#include "shaders/compress.glsl"
+#include "scene_conversion.hpp"
 #include "tiny_gltf.h"
 #include "tools.hpp"
 
@@ -72,7 +73,7 @@ bool Scene::load(const std::string& filename)
     gltf.importMaterials(tmodel);
     gltf.importDrawableNodes(tmodel, nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0
                                          | nvh::GltfAttributes::Tangent | nvh::GltfAttributes::Color_0);
-    timer.print();
+    timer.print("gltf convert");
   }
 
   // Setting all cameras found in the scene, such that they appears in the camera GUI helper
@@ -103,7 +104,7 @@ bool Scene::load(const std::string& filename)
   MilliTimer timer;
   cmdBufGet.submitAndWait(cmdBuf);
   m_pAlloc->finalizeAndReleaseStaging();
-  timer.print();
+  timer.print("finalize");
 
 
   // Descriptor set for all elements
@@ -114,6 +115,7 @@ bool Scene::load(const std::string& filename)
   m_gltf.m_primMeshes = gltf.m_primMeshes;
   m_gltf.m_materials  = gltf.m_materials;
   m_gltf.m_dimensions = gltf.m_dimensions;
+  m_gltf.m_cameras    = gltf.m_cameras;
 
   return true;
 }
@@ -138,13 +140,13 @@ bool Scene::loadGltfScene(const std::string& filename, tinygltf::Model& tmodel)
     // because it is faster to use FreeImage
     tcontext.RemoveImageLoader();
     result = tcontext.LoadASCIIFromFile(&tmodel, &error, &warn, filename);
-    timer.print();
+    timer.print("gltf parse");
     if(result)
     {
       // Loading images in parallel using FreeImage
       LOGI("Loading %d external images", tmodel.images.size());
       tinygltf::loadExternalImages(&tmodel, filename);
-      timer.print();
+      timer.print("image load");
     }
   }
   else
@@ -152,7 +154,7 @@ bool Scene::loadGltfScene(const std::string& filename, tinygltf::Model& tmodel)
     // Binary loader
     tcontext.SetImageLoader(&tinygltf::LoadFreeImageData, nullptr);
     result = tcontext.LoadBinaryFromFile(&tmodel, &error, &warn, filename);
-    timer.print();
+    timer.print("gltf parse");
   }
 
   if(result == false)
@@ -229,29 +231,7 @@ void Scene::createVertexBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& glt
     {
 
       vertex.resize(primMesh.vertexCount);
-      for(size_t v_ctx = 0; v_ctx < primMesh.vertexCount; v_ctx++)
-      {
-        size_t           idx = primMesh.vertexOffset + v_ctx;
-        VertexAttributes v{};
-        v.position = gltf.m_positions[idx];
-        v.normal   = compress_unit_vec(gltf.m_normals[idx]);
-        v.tangent  = compress_unit_vec(gltf.m_tangents[idx]);
-        v.texcoord = gltf.m_texcoords0[idx];
-        v.color    = packUnorm4x8(gltf.m_colors0[idx]);
-
-        // Encode to the Less-Significant-Bit the handiness of the tangent
-        // Not a significant change on the UV to make a visual difference
-        //auto     uintBitsToFloat = [](uint32_t a) -> float { return *(float*)&(a); };
-        //auto     floatBitsToUint = [](float a) -> uint32_t { return *(uint32_t*)&(a); };
-        uint32_t value = floatBitsToUint(v.texcoord.y);
-        if(gltf.m_tangents[idx].w > 0)
-          value |= 1;  // set bit, H == +1
-        else
-          value &= ~1;  // clear bit, H == -1
-        v.texcoord.y = uintBitsToFloat(value);
-
-        vertex[v_ctx] = std::move(v);
-      }
+      convertVertices(gltf, primMesh.vertexOffset, primMesh.vertexCount, vertex.data());
       v_buffer = m_pAlloc->createBuffer(cmdBuf, vertex,
                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
                                             | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
@@ -282,7 +262,7 @@ void Scene::createVertexBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& glt
 
     prim_idx++;
   }
-  timer.print();
+  timer.print("vertex buffers");
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -335,6 +315,10 @@ void Scene::createLightBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& gltf
       l.type = LightType_Directional;
     else if(l_gltf.light.type == "spot")
       l.type = LightType_Spot;
+    const int nbSets = eLightGroupCount - eLightGroupPunctual;
+    const int index  = static_cast<int>(all_lights.size());
+    l.lightSet       = index < static_cast<int>(m_lightSets.size()) ? m_lightSets[index] : std::min(index, nbSets - 1);
+    l.lightSet       = std::max(0, std::min(l.lightSet, nbSets - 1));
     all_lights.emplace_back(l);
   }
 
@@ -353,50 +337,10 @@ void Scene::createMaterialBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& g
   LOGI(" - Create %d Material Buffer", gltf.m_materials.size());
   MilliTimer timer;
 
-  std::vector<GltfShadeMaterial> shadeMaterials;
-  for(auto& m : gltf.m_materials)
-  {
-    GltfShadeMaterial smat{};
-    smat.pbrBaseColorFactor           = m.baseColorFactor;
-    smat.pbrBaseColorTexture          = m.baseColorTexture;
-    smat.pbrMetallicFactor            = m.metallicFactor;
-    smat.pbrRoughnessFactor           = m.roughnessFactor;
-    smat.pbrMetallicRoughnessTexture  = m.metallicRoughnessTexture;
-    smat.khrDiffuseFactor             = m.specularGlossiness.diffuseFactor;
-    smat.khrSpecularFactor            = m.specularGlossiness.specularFactor;
-    smat.khrDiffuseTexture            = m.specularGlossiness.diffuseTexture;
-    smat.khrGlossinessFactor          = m.specularGlossiness.glossinessFactor;
-    smat.khrSpecularGlossinessTexture = m.specularGlossiness.specularGlossinessTexture;
-    smat.shadingModel                 = m.shadingModel;
-    smat.emissiveTexture              = m.emissiveTexture;
-    smat.emissiveFactor               = m.emissiveFactor;
-    smat.alphaMode                    = m.alphaMode;
-    smat.alphaCutoff                  = m.alphaCutoff;
-    smat.doubleSided                  = m.doubleSided;
-    smat.normalTexture                = m.normalTexture;
-    smat.normalTextureScale           = m.normalTextureScale;
-    smat.uvTransform                  = m.textureTransform.uvTransform;
-    smat.unlit                        = m.unlit.active;
-    smat.transmissionFactor           = m.transmission.factor;
-    smat.transmissionTexture          = m.transmission.texture;
-    smat.anisotropy                   = m.anisotropy.factor;
-    smat.anisotropyDirection          = m.anisotropy.direction;
-    smat.ior                          = m.ior.ior;
-    smat.attenuationColor             = m.volume.attenuationColor;
-    smat.thicknessFactor              = m.volume.thicknessFactor;
-    smat.thicknessTexture             = m.volume.thicknessTexture;
-    smat.attenuationDistance          = m.volume.attenuationDistance;
-    smat.clearcoatFactor              = m.clearcoat.factor;
-    smat.clearcoatRoughness           = m.clearcoat.roughnessFactor;
-    smat.clearcoatTexture             = m.clearcoat.texture;
-    smat.clearcoatRoughnessTexture    = m.clearcoat.roughnessTexture;
-    smat.sheen                        = packUnorm4x8(vec4(m.sheen.colorFactor, m.sheen.roughnessFactor));
-
-    shadeMaterials.emplace_back(smat);
-  }
+  std::vector<GltfShadeMaterial> shadeMaterials = convertMaterials(gltf.m_materials);
   m_buffer[eMaterial] = m_pAlloc->createBuffer(cmdBuf, shadeMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
   NAME_VK(m_buffer[eMaterial].buffer);
-  timer.print();
+  timer.print("material buffer");
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -459,47 +403,6 @@ void Scene::destroy()
   m_descSet       = VkDescriptorSet();
 }
 
-//--------------------------------------------------------------------------------------------------
-// Return the Vulkan sampler based on the glTF sampler information
-//
-VkSamplerCreateInfo gltfSamplerToVulkan(tinygltf::Sampler& tsampler)
-{
-  VkSamplerCreateInfo vk_sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
-
-  std::map<int, VkFilter> filters;
-  filters[9728] = VK_FILTER_NEAREST;  // NEAREST
-  filters[9729] = VK_FILTER_LINEAR;   // LINEAR
-  filters[9984] = VK_FILTER_NEAREST;  // NEAREST_MIPMAP_NEAREST
-  filters[9985] = VK_FILTER_LINEAR;   // LINEAR_MIPMAP_NEAREST
-  filters[9986] = VK_FILTER_NEAREST;  // NEAREST_MIPMAP_LINEAR
-  filters[9987] = VK_FILTER_LINEAR;   // LINEAR_MIPMAP_LINEAR
-
-  std::map<int, VkSamplerMipmapMode> mipmap;
-  mipmap[9728] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // NEAREST
-  mipmap[9729] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // LINEAR
-  mipmap[9984] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // NEAREST_MIPMAP_NEAREST
-  mipmap[9985] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // LINEAR_MIPMAP_NEAREST
-  mipmap[9986] = VK_SAMPLER_MIPMAP_MODE_LINEAR;   // NEAREST_MIPMAP_LINEAR
-  mipmap[9987] = VK_SAMPLER_MIPMAP_MODE_LINEAR;   // LINEAR_MIPMAP_LINEAR
-
-  std::map<int, VkSamplerAddressMode> addressMode;
-  addressMode[33071] = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  addressMode[33648] = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-  addressMode[10497] = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-  vk_sampler.magFilter  = filters[tsampler.magFilter];
-  vk_sampler.minFilter  = filters[tsampler.minFilter];
-  vk_sampler.mipmapMode = mipmap[tsampler.minFilter];
-
-  vk_sampler.addressModeU = addressMode[tsampler.wrapS];
-  vk_sampler.addressModeV = addressMode[tsampler.wrapT];
-
-  // Always allow LOD
-  vk_sampler.maxLod = FLT_MAX;
-  return vk_sampler;
-}
-
-
 //--------------------------------------------------------------------------------------------------
 // Uploading all textures and images to the GPU
 //
@@ -532,7 +435,7 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
   {
     // No images, add a default one.
     addDefaultTexture();
-    timer.print();
+    timer.print("textures");
     return;
   }
 
@@ -594,7 +497,7 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
     NAME_IDX_VK(m_textures[i].image, i);
   }
 
-  timer.print();
+  timer.print("textures");
 }
 
 //--------------------------------------------------------------------------------------------------
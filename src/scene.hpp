@@ -75,6 +75,10 @@ public:
   const std::string&               getSceneName() const { return m_sceneName; }
   SceneCamera&                     getCamera() { return m_camera; }
 
+  // Relighting: set of each punctual light, before load(). Without it, light i is in set i, the
+  // last set also holding all the following lights (see LightGroups).
+  std::vector<int> m_lightSets;
+
 private:
   void createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfModel);
   void createDescriptorSet(const nvh::GltfScene& gltf);
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cfloat>
+#include <math.h>  // isinf() of compress.glsl, in the global namespace
+#include <map>
+
+#include "scene_conversion.hpp"
+#include "shaders/compress.glsl"
+#include "tiny_gltf.h"
+
+
+//--------------------------------------------------------------------------------------------------
+// Normal and tangent are compressed using the octahedral encoding
+// http://jcgt.org/published/0003/02/01/paper.pdf
+// The handiness of the tangent is stored in the less significant bit of the V component of the tcoord.
+// Color is encoded on 32bit
+//
+void convertVertices(const nvh::GltfScene& gltf, uint32_t vertexOffset, uint32_t vertexCount, VertexAttributes* dst)
+{
+  for(size_t v_ctx = 0; v_ctx < vertexCount; v_ctx++)
+  {
+    size_t           idx = vertexOffset + v_ctx;
+    VertexAttributes v{};
+    v.position = gltf.m_positions[idx];
+    v.normal   = compress_unit_vec(gltf.m_normals[idx]);
+    v.tangent  = compress_unit_vec(gltf.m_tangents[idx]);
+    v.texcoord = gltf.m_texcoords0[idx];
+    v.color    = packUnorm4x8(gltf.m_colors0[idx]);
+
+    // Encode to the Less-Significant-Bit the handiness of the tangent
+    // Not a significant change on the UV to make a visual difference
+    uint32_t value = floatBitsToUint(v.texcoord.y);
+    if(gltf.m_tangents[idx].w > 0)
+      value |= 1;  // set bit, H == +1
+    else
+      value &= ~1;  // clear bit, H == -1
+    v.texcoord.y = uintBitsToFloat(value);
+
+    dst[v_ctx] = std::move(v);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Converting the glTF material to the shading material
+// Most parameters are supported, and GltfShadeMaterial is GLSL packed compliant
+//
+std::vector<GltfShadeMaterial> convertMaterials(const std::vector<nvh::GltfMaterial>& materials)
+{
+  std::vector<GltfShadeMaterial> shadeMaterials;
+  shadeMaterials.reserve(materials.size());
+  for(auto& m : materials)
+  {
+    GltfShadeMaterial smat{};
+    smat.pbrBaseColorFactor           = m.baseColorFactor;
+    smat.pbrBaseColorTexture          = m.baseColorTexture;
+    smat.pbrMetallicFactor            = m.metallicFactor;
+    smat.pbrRoughnessFactor           = m.roughnessFactor;
+    smat.pbrMetallicRoughnessTexture  = m.metallicRoughnessTexture;
+    smat.khrDiffuseFactor             = m.specularGlossiness.diffuseFactor;
+    smat.khrSpecularFactor            = m.specularGlossiness.specularFactor;
+    smat.khrDiffuseTexture            = m.specularGlossiness.diffuseTexture;
+    smat.khrGlossinessFactor          = m.specularGlossiness.glossinessFactor;
+    smat.khrSpecularGlossinessTexture = m.specularGlossiness.specularGlossinessTexture;
+    smat.shadingModel                 = m.shadingModel;
+    smat.emissiveTexture              = m.emissiveTexture;
+    smat.emissiveFactor               = m.emissiveFactor;
+    smat.alphaMode                    = m.alphaMode;
+    smat.alphaCutoff                  = m.alphaCutoff;
+    smat.doubleSided                  = m.doubleSided;
+    smat.normalTexture                = m.normalTexture;
+    smat.normalTextureScale           = m.normalTextureScale;
+    smat.uvTransform                  = m.textureTransform.uvTransform;
+    smat.unlit                        = m.unlit.active;
+    smat.transmissionFactor           = m.transmission.factor;
+    smat.transmissionTexture          = m.transmission.texture;
+    smat.anisotropy                   = m.anisotropy.factor;
+    smat.anisotropyDirection          = m.anisotropy.direction;
+    smat.ior                          = m.ior.ior;
+    smat.attenuationColor             = m.volume.attenuationColor;
+    smat.thicknessFactor              = m.volume.thicknessFactor;
+    smat.thicknessTexture             = m.volume.thicknessTexture;
+    smat.attenuationDistance          = m.volume.attenuationDistance;
+    smat.clearcoatFactor              = m.clearcoat.factor;
+    smat.clearcoatRoughness           = m.clearcoat.roughnessFactor;
+    smat.clearcoatTexture             = m.clearcoat.texture;
+    smat.clearcoatRoughnessTexture    = m.clearcoat.roughnessTexture;
+    smat.sheen                        = packUnorm4x8(vec4(m.sheen.colorFactor, m.sheen.roughnessFactor));
+
+    shadeMaterials.emplace_back(smat);
+  }
+  return shadeMaterials;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return the Vulkan sampler based on the glTF sampler information
+//
+VkSamplerCreateInfo gltfSamplerToVulkan(const tinygltf::Sampler& tsampler)
+{
+  VkSamplerCreateInfo vk_sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+
+  std::map<int, VkFilter> filters;
+  filters[9728] = VK_FILTER_NEAREST;  // NEAREST
+  filters[9729] = VK_FILTER_LINEAR;   // LINEAR
+  filters[9984] = VK_FILTER_NEAREST;  // NEAREST_MIPMAP_NEAREST
+  filters[9985] = VK_FILTER_LINEAR;   // LINEAR_MIPMAP_NEAREST
+  filters[9986] = VK_FILTER_NEAREST;  // NEAREST_MIPMAP_LINEAR
+  filters[9987] = VK_FILTER_LINEAR;   // LINEAR_MIPMAP_LINEAR
+
+  std::map<int, VkSamplerMipmapMode> mipmap;
+  mipmap[9728] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // NEAREST
+  mipmap[9729] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // LINEAR
+  mipmap[9984] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // NEAREST_MIPMAP_NEAREST
+  mipmap[9985] = VK_SAMPLER_MIPMAP_MODE_NEAREST;  // LINEAR_MIPMAP_NEAREST
+  mipmap[9986] = VK_SAMPLER_MIPMAP_MODE_LINEAR;   // NEAREST_MIPMAP_LINEAR
+  mipmap[9987] = VK_SAMPLER_MIPMAP_MODE_LINEAR;   // LINEAR_MIPMAP_LINEAR
+
+  std::map<int, VkSamplerAddressMode> addressMode;
+  addressMode[33071] = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  addressMode[33648] = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  addressMode[10497] = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+  vk_sampler.magFilter  = filters[tsampler.magFilter];
+  vk_sampler.minFilter  = filters[tsampler.minFilter];
+  vk_sampler.mipmapMode = mipmap[tsampler.minFilter];
+
+  vk_sampler.addressModeU = addressMode[tsampler.wrapS];
+  vk_sampler.addressModeV = addressMode[tsampler.wrapT];
+
+  // Always allow LOD
+  vk_sampler.maxLod = FLT_MAX;
+  return vk_sampler;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include "nvh/gltfscene.hpp"
+#include "shaders/host_device.h"
+#include "vulkan/vulkan_core.h"
+
+//--------------------------------------------------------------------------------------------------
+// Conversion of the glTF data to the layouts used by the shaders. This is the host side part of
+// Scene::createVertexBuffer, Scene::createMaterialBuffer and Scene::createTextureImages, kept apart
+// so it can be measured without a device (see benchmarks/bench_scene_conversion.cpp).
+//
+
+// Vertices [vertexOffset, vertexOffset + vertexCount) of the scene, normal and tangent compressed
+// to octahedral, the color packed to RGBA8 and the handiness of the tangent in the LSB of texcoord.y
+void convertVertices(const nvh::GltfScene& gltf, uint32_t vertexOffset, uint32_t vertexCount, VertexAttributes* dst);
+
+// One GltfShadeMaterial per glTF material
+std::vector<GltfShadeMaterial> convertMaterials(const std::vector<nvh::GltfMaterial>& materials);
+
+// Return the Vulkan sampler based on the glTF sampler information
+VkSamplerCreateInfo gltfSamplerToVulkan(const tinygltf::Sampler& tsampler);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <fstream>
+#include <mutex>
+
+#include "json.hpp"  // nlohmann::json, bundled with tinygltf
+#include "nvh/nvprint.hpp"
+#include "stage_times.hpp"
+
+namespace stages {
+
+namespace {
+std::mutex         s_mutex;
+std::vector<Stage> s_stages;
+}  // namespace
+
+void record(const std::string& name, double ms)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  for(auto& stage : s_stages)
+  {
+    if(stage.name == name)
+    {
+      stage.ms += ms;
+      stage.count++;
+      return;
+    }
+  }
+  s_stages.push_back({name, ms, 1});
+}
+
+std::vector<Stage> all()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return s_stages;
+}
+
+bool writeJson(const std::string& filename)
+{
+  nlohmann::json list = nlohmann::json::array();
+  for(const auto& stage : all())
+    list.push_back({{"name", stage.name}, {"ms", stage.ms}, {"count", stage.count}});
+
+  std::ofstream file(filename);
+  file << nlohmann::json{{"stages", list}}.dump(2) << std::endl;
+  if(!file)
+  {
+    LOGE("Failed to write %s\n", filename.c_str());
+    return false;
+  }
+  LOGI("Stage times written to %s\n", filename.c_str());
+  return true;
+}
+
+}  // namespace stages
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Time of the stages of a run (glTF parse, textures, acceleration structures, render, ...), as
+// printed by MilliTimer::print(stage). With -stages they are written as JSON for the performance
+// regression runner (benchmarks/regression). A stage done several times sums its times.
+//
+namespace stages {
+
+struct Stage
+{
+  std::string name;
+  double      ms{0.};
+  int         count{0};
+};
+
+// Thread safe, the images are written in the background
+void               record(const std::string& name, double ms);
+std::vector<Stage> all();  // In the order they were first recorded
+
+// {"stages": [{"name": "gltf parse", "ms": 12.3, "count": 1}, ...]}
+bool writeJson(const std::string& filename);
+
+}  // namespace stages
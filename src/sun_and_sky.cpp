@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cmath>
+
+#include "sun_and_sky.hpp"
+#include "tools.hpp"
+
+
+namespace {
+
+//--------------------------------------------------------------------------------------------------
+// The minimum of GLSL needed to compile sun_and_sky.glsl. The functions are declared in this
+// namespace to hide the double and integer versions of the global namespace (ex. ::abs(int)).
+//
+namespace glsl {
+
+struct vec2
+{
+  float x{0}, y{0};
+  vec2() = default;
+  vec2(float x_, float y_)
+      : x(x_)
+      , y(y_)
+  {
+  }
+};
+
+struct vec3
+{
+  float x{0}, y{0}, z{0};
+  vec3() = default;
+  explicit vec3(float v)
+      : x(v)
+      , y(v)
+      , z(v)
+  {
+  }
+  vec3(float x_, float y_, float z_)
+      : x(x_)
+      , y(y_)
+      , z(z_)
+  {
+  }
+  vec3(const nvmath::vec3f& v)  // SunAndSky members
+      : x(v.x)
+      , y(v.y)
+      , z(v.z)
+  {
+  }
+
+  vec3& operator+=(const vec3& v) { return *this = vec3(x + v.x, y + v.y, z + v.z); }
+  vec3& operator*=(const vec3& v) { return *this = vec3(x * v.x, y * v.y, z * v.z); }
+  vec3& operator*=(float s) { return *this = vec3(x * s, y * s, z * s); }
+  vec3& operator/=(float s) { return *this = vec3(x / s, y / s, z / s); }
+};
+
+inline vec3 operator+(const vec3& a, const vec3& b) { return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline vec3 operator+(const vec3& a, float s) { return vec3(a.x + s, a.y + s, a.z + s); }
+inline vec3 operator*(const vec3& a, const vec3& b) { return vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline vec3 operator*(const vec3& a, float s) { return vec3(a.x * s, a.y * s, a.z * s); }
+inline vec3 operator*(float s, const vec3& a) { return a * s; }
+inline vec3 operator/(const vec3& a, float s) { return vec3(a.x / s, a.y / s, a.z / s); }
+
+inline float abs(float x) { return std::fabs(x); }
+inline float sqrt(float x) { return std::sqrt(x); }
+inline float cos(float x) { return std::cos(x); }
+inline float sin(float x) { return std::sin(x); }
+inline float tan(float x) { return std::tan(x); }
+inline float acos(float x) { return std::acos(x); }
+inline float exp(float x) { return std::exp(x); }
+inline float pow(float x, float y) { return std::pow(x, y); }
+inline vec3  exp(const vec3& v) { return vec3(exp(v.x), exp(v.y), exp(v.z)); }
+inline vec3  pow(const vec3& v, const vec3& p) { return vec3(pow(v.x, p.x), pow(v.y, p.y), pow(v.z, p.z)); }
+inline float dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(const vec3& v) { return sqrt(dot(v, v)); }
+inline vec3  normalize(const vec3& v) { return v / length(v); }
+inline vec3  cross(const vec3& a, const vec3& b)
+{
+  return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float smoothstep(float edge0, float edge1, float x)
+{
+  float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.f), 1.f);
+  return t * t * (3.f - 2.f * t);
+}
+
+vec3 cachedIrradiance(const vec3& sunDir);
+#define SUN_AND_SKY_IRRAD(sun_dir) cachedIrradiance(sun_dir)
+
+#define in  // GLSL parameter qualifier
+#include "shaders/sun_and_sky.glsl"
+#undef in
+
+// calc_irrad() integrates 25 directions of the sky, for each direction below the horizon.
+// The result is kept per thread, for the last sun direction.
+vec3 cachedIrradiance(const vec3& sunDir)
+{
+  thread_local bool valid = false;
+  thread_local vec3 key, irrad;
+  if(!valid || key.x != sunDir.x || key.y != sunDir.y || key.z != sunDir.z)
+  {
+    key   = sunDir;
+    irrad = calc_irrad(sunDir, 2.0);
+    valid = true;
+  }
+  return irrad;
+}
+
+}  // namespace glsl
+
+}  // namespace
+
+
+namespace sunsky {
+
+nvmath::vec3f evaluate(const SunAndSky& ss, const nvmath::vec3f& dir)
+{
+  glsl::vec3 c = glsl::sun_and_sky(ss, glsl::vec3(dir));
+  return {c.x, c.y, c.z};
+}
+
+// Same as sun_and_sky(): radius of the glow, 10 times the scaled sun disk
+float coneAngle(const SunAndSky& ss)
+{
+  return 0.00465f * 10.0f * ss.sun_disk_scale;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same parameterization as GetSphericalUv(): u = atan(z, x) / 2PI + 0.5, v = acos(y) / PI
+//
+void bake(const SunAndSky& ss, uint32_t width, FloatImage& image)
+{
+  const uint32_t w = std::max(width, 2u);
+  const uint32_t h = w / 2;
+  image.width      = w;
+  image.height     = h;
+  image.channels   = 3;
+  image.pixels.resize(size_t(w) * h * 3);
+
+  const float stepPhi   = float(2.0 * M_PI) / float(w);
+  const float stepTheta = float(M_PI) / float(h);
+
+  // Texels closer than this to the sun cone are supersampled
+  const nvmath::vec3f sunDir = nvmath::normalize(ss.sun_direction);
+  const float         cosMax = std::cos(std::min(coneAngle(ss) + std::sqrt(stepPhi * stepPhi + stepTheta * stepTheta), float(M_PI)));
+  const uint32_t      nbSub  = 4;
+
+  auto direction = [](float u, float v) {
+    const float phi   = u * float(2.0 * M_PI) - float(M_PI);
+    const float theta = v * float(M_PI);
+    return nvmath::vec3f(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+  };
+
+  parallelRanges(h, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; ++y)
+    {
+      float* dst = image.row(static_cast<uint32_t>(y));
+      for(uint32_t x = 0; x < w; ++x)
+      {
+        const float   u   = (float(x) + 0.5f) / float(w);
+        const float   v   = (float(y) + 0.5f) / float(h);
+        nvmath::vec3f dir = direction(u, v);
+        nvmath::vec3f color;
+        if(nvmath::dot(dir, sunDir) < cosMax)
+        {
+          color = evaluate(ss, dir);
+        }
+        else
+        {
+          // Averaging a regular grid of sub-samples, the sun disk is only a few texels wide
+          color = nvmath::vec3f(0.f, 0.f, 0.f);
+          for(uint32_t sy = 0; sy < nbSub; ++sy)
+            for(uint32_t sx = 0; sx < nbSub; ++sx)
+            {
+              nvmath::vec3f c = evaluate(ss, direction((float(x) + (float(sx) + 0.5f) / nbSub) / float(w),
+                                                       (float(y) + (float(sy) + 0.5f) / nbSub) / float(h)));
+              color.x += c.x;
+              color.y += c.y;
+              color.z += c.z;
+            }
+          const float norm = 1.f / float(nbSub * nbSub);
+          color            = nvmath::vec3f(color.x * norm, color.y * norm, color.z * norm);
+        }
+        dst[x * 3 + 0] = color.x;
+        dst[x * 3 + 1] = color.y;
+        dst[x * 3 + 2] = color.z;
+      }
+    }
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// The texels are attributed to the cone by their center
+//
+float coneImportance(const SunAndSky& ss, const FloatImage& image)
+{
+  if(ss.sun_disk_intensity <= 0.f || ss.sun_disk_scale <= 0.f || image.pixels.empty())
+    return 0.f;
+
+  const uint32_t      w         = image.width;
+  const uint32_t      h         = image.height;
+  const float         stepPhi   = float(2.0 * M_PI) / float(w);
+  const float         stepTheta = float(M_PI) / float(h);
+  const nvmath::vec3f sunDir    = nvmath::normalize(ss.sun_direction);
+  const float         cosMax    = std::cos(coneAngle(ss));
+
+  std::vector<double> rowTotal(h, 0.0);
+  std::vector<double> rowCone(h, 0.0);
+  parallelRanges(h, [&](uint64_t begin, uint64_t end) {
+    for(uint64_t y = begin; y < end; ++y)
+    {
+      const float  theta = (float(y) + 0.5f) * stepTheta;
+      const float  area  = (std::cos(float(y) * stepTheta) - std::cos(float(y + 1) * stepTheta)) * stepPhi;
+      const float* src   = image.row(static_cast<uint32_t>(y));
+      for(uint32_t x = 0; x < w; ++x)
+      {
+        const float*  p   = &src[x * image.channels];
+        const float   phi = (float(x) + 0.5f) * stepPhi - float(M_PI);
+        nvmath::vec3f dir(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+        const double  imp = double(area) * std::max(p[0], std::max(p[1], p[2]));
+        rowTotal[y] += imp;
+        if(nvmath::dot(dir, sunDir) >= cosMax)
+          rowCone[y] += imp;
+      }
+    }
+  });
+
+  double total = 0, cone = 0;
+  for(uint32_t y = 0; y < h; ++y)
+  {
+    total += rowTotal[y];
+    cone += rowCone[y];
+  }
+  return total > 0.0 ? static_cast<float>(cone / total) : 0.f;
+}
+
+}  // namespace sunsky
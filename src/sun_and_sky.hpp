@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include "image_io.hpp"
+#include "shaders/host_device.h"
+
+//--------------------------------------------------------------------------------------------------
+// Host evaluation of the Sun & Sky model. The code of shaders/sun_and_sky.glsl is compiled as is,
+// so the baked environment matches what the shaders compute.
+//
+// The sun disk and its glow are contained in a cone around the sun direction. The shaders evaluate
+// the model analytically inside that cone and use the baked environment everywhere else, see
+// EnvEval() in env_sampling.glsl.
+//
+namespace sunsky {
+
+// Radiance for the world direction `dir` (normalized), same as sun_and_sky() in the shaders
+nvmath::vec3f evaluate(const SunAndSky& ss, const nvmath::vec3f& dir);
+
+// Half angle (radians) of the cone holding the sun disk and its glow
+float coneAngle(const SunAndSky& ss);
+
+// Bake the model in a RGB lat-long image of `width` x `width`/2, rows are computed in parallel.
+// Texels overlapping the sun cone are supersampled.
+void bake(const SunAndSky& ss, uint32_t width, FloatImage& image);
+
+// Fraction of the importance (solid angle weighted max component, as in HdrSampling) of the baked
+// image which is in the sun cone. It is the probability of sampling the sun cone explicitly.
+float coneImportance(const SunAndSky& ss, const FloatImage& image);
+
+}  // namespace sunsky
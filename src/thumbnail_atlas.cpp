@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "json_utils.hpp"
+#include "nvh/nvprint.hpp"
+#include "thumbnail_atlas.hpp"
+
+namespace {
+
+Thumbnail thumbnailFromJson(const json& j)
+{
+  Thumbnail thumb;
+  thumb.output = j.value("output", thumb.output);
+  thumb.hdr    = j.value("hdr", thumb.hdr);
+
+  if(j.contains("instances"))
+  {
+    const json& range = j["instances"];
+    if(!range.is_array() || range.size() != 2)
+      throw std::runtime_error("\"instances\" is [first, count]");
+    thumb.firstInstance = range[0].get<int>();
+    thumb.nbInstances   = range[1].get<int>();
+    if(thumb.firstInstance < 0 || thumb.nbInstances < 1)
+      throw std::runtime_error("empty range of instances");
+  }
+
+  if(j.contains("camera"))
+    cameraFromJson(j["camera"], thumb);
+  return thumb;
+}
+
+}  // namespace
+
+
+bool loadThumbnails(const std::string& filename, const ThumbnailFarm& defaults, ThumbnailFarm& farm)
+{
+  std::ifstream file(filename);
+  if(!file)
+  {
+    LOGE("Cannot open the thumbnail file %s\n", filename.c_str());
+    return false;
+  }
+
+  try
+  {
+    json root = json::parse(file);
+
+    farm = defaults;
+    farm.thumbnails.clear();
+    if(root.contains("tile"))
+    {
+      const json& tile = root["tile"];
+      farm.tileWidth   = tile.is_array() ? tile.at(0).get<uint32_t>() : tile.get<uint32_t>();
+      farm.tileHeight  = tile.is_array() ? tile.at(1).get<uint32_t>() : farm.tileWidth;
+    }
+    farm.samples = root.value("samples", farm.samples);
+    farm.frames  = root.value("frames", farm.frames);
+    farm.maxSize = root.value("maxSize", farm.maxSize);
+    if(farm.tileWidth == 0 || farm.tileHeight == 0 || farm.tileWidth > farm.maxSize || farm.tileHeight > farm.maxSize)
+      throw std::runtime_error("invalid tile size");
+    if(farm.samples < 1 || farm.frames < 1)
+      throw std::runtime_error("invalid samples or frames");
+
+    for(const json& j : root.at("thumbnails"))
+    {
+      farm.thumbnails.push_back(thumbnailFromJson(j));
+      if(farm.thumbnails.back().output.empty() && farm.thumbnails.back().hdr.empty())
+        LOGW("Thumbnail %zu of %s has no output\n", farm.thumbnails.size() - 1, filename.c_str());
+    }
+  }
+  catch(const std::exception& e)
+  {
+    LOGE("Invalid thumbnail file %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+
+  LOGI("%zu thumbnails of %ux%u in %s\n", farm.thumbnails.size(), farm.tileWidth, farm.tileHeight, filename.c_str());
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// As many columns as rows, less when the atlas would be wider than maxSize. The rows are the
+// ones needed, up to maxSize: the remaining thumbnails go to the next launch.
+//
+void atlasGrid(const ThumbnailFarm& farm, uint32_t count, uint32_t& columns, uint32_t& rows)
+{
+  const uint32_t maxColumns = std::max(farm.maxSize / farm.tileWidth, 1u);
+  const uint32_t maxRows    = std::max(farm.maxSize / farm.tileHeight, 1u);
+
+  count   = std::max(count, 1u);
+  columns = std::min(static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))), maxColumns);
+  rows    = std::min((count + columns - 1) / columns, maxRows);
+}
+
+void cropImage(const OutputImage& atlas, uint32_t x, uint32_t y, uint32_t width, uint32_t height, OutputImage& tile)
+{
+  tile.width    = width;
+  tile.height   = height;
+  tile.channels = atlas.channels;
+  tile.names    = atlas.names;
+  tile.ldr.clear();
+  tile.hdr.clear();
+
+  const size_t rowSize = size_t(width) * atlas.channels;
+  if(!atlas.ldr.empty())
+  {
+    tile.ldr.resize(rowSize * height);
+    for(uint32_t row = 0; row < height; row++)
+      memcpy(&tile.ldr[row * rowSize], &atlas.ldr[(size_t(y + row) * atlas.width + x) * atlas.channels], rowSize);
+  }
+  else
+  {
+    tile.hdr.resize(rowSize * height);
+    for(uint32_t row = 0; row < height; row++)
+      memcpy(&tile.hdr[row * rowSize], &atlas.hdr[(size_t(y + row) * atlas.width + x) * atlas.channels], rowSize * sizeof(float));
+  }
+}
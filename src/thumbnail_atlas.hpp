@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "image_writer.hpp"
+#include "nvmath/nvmath.h"
+
+//--------------------------------------------------------------------------------------------------
+// Thumbnail farm: many small renders packed as the tiles of one image, rendered together. Each
+// tile has its camera and shows a range of the scene nodes (the instances of the TLAS). Read from
+// a JSON file:
+//
+//  {
+//    "tile": 256, "samples": 16, "frames": 8,
+//    "thumbnails": [
+//      { "instances": [0, 3], "output": "chair.png" },
+//      { "instances": [3, 1], "camera": { "eye": [2, 1, 2], "center": [0, 0.5, 0], "fov": 30 }, "output": "lamp.jpg" },
+//      { "camera": 1, "output": "room.png", "hdr": "room.exr" }
+//    ]
+//  }
+//
+// "tile" is the size of the square tiles or [width, height]. "instances" is [first, count] of
+// the nodes, all of them when missing. Without "camera", the current view direction and field of
+// view are used, with the camera fitted on the bounds of the instances.
+//
+struct Thumbnail
+{
+  std::string output;  // Tonemapped image, empty: none
+  std::string hdr;     // Accumulation buffer (.exr | .pfm), empty: none
+
+  int firstInstance{0};
+  int nbInstances{0};  // 0: all nodes
+
+  int           cameraIndex{-1};  // In gltf.m_cameras, -1: explicit camera or fitted on the instances
+  bool          hasCamera{false};
+  nvmath::vec3f eye{0.f, 0.f, 1.f};
+  nvmath::vec3f center{0.f, 0.f, 0.f};
+  nvmath::vec3f up{0.f, 1.f, 0.f};
+  float         fov{45.f};  // Vertical, in degrees
+};
+
+struct ThumbnailFarm
+{
+  uint32_t tileWidth{256};
+  uint32_t tileHeight{256};
+  uint32_t maxSize{8192};  // Largest side of the atlas, more thumbnails are rendered in several launches
+  int      samples{1};     // Samples per pixel in each frame
+  int      frames{1};      // Accumulated frames
+
+  std::vector<Thumbnail> thumbnails;
+};
+
+// Thumbnails of `filename`, starting from the settings of `defaults` (the command line)
+bool loadThumbnails(const std::string& filename, const ThumbnailFarm& defaults, ThumbnailFarm& farm);
+
+// Columns and rows of the atlas for `count` thumbnails, as square as possible and within maxSize
+void atlasGrid(const ThumbnailFarm& farm, uint32_t count, uint32_t& columns, uint32_t& rows);
+
+// The pixels of the rectangle (x, y, width, height) of `atlas`, 8-bit or float
+void cropImage(const OutputImage& atlas, uint32_t x, uint32_t y, uint32_t width, uint32_t height, OutputImage& tile);
@@ -31,16 +31,29 @@
 //   ... stuff ...
 //   double time_elapse = timer.elapse();
 // }
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <ios>
+#include <thread>
+#include <vector>
 
 #include "nvh/nvprint.hpp"
 #include "nvh/timesampler.hpp"
+#include "stage_times.hpp"
 
 struct MilliTimer : public nvh::Stopwatch
 {
   void print() { LOGI(" --> (%5.3f ms)\n", elapsed()); }
+
+  // Also recording the time of the stage (see stage_times.hpp), the timer restarts for the next one
+  void print(const char* stage)
+  {
+    const double ms = elapsed();
+    LOGI(" --> (%5.3f ms)\n", ms);
+    stages::record(stage, ms);
+    reset();
+  }
 };
 
 
@@ -54,4 +67,32 @@ std::string FormatNumbers(T value)
   return ss.str();
 }
 
+
+// Splitting [0, count) in contiguous ranges and calling fn(begin, end) on each, one range per thread.
+// The calling thread is working on the last range.
+template <typename F>
+void parallelRanges(uint64_t count, F&& fn, uint32_t numThreads = std::thread::hardware_concurrency())
+{
+  numThreads = std::max(1u, std::min(numThreads, static_cast<uint32_t>(std::min<uint64_t>(count, 1024))));
+  if(numThreads <= 1)
+  {
+    fn(uint64_t(0), count);
+    return;
+  }
+
+  const uint64_t           chunk = (count + numThreads - 1) / numThreads;
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for(uint32_t t = 0; t + 1 < numThreads; t++)
+  {
+    uint64_t begin = std::min(count, t * chunk);
+    uint64_t end   = std::min(count, begin + chunk);
+    threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
+  }
+  fn(std::min(count, (numThreads - 1) * chunk), count);
+
+  for(auto& t : threads)
+    t.join();
+}
+
 #endif